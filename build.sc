@@ -129,6 +129,73 @@ object diplomatic extends common.DiplomaticModule {
   def rocketModule = rocket
 
   def rocketchipModule = myrocketchip
+
+  /** the C++ of the rocket-chip style emulator in `resources/csrc`. The emulator itself is verilated by the flow which
+    * elaborates a TestHarness, `emulatorCMake` gives it the sources to compile next to the verilog, `tools` builds the
+    * standalone post-processors of its traces and logs.
+    */
+  object csrc extends Module {
+
+    def millSourcePath = m.millSourcePath / "resources" / "csrc"
+
+    /** emulator.cc and every DPI model and helper it links, whether or not the core instantiates their taps */
+    def emulatorSources = T.sources(
+      Seq("emulator", "SimDTM", "SimJTAG", "remote_bitbang", "dtm_replay", "commit_trace", "hpm_trace", "rocc_dpi")
+        .map(name => PathRef(millSourcePath / s"$name.cc"))
+    )
+
+    /** sources of the standalone tools, each is an executable of its own */
+    def toolSources = T.sources(
+      Seq("commit_render", "hpm_report", "comlog", "float_fix").map(name => PathRef(millSourcePath / s"$name.cc"))
+    )
+
+    /** emulator.cmake for the CMake project verilating a TestHarness, which `include()`s it and adds
+      * `ROCKET_EMULATOR_SOURCES` to the executable and `ROCKET_EMULATOR_INCLUDE_DIRS` to its include path
+      */
+    def emulatorCMake = T {
+      // format: off
+      os.write.over(T.dest / "emulator.cmake",
+        s"""set(ROCKET_EMULATOR_SOURCES
+           |${emulatorSources().map(_.path).mkString("\n")}
+           |)
+           |set(ROCKET_EMULATOR_INCLUDE_DIRS ${millSourcePath})
+           |""".stripMargin)
+      // format: on
+      PathRef(T.dest / "emulator.cmake")
+    }
+
+    def CMakeListsString = T {
+      // format: off
+      s"""cmake_minimum_required(VERSION 3.20)
+         |set(CMAKE_CXX_STANDARD 17)
+         |set(CMAKE_CXX_COMPILER_ID "clang")
+         |set(CMAKE_C_COMPILER "clang")
+         |set(CMAKE_CXX_COMPILER "clang++")
+         |
+         |project(emulator-tools)
+         |
+         |find_package(libspike REQUIRED)
+         |
+         |${toolSources().map { p =>
+              val name = p.path.baseName
+              s"""add_executable($name ${p.path})
+                 |target_include_directories($name PUBLIC ${millSourcePath})
+                 |""".stripMargin
+            }.mkString("\n")}
+         |# commit_render disassembles with spike
+         |target_link_libraries(commit_render PUBLIC libspike)
+         |""".stripMargin
+      // format: on
+    }
+
+    def tools = T.persistent {
+      os.write.over(T.dest / "CMakeLists.txt", CMakeListsString())
+      os.proc("cmake", "-G", "Ninja", T.dest.toString).call(T.dest)
+      os.proc("ninja").call(T.dest)
+      T.log.info(s"emulator tools generated in ${T.dest}")
+      PathRef(T.dest)
+    }
+  }
 }
 
 object cosim extends Module {
@@ -176,11 +243,16 @@ object cosim extends Module {
         Seq(
           "--dir", T.dest.toString,
           "--xlen", xLen
-        ),
+        ) ++ Option.when(clockGate())("--clock-gate"),
       )
       PathRef(T.dest)
     }
 
+    /** COSIM_CLOCK_GATE=1 elaborates a core and dcache with gated clocks */
+    def clockGate = T.input {
+      sys.env.get("COSIM_CLOCK_GATE").contains("1")
+    }
+
     def topName = T {
       chirrtl().path.last.split('.').head
     }
@@ -240,6 +312,27 @@ object cosim extends Module {
 
     val emulatorCores: Int = if(ncores > 8) 8 else ncores
 
+    /** EMULATOR_THREADS overrides the verilator threads, e.g. to measure their speedup */
+    def threads = T.input {
+      sys.env.get("EMULATOR_THREADS").map(_.toInt).getOrElse(emulatorCores)
+    }
+
+    /** SIM_CLOCK_MODELS=0 keeps the clocking blackboxes of diplomatic/resources/vsrc instead of their simulation
+      * models in vsrc/sim, which Verilator schedules and partitions across threads without derived clock races
+      */
+    def simClockModels = T.input {
+      !sys.env.get("SIM_CLOCK_MODELS").contains("0")
+    }
+
+    def simVsrcs = T.source {
+      os.pwd / "diplomatic" / "resources" / "vsrc" / "sim"
+    }
+
+    /** EMULATOR_ALLOC_STATS=1 counts the heap allocations of the process, on_finish reports them per committed insn */
+    def allocStats = T.input {
+      sys.env.get("EMULATOR_ALLOC_STATS").contains("1")
+    }
+
     val topName = "TestBench"
 
     def sources = T.sources(millSourcePath)
@@ -292,7 +385,12 @@ object cosim extends Module {
          |${allCSourceFiles().map(_.path).mkString("\n")}
          |)
          |
-         |target_include_directories(${topName} PUBLIC ${csources().path.toString})
+         |target_include_directories(${topName} PUBLIC ${csources().path.toString} ${sharedCSources().path.toString} ${myriscvopcodes.cxxDecodeTable().path.toString})
+         |
+         |# cosim_main.cc sizes the VerilatedContext of every instance for the model and runs as many COSIM_jobs instances
+         |# at a time as fit the hardware threads
+         |target_compile_definitions(${topName} PRIVATE COSIM_MODEL_THREADS=${threads()})
+         |${if (allocStats()) s"target_compile_definitions(${topName} PRIVATE COSIM_ALLOC_STATS)" else ""}
          |
          |target_link_libraries(${topName} PUBLIC $${CMAKE_THREAD_LIBS_INIT})
          |target_link_libraries(${topName} PUBLIC libspike fmt glog)  # note that libargs is header only, nothing to link
@@ -304,7 +402,7 @@ object cosim extends Module {
          |  TOP_MODULE TestBench
          |  PREFIX VTestBench
          |  OPT_FAST
-         |  THREADS ${emulatorCores}
+         |  THREADS ${threads()}
          |  VERILATOR_ARGS ${verilatorArgs().mkString(" ")}
          |)
          |""".stripMargin
@@ -315,8 +413,15 @@ object cosim extends Module {
       millSourcePath / "src"
     }
 
+    /** headers shared with the rocket-chip style emulator in diplomatic/resources/csrc */
+    def sharedCSources = T.source {
+      os.pwd / "diplomatic" / "resources" / "csrc"
+    }
+
     def vsrcs = T.persistent {
+      val models = if (simClockModels()) os.list(simVsrcs().path).map(p => p.last -> p).toMap else Map.empty[String, os.Path]
       mfccompile(xLen).rtls().filter(p => p.path.ext == "v" || p.path.ext == "sv")
+        .map(p => models.get(p.path.last).map(PathRef(_)).getOrElse(p))
     }
 
     def allCSourceFiles = T {
@@ -336,18 +441,219 @@ object cosim extends Module {
         "--output-split 20000",
         "--output-split-cfuncs 20000",
         "--max-num-width 1048576",
-        "--main",
         "--timing"
         // format: on
       )
     }
   }
 
+  /** standalone post-processing tools, every `.cc` in `cosim/tools/src` is a separate executable.
+    * They share headers with the emulator but must not depend on spike or verilator.
+    */
+  object tools extends Module {
+
+    def csources = T.source {
+      millSourcePath / "src"
+    }
+
+    def emulatorCSources = T.source {
+      millSourcePath / os.up / "emulator" / "src"
+    }
+
+    def sharedCSources = T.source {
+      os.pwd / "diplomatic" / "resources" / "csrc"
+    }
+
+    def toolSources = T {
+      Lib.findSourceFiles(Seq(csources()), Seq("cc")).map(PathRef(_))
+    }
+
+    def CMakeListsString = T {
+      // format: off
+      s"""cmake_minimum_required(VERSION 3.20)
+         |set(CMAKE_CXX_STANDARD 17)
+         |set(CMAKE_CXX_COMPILER_ID "clang")
+         |set(CMAKE_C_COMPILER "clang")
+         |set(CMAKE_CXX_COMPILER "clang++")
+         |
+         |project(cosim-tools)
+         |
+         |find_package(fmt REQUIRED)
+         |find_package(Threads REQUIRED)
+         |
+         |${toolSources().map { p =>
+              val name = p.path.baseName
+              s"""add_executable($name ${p.path})
+                 |target_include_directories($name PUBLIC ${emulatorCSources().path} ${sharedCSources().path} ${myriscvopcodes.cxxDecodeTable().path})
+                 |target_link_libraries($name PUBLIC fmt $${CMAKE_THREAD_LIBS_INIT})
+                 |""".stripMargin
+            }.mkString("\n")}
+         |""".stripMargin
+      // format: on
+    }
+
+    def bin = T.persistent {
+      os.write.over(T.dest / "CMakeLists.txt", CMakeListsString())
+      os.proc("cmake", "-G", "Ninja", T.dest.toString).call(T.dest)
+      os.proc("ninja").call(T.dest)
+      T.log.info(s"cosim tools generated in ${T.dest}")
+      PathRef(T.dest)
+    }
+  }
+
   object elaborate extends Cross[elaborate]("32", "64")
 
   object mfccompile extends Cross[mfccompile]("32", "64")
 
   object emulator extends Cross[emulator]("32", "64")
+
+  /** unit-level harnesses of the ALU, ABLU, BitManipCrypto and MulDiv of rocket, without a core around them:
+    * `elaborate` builds one top per unit with UNIT_LANES copies of it, `harness` verilates them all into one
+    * executable which checks them against the reference model in `harness/src`.
+    */
+  object units extends Module {
+    class elaborate(xLen: String) extends ScalaModule with ScalafmtModule {
+
+      def sources = T.sources(millSourcePath / "src")
+
+      def millSourcePath = super.millSourcePath / os.up
+
+      override def scalacPluginClasspath = T {
+        Agg(mychisel3.plugin.jar())
+      }
+
+      override def scalacOptions = T {
+        super.scalacOptions() ++ Some(mychisel3.plugin.jar()).map(path => s"-Xplugin:${path.path}")
+      }
+
+      override def scalaVersion = v.scala
+
+      // cosim.elaborate for its Convert phase
+      override def moduleDeps = Seq(rocket, cosim.elaborate(xLen))
+
+      override def ivyDeps = T {
+        Seq(
+          v.mainargs,
+          v.osLib
+        )
+      }
+
+      /** UNIT_LANES sets the copies of every unit which one eval of the harness computes */
+      def lanes = T.input {
+        sys.env.get("UNIT_LANES").map(_.toInt).getOrElse(16)
+      }
+
+      def elaborate = T {
+        upstreamCompileOutput()
+        mill.modules.Jvm.runLocal(
+          finalMainClass(),
+          runClasspath().map(_.path),
+          Seq(
+            "--dir", T.dest.toString,
+            "--xlen", xLen,
+            "--lanes", lanes().toString
+          ),
+        )
+        PathRef(T.dest)
+      }
+
+      def chirrtls = T {
+        os.walk(elaborate().path).filter(_.ext == "fir").map(PathRef(_))
+      }
+    }
+
+    class mfccompile(xLen: String) extends Module {
+
+      def millSourcePath = super.millSourcePath / os.up
+
+      /** the verilog of every top, by top name */
+      def rtls = T {
+        elaborate(xLen).chirrtls().map { fir =>
+          val topName = fir.path.baseName
+          val dest = T.dest / topName
+          os.makeDir.all(dest)
+          os.proc("firtool",
+            fir.path,
+            "-disable-infer-rw",
+            "-dedup",
+            "-O=release",
+            "--split-verilog",
+            s"-o=$dest"
+          ).call(dest)
+          topName -> os.read(dest / "filelist.f").split("\n").filter(_.nonEmpty)
+            .map(str => if (str.startsWith("./")) dest / str.drop(2) else os.Path(str, dest))
+            .filter(p => p.ext == "v" || p.ext == "sv").map(PathRef(_)).toSeq
+        }.toMap
+      }
+    }
+
+    class harness(xLen: String) extends Module {
+
+      def millSourcePath = super.millSourcePath / os.up
+
+      def csources = T.source {
+        millSourcePath / "src"
+      }
+
+      def allCSourceFiles = T {
+        Lib.findSourceFiles(Seq(csources().path), Seq("cc")).map(PathRef(_))
+      }
+
+      val topName = "unit_harness"
+
+      def CMakeListsString = T {
+        // format: off
+        s"""cmake_minimum_required(VERSION 3.20)
+           |set(CMAKE_CXX_STANDARD 17)
+           |set(CMAKE_CXX_COMPILER_ID "clang")
+           |set(CMAKE_C_COMPILER "clang")
+           |set(CMAKE_CXX_COMPILER "clang++")
+           |
+           |project(units)
+           |
+           |find_package(fmt REQUIRED)
+           |find_package(verilator REQUIRED)
+           |find_package(Threads REQUIRED)
+           |set(THREADS_PREFER_PTHREAD_FLAG ON)
+           |
+           |set(CMAKE_CXX_FLAGS "$${CMAKE_CXX_FLAGS} -O2 -march=native")
+           |
+           |add_executable(${topName}
+           |${allCSourceFiles().map(_.path).mkString("\n")}
+           |)
+           |target_include_directories(${topName} PUBLIC ${csources().path})
+           |target_compile_definitions(${topName} PUBLIC UNIT_XLEN=${xLen} UNIT_LANES=${elaborate(xLen).lanes()})
+           |target_link_libraries(${topName} PUBLIC fmt $${CMAKE_THREAD_LIBS_INIT})
+           |
+           |${mfccompile(xLen).rtls().map { case (top, rtls) =>
+                s"""verilate(${topName}
+                   |  SOURCES
+                   |${rtls.map(_.path).mkString("\n")}
+                   |  TOP_MODULE ${top}
+                   |  PREFIX V${top}
+                   |  OPT_FAST
+                   |  VERILATOR_ARGS -Wno-WIDTH --x-assign unique
+                   |)
+                   |""".stripMargin
+              }.mkString("\n")}
+           |""".stripMargin
+        // format: on
+      }
+
+      def elf = T.persistent {
+        os.write.over(T.dest / "CMakeLists.txt", CMakeListsString())
+        os.proc("cmake", "-G", "Ninja", T.dest.toString).call(T.dest)
+        os.proc("ninja").call(T.dest)
+        PathRef(T.dest / topName)
+      }
+    }
+
+    object elaborate extends Cross[elaborate]("32", "64")
+
+    object mfccompile extends Cross[mfccompile]("32", "64")
+
+    object harness extends Cross[harness]("32", "64")
+  }
 }
 
 object cases extends Module {
@@ -471,6 +777,7 @@ object tests extends Module() {
             "COSIM_wave" -> (T.dest / "wave").toString,
             "COSIM_reset_vector" -> "80000000",
             "COSIM_timeout" -> "100000",
+            "COSIM_coverage" -> (T.dest / s"$name.cov").toString,
             "passaddress" -> pass_address,
             "xlen" -> xlen
           )
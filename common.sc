@@ -66,4 +66,10 @@ trait RiscvOpcodesModule extends Module {
     os.proc("python", script().path, "csrs").call(stdout = f, env = Map("PYTHONPATH"->millSourcePath.toString))
     PathRef(f)
   }
+  // constexpr decode tables for the cosim, the PathRef is the directory of riscv_decode_table.h
+  def cxxDecodeTable = T {
+    val f = T.ctx.dest / "riscv_decode_table.h"
+    os.proc("python", script().path, "cxx").call(stdout = f, env = Map("PYTHONPATH"->millSourcePath.toString))
+    PathRef(T.ctx.dest)
+  }
 }
@@ -9,7 +9,10 @@ import org.chipsalliance.rocket._
 
 object RocketTileParamsKey extends Field[RocketTileParams]
 
-case class CosimConfig(xLength: Int) extends Config((site, here, up) => {
+/** clockGate gates the clocks of the core and the dcache with EICG_wrapper, the configuration to benchmark the clock
+  * models of vsrc/sim with
+  */
+case class CosimConfig(xLength: Int, clockGate: Boolean = false) extends Config((site, here, up) => {
   case MonitorsEnabled => false
   case XLen => xLength
   case MaxHartIdBits => 1
@@ -19,11 +22,13 @@ case class CosimConfig(xLength: Int) extends Config((site, here, up) => {
       mulUnroll = xLength,
       mulEarlyOut = true,
       divEarlyOut = true)),
-      fpu = Some(FPUParams(minFLen = 16, fLen = xLength))),
+      fpu = Some(FPUParams(minFLen = 16, fLen = xLength)),
+      clockGate = clockGate),
     dcache = Some(DCacheParams(
       rowBits = site(SystemBusKey).beatBits,
       nMSHRs = 0,
-      blockBytes = site(CacheBlockBytes))),
+      blockBytes = site(CacheBlockBytes),
+      clockGate = clockGate)),
     icache = Some(ICacheParams(
       rowBits = site(SystemBusKey).beatBits,
       blockBytes = site(CacheBlockBytes))))
@@ -10,14 +10,14 @@ import mainargs._
 import upickle.default._
 
 object Main {
-  @main def elaborate(@arg(name = "dir") dir: String, @arg("xlen") xlen: Int) = {
+  @main def elaborate(@arg(name = "dir") dir: String, @arg("xlen") xlen: Int, @arg(name = "clock-gate") clockGate: Flag) = {
     var topName: String = null
     val annos: AnnotationSeq = Seq(
       new chisel3.stage.phases.Elaborate,
       new chisel3.tests.elaborate.Convert
     ).foldLeft(
       Seq(
-        ChiselGeneratorAnnotation(() => new TestBench(xlen) )
+        ChiselGeneratorAnnotation(() => new TestBench(xlen, clockGate.value) )
       ): AnnotationSeq
     ) { case (annos, stage) => stage.transform(annos) }
       .flatMap {
@@ -50,8 +50,13 @@ class VerificationModule(dut:DUT) extends TapModule {
          |  reg _reset = 1'b1;
          |  initial #(${2 * clockRate + 1}) _reset = 0;
          |
+         |  // the fuzz mode resets the core between programs
+         |  import "DPI-C" function bit dpiFuzzReset();
+         |  reg _fuzzReset = 1'b0;
+         |  always @ (negedge _clock) _fuzzReset = dpiFuzzReset();
+         |
          |  assign clock = _clock;
-         |  assign reset = _reset;
+         |  assign reset = _reset | _fuzzReset;
          |
          |  import "DPI-C" function void dpiInitCosim();
          |  initial dpiInitCosim();
@@ -138,6 +143,7 @@ class VerificationModule(dut:DUT) extends TapModule {
     val wb_reg_inst = IO(Input(UInt(32.W)))
     val wb_valid    = IO(Input(Bool()))
     val ll_wen      = IO(Input(Bool()))
+    val wb_set_sboard = IO(Input(Bool()))
       setInline(
         s"$desiredName.sv",
         s"""module $desiredName(
@@ -145,6 +151,7 @@ class VerificationModule(dut:DUT) extends TapModule {
            |  input ll_wen,
            |  input rf_wen,
            |  input wb_valid,
+           |  input wb_set_sboard,
            |  input [31:0] rf_waddr,
            |  input [63:0] rf_wdata,
            |  input [31:0] wb_reg_pc,
@@ -159,6 +166,7 @@ class VerificationModule(dut:DUT) extends TapModule {
            |  input ll_wen,
            |  input bit rf_wen,
            |  input bit wb_valid,
+           |  input bit wb_set_sboard,
            |  input bit[31:0] rf_waddr,
            |  input bit[31:0] rf_wdata_high,
            |  input bit[31:0] rf_wdata_low,
@@ -169,6 +177,7 @@ class VerificationModule(dut:DUT) extends TapModule {
            |  ll_wen,
            |  rf_wen,
            |  wb_valid,
+           |  wb_set_sboard,
            |  rf_waddr,
            |  rf_wdata_high,
            |  rf_wdata_low,
@@ -188,8 +197,74 @@ class VerificationModule(dut:DUT) extends TapModule {
   dpiCommitPeek.wb_reg_pc   := tap(dut.ldut.rocketTile.module.core.rocketImpl.wb_reg_pc)
   dpiCommitPeek.wb_reg_inst := tap(dut.ldut.rocketTile.module.core.rocketImpl.wb_reg_inst)
   dpiCommitPeek.wb_valid    := tap(dut.ldut.rocketTile.module.core.rocketImpl.wb_valid)
+  dpiCommitPeek.wb_set_sboard := tap(dut.ldut.rocketTile.module.core.rocketImpl.wb_set_sboard)
   dpiCommitPeek.clock       := clock
 
+  // register file writes of the FPU, in hardfloat's recoded format
+  val fpu = dut.ldut.rocketTile.module.fpuOpt.get
+  val fRecodedWidth = xlen + 1
+  val dpiFpWritePeek = Module(new ExtModule with HasExtModuleInline {
+    override val desiredName = "dpiFpWritePeek"
+    val clock      = IO(Input(Clock()))
+    val load_wen   = IO(Input(Bool()))
+    val load_waddr = IO(Input(UInt(5.W)))
+    val load_wdata = IO(Input(UInt(fRecodedWidth.W)))
+    val wb_wen     = IO(Input(Bool()))
+    val wb_waddr   = IO(Input(UInt(5.W)))
+    val wb_wdata   = IO(Input(UInt(fRecodedWidth.W)))
+      setInline(
+        s"$desiredName.sv",
+        s"""module $desiredName(
+           |  input clock,
+           |  input load_wen,
+           |  input [4:0] load_waddr,
+           |  input [${fRecodedWidth - 1}:0] load_wdata,
+           |  input wb_wen,
+           |  input [4:0] wb_waddr,
+           |  input [${fRecodedWidth - 1}:0] wb_wdata
+           |);
+           |
+           |  bit[95:0] load_wdata_ext, wb_wdata_ext;
+           |  assign load_wdata_ext = {${96 - fRecodedWidth}'b0, load_wdata};
+           |  assign wb_wdata_ext   = {${96 - fRecodedWidth}'b0, wb_wdata};
+           |
+           |  import "DPI-C" function void $desiredName(
+           |  input bit load_wen,
+           |  input bit[4:0] load_waddr,
+           |  input bit[31:0] load_wdata_sign,
+           |  input bit[31:0] load_wdata_high,
+           |  input bit[31:0] load_wdata_low,
+           |  input bit wb_wen,
+           |  input bit[4:0] wb_waddr,
+           |  input bit[31:0] wb_wdata_sign,
+           |  input bit[31:0] wb_wdata_high,
+           |  input bit[31:0] wb_wdata_low
+           |  );
+           |  always @ (posedge clock) #($latPeekCommit) $desiredName(
+           |  load_wen,
+           |  load_waddr,
+           |  load_wdata_ext[95:64],
+           |  load_wdata_ext[63:32],
+           |  load_wdata_ext[31:0],
+           |  wb_wen,
+           |  wb_waddr,
+           |  wb_wdata_ext[95:64],
+           |  wb_wdata_ext[63:32],
+           |  wb_wdata_ext[31:0]
+           |  );
+           |
+           |endmodule
+           |""".stripMargin
+      )
+  })
+  dpiFpWritePeek.load_wen   := tap(fpu.load_wb)
+  dpiFpWritePeek.load_waddr := tap(fpu.load_wb_tag)
+  dpiFpWritePeek.load_wdata := tap(fpu.load_wb_wdata)
+  dpiFpWritePeek.wb_wen     := tap(fpu.wb_wen)
+  dpiFpWritePeek.wb_waddr   := tap(fpu.waddr)
+  dpiFpWritePeek.wb_wdata   := tap(fpu.wdata)
+  dpiFpWritePeek.clock      := clock
+
 
   @instantiable
   class PeekTL(param_a: TileLinkChannelAParameter, param_c: TileLinkChannelCParameter) extends ExtModule with HasExtModuleInline {
@@ -0,0 +1,55 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "alloc_stats.h"
+
+#ifdef COSIM_ALLOC_STATS
+
+static std::atomic<uint64_t> alloc_counter{0};
+
+void *operator new(size_t size) {
+  alloc_counter.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(size ? size : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void operator delete(void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+  std::free(p);
+}
+
+uint64_t alloc_count() {
+  return alloc_counter.load(std::memory_order_relaxed);
+}
+
+bool alloc_stats_enabled() {
+  return true;
+}
+
+#else
+
+uint64_t alloc_count() {
+  return 0;
+}
+
+bool alloc_stats_enabled() {
+  return false;
+}
+
+#endif
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+
+/// Number of global operator new calls since process start.
+/// Only counted when built with -DCOSIM_ALLOC_STATS (EMULATOR_ALLOC_STATS=1 for the mill build), otherwise always 0.
+uint64_t alloc_count();
+
+/// whether alloc_count() reports real numbers in this build
+bool alloc_stats_enabled();
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <string>
+
+#include <fmt/core.h>
+#include <glog/logging.h>
+
+#include "arch_digest.h"
+#include "glog_exception_safe.h"
+#include "recoded_float.h"
+#include "util.h"
+
+const char *arch_digest::file_name(reg_file file) {
+  switch (file) {
+    case XRF: return "x";
+    case FRF: return "f";
+    default: return "?";
+  }
+}
+
+digest_checker::digest_checker() {
+  full_compare_interval = std::stoul(get_env_arg_default("COSIM_digest_interval", "1000"), nullptr, 10);
+}
+
+void digest_checker::configure_fp(int flen_) {
+  CHECK_S(flen_ == 0 || flen_ == 32 || flen_ == 64) << fmt::format("unsupported flen {}", flen_);
+  flen = flen_;
+  f_mask = flen == 64 ? ~0ull : (1ull << flen) - 1;
+}
+
+void digest_checker::rtl_fp_write(uint32_t idx, uint64_t lo, uint64_t hi) {
+  if (!flen) return;
+  // the cosim FPU has floatTypes H to FLEN, see CosimConfig
+  uint64_t val = flen == 64 ? fpu_recoding_t<16, 64>::ieee(lo, hi) : fpu_recoding_t<16, 32>::ieee(lo, hi);
+  rtl.write(arch_digest::FRF, idx, val & f_mask);
+  pending[arch_digest::FRF]--;
+}
+
+void digest_checker::spike_write(uint64_t write_idx, uint64_t val, digest_point &point) {
+  // see SpikeEvent::log_arch_changes for the layout of write_idx
+  uint32_t idx = write_idx >> 4;
+  arch_digest::reg_file file;
+  switch (write_idx & 0xf) {
+    case 0b0000:
+      if (idx == 0) return;
+      file = arch_digest::XRF;
+      break;
+    case 0b0001:
+      if (!flen) return;
+      file = arch_digest::FRF;
+      val &= f_mask;
+      break;
+    default:
+      return;
+  }
+  spike.write(file, idx, val);
+  point.has_write[file] = true;
+  point.write_idx[file] = idx;
+  point.write_val[file] = val;
+}
+
+void digest_checker::spike_retire(digest_point &point) {
+  for (int f = 0; f < arch_digest::nFiles; f++) {
+    point.digests[f] = spike.get(static_cast<arch_digest::reg_file>(f));
+  }
+  spike_insns++;
+  point.has_snapshot = full_compare_interval != 0 && spike_insns % full_compare_interval == 0;
+  if (point.has_snapshot) {
+    memcpy(point.snapshot, spike.values(arch_digest::XRF), sizeof(point.snapshot));
+  }
+}
+
+bool digest_checker::settled(arch_digest::reg_file file) {
+  if (pending[file] == 0) {
+    unsettled_commits[file] = 0;
+    return true;
+  }
+  if (++unsettled_commits[file] > max_unsettled_commits) {
+    LOG(WARNING) << fmt::format("{} {} register writes unmatched for {} commits, resync digest tracking",
+                                pending[file], arch_digest::file_name(file), unsettled_commits[file]);
+    pending[file] = 0;
+    unsettled_commits[file] = 0;
+  }
+  return false;
+}
+
+void digest_checker::commit(uint64_t pc, uint32_t inst_bits, const digest_point &point, bool is_long_latency,
+                            bool is_csr) {
+  if (is_csr) rtl_adopt_spike_write(point);
+  if (is_long_latency) pending[arch_digest::XRF]++;
+  if (point.has_write[arch_digest::FRF]) pending[arch_digest::FRF]++;
+
+  log_entry &e = log[seq % log_size];
+  e.seq = seq;
+  e.pc = pc;
+  e.inst_bits = inst_bits;
+  for (int f = 0; f < arch_digest::nFiles; f++) {
+    e.has_write[f] = point.has_write[f];
+    e.write_idx[f] = point.write_idx[f];
+    e.write_val[f] = point.write_val[f];
+  }
+
+  for (int f = 0; f < arch_digest::nFiles; f++) {
+    auto file = static_cast<arch_digest::reg_file>(f);
+    if (!compared(file) || !settled(file)) continue;
+    if (point.digests[f] != rtl.get(file)) report_mismatch(file, point);
+    first_unmatched_seq[f] = seq + 1;
+    if (file == arch_digest::XRF && point.has_snapshot) full_compare(point, pc);
+  }
+  seq++;
+}
+
+void digest_checker::full_compare(const digest_point &point, uint64_t pc) {
+  full_compares++;
+  const uint64_t *rtl_regs = rtl.values(arch_digest::XRF);
+  for (int i = 1; i < arch_digest::nRegs; i++) {
+    CHECK_EQ_S(rtl_regs[i], point.snapshot[i])
+      << fmt::format(": full compare at pc={:08X} finds x{} differs, rtl={:08X} spike={:08X}", pc, i, rtl_regs[i],
+                     point.snapshot[i]);
+  }
+  CHECK_EQ_S(rtl.get(arch_digest::XRF), rtl.recompute(arch_digest::XRF))
+    << ": rtl incremental digest is out of sync with its registers";
+  CHECK_EQ_S(spike.get(arch_digest::XRF), spike.recompute(arch_digest::XRF))
+    << ": spike incremental digest is out of sync with its registers";
+  VLOG(1) << fmt::format("full state compare #{} passed at pc={:08X}", full_compares, pc);
+}
+
+void digest_checker::report_mismatch(arch_digest::reg_file file, const digest_point &point) {
+  // The digests matched after commit first_unmatched_seq - 1, the commits since then left a write of the file pending
+  // until this one. The bad write is among them: a register holds the last value written to it, so a register
+  // written in the window whose last spike write differs from what rtl holds now is a bad one.
+  const char *name = arch_digest::file_name(file);
+  uint64_t lo = std::max(first_unmatched_seq[file], seq + 1 > log_size ? seq + 1 - log_size : 0);
+  LOG(ERROR) << fmt::format("{} digest mismatch at commit #{}: spike={:016X} rtl={:016X}, {} commits since the last "
+                            "match{}", name, seq, point.digests[file], rtl.get(file), seq + 1 - first_unmatched_seq[file],
+                            lo > first_unmatched_seq[file] ? fmt::format(", the last {} logged", seq + 1 - lo) : "");
+  const log_entry *last_write[arch_digest::nRegs] = {};
+  for (uint64_t s = lo; s <= seq; s++) {
+    const log_entry &e = log[s % log_size];
+    if (e.has_write[file]) last_write[e.write_idx[file]] = &e;
+  }
+  const log_entry *first_bad = nullptr;
+  for (uint32_t i = 0; i < arch_digest::nRegs; i++) {
+    const log_entry *e = last_write[i];
+    if (!e || e->write_val[file] == rtl.value(file, i)) continue;
+    LOG(ERROR) << fmt::format("  {}{}: rtl={:016X} spike={:016X}, last written by commit #{} pc={:08X} bits={:08X}",
+                              name, i, rtl.value(file, i), e->write_val[file], e->seq, e->pc, e->inst_bits);
+    if (!first_bad || e->seq < first_bad->seq) first_bad = e;
+  }
+  if (!first_bad) {
+    LOG(FATAL_S) << fmt::format("{} digest mismatch, every {} register spike wrote since the last match holds spike's "
+                                "value: rtl wrote one spike did not", name, name);
+  }
+  LOG(FATAL_S) << fmt::format("{} digest mismatch, the earliest differing register was written by insn pc={:08X} "
+                              "bits={:08X}", name, first_bad->pc, first_bad->inst_bits);
+  __builtin_unreachable();
+}
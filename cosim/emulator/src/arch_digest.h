@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+/// Order independent digest of the architectural registers: the XOR of a keyed hash of every tracked register.
+/// A single write updates it in O(1), so spike and rtl can each keep one and compare a single word per commit.
+/// The integer and the f registers are tracked. Csrs are not: the cosim has no rtl taps of the csr file, and spike logs
+/// the WARL view of a csr where rocket keeps its own bundles, so neither side could be compared without false alarms.
+class arch_digest {
+public:
+    enum reg_file : uint8_t {
+        XRF = 0, FRF = 1, nFiles = 2
+    };
+    static constexpr int nRegs = 32;
+
+    arch_digest() { reset(); }
+
+    void reset() {
+      memset(regs, 0, sizeof(regs));
+      for (int f = 0; f < nFiles; f++) digests[f] = recompute(static_cast<reg_file>(f));
+    }
+
+    void write(reg_file file, uint32_t idx, uint64_t val) {
+      uint64_t &old = regs[file][idx];
+      digests[file] ^= hash(file, idx, old) ^ hash(file, idx, val);
+      old = val;
+    }
+
+    [[nodiscard]] uint64_t get(reg_file file) const { return digests[file]; }
+
+    [[nodiscard]] uint64_t value(reg_file file, uint32_t idx) const { return regs[file][idx]; }
+
+    [[nodiscard]] const uint64_t *values(reg_file file) const { return regs[file]; }
+
+    /// digest of one register file computed from scratch, used to validate the incremental one
+    [[nodiscard]] uint64_t recompute(reg_file file) const {
+      uint64_t d = 0;
+      for (uint32_t i = 0; i < nRegs; i++) d ^= hash(file, i, regs[file][i]);
+      return d;
+    }
+
+    static const char *file_name(reg_file file);
+
+private:
+    // splitmix64 finalizer over (value, register key)
+    static uint64_t hash(reg_file file, uint32_t idx, uint64_t val) {
+      uint64_t z = val ^ ((uint64_t(file) << 8 | idx) * 0x9E3779B97F4A7C15ull);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      return z ^ (z >> 31);
+    }
+
+    uint64_t regs[nFiles][nRegs];
+    uint64_t digests[nFiles];
+};
+
+/// digest values recorded by spike after executing one insn, carried by its SpikeEvent
+struct digest_point {
+    uint64_t digests[arch_digest::nFiles];
+    /// a full copy of the integer registers, taken every COSIM_digest_interval insns
+    bool has_snapshot;
+    uint64_t snapshot[arch_digest::nRegs];
+    /// the register of each file written by this insn, an insn writes at most one per file
+    bool has_write[arch_digest::nFiles];
+    uint32_t write_idx[arch_digest::nFiles];
+    uint64_t write_val[arch_digest::nFiles];
+};
+
+/// Keeps the spike and rtl digests and compares them at every commit. A file is only compared while rtl has no write
+/// of it pending: long latency integer writes and FPU writes land after their insn left the commit port. On a mismatch
+/// the writes logged since the last match name the registers which differ and the commits which wrote them.
+class digest_checker {
+public:
+    explicit digest_checker();
+
+    /// flen of the f registers, 0 leaves them out of the compare
+    void configure_fp(int flen);
+
+    /// rtl side: an integer register write seen on the commit port
+    void rtl_write(uint32_t idx, uint64_t val) {
+      if (idx != 0) rtl.write(arch_digest::XRF, idx, val);
+    }
+
+    /// rtl side: a long latency (ll_wen) integer register write
+    void rtl_ll_write(uint32_t idx, uint64_t val) {
+      rtl_write(idx, val);
+      pending[arch_digest::XRF]--;
+    }
+
+    /// rtl side: a write port of the FPU register file in hardfloat's recoded format, hi is bit 64 of a recoded double
+    void rtl_fp_write(uint32_t idx, uint64_t lo, uint64_t hi);
+
+    /// rtl side: the rd of a csr insn takes the value spike read. Rtl and spike legitimately disagree on counters like
+    /// cycle, time and instret, so the commit port skips these writes and the insn adopts spike's when it is popped.
+    void rtl_adopt_spike_write(const digest_point &point) {
+      if (point.has_write[arch_digest::XRF]) {
+        rtl_write(point.write_idx[arch_digest::XRF], point.write_val[arch_digest::XRF]);
+      }
+    }
+
+    /// spike side: a register write from spike's log_reg_write, keyed the same way
+    void spike_write(uint64_t write_idx, uint64_t val, digest_point &point);
+
+    /// spike side: seal the digest of an insn after all its writes are logged
+    void spike_retire(digest_point &point);
+
+    /// an insn is popped from to_rtl_queue after rtl committed it
+    void commit(uint64_t pc, uint32_t inst_bits, const digest_point &point, bool is_long_latency, bool is_csr);
+
+    /// forget both register states, for a fresh program after rtl and spike are reset
+    void reset() {
+      rtl.reset();
+      spike.reset();
+      for (int f = 0; f < arch_digest::nFiles; f++) {
+        first_unmatched_seq[f] = seq;
+        pending[f] = 0;
+        unsettled_commits[f] = 0;
+      }
+    }
+
+    arch_digest rtl;
+    arch_digest spike;
+
+private:
+    struct log_entry {
+        uint64_t seq;
+        uint64_t pc;
+        uint32_t inst_bits;
+        bool has_write[arch_digest::nFiles];
+        uint32_t write_idx[arch_digest::nFiles];
+        uint64_t write_val[arch_digest::nFiles];
+    };
+
+    [[nodiscard]] bool compared(arch_digest::reg_file file) const { return file == arch_digest::XRF || flen != 0; }
+
+    /// whether rtl has no write of the file pending, resyncs if a write is never matched
+    bool settled(arch_digest::reg_file file);
+
+    void full_compare(const digest_point &point, uint64_t pc);
+
+    [[noreturn]] void report_mismatch(arch_digest::reg_file file, const digest_point &point);
+
+    static constexpr size_t log_size = 4096;
+    log_entry log[log_size];
+    /// number of commits seen so far, log[seq % log_size] is the entry of commit seq
+    uint64_t seq = 0;
+    /// per file, seq following the last commit whose digests matched
+    uint64_t first_unmatched_seq[arch_digest::nFiles] = {};
+
+    /// per file, rtl writes expected by the committed insns minus the ones seen. It goes negative when the write comes
+    /// before the pop.
+    int64_t pending[arch_digest::nFiles] = {};
+    /// per file, commits since pending was last zero, used to resync if a write is never matched
+    uint64_t unsettled_commits[arch_digest::nFiles] = {};
+    static constexpr uint64_t max_unsettled_commits = 256;
+
+    int flen = 0;
+    uint64_t f_mask = 0;
+
+    /// full compare interval in spike insns, 0 to disable
+    uint64_t full_compare_interval;
+    uint64_t spike_insns = 0;
+    uint64_t full_compares = 0;
+};
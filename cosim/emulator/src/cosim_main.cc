@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "verilated.h"
+#include "VTestBench.h"
+
+#include "util.h"
+#include "vbridge_impl.h"
+
+// Runs the cosim TestBench. Without COSIM_jobs it simulates one instance configured by the process environment, like
+// the main Verilator generates. COSIM_jobs names a file of tests, one per line as KEY=VALUE settings on top of the
+// environment (blank lines and lines starting with # are skipped), e.g.
+//
+//   COSIM_bin=add.bin passaddress=80000040 COSIM_wave=add COSIM_flight_recorder_out=add-flight.log
+//
+// COSIM_instances of them run at a time, each with its own VerilatedContext, VTestBench and VBridgeImpl on a thread of
+// its own, so the tests share the loaded spike and the page cache of the process. Give every test its own output
+// files. Every instance runs COSIM_MODEL_THREADS model threads, so by default as many instances run as fit the
+// hardware threads; verilate with EMULATOR_THREADS=1 to run one instance per hardware thread. Snapshots are not taken
+// by instances which share the process.
+
+#ifndef COSIM_MODEL_THREADS
+#define COSIM_MODEL_THREADS 1
+#endif
+
+/// simulate one instance on the calling thread until it finishes, true if it passed
+static bool run_instance(const cosim_env *env, int argc, char **argv) {
+  instance_env = env;
+  auto context = std::make_unique<VerilatedContext>();
+  context->threads(COSIM_MODEL_THREADS);
+  context->commandArgs(argc, argv);
+  context->traceEverOn(true);
+  // a failing test stops its own context, not the process
+  if (env) context->fatalOnError(false);
+  Verilated::threadContextp(context.get());
+  create_vbridge(context.get());
+
+  {
+    // the scope names of the bridge start with the model name
+    auto top = std::make_unique<VTestBench>(context.get(), "TOP");
+    while (!context->gotFinish()) {
+      top->eval();
+      if (!top->eventsPending()) break;
+      context->time(top->nextTimeSlot());
+    }
+    top->final();
+  }
+  bool passed = context->gotFinish() && !context->gotError();
+  destroy_vbridge(context.get());
+  instance_env = nullptr;
+  return passed;
+}
+
+static std::vector<cosim_env> read_jobs(const std::string &path) {
+  std::ifstream in(path);
+  CHECK_S(in.is_open()) << fmt::format("cannot open COSIM_jobs file {}", path);
+  std::vector<cosim_env> jobs;
+  std::string line;
+  while (std::getline(in, line)) {
+    std::istringstream words(line);
+    std::string kv;
+    cosim_env env;
+    while (words >> kv) {
+      if (env.empty() && kv[0] == '#') break;
+      size_t eq = kv.find('=');
+      CHECK_S(eq != std::string::npos && eq > 0) << fmt::format("COSIM_jobs: expected KEY=VALUE, got '{}'", kv);
+      env[kv.substr(0, eq)] = kv.substr(eq + 1);
+    }
+    if (!env.empty()) jobs.push_back(std::move(env));
+  }
+  return jobs;
+}
+
+int main(int argc, char **argv) {
+  const char *jobs_path = std::getenv("COSIM_jobs");
+  if (!jobs_path) return run_instance(nullptr, argc, argv) ? 0 : 1;
+
+  std::vector<cosim_env> jobs = read_jobs(jobs_path);
+  unsigned hw = std::max(std::thread::hardware_concurrency(), 1u);
+  unsigned fit = std::max(hw / COSIM_MODEL_THREADS, 1u);
+  size_t instances = std::stoul(get_env_arg_default("COSIM_instances", std::to_string(fit).c_str()), nullptr, 10);
+  instances = std::clamp<size_t>(instances, 1, std::max<size_t>(jobs.size(), 1));
+  if (instances > 1 && instances * COSIM_MODEL_THREADS > hw) {
+    fmt::print(stderr, "{} instances of {} model threads each oversubscribe the {} hardware threads\n", instances,
+               COSIM_MODEL_THREADS, hw);
+  }
+
+  std::vector<char> passed(jobs.size(), 0);
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> pool;
+  for (size_t i = 0; i < instances; i++) {
+    pool.emplace_back([&] {
+      for (size_t job = next++; job < jobs.size(); job = next++) {
+        try {
+          passed[job] = run_instance(&jobs[job], argc, argv);
+        } catch (std::exception &e) {
+          fmt::print(stderr, "job {}: {}\n", job, e.what());
+        }
+      }
+    });
+  }
+  for (auto &thread: pool) thread.join();
+
+  size_t failed = 0;
+  for (size_t job = 0; job < jobs.size(); job++) {
+    const auto bin = jobs[job].find("COSIM_bin");
+    fmt::print("job {} ({}): {}\n", job, bin == jobs[job].end() ? "-" : bin->second, passed[job] ? "passed" : "FAILED");
+    failed += !passed[job];
+  }
+  fmt::print("{} of {} jobs passed on {} instances\n", jobs.size() - failed, jobs.size(), instances);
+  return failed ? 1 : 0;
+}
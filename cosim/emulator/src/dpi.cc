@@ -12,26 +12,35 @@
 #include "exceptions.h"
 #include "encoding.h"
 
-static bool terminated = false;
-
-
 void sigint_handler(int s) {
-  terminated = true;
-  dpiFinish();
+  interrupt_vbridges();
 }
 
-
+// every call is routed to the bridge of the VerilatedContext which makes it
 #define TRY(action) \
+  VBridgeImpl &bridge = current_vbridge(); \
   try {             \
-    if (!terminated) {action}          \
+    if (!bridge.terminated) {action}          \
   } catch (ReturnException &e) { \
-    terminated = true;                \
+    bridge.terminated = true;                \
     LOG(INFO) << fmt::format("test passed, gracefully quit simulation");                  \
+    bridge.on_finish(true);                \
     dpiFinish();    \
+  } catch (TimeoutException &e) { \
+    bridge.terminated = true;                \
+    LOG(ERROR) << fmt::format("simulation timeout, gracefully abort simulation");                 \
+    bridge.dump_flight_recorder("timeout"); \
+    bridge.on_finish(false);           \
+    dpiError("timeout");  \
   } catch (std::runtime_error &e) { \
-    terminated = true;                \
-    LOG(ERROR) << fmt::format("detect exception ({}), gracefully abort simulation", e.what());                 \
-    dpiError(e.what());  \
+    if (!bridge.fuzz_on_failure(e.what())) { \
+      bridge.terminated = true;                \
+      LOG(ERROR) << fmt::format("detect exception ({}), gracefully abort simulation", e.what());                 \
+      bridge.dump_flight_recorder(e.what()); \
+      bridge.resimulate_failure();       \
+      bridge.on_finish(false);           \
+      dpiError(e.what());  \
+    } \
   }
 
 #if VM_TRACE
@@ -46,16 +55,26 @@ void VBridgeImpl::dpiDumpWave() {
 
 [[maybe_unused]] void dpiInitCosim() {
   std::signal(SIGINT, sigint_handler);
-  svSetScope(svGetScopeFromName("TOP.TestBench.verificationModule.verbatim"));
   TRY({
-        vbridge_impl_instance.dpiInitCosim();
+        // the scope names are per context, this is the Verbatim module of the calling instance
+        bridge.scope = svGetScopeFromName("TOP.TestBench.verificationModule.verbatim");
+        svSetScope(bridge.scope);
+        bridge.dpiInitCosim();
       })
 }
 
 [[maybe_unused]] void dpiTimeoutCheck() {
   TRY({
-        vbridge_impl_instance.timeoutCheck();
+        bridge.timeoutCheck();
+      })
+}
+
+[[maybe_unused]] svBit dpiFuzzReset() {
+  svBit reset = 0;
+  TRY({
+        reset = bridge.dpiFuzzReset();
       })
+  return reset;
 }
 
 [[maybe_unused]] void dpiBasePoke(svBitVecVal *resetVector) {
@@ -70,11 +89,11 @@ dpiPeekTL(const svBitVecVal *pc, const svBitVecVal *a_opcode, const svBitVecVal
           const svBitVecVal *c_source, const svBitVecVal *c_address, const svBitVecVal *c_data, svBit a_corrupt,
           svBit a_valid, svBit c_corrupt, svBit c_valid, svBit d_ready, svBit miss) {
   TRY({
-        vbridge_impl_instance.dpiPeekTL(miss, *pc,
-                                        TlAPeekInterface{*a_opcode, *a_param, *a_size, *a_source, *a_address, *a_mask,
-                                                         *a_data, a_corrupt, a_valid, d_ready},
-                                        TlCPeekInterface{*c_opcode, *c_param, *c_size, *c_source, *c_address, *c_data,
-                                                         c_corrupt, c_valid});
+        bridge.dpiPeekTL(miss, *pc,
+                         TlAPeekInterface{*a_opcode, *a_param, *a_size, *a_source, *a_address, *a_mask, *a_data,
+                                          a_corrupt, a_valid, d_ready},
+                         TlCPeekInterface{*c_opcode, *c_param, *c_size, *c_source, *c_address, *c_data, c_corrupt,
+                                          c_valid});
       })
 }
 
@@ -83,7 +102,7 @@ dpiPokeTL(svBitVecVal *d_bits_data_high, svBitVecVal *d_bits_data_low, svBitVecV
           svBitVecVal *d_size, svBitVecVal *d_source, svBitVecVal *d_sink, svBitVecVal *d_denied, svBit *d_corrupt,
           svBit *d_valid, svBit d_ready) {
   TRY({
-        vbridge_impl_instance.dpiPokeTL(
+        bridge.dpiPokeTL(
             TlPokeInterface{d_bits_data_high, d_bits_data_low, d_opcode, d_param, d_size, d_source, d_sink, d_denied,
                             d_corrupt, d_valid, d_ready});
       })
@@ -95,23 +114,37 @@ dpiPokeTL(svBitVecVal *d_bits_data_high, svBitVecVal *d_bits_data_low, svBitVecV
 
 ) {
   TRY({
-        vbridge_impl_instance.dpiRefillQueue();
+        bridge.dpiRefillQueue();
       })
 
 
 }
 
 [[maybe_unused]] void
-dpiCommitPeek(svBit ll_wen, svBit rf_wen, svBit wb_valid, const svBitVecVal *rf_waddr, const svBitVecVal *rf_wdata_high,
-              const svBitVecVal *rf_wdata_low, const svBitVecVal *wb_reg_pc, const svBitVecVal *wb_reg_inst) {
+dpiCommitPeek(svBit ll_wen, svBit rf_wen, svBit wb_valid, svBit wb_set_sboard, const svBitVecVal *rf_waddr,
+              const svBitVecVal *rf_wdata_high, const svBitVecVal *rf_wdata_low, const svBitVecVal *wb_reg_pc,
+              const svBitVecVal *wb_reg_inst) {
   TRY({
-        vbridge_impl_instance.dpiCommitPeek(
-            CommitPeekInterface{ll_wen, rf_wen, wb_valid, *rf_waddr, *rf_wdata_high, *rf_wdata_low, *wb_reg_pc, *wb_reg_inst});
+        bridge.dpiCommitPeek(
+            CommitPeekInterface{ll_wen, rf_wen, wb_valid, wb_set_sboard, *rf_waddr, *rf_wdata_high, *rf_wdata_low,
+                                *wb_reg_pc, *wb_reg_inst});
       })
 
 
 }
 
+[[maybe_unused]] void
+dpiFpWritePeek(svBit load_wen, const svBitVecVal *load_waddr, const svBitVecVal *load_wdata_sign,
+               const svBitVecVal *load_wdata_high, const svBitVecVal *load_wdata_low, svBit wb_wen,
+               const svBitVecVal *wb_waddr, const svBitVecVal *wb_wdata_sign, const svBitVecVal *wb_wdata_high,
+               const svBitVecVal *wb_wdata_low) {
+  TRY({
+        bridge.dpiFpWritePeek(
+            FpWritePeekInterface{load_wen, *load_waddr, *load_wdata_sign, *load_wdata_high, *load_wdata_low, wb_wen,
+                                 *wb_waddr, *wb_wdata_sign, *wb_wdata_high, *wb_wdata_low});
+      })
+}
+
 
 
 
@@ -54,6 +54,8 @@ struct CommitPeekInterface {
     svBit ll_wen;
     svBit rf_wen;
     svBit wb_valid;
+    /// the committing insn writes back later through ll_wen
+    svBit wb_set_sboard;
     svBitVecVal rf_waddr;
     svBitVecVal rf_wdata_high;
     svBitVecVal rf_wdata_low;
@@ -61,4 +63,18 @@ struct CommitPeekInterface {
     svBitVecVal wb_reg_inst;
 };
 
+/// recoded values are split into 32 bit words, sign holds bit 64 of a recoded double
+struct FpWritePeekInterface {
+    svBit load_wen;
+    svBitVecVal load_waddr;
+    svBitVecVal load_wdata_sign;
+    svBitVecVal load_wdata_high;
+    svBitVecVal load_wdata_low;
+    svBit wb_wen;
+    svBitVecVal wb_waddr;
+    svBitVecVal wb_wdata_sign;
+    svBitVecVal wb_wdata_high;
+    svBitVecVal wb_wdata_low;
+};
+
 
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include <fmt/core.h>
+
+#include "glog_exception_safe.h"
+
+/// Fixed-capacity map stored inline, for the handful of entries a single instruction produces.
+/// Lookups are a linear scan, which beats a tree for N <= 8 and never touches the heap.
+template<typename K, typename V, size_t N>
+class fixed_map {
+public:
+    using value_type = std::pair<K, V>;
+    using iterator = value_type *;
+    using const_iterator = const value_type *;
+
+    iterator begin() { return entries; }
+
+    iterator end() { return entries + count; }
+
+    const_iterator begin() const { return entries; }
+
+    const_iterator end() const { return entries + count; }
+
+    [[nodiscard]] size_t size() const { return count; }
+
+    [[nodiscard]] bool empty() const { return count == 0; }
+
+    void clear() { count = 0; }
+
+    iterator find(const K &key) {
+      for (size_t i = 0; i < count; i++) {
+        if (entries[i].first == key) return &entries[i];
+      }
+      return end();
+    }
+
+    V &operator[](const K &key) {
+      auto it = find(key);
+      if (it != end()) return it->second;
+      CHECK_S(count < N) << fmt::format("fixed_map overflow, capacity={}", N);
+      entries[count] = value_type{key, V{}};
+      return entries[count++].second;
+    }
+
+private:
+    value_type entries[N];
+    size_t count = 0;
+};
+
+/// Fixed-capacity FIFO whose slots are constructed in place and recycled, so a steady stream of
+/// elements never allocates. Iteration goes from the oldest (front) to the newest (back) element.
+template<typename T, size_t N>
+class fixed_ring {
+public:
+    template<typename Ring, typename Elem>
+    class iter {
+    public:
+        iter(Ring *ring, size_t idx) : ring(ring), idx(idx) {}
+
+        Elem &operator*() const { return ring->at(idx); }
+
+        Elem *operator->() const { return &ring->at(idx); }
+
+        iter &operator++() {
+          idx++;
+          return *this;
+        }
+
+        bool operator==(const iter &other) const { return idx == other.idx; }
+
+        bool operator!=(const iter &other) const { return idx != other.idx; }
+
+    private:
+        Ring *ring;
+        size_t idx;
+    };
+
+    using iterator = iter<fixed_ring, T>;
+    using const_iterator = iter<const fixed_ring, const T>;
+
+    fixed_ring() = default;
+
+    fixed_ring(const fixed_ring &) = delete;
+
+    fixed_ring &operator=(const fixed_ring &) = delete;
+
+    ~fixed_ring() { clear(); }
+
+    [[nodiscard]] size_t size() const { return count; }
+
+    [[nodiscard]] bool empty() const { return count == 0; }
+
+    [[nodiscard]] bool full() const { return count == N; }
+
+    static constexpr size_t capacity() { return N; }
+
+    T &front() { return at(0); }
+
+    T &back() { return at(count - 1); }
+
+    /// i-th element counted from the oldest one
+    T &at(size_t i) { return *slot((head + i) % N); }
+
+    const T &at(size_t i) const { return *slot((head + i) % N); }
+
+    iterator begin() { return {this, 0}; }
+
+    iterator end() { return {this, count}; }
+
+    const_iterator begin() const { return {this, 0}; }
+
+    const_iterator end() const { return {this, count}; }
+
+    template<typename... Args>
+    T &emplace_back(Args &&... args) {
+      CHECK_S(count < N) << fmt::format("fixed_ring overflow, capacity={}", N);
+      T *p = new(slot((head + count) % N)) T(std::forward<Args>(args)...);
+      count++;
+      return *p;
+    }
+
+    void pop_front() {
+      std::destroy_at(slot(head));
+      head = (head + 1) % N;
+      count--;
+    }
+
+    void pop_back() {
+      std::destroy_at(slot((head + count - 1) % N));
+      count--;
+    }
+
+    void clear() {
+      while (count) pop_front();
+      head = 0;
+    }
+
+private:
+    T *slot(size_t i) { return std::launder(reinterpret_cast<T *>(&storage[i * sizeof(T)])); }
+
+    const T *slot(size_t i) const { return std::launder(reinterpret_cast<const T *>(&storage[i * sizeof(T)])); }
+
+    alignas(T) unsigned char storage[N * sizeof(T)];
+    size_t head = 0;
+    size_t count = 0;
+};
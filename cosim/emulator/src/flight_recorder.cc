@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <unordered_set>
+
+#include <fmt/core.h>
+#include <glog/logging.h>
+
+#include "glog_exception_safe.h"
+#include "flight_recorder.h"
+
+thread_local std::pair<uint64_t, flight_recorder::ring_t *>
+    flight_recorder::thread_rings[flight_recorder::max_recorders];
+
+static std::atomic<uint64_t> next_recorder_id{1};
+/// the ids of the recorders alive, the slots of the others are free
+static std::mutex live_mutex;
+static std::unordered_set<uint64_t> live_ids;
+
+flight_recorder::flight_recorder() : id(next_recorder_id++) {
+  std::lock_guard<std::mutex> lock(live_mutex);
+  live_ids.insert(id);
+}
+
+flight_recorder::~flight_recorder() {
+  std::lock_guard<std::mutex> lock(live_mutex);
+  live_ids.erase(id);
+}
+
+void flight_recorder::configure(size_t capacity) {
+  size_t n = 1;
+  while (n < capacity) n *= 2;
+  mask = capacity ? std::max<size_t>(n, 2) - 1 : 0;
+}
+
+flight_recorder::ring_t &flight_recorder::register_thread() {
+  auto *slot = std::begin(thread_rings);
+  {
+    std::lock_guard<std::mutex> lock(live_mutex);
+    slot = std::find_if(std::begin(thread_rings), std::end(thread_rings),
+                        [](const auto &entry) { return entry.first == 0 || !live_ids.count(entry.first); });
+  }
+  CHECK_S(slot != std::end(thread_rings))
+    << fmt::format("a thread records into more than {} live flight recorders", max_recorders);
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  auto &ring = rings.emplace_back(std::make_unique<ring_t>());
+  ring->events = std::make_unique<flight_event[]>(mask + 1);
+  *slot = {id, ring.get()};
+  return *ring;
+}
+
+void flight_recorder::clear() {
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  for (auto &ring: rings) ring->head = 0;
+}
+
+bool flight_recorder::dump(const std::string &path, const std::string &reason) {
+  struct numbered {
+    flight_event e;
+    size_t thread;
+    uint64_t seq;
+  };
+  std::vector<numbered> events;
+  {
+    std::lock_guard<std::mutex> lock(rings_mutex);
+    for (size_t i = 0; i < rings.size(); i++) {
+      const ring_t &ring = *rings[i];
+      uint64_t first = ring.head > mask + 1 ? ring.head - (mask + 1) : 0;
+      for (uint64_t seq = first; seq < ring.head; seq++) events.push_back({ring.events[seq & mask], i, seq});
+    }
+  }
+  // the rings share the time base, events of one thread keep their order within a time step
+  std::stable_sort(events.begin(), events.end(), [](const numbered &l, const numbered &r) {
+    return l.e.t != r.e.t ? l.e.t < r.e.t : l.thread != r.thread ? l.thread < r.thread : l.seq < r.seq;
+  });
+
+  FILE *file = fopen(path.c_str(), "w");
+  if (!file) return false;
+  fmt::print(file, "# {}\n# last {} events of {} threads\n", reason, events.size(), rings.size());
+  for (const auto &n: events) fmt::print(file, "[{}] {}: {}\n", n.e.t, n.thread, describe(n.e));
+  fclose(file);
+  return true;
+}
+
+std::string flight_recorder::describe(const flight_event &e) {
+  switch (e.kind) {
+    case flight_event::SPIKE_STEP:
+      return fmt::format("spike   pc={:08X} insn={:08X} x{}={:016X}", e.a, e.c, e.x, e.b);
+    case flight_event::TL_A:
+      return fmt::format("tl A    opcode={} source={} size={} addr={:08X} data={:016X}", e.x, e.c, e.y, e.a, e.b);
+    case flight_event::TL_C:
+      return fmt::format("tl C    opcode={} source={} size={} addr={:08X}", e.x, e.c, e.y, e.a);
+    case flight_event::TL_D:
+      return fmt::format("tl D    opcode={} source={} size={} data={:016X}", e.x, e.c, e.y, e.b);
+    case flight_event::COMMIT: {
+      std::string flags;
+      if (e.y & flight_event::COMMIT_WB_VALID) flags += " wb_valid";
+      if (e.y & flight_event::COMMIT_RF_WEN) flags += " rf_wen";
+      if (e.y & flight_event::COMMIT_LL_WEN) flags += " ll_wen";
+      if (e.y & flight_event::COMMIT_SET_SBOARD) flags += " set_sboard";
+      return fmt::format("commit  pc={:08X} insn={:08X} x{}={:016X}{}", e.a, e.c, e.x, e.b, flags);
+    }
+    default:
+      return fmt::format("unknown event {}", e.kind);
+  }
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/// One event of the flight recorder, raw values only: formatting waits for the dump.
+struct flight_event {
+    enum event_kind : uint8_t {
+        /// spike executed an insn: a = pc, b = rd after it, c = insn bits, x = rd
+        SPIKE_STEP,
+        /// a TL request on the A or C channel: a = address, b = data, c = source, x = opcode, y = size
+        TL_A, TL_C,
+        /// a D beat of the bridge: b = data, c = source, x = opcode, y = size
+        TL_D,
+        /// rtl committed an insn or wrote back through ll_wen: a = pc, b = rf_wdata, c = insn bits, x = rf_waddr,
+        /// y = the COMMIT_* flags
+        COMMIT,
+    };
+
+    enum : uint8_t {
+        COMMIT_WB_VALID = 1, COMMIT_RF_WEN = 2, COMMIT_LL_WEN = 4, COMMIT_SET_SBOARD = 8,
+    };
+
+    uint64_t t;
+    uint64_t a;
+    uint64_t b;
+    uint32_t c;
+    uint8_t kind;
+    uint8_t x;
+    uint8_t y;
+    uint8_t reserved;
+};
+
+/// A binary ring of the last events of every thread calling into the bridge (COSIM_flight_recorder events each).
+/// Recording stores one fixed size flight_event into memory of the calling thread: no formatting, no locks and no
+/// syscalls, so the full context of a failure costs nothing on passing runs, which run with glog quiet. When a run
+/// aborts, dump() merges the rings in time order and formats them into a file.
+class flight_recorder {
+public:
+    flight_recorder();
+
+    ~flight_recorder();
+
+    /// record the last capacity events per thread, rounded up to a power of 2, 0 disables recording
+    void configure(size_t capacity);
+
+    [[nodiscard]] bool enabled() const { return mask != 0; }
+
+    void record(uint64_t t, flight_event::event_kind kind, uint64_t a, uint64_t b, uint32_t c, uint8_t x = 0,
+                uint8_t y = 0) {
+      ring_t &r = local_ring();
+      r.events[r.head++ & mask] = flight_event{t, a, b, c, kind, x, y, 0};
+    }
+
+    /// forget the events of every thread, for a fresh program after rtl and spike are reset
+    void clear();
+
+    /// write the recorded events, oldest first, behind a line giving the reason, false if path cannot be written
+    bool dump(const std::string &path, const std::string &reason);
+
+    [[nodiscard]] static std::string describe(const flight_event &e);
+
+private:
+    struct ring_t {
+        std::unique_ptr<flight_event[]> events;
+        /// events recorded so far, the ring holds the last mask + 1 of them
+        uint64_t head = 0;
+    };
+
+    /// the ring of the calling thread, registered on its first event
+    ring_t &local_ring() {
+      for (auto &[owner, ring]: thread_rings) {
+        if (owner == id) return *ring;
+      }
+      return register_thread();
+    }
+
+    ring_t &register_thread();
+
+    /// the rings this thread records into, one per live recorder. A slot is keyed by the id of its recorder, ids are
+    /// never reused: the slot of a destroyed recorder never matches again and is taken over by the next one
+    static constexpr int max_recorders = 8;
+    static thread_local std::pair<uint64_t, ring_t *> thread_rings[max_recorders];
+
+    /// unique for the process, 0 marks a free slot
+    const uint64_t id;
+    size_t mask = 0;
+    std::mutex rings_mutex;
+    std::vector<std::unique_ptr<ring_t>> rings;
+};
@@ -0,0 +1,54 @@
+#include <fmt/core.h>
+#include <glog/logging.h>
+
+#include "fp_check.h"
+#include "glog_exception_safe.h"
+#include "recoded_float.h"
+
+// the cosim FPU has floatTypes H to FLEN, see CosimConfig
+typedef fpu_recoding_t<16, 64> fpu_recoding_64_t;
+typedef fpu_recoding_t<16, 32> fpu_recoding_32_t;
+
+void fp_write_checker::configure(int flen_) {
+  CHECK_S(flen_ == 0 || flen_ == 32 || flen_ == 64) << fmt::format("unsupported flen {}", flen_);
+  flen = flen_;
+  mask = flen == 64 ? ~0ull : (1ull << flen) - 1;
+  reset();
+}
+
+void fp_write_checker::spike_write(uint32_t idx, uint64_t val) {
+  auto &queue = expected[idx];
+  CHECK_S(!queue.full()) << fmt::format("{} spike writes of f{} were never written by rtl", queue_size, idx);
+  queue.emplace_back(val & mask);
+}
+
+void fp_write_checker::flush() {
+  size_t n = pending;
+  pending = 0;
+  if (flen == 64) {
+    fpu_recoding_64_t::ieee_batch(pending_lo, pending_hi, pending_ieee, n);
+  } else {
+    fpu_recoding_32_t::ieee_batch(pending_lo, pending_hi, pending_ieee, n);
+  }
+  for (size_t i = 0; i < n; i++) {
+    uint32_t idx = pending_idx[i];
+    uint64_t rtl = pending_ieee[i] & mask;
+    auto &queue = expected[idx];
+    if (queue.empty()) {
+      LOG(FATAL_S) << fmt::format("[{}] rtl wrote f{}={:016X} (recoded {:X}_{:016X}) without a spike write",
+                                  pending_t[i], idx, rtl, pending_hi[i], pending_lo[i]);
+    }
+    uint64_t spike = queue.front();
+    queue.pop_front();
+    if (rtl != spike) {
+      LOG(FATAL_S) << fmt::format("[{}] f{} mismatch: rtl={:016X} (recoded {:X}_{:016X}), spike={:016X}",
+                                  pending_t[i], idx, rtl, pending_hi[i], pending_lo[i], spike);
+    }
+    checked_writes++;
+  }
+}
+
+void fp_write_checker::reset() {
+  for (auto &queue: expected) queue.clear();
+  pending = 0;
+}
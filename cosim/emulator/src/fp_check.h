@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "flat_containers.h"
+
+/// Checks the register file writes of the FPU against spike. FP writebacks land after their insn left the integer
+/// commit port, so unlike the integer registers they do not fit the per-commit digests: instead the writes to each f
+/// register are matched in order. spike queues the value of every f write when it executes the insn, rtl writes are
+/// buffered in hardfloat's recoded format and unrecoded in batches with recoded_float.h before they are compared to
+/// the oldest value spike queued for their register.
+class fp_write_checker {
+public:
+    /// flen 0 disables the checker
+    void configure(int flen);
+
+    [[nodiscard]] bool enabled() const { return flen != 0; }
+
+    /// spike side: the NaN-boxed value of an f write from log_reg_write
+    void spike_write(uint32_t idx, uint64_t val);
+
+    /// rtl side: a write port of the FPU register file, hi is bit 64 of a recoded double
+    void rtl_write(uint64_t t, uint32_t idx, uint64_t lo, uint64_t hi) {
+      pending_t[pending] = t;
+      pending_idx[pending] = idx;
+      pending_lo[pending] = lo;
+      pending_hi[pending] = hi;
+      if (++pending == batch_size) flush();
+    }
+
+    /// compare the buffered rtl writes, throws on the first mismatch
+    void flush();
+
+    /// forget the queued and buffered writes, for a fresh program after rtl and spike are reset
+    void reset();
+
+    [[nodiscard]] uint64_t checked() const { return checked_writes; }
+
+private:
+    static constexpr size_t batch_size = 64;
+    /// spike runs at most to_rtl_queue_size insns ahead of the rtl commits and the rtl writes of a batch are not
+    /// matched yet, a register whose queue overflows is never written by rtl
+    static constexpr size_t queue_size = 128;
+    static constexpr int nRegs = 32;
+
+    int flen = 0;
+    uint64_t mask = 0;
+
+    fixed_ring<uint64_t, queue_size> expected[nRegs];
+
+    size_t pending = 0;
+    uint64_t pending_t[batch_size];
+    uint32_t pending_idx[batch_size];
+    uint64_t pending_lo[batch_size];
+    uint64_t pending_hi[batch_size];
+    uint64_t pending_ieee[batch_size];
+
+    uint64_t checked_writes = 0;
+};
@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <cstring>
+
+#include "fuzz.h"
+
+namespace {
+
+constexpr uint32_t OP_LOAD = 0b0000011;
+constexpr uint32_t OP_IMM = 0b0010011;
+constexpr uint32_t OP_AUIPC = 0b0010111;
+constexpr uint32_t OP_IMM_32 = 0b0011011;
+constexpr uint32_t OP_STORE = 0b0100011;
+constexpr uint32_t OP_OP = 0b0110011;
+constexpr uint32_t OP_LUI = 0b0110111;
+constexpr uint32_t OP_OP_32 = 0b0111011;
+constexpr uint32_t OP_BRANCH = 0b1100011;
+constexpr uint32_t OP_JAL = 0b1101111;
+
+uint32_t r_type(uint32_t funct7, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode) {
+  return funct7 << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+}
+
+uint32_t i_type(uint32_t imm, uint32_t rs1, uint32_t funct3, uint32_t rd, uint32_t opcode) {
+  return (imm & 0xfff) << 20 | rs1 << 15 | funct3 << 12 | rd << 7 | opcode;
+}
+
+uint32_t s_type(uint32_t imm, uint32_t rs2, uint32_t rs1, uint32_t funct3, uint32_t opcode) {
+  return (imm >> 5 & 0x7f) << 25 | rs2 << 20 | rs1 << 15 | funct3 << 12 | (imm & 0x1f) << 7 | opcode;
+}
+
+uint32_t u_type(uint32_t imm20, uint32_t rd, uint32_t opcode) {
+  return (imm20 & 0xfffff) << 12 | rd << 7 | opcode;
+}
+
+uint32_t b_offset(uint32_t offset) {
+  return (offset >> 12 & 1) << 31 | (offset >> 5 & 0x3f) << 25 | (offset >> 1 & 0xf) << 8 | (offset >> 11 & 1) << 7;
+}
+
+uint32_t j_offset(uint32_t offset) {
+  return (offset >> 20 & 1) << 31 | (offset >> 1 & 0x3ff) << 21 | (offset >> 11 & 1) << 20 |
+         (offset >> 12 & 0xff) << 12;
+}
+
+struct r_op {
+    uint32_t funct7, funct3, opcode;
+    bool rv64_only;
+};
+
+// add sub sll slt sltu xor srl sra or and, the M extension, and their 32 bit variants
+constexpr r_op r_ops[] = {
+    {0x00, 0, OP_OP, false}, {0x20, 0, OP_OP, false}, {0x00, 1, OP_OP, false}, {0x00, 2, OP_OP, false},
+    {0x00, 3, OP_OP, false}, {0x00, 4, OP_OP, false}, {0x00, 5, OP_OP, false}, {0x20, 5, OP_OP, false},
+    {0x00, 6, OP_OP, false}, {0x00, 7, OP_OP, false},
+    {0x01, 0, OP_OP, false}, {0x01, 1, OP_OP, false}, {0x01, 2, OP_OP, false}, {0x01, 3, OP_OP, false},
+    {0x01, 4, OP_OP, false}, {0x01, 5, OP_OP, false}, {0x01, 6, OP_OP, false}, {0x01, 7, OP_OP, false},
+    {0x00, 0, OP_OP_32, true}, {0x20, 0, OP_OP_32, true}, {0x00, 1, OP_OP_32, true}, {0x00, 5, OP_OP_32, true},
+    {0x20, 5, OP_OP_32, true}, {0x01, 0, OP_OP_32, true}, {0x01, 4, OP_OP_32, true}, {0x01, 5, OP_OP_32, true},
+    {0x01, 6, OP_OP_32, true}, {0x01, 7, OP_OP_32, true},
+};
+
+// byte size of lb lh lw ld lbu lhu lwu by funct3
+constexpr uint32_t load_size[] = {1, 2, 4, 8, 1, 2, 4};
+
+}  // namespace
+
+std::vector<uint32_t> fuzz_program::code() const {
+  std::vector<uint32_t> words(prologue);
+  words.reserve(prologue.size() + body.size() + epilogue_size);
+  for (size_t i = 0; i < body.size(); i++) {
+    const insn &in = body[i];
+    // a jump never goes past the first epilogue insn, removing insns while minimizing keeps the program valid
+    uint32_t skip = std::min<size_t>(in.skip, body.size() - i - 1);
+    uint32_t offset = 4 * (skip + 1);
+    switch (in.k) {
+      case BRANCH: words.push_back(in.bits | b_offset(offset)); break;
+      case JAL: words.push_back(in.bits | j_offset(offset)); break;
+      default: words.push_back(in.bits); break;
+    }
+  }
+  for (uint32_t r = 1; r < 31; r += 2) words.push_back(r_type(0, r + 1, r, 6, 0, OP_OP));  // or x0, xr, xr+1
+  words.push_back(OP_JAL);  // j .
+  return words;
+}
+
+std::vector<uint8_t> fuzz_program::image() const {
+  std::vector<uint32_t> words = code();
+  std::vector<uint8_t> bytes(data_offset + data_size, 0);
+  memcpy(bytes.data(), words.data(), std::min<size_t>(words.size() * 4, data_offset));
+  memcpy(bytes.data() + data_offset, data.data(), std::min<size_t>(data.size(), data_size));
+  return bytes;
+}
+
+fuzz_program fuzz_generator::generate(size_t len, uint64_t base) {
+  fuzz_program p;
+  // every register starts from a random 32 bit value
+  for (uint32_t r = 1; r < 31; r++) {
+    p.prologue.push_back(u_type(rng(), r, OP_LUI));
+    p.prologue.push_back(i_type(rng(), r, 0, r, OP_IMM));  // addi
+  }
+  uint64_t data_base = base + fuzz_program::data_offset;
+  p.prologue.push_back(u_type(data_base >> 12, 31, OP_LUI));
+  if (xlen == 64) {
+    // lui sign extends, clear the upper half again
+    p.prologue.push_back(i_type(32, 31, 1, 31, OP_IMM));  // slli
+    p.prologue.push_back(i_type(32, 31, 5, 31, OP_IMM));  // srli
+  }
+
+  // the body must fit below the data region
+  size_t max_len = fuzz_program::data_offset / 4 - p.prologue.size() - fuzz_program::epilogue_size;
+  len = std::min(len, max_len);
+  p.body.reserve(len);
+  for (size_t i = 0; i < len; i++) p.body.push_back(random_insn(len - i - 1));
+
+  p.data.resize(fuzz_program::data_size);
+  for (auto &b: p.data) b = rng();
+  return p;
+}
+
+fuzz_program::insn fuzz_generator::random_insn(size_t remaining) {
+  uint32_t pick = rng() % 100;
+  if (pick < 40) {
+    const r_op *op;
+    do {
+      op = &r_ops[rng() % std::size(r_ops)];
+    } while (op->rv64_only && xlen != 64);
+    return {r_type(op->funct7, reg(), reg(), op->funct3, reg(), op->opcode), fuzz_program::PLAIN, 0};
+  }
+  if (pick < 65) {
+    bool word = xlen == 64 && rng() % 4 == 0;
+    uint32_t opcode = word ? OP_IMM_32 : OP_IMM;
+    uint32_t shamt_mask = word || xlen == 32 ? 0x1f : 0x3f;
+    uint32_t imm = rng();
+    uint32_t funct3;
+    switch (rng() % 9) {
+      case 0: funct3 = 1; imm &= shamt_mask; break;                // slli
+      case 1: funct3 = 5; imm &= shamt_mask; break;                // srli
+      case 2: funct3 = 5; imm = 0x400 | (imm & shamt_mask); break; // srai
+      default: {
+        // addi slti sltiu xori ori andi, only addiw exists in OP-IMM-32
+        static constexpr uint32_t alu[] = {0, 2, 3, 4, 6, 7};
+        funct3 = word ? 0 : alu[rng() % std::size(alu)];
+        break;
+      }
+    }
+    return {i_type(imm, reg(), funct3, reg(), opcode), fuzz_program::PLAIN, 0};
+  }
+  if (pick < 77) {
+    uint32_t funct3;
+    do {
+      funct3 = rng() % std::size(load_size);
+    } while (xlen != 64 && (funct3 == 3 || funct3 == 6));  // ld and lwu
+    uint32_t offset = rng() % fuzz_program::data_size & ~(load_size[funct3] - 1);
+    return {i_type(offset, 31, funct3, reg(), OP_LOAD), fuzz_program::PLAIN, 0};
+  }
+  if (pick < 87) {
+    uint32_t funct3 = rng() % (xlen == 64 ? 4 : 3);
+    uint32_t offset = rng() % fuzz_program::data_size & ~((1u << funct3) - 1);
+    return {s_type(offset, reg(), 31, funct3, OP_STORE), fuzz_program::PLAIN, 0};
+  }
+  auto skip = static_cast<uint8_t>(std::min<size_t>(rng() % 5, remaining));
+  if (pick < 95) {
+    static constexpr uint32_t branch[] = {0, 1, 4, 5, 6, 7};  // beq bne blt bge bltu bgeu
+    uint32_t funct3 = branch[rng() % std::size(branch)];
+    return {r_type(0, reg(), reg(), funct3, 0, OP_BRANCH), fuzz_program::BRANCH, skip};
+  }
+  if (pick < 98) return {reg() << 7 | OP_JAL, fuzz_program::JAL, skip};
+  return {u_type(rng(), reg(), rng() % 2 ? OP_LUI : OP_AUIPC), fuzz_program::PLAIN, 0};
+}
+
+void fuzz_minimizer::start(const fuzz_program &failing) {
+  best = failing;
+  chunk = std::max<size_t>(best.body.size() / 2, 1);
+  pos = 0;
+  n_runs = 0;
+}
+
+bool fuzz_minimizer::next(fuzz_program &candidate) {
+  while (chunk > 0 && !best.body.empty()) {
+    if (pos < best.body.size()) {
+      trial = best;
+      trial.body.erase(trial.body.begin() + pos, trial.body.begin() + std::min(pos + chunk, best.body.size()));
+      candidate = trial;
+      return true;
+    }
+    chunk /= 2;
+    pos = 0;
+  }
+  return false;
+}
+
+void fuzz_minimizer::result(bool failed) {
+  n_runs++;
+  // the insns after pos shifted down on success, so pos already points at the next chunk
+  if (failed) best = trial;
+  else pos += chunk;
+}
+
+const fuzz_program *fuzz_session::next() {
+  switch (phase) {
+    case GENERATE:
+      if (limit != 0 && n_generated >= limit) return nullptr;
+      n_generated++;
+      current = gen.generate(len, base);
+      return &current;
+    case MINIMIZE:
+      if (minimizer.next(current)) return &current;
+      phase = DONE;
+      return nullptr;
+    default:
+      return nullptr;
+  }
+}
+
+void fuzz_session::report(bool failed, const std::string &error) {
+  switch (phase) {
+    case GENERATE:
+      if (!failed) {
+        n_passed++;
+        break;
+      }
+      what = error;
+      minimizer.start(current);
+      phase = MINIMIZE;
+      break;
+    case MINIMIZE:
+      minimizer.result(failed);
+      break;
+    default:
+      break;
+  }
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+/// A random RV32IM/RV64IM program for the in-process fuzz mode (COSIM_fuzz).
+/// Control flow only goes forward, so every program reaches the end loop; loads and stores stay in a private data
+/// region addressed through x31. The image starts at the reset vector and can be rerun as a normal COSIM_bin.
+struct fuzz_program {
+    enum kind : uint8_t {
+        PLAIN, BRANCH, JAL
+    };
+    struct insn {
+        /// for BRANCH and JAL the offset field is left zero and filled in by code()
+        uint32_t bits;
+        kind k;
+        /// number of following insns jumped over by a BRANCH or JAL
+        uint8_t skip;
+    };
+
+    static constexpr uint64_t data_offset = 0x10000;
+    /// accessed with a positive 12 bit offset from x31
+    static constexpr uint64_t data_size = 0x800;
+    /// reads every register to wait for outstanding long latency writes, then `j .`
+    static constexpr size_t epilogue_size = 16;
+
+    std::vector<uint32_t> prologue;
+    std::vector<insn> body;
+    std::vector<uint8_t> data;
+
+    [[nodiscard]] std::vector<uint32_t> code() const;
+
+    /// code and data laid out from the reset vector
+    [[nodiscard]] std::vector<uint8_t> image() const;
+
+    /// pc of the final `j .`, rtl committing it means the program is done
+    [[nodiscard]] uint64_t end_pc(uint64_t base) const {
+      return base + 4 * (prologue.size() + body.size() + epilogue_size - 1);
+    }
+};
+
+class fuzz_generator {
+public:
+    fuzz_generator(uint64_t seed, int xlen) : rng(seed), xlen(xlen) {}
+
+    fuzz_program generate(size_t len, uint64_t base);
+
+private:
+    /// x31 holds the data region base and is never written by the body
+    uint32_t reg() { return 1 + rng() % 30; }
+
+    fuzz_program::insn random_insn(size_t remaining);
+
+    std::mt19937_64 rng;
+    int xlen;
+};
+
+/// Shrinks a failing program by removing chunks of its body, halving the chunk size whenever no chunk of the current
+/// size can be removed (the complement step of ddmin).
+class fuzz_minimizer {
+public:
+    void start(const fuzz_program &failing);
+
+    /// next candidate to try, false when the program cannot be shrunk any further
+    bool next(fuzz_program &candidate);
+
+    /// outcome of the candidate returned by the last next()
+    void result(bool failed);
+
+    [[nodiscard]] const fuzz_program &smallest() const { return best; }
+
+    [[nodiscard]] uint64_t runs() const { return n_runs; }
+
+private:
+    fuzz_program best;
+    fuzz_program trial;
+    size_t chunk = 0;
+    size_t pos = 0;
+    uint64_t n_runs = 0;
+};
+
+/// Decides which program runs next: random ones until one fails or COSIM_fuzz programs passed, then the candidates
+/// of the minimizer.
+class fuzz_session {
+public:
+    fuzz_session(uint64_t seed, int xlen, size_t len, uint64_t limit, uint64_t base)
+        : gen(seed, xlen), len(len), limit(limit), base(base) {}
+
+    /// program to run next, nullptr when the session is over
+    const fuzz_program *next();
+
+    /// outcome of the program returned by the last next()
+    void report(bool failed, const std::string &what);
+
+    [[nodiscard]] bool failed() const { return phase != GENERATE; }
+
+    [[nodiscard]] bool minimizing() const { return phase == MINIMIZE; }
+
+    /// the minimizer has finished
+    [[nodiscard]] bool done() const { return phase == DONE; }
+
+    [[nodiscard]] const fuzz_program &smallest_failure() const { return minimizer.smallest(); }
+
+    /// error of the original failing program
+    [[nodiscard]] const std::string &failure_what() const { return what; }
+
+    [[nodiscard]] uint64_t passed() const { return n_passed; }
+
+    [[nodiscard]] uint64_t minimizer_runs() const { return minimizer.runs(); }
+
+private:
+    enum {
+        GENERATE, MINIMIZE, DONE
+    } phase = GENERATE;
+
+    fuzz_generator gen;
+    fuzz_minimizer minimizer;
+    fuzz_program current;
+    size_t len;
+    /// number of programs to generate, 0 to run until a failure
+    uint64_t limit;
+    uint64_t base;
+    uint64_t n_generated = 0;
+    uint64_t n_passed = 0;
+    std::string what;
+};
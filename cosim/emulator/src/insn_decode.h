@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+
+/// One insn of riscv-opcodes, classified for the cosim. The tables are generated by scripts/riscvopcodes.py for the
+/// extensions IDecode.scala and RVC.scala decode.
+struct riscv_insn_t {
+    enum : uint16_t {
+        RV32 = 1, RV64 = 2,
+        COMPRESSED = 4,
+        LOAD = 8, STORE = 16, AMO = 32,
+        CSR = 64,
+        /// F, D, Zfh and their compressed forms
+        FP = 128,
+        /// rd is an f register
+        FP_RD = 256,
+        /// M, written back through ll_wen
+        LONG_LATENCY = 512,
+    };
+
+    /// how the address of a memory access is formed
+    enum addr_mode : uint8_t {
+        ADDR_NONE,
+        /// rs1 + i_imm, rs1 + s_imm
+        ADDR_I, ADDR_S,
+        /// rs1, for AMOs and hypervisor loads/stores
+        ADDR_RS1,
+        /// rs1' + the scaled immediate of the compressed loads and stores
+        ADDR_C_LW, ADDR_C_LD,
+        /// sp + the scaled immediate
+        ADDR_C_LWSP, ADDR_C_LDSP, ADDR_C_SWSP, ADDR_C_SDSP,
+    };
+
+    /// where rd is encoded
+    enum rd_field : uint8_t {
+        RD_NONE,
+        /// bits 11:7
+        RD,
+        /// rd' in bits 4:2, rd'/rs1' in bits 9:7
+        RD_C_RS2S, RD_C_RS1S,
+        /// x1 of c.jal and c.jalr
+        RD_RA,
+    };
+
+    const char *name;
+    uint32_t mask;
+    uint32_t match;
+    uint16_t flags;
+    addr_mode addr;
+    rd_field rd;
+
+    [[nodiscard]] constexpr bool has(uint16_t flag) const { return flags & flag; }
+};
+
+/// first level of the dispatch, the major opcode of 32 bit insns and the quadrant and funct3 of compressed ones
+struct riscv_decode_bucket_t {
+    /// first slot of the bucket in riscv_decode_slots
+    uint16_t base;
+    /// the field of the insn that indexes the slots of the bucket
+    uint8_t lsb;
+    uint8_t width;
+};
+
+/// candidate insns of a slot, a range of riscv_decode_index ordered from the most specific mask
+struct riscv_decode_slot_t {
+    uint16_t start;
+    uint8_t count;
+};
+
+#include "riscv_decode_table.h"
+
+/// the insn of the given bits, nullptr for an encoding none of the decoded extensions has
+constexpr const riscv_insn_t *riscv_decode(uint32_t bits, int xlen) {
+  uint32_t key = (bits & 3) == 3 ? (bits >> 2) & 31 : 32 + (bits & 3) * 8 + ((bits >> 13) & 7);
+  const riscv_decode_bucket_t &bucket = riscv_decode_buckets[key];
+  const riscv_decode_slot_t &slot = riscv_decode_slots[bucket.base + ((bits >> bucket.lsb) & ((1u << bucket.width) - 1))];
+  uint16_t xlen_flag = xlen == 32 ? riscv_insn_t::RV32 : riscv_insn_t::RV64;
+  for (uint32_t i = slot.start; i < slot.start + slot.count; i++) {
+    const riscv_insn_t &insn = riscv_insns[riscv_decode_index[i]];
+    if ((bits & insn.mask) == insn.match && insn.has(xlen_flag)) return &insn;
+  }
+  return nullptr;
+}
+
+/// every insn decodes to itself, or to a more specific encoding that shadows it (c.nop is c.addi x0, 0)
+constexpr bool riscv_decode_consistent() {
+  for (const riscv_insn_t &insn: riscv_insns) {
+    for (int xlen = 32; xlen <= 64; xlen *= 2) {
+      if (!insn.has(xlen == 32 ? riscv_insn_t::RV32 : riscv_insn_t::RV64)) continue;
+      const riscv_insn_t *found = riscv_decode(insn.match, xlen);
+      if (found == nullptr || (insn.match & found->mask) != found->match) return false;
+      if (found != &insn && __builtin_popcount(found->mask) <= __builtin_popcount(insn.mask)) return false;
+    }
+  }
+  return true;
+}
+
+static_assert(riscv_decode_consistent(), "riscv_decode_table.h does not dispatch every insn to itself");
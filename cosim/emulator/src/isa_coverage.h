@@ -0,0 +1,312 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iterator>
+#include <string>
+
+#include "insn_decode.h"
+
+/// Instruction mix and ISA coverage counters of one run.
+/// Every counter is a bin in one flat array, so recording an insn is a few increments,
+/// and shards are merged by adding arrays. This header has no spike/glog dependency so cosim/tools can use it.
+struct isa_coverage {
+    enum ext : uint8_t {
+        I, M, A, F, D, Zfh, C, Zicsr, Zifencei, System, nExt
+    };
+
+    /// insns are identified by their entry in the decode table, the last id counts the ones it does not have
+    static constexpr uint32_t nOpIds = std::size(riscv_insns) + 1;
+    static constexpr uint32_t nRegs = 32;
+    /// immediates are binned by sign and number of significant bits, bin 0 of the positive half is zero
+    static constexpr uint32_t nImmBits = 33;
+    static constexpr uint32_t nCsrs = 4096;
+
+    enum section : uint32_t {
+        OP = 0,
+        EXT = OP + nOpIds,
+        RD = EXT + nExt,
+        RS1 = RD + nRegs,
+        RS2 = RS1 + nRegs,
+        IMM_POS = RS2 + nRegs,
+        IMM_NEG = IMM_POS + nImmBits,
+        CSR = IMM_NEG + nImmBits,
+        nBins = CSR + nCsrs
+    };
+
+    static constexpr uint32_t magic = 0x56434f52;  // "ROCV"
+    static constexpr uint32_t version = 2;
+
+    uint64_t bins[nBins] = {};
+
+    /// count an insn, insn is the entry riscv_decode found for bits or nullptr
+    void record(uint32_t bits, const riscv_insn_t *insn) {
+      bins[OP + (insn ? insn - riscv_insns : nOpIds - 1)]++;
+      if ((bits & 0b11) != 0b11) {
+        bins[EXT + C]++;
+        record_compressed(bits, insn);
+        return;
+      }
+      uint32_t major = bits >> 2 & 0b11111;
+      uint32_t funct3 = bits >> 12 & 0b111;
+      uint32_t funct7 = bits >> 25;
+      uint32_t rd = bits >> 7 & 0b11111;
+      uint32_t rs1 = bits >> 15 & 0b11111;
+      uint32_t rs2 = bits >> 20 & 0b11111;
+      bins[EXT + classify(major, funct3, funct7)]++;
+
+      switch (major) {
+        case 0b01100:  // OP
+        case 0b01110:  // OP-32
+        case 0b01011:  // AMO
+        case 0b10100:  // OP-FP
+        case 0b10000:  // MADD
+        case 0b10001:  // MSUB
+        case 0b10010:  // NMSUB
+        case 0b10011:  // NMADD
+          bins[RD + rd]++;
+          bins[RS1 + rs1]++;
+          bins[RS2 + rs2]++;
+          break;
+        case 0b00100:  // OP-IMM
+        case 0b00110:  // OP-IMM-32
+        case 0b00000:  // LOAD
+        case 0b00001:  // LOAD-FP
+        case 0b11001:  // JALR
+          bins[RD + rd]++;
+          bins[RS1 + rs1]++;
+          record_imm((int32_t) bits >> 20);
+          break;
+        case 0b01000:  // STORE
+        case 0b01001:  // STORE-FP
+          bins[RS1 + rs1]++;
+          bins[RS2 + rs2]++;
+          record_imm(((int32_t) bits >> 25 << 5) | (int32_t) rd);
+          break;
+        case 0b11000:  // BRANCH
+          bins[RS1 + rs1]++;
+          bins[RS2 + rs2]++;
+          record_imm(((int32_t) bits >> 31 << 12) | (int32_t) (bits << 4 & 0x800) | (int32_t) (bits >> 20 & 0x7e0) |
+                     (int32_t) (bits >> 7 & 0x1e));
+          break;
+        case 0b01101:  // LUI
+        case 0b00101:  // AUIPC
+          bins[RD + rd]++;
+          record_imm((int32_t) (bits & 0xfffff000));
+          break;
+        case 0b11011:  // JAL
+          bins[RD + rd]++;
+          record_imm(((int32_t) bits >> 31 << 20) | (int32_t) (bits & 0xff000) | (int32_t) (bits >> 9 & 0x800) |
+                     (int32_t) (bits >> 20 & 0x7fe));
+          break;
+        case 0b11100:  // SYSTEM
+          if (funct3 != 0 && funct3 != 4) {
+            bins[RD + rd]++;
+            bins[CSR + (bits >> 20)]++;
+          }
+          break;
+        default:
+          break;
+      }
+    }
+
+    void merge(const isa_coverage &other) {
+      for (uint32_t i = 0; i < nBins; i++) bins[i] += other.bins[i];
+    }
+
+    [[nodiscard]] uint64_t insns() const {
+      uint64_t n = 0;
+      for (uint32_t i = 0; i < nOpIds; i++) n += bins[OP + i];
+      return n;
+    }
+
+    [[nodiscard]] uint32_t covered(uint32_t begin = 0, uint32_t end = nBins) const {
+      uint32_t n = 0;
+      for (uint32_t i = begin; i < end; i++) n += bins[i] != 0;
+      return n;
+    }
+
+    bool save(const std::string &path) const {
+      FILE *f = fopen(path.c_str(), "wb");
+      if (!f) return false;
+      uint32_t header[3] = {magic, version, nBins};
+      bool ok = fwrite(header, sizeof(header), 1, f) == 1 && fwrite(bins, sizeof(bins), 1, f) == 1;
+      return fclose(f) == 0 && ok;
+    }
+
+    bool load(const std::string &path) {
+      FILE *f = fopen(path.c_str(), "rb");
+      if (!f) return false;
+      uint32_t header[3];
+      bool ok = fread(header, sizeof(header), 1, f) == 1 && header[0] == magic && header[1] == version &&
+                header[2] == nBins && fread(bins, sizeof(bins), 1, f) == 1;
+      fclose(f);
+      return ok;
+    }
+
+    static ext classify(uint32_t major, uint32_t funct3, uint32_t funct7) {
+      switch (major) {
+        case 0b01100:  // OP
+        case 0b01110:  // OP-32
+          return funct7 == 1 ? M : I;
+        case 0b01011:  // AMO
+          return A;
+        case 0b00001:  // LOAD-FP
+        case 0b01001:  // STORE-FP
+          return funct3 == 1 ? Zfh : funct3 == 3 ? D : F;
+        case 0b10100:  // OP-FP
+        case 0b10000:  // MADD
+        case 0b10001:  // MSUB
+        case 0b10010:  // NMSUB
+        case 0b10011:  // NMADD
+          switch (funct7 & 0b11) {
+            case 0: return F;
+            case 1: return D;
+            default: return Zfh;
+          }
+        case 0b00011:  // MISC-MEM
+          return funct3 == 1 ? Zifencei : I;
+        case 0b11100:  // SYSTEM
+          return funct3 == 0 ? System : Zicsr;
+        default:
+          return I;
+      }
+    }
+
+    static const char *ext_name(uint32_t e) {
+      static const char *names[nExt] = {"I", "M", "A", "F", "D", "Zfh", "C", "Zicsr", "Zifencei", "System"};
+      return e < nExt ? names[e] : "?";
+    }
+
+    /// name of an op id in riscv-opcodes, e.g. "add" or "c.addi"
+    static std::string op_name(uint32_t id) {
+      return id < nOpIds - 1 ? riscv_insns[id].name : "(custom)";
+    }
+
+private:
+    /// registers and immediate of a compressed insn, rd' and rs1' of the 3 bit fields are x8-x15
+    void record_compressed(uint32_t bits, const riscv_insn_t *insn) {
+      if (insn == nullptr) return;
+      auto field = [bits](int lsb, int width) { return bits >> lsb & ((1u << width) - 1); };
+      auto bit = [bits](int i, int to) { return (int32_t) (bits >> i & 1) << to; };
+      // the signed 6 bit immediate of c.addi, c.li, c.andi and friends
+      int32_t imm6 = ((int32_t) (bits << 19) >> 26 & ~0x1f) | (int32_t) field(2, 5);
+      uint32_t rd_rs1 = field(7, 5), rs2 = field(2, 5);
+      uint32_t rs1_p = 8 + field(7, 3), rs2_p = 8 + field(2, 3);
+
+      switch (insn->addr) {
+        case riscv_insn_t::ADDR_C_LW:
+        case riscv_insn_t::ADDR_C_LD:
+          bins[RS1 + rs1_p]++;
+          bins[(insn->has(riscv_insn_t::STORE) ? RS2 : RD) + rs2_p]++;
+          record_imm((int32_t) field(10, 3) << 3 |
+                     (insn->addr == riscv_insn_t::ADDR_C_LW ? bit(6, 2) | bit(5, 6) : (int32_t) field(5, 2) << 6));
+          return;
+        case riscv_insn_t::ADDR_C_LWSP:
+          bins[RS1 + 2]++;
+          bins[RD + rd_rs1]++;
+          record_imm(bit(12, 5) | (int32_t) field(4, 3) << 2 | (int32_t) field(2, 2) << 6);
+          return;
+        case riscv_insn_t::ADDR_C_LDSP:
+          bins[RS1 + 2]++;
+          bins[RD + rd_rs1]++;
+          record_imm(bit(12, 5) | (int32_t) field(5, 2) << 3 | (int32_t) field(2, 3) << 6);
+          return;
+        case riscv_insn_t::ADDR_C_SWSP:
+          bins[RS1 + 2]++;
+          bins[RS2 + rs2]++;
+          record_imm((int32_t) field(9, 4) << 2 | (int32_t) field(7, 2) << 6);
+          return;
+        case riscv_insn_t::ADDR_C_SDSP:
+          bins[RS1 + 2]++;
+          bins[RS2 + rs2]++;
+          record_imm((int32_t) field(10, 3) << 3 | (int32_t) field(7, 3) << 6);
+          return;
+        default:
+          break;
+      }
+
+      uint32_t quadrant = bits & 0b11, funct3 = field(13, 3);
+      switch (quadrant << 3 | funct3) {
+        case 0b00000:  // c.addi4spn
+          bins[RD + rs2_p]++;
+          bins[RS1 + 2]++;
+          record_imm((int32_t) field(11, 2) << 4 | (int32_t) field(7, 4) << 6 | bit(6, 2) | bit(5, 3));
+          break;
+        case 0b01000:  // c.addi, c.nop
+        case 0b01010:  // c.li
+          bins[RD + rd_rs1]++;
+          if (funct3 == 0b000) bins[RS1 + rd_rs1]++;
+          record_imm(imm6);
+          break;
+        case 0b01001:  // c.jal of rv32, c.addiw of rv64
+          if (insn->rd == riscv_insn_t::RD_RA) {
+            bins[RD + 1]++;
+            record_imm(cj_imm(bits));
+          } else {
+            bins[RD + rd_rs1]++;
+            bins[RS1 + rd_rs1]++;
+            record_imm(imm6);
+          }
+          break;
+        case 0b01011:  // c.addi16sp, c.lui
+          bins[RD + rd_rs1]++;
+          if (rd_rs1 == 2) {
+            bins[RS1 + 2]++;
+            record_imm(((int32_t) (bits << 19) >> 22 & ~0x1ff) | bit(6, 4) | bit(5, 6) | (int32_t) field(3, 2) << 7 |
+                       bit(2, 5));
+          } else {
+            record_imm(imm6 * (1 << 12));
+          }
+          break;
+        case 0b01100:  // c.srli, c.srai, c.andi, c.sub and the other register ops of rd'
+          bins[RD + rs1_p]++;
+          bins[RS1 + rs1_p]++;
+          if (field(10, 2) == 0b11) bins[RS2 + rs2_p]++;
+          else if (field(10, 2) == 0b10) record_imm(imm6);
+          else record_imm(bit(12, 5) | (int32_t) field(2, 5));
+          break;
+        case 0b01101:  // c.j
+          record_imm(cj_imm(bits));
+          break;
+        case 0b01110:  // c.beqz
+        case 0b01111:  // c.bnez
+          bins[RS1 + rs1_p]++;
+          record_imm(((int32_t) (bits << 19) >> 23 & ~0xff) | (int32_t) field(10, 2) << 3 | (int32_t) field(5, 2) << 6 |
+                     (int32_t) field(3, 2) << 1 | bit(2, 5));
+          break;
+        case 0b10000:  // c.slli
+          bins[RD + rd_rs1]++;
+          bins[RS1 + rd_rs1]++;
+          record_imm(bit(12, 5) | (int32_t) field(2, 5));
+          break;
+        case 0b10100:  // c.jr, c.mv, c.ebreak, c.jalr, c.add
+          if (rs2 == 0) {
+            if (rd_rs1 != 0) bins[RS1 + rd_rs1]++;
+            if (insn->rd == riscv_insn_t::RD_RA) bins[RD + 1]++;
+          } else {
+            bins[RD + rd_rs1]++;
+            if (field(12, 1)) bins[RS1 + rd_rs1]++;
+            bins[RS2 + rs2]++;
+          }
+          break;
+        default:
+          break;
+      }
+    }
+
+    /// the jump offset of c.j and c.jal
+    static int32_t cj_imm(uint32_t bits) {
+      auto bit = [bits](int i, int to) { return (int32_t) (bits >> i & 1) << to; };
+      return ((int32_t) (bits << 19) >> 20 & ~0x7ff) | bit(11, 4) | (int32_t) (bits >> 9 & 3) << 8 | bit(8, 10) |
+             bit(7, 6) | bit(6, 7) | (int32_t) (bits >> 3 & 7) << 1 | bit(2, 5);
+    }
+
+    void record_imm(int32_t imm) {
+      // a negative immediate is binned by the significant bits of its complement, so -1 lands in bin 0
+      uint32_t magnitude = imm >= 0 ? (uint32_t) imm : ~(uint32_t) imm;
+      uint32_t nbits = magnitude == 0 ? 0 : 32 - __builtin_clz(magnitude);
+      bins[(imm >= 0 ? IMM_POS : IMM_NEG) + nbits]++;
+    }
+};
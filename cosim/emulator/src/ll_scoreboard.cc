@@ -0,0 +1,86 @@
+#include <algorithm>
+#include <cstring>
+
+#include <fmt/core.h>
+#include <glog/logging.h>
+
+#include "glog_exception_safe.h"
+#include "ll_scoreboard.h"
+
+ll_scoreboard::insn_class ll_scoreboard::classify(const riscv_insn_t *decoded) {
+  // insns the decode table does not know are custom, i.e. RoCC
+  if (decoded == nullptr) return ROCC;
+  if (decoded->has(riscv_insn_t::LOAD) || decoded->has(riscv_insn_t::AMO)) return LOAD;
+  if (decoded->has(riscv_insn_t::LONG_LATENCY)) return strncmp(decoded->name, "mul", 3) == 0 ? MUL : DIV;
+  return OTHER;
+}
+
+const char *ll_scoreboard::class_name(insn_class cls) {
+  switch (cls) {
+    case LOAD: return "load";
+    case MUL: return "mul";
+    case DIV: return "div";
+    case ROCC: return "rocc";
+    default: return "other";
+  }
+}
+
+void ll_scoreboard::issue(uint64_t t, uint32_t waddr, uint64_t expected, uint64_t pc, insn_class cls) {
+  // ll_wen writes of x0 are dropped by the register file
+  if (waddr == 0) return;
+  auto &queue = regs[waddr];
+  CHECK_S(!queue.full()) << fmt::format("[{}] {} long latency writes of x{} in flight, the last at pc={:08X}", t,
+                                        depth, waddr, pc);
+  queue.emplace_back(entry{t, expected, pc, cls});
+  in_flight++;
+}
+
+void ll_scoreboard::writeback(uint64_t t, uint32_t waddr, uint64_t wdata) {
+  if (waddr == 0) return;
+  auto &queue = regs[waddr];
+  if (queue.empty()) {
+    LOG(FATAL_S) << fmt::format("[{}] ll_wen x{}={:016X} without a long latency insn in flight", t, waddr, wdata);
+  }
+  entry e = queue.front();
+  queue.pop_front();
+  in_flight--;
+  if (wdata != e.expected) {
+    LOG(FATAL_S) << fmt::format("[{}] ll_wen x{} of the {} at pc={:08X}: rtl={:016X}, spike={:016X}", t, waddr,
+                                class_name(e.cls), e.pc, wdata, e.expected);
+  }
+
+  uint64_t latency = t - e.t;
+  int bucket = std::min(latency == 0 ? 0 : 64 - __builtin_clzll(latency), nBuckets - 1);
+  histogram[e.cls][bucket]++;
+  max_latency[e.cls] = std::max(max_latency[e.cls], latency);
+  VLOG(1) << fmt::format("ll_wen x{} of pc={:08X} matched after {}", waddr, e.pc, latency);
+}
+
+void ll_scoreboard::reset() {
+  for (auto &queue: regs) queue.clear();
+  in_flight = 0;
+}
+
+std::string ll_scoreboard::summary() const {
+  std::string out;
+  for (int c = 0; c < nClasses; c++) {
+    uint64_t n = 0;
+    for (uint64_t count: histogram[c]) n += count;
+    if (n == 0) continue;
+    out += fmt::format("\n  {:5} {} writebacks, max latency {}:", class_name(static_cast<insn_class>(c)), n,
+                       max_latency[c]);
+    for (int b = 0; b < nBuckets; b++) {
+      if (histogram[c][b] == 0) continue;
+      if (b == 0) {
+        out += fmt::format(" [0]={}", histogram[c][b]);
+      } else {
+        out += fmt::format(" [{},{})={}", 1ull << (b - 1), b == nBuckets - 1 ? std::string("inf") :
+                                                           std::to_string(1ull << b), histogram[c][b]);
+      }
+    }
+  }
+  uint64_t pending_regs = 0;
+  for (const auto &queue: regs) pending_regs += !queue.empty();
+  if (in_flight) out += fmt::format("\n  {} still in flight on {} registers", in_flight, pending_regs);
+  return out;
+}
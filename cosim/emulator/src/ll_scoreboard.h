@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "flat_containers.h"
+#include "insn_decode.h"
+
+/// Integer writebacks in flight on the ll_wen port of rocket: divides and non-pipelined multiplies, loads that missed
+/// in the D$ and RoCC responses. They commit with wb_set_sboard and write back any number of cycles later, in any
+/// order across registers. Each register keeps its own FIFO of the values spike expects, so an ll_wen writeback is
+/// matched in O(1) however many others are outstanding, and the latency from commit to writeback is recorded in a
+/// log2 histogram per insn class.
+class ll_scoreboard {
+public:
+    enum insn_class : uint8_t {
+        LOAD, MUL, DIV, ROCC, OTHER, nClasses
+    };
+
+    static insn_class classify(const riscv_insn_t *decoded);
+
+    static const char *class_name(insn_class cls);
+
+    /// a long latency insn committed on rtl, expected is spike's value of waddr after it
+    void issue(uint64_t t, uint32_t waddr, uint64_t expected, uint64_t pc, insn_class cls);
+
+    /// an ll_wen writeback, throws if it does not match the oldest insn in flight on waddr
+    void writeback(uint64_t t, uint32_t waddr, uint64_t wdata);
+
+    [[nodiscard]] uint64_t outstanding() const { return in_flight; }
+
+    /// forget the insns in flight, for a fresh program after rtl and spike are reset. The histograms are kept.
+    void reset();
+
+    /// the latency histograms and the insns still in flight, one line per class
+    [[nodiscard]] std::string summary() const;
+
+private:
+    struct entry {
+        uint64_t t;
+        uint64_t expected;
+        uint64_t pc;
+        insn_class cls;
+    };
+
+    static constexpr int nRegs = 32;
+    /// rocket's scoreboard holds one long latency write per register, allow a few more
+    static constexpr size_t depth = 4;
+    fixed_ring<entry, depth> regs[nRegs];
+    uint64_t in_flight = 0;
+
+    /// bucket b counts latencies in [2^(b-1), 2^b), bucket 0 counts 0
+    static constexpr int nBuckets = 16;
+    uint64_t histogram[nClasses][nBuckets] = {};
+    uint64_t max_latency[nClasses] = {};
+};
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <map>
+
+#include <fmt/core.h>
+#include <glog/logging.h>
+
+#include "glog_exception_safe.h"
+#include "mem_timing.h"
+
+std::unique_ptr<mem_timing_model> mem_timing_model::create(const std::string &spec) {
+  size_t colon = spec.find(':');
+  std::string name = spec.substr(0, colon);
+  std::map<std::string, uint64_t> keys;
+  std::string args = colon == std::string::npos ? "" : spec.substr(colon + 1);
+  for (size_t pos = 0; pos < args.size();) {
+    size_t end = std::min(args.find(',', pos), args.size());
+    std::string kv = args.substr(pos, end - pos);
+    size_t eq = kv.find('=');
+    CHECK_S(eq != std::string::npos && eq + 1 < kv.size() &&
+            kv.find_first_not_of("0123456789", eq + 1) == std::string::npos)
+      << fmt::format("COSIM_mem_model: expected KEY=VALUE, got '{}'", kv);
+    keys[kv.substr(0, eq)] = std::stoull(kv.substr(eq + 1));
+    pos = end + 1;
+  }
+  // take a key of the model, the ones left over at the end are unknown
+  auto take = [&](const char *key, uint64_t def) {
+    auto it = keys.find(key);
+    if (it == keys.end()) return def;
+    uint64_t value = it->second;
+    keys.erase(it);
+    return value;
+  };
+
+  std::unique_ptr<mem_timing_model> model;
+  if (name == "fixed") {
+    model = std::make_unique<fixed_mem_timing>(take("latency", 0));
+  } else if (name == "queue") {
+    uint64_t latency = take("latency", 40);
+    uint64_t bytes_per_cycle = take("bytes_per_cycle", 8);
+    CHECK_S(bytes_per_cycle > 0) << ": COSIM_mem_model: bytes_per_cycle must not be 0";
+    model = std::make_unique<queue_mem_timing>(latency, bytes_per_cycle);
+  } else if (name == "dram") {
+    dram_timing::config cfg;
+    cfg.channels = take("channels", cfg.channels);
+    cfg.banks = take("banks", cfg.banks);
+    cfg.row_bytes = take("row_bytes", cfg.row_bytes);
+    cfg.ctrl = take("ctrl", cfg.ctrl);
+    cfg.tCL = take("tCL", cfg.tCL);
+    cfg.tRCD = take("tRCD", cfg.tRCD);
+    cfg.tRP = take("tRP", cfg.tRP);
+    cfg.burst = take("burst", cfg.burst);
+    cfg.tREFI = take("tREFI", cfg.tREFI);
+    cfg.tRFC = take("tRFC", cfg.tRFC);
+    CHECK_S(cfg.channels > 0 && cfg.banks > 0 && cfg.row_bytes >= 64)
+      << ": COSIM_mem_model: dram needs channels and banks > 0 and row_bytes >= 64";
+    CHECK_S(cfg.tREFI == 0 || cfg.tRFC < cfg.tREFI) << ": COSIM_mem_model: tRFC must be shorter than tREFI";
+    model = std::make_unique<dram_timing>(cfg);
+  } else {
+    LOG(FATAL_S) << fmt::format("COSIM_mem_model: unknown model '{}', known are fixed, queue and dram", name);
+  }
+  if (!keys.empty()) {
+    LOG(FATAL_S) << fmt::format("COSIM_mem_model: unknown key '{}' of {}", keys.begin()->first, name);
+  }
+  return model;
+}
+
+std::string mem_timing_model::latency_summary() const {
+  return fmt::format("{} requests, {:.1f} cycles to the first beat on average", requests,
+                     requests ? (double) total_latency / requests : 0.0);
+}
+
+uint64_t fixed_mem_timing::access(uint64_t now, uint64_t addr, uint32_t bytes, bool write) {
+  requests++;
+  total_latency += latency;
+  return latency;
+}
+
+std::string fixed_mem_timing::summary() const {
+  return fmt::format("fixed latency {}: {}", latency, latency_summary());
+}
+
+uint64_t queue_mem_timing::access(uint64_t now, uint64_t addr, uint32_t bytes, bool write) {
+  uint64_t start = std::max(now, free_at);
+  free_at = start + (bytes + bytes_per_cycle - 1) / bytes_per_cycle;
+  queued_cycles += start - now;
+  uint64_t cycles = start - now + latency;
+  requests++;
+  total_latency += cycles;
+  return cycles;
+}
+
+std::string queue_mem_timing::summary() const {
+  return fmt::format("queue of latency {} and {} bytes per cycle: {}, {} cycles queued", latency, bytes_per_cycle,
+                     latency_summary(), queued_cycles);
+}
+
+dram_timing::dram_timing(const config &cfg) : cfg(cfg), lines_per_row(cfg.row_bytes / line_bytes),
+                                              banks(cfg.channels * cfg.banks), channels(cfg.channels) {}
+
+uint64_t dram_timing::access(uint64_t now, uint64_t addr, uint32_t bytes, bool write) {
+  // line interleaved over the channels, then the columns of a row, then the banks
+  uint64_t line = addr / line_bytes;
+  uint64_t ch = line % cfg.channels;
+  uint64_t rest = line / cfg.channels / lines_per_row;
+  uint64_t row = rest / cfg.banks;
+  channel_t &channel = channels[ch];
+  bank_t &bank = banks[ch * cfg.banks + rest % cfg.banks];
+
+  uint64_t t = now + cfg.ctrl;
+  if (bank.ready_at > t) {
+    bank_stalls++;
+    t = bank.ready_at;
+  }
+  if (cfg.tREFI) {
+    // an all-bank refresh starts every tREFI cycles and precharges every bank of the channel
+    uint64_t epoch = t / cfg.tREFI;
+    if (t - epoch * cfg.tREFI < cfg.tRFC) {
+      refresh_stalls++;
+      t = epoch * cfg.tREFI + cfg.tRFC;
+    }
+    if (epoch != channel.refresh_epoch) {
+      channel.refresh_epoch = epoch;
+      for (uint32_t b = 0; b < cfg.banks; b++) banks[ch * cfg.banks + b].open_row = no_row;
+    }
+  }
+
+  if (bank.open_row == row) {
+    row_hits++;
+  } else if (bank.open_row == no_row) {
+    row_misses++;
+    t += cfg.tRCD;
+  } else {
+    row_conflicts++;
+    t += cfg.tRP + cfg.tRCD;
+  }
+  bank.open_row = row;
+  t += cfg.tCL;
+
+  if (channel.bus_free_at > t) {
+    bus_stalls++;
+    t = channel.bus_free_at;
+  }
+  uint64_t beats = cfg.burst * ((bytes + line_bytes - 1) / line_bytes);
+  channel.bus_free_at = t + beats;
+  // the next column command of the bank goes out once this one has the bus
+  bank.ready_at = t + beats - cfg.tCL;
+
+  uint64_t cycles = t - now;
+  requests++;
+  total_latency += cycles;
+  return cycles;
+}
+
+std::string dram_timing::summary() const {
+  uint64_t accesses = std::max<uint64_t>(row_hits + row_misses + row_conflicts, 1);
+  return fmt::format("dram of {} channels x {} banks: {}, row hits {:.1f}%, misses {:.1f}%, conflicts {:.1f}%, "
+                     "stalls on bank {}, bus {}, refresh {}", cfg.channels, cfg.banks, latency_summary(),
+                     100.0 * row_hits / accesses, 100.0 * row_misses / accesses, 100.0 * row_conflicts / accesses,
+                     bank_stalls, bus_stalls, refresh_stalls);
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/// Timing of the memory behind the TL responder of the bridge, selected with COSIM_mem_model as NAME[:KEY=VALUE,...]:
+///
+///   fixed:latency=0                   every request takes the same number of cycles, the default
+///   queue:latency=40,bytes_per_cycle=8
+///                                     a fixed latency after a single server which moves bytes_per_cycle, so a
+///                                     burst of requests queues behind the bandwidth
+///   dram:channels=1,banks=8,row_bytes=2048,ctrl=10,tCL=14,tRCD=14,tRP=14,burst=4,tREFI=7800,tRFC=350
+///                                     an open page DRAM: row buffer hits, misses to a closed bank and conflicts
+///                                     with another open row, per bank busy time, the data bus of each channel and
+///                                     all-bank refresh
+///
+/// All times are in cycles of the D channel, on top of the cycle the bridge takes to answer a request at the earliest.
+/// A model only sees the requests and keeps a few counters per bank, so timing a request is O(1).
+class mem_timing_model {
+public:
+    virtual ~mem_timing_model() = default;
+
+    /// parse a COSIM_mem_model spec, throws on an unknown model or key
+    static std::unique_ptr<mem_timing_model> create(const std::string &spec);
+
+    /// the cycles a request issued at now waits for its first data beat
+    virtual uint64_t access(uint64_t now, uint64_t addr, uint32_t bytes, bool write) = 0;
+
+    /// the counters of the model for the end of run log
+    [[nodiscard]] virtual std::string summary() const = 0;
+
+protected:
+    uint64_t requests = 0;
+    uint64_t total_latency = 0;
+
+    [[nodiscard]] std::string latency_summary() const;
+};
+
+class fixed_mem_timing : public mem_timing_model {
+public:
+    explicit fixed_mem_timing(uint64_t latency) : latency(latency) {}
+
+    uint64_t access(uint64_t now, uint64_t addr, uint32_t bytes, bool write) override;
+
+    [[nodiscard]] std::string summary() const override;
+
+private:
+    uint64_t latency;
+};
+
+class queue_mem_timing : public mem_timing_model {
+public:
+    queue_mem_timing(uint64_t latency, uint64_t bytes_per_cycle) : latency(latency),
+                                                                   bytes_per_cycle(bytes_per_cycle) {}
+
+    uint64_t access(uint64_t now, uint64_t addr, uint32_t bytes, bool write) override;
+
+    [[nodiscard]] std::string summary() const override;
+
+private:
+    uint64_t latency;
+    uint64_t bytes_per_cycle;
+    /// the cycle the server finishes the requests queued so far
+    uint64_t free_at = 0;
+    uint64_t queued_cycles = 0;
+};
+
+class dram_timing : public mem_timing_model {
+public:
+    struct config {
+        uint32_t channels = 1;
+        uint32_t banks = 8;
+        uint32_t row_bytes = 2048;
+        /// controller and interconnect cycles of every request
+        uint32_t ctrl = 10;
+        uint32_t tCL = 14;
+        uint32_t tRCD = 14;
+        uint32_t tRP = 14;
+        /// data bus cycles of a 64 byte line
+        uint32_t burst = 4;
+        /// refresh interval and duration, tREFI = 0 disables refresh
+        uint32_t tREFI = 7800;
+        uint32_t tRFC = 350;
+    };
+
+    explicit dram_timing(const config &cfg);
+
+    uint64_t access(uint64_t now, uint64_t addr, uint32_t bytes, bool write) override;
+
+    [[nodiscard]] std::string summary() const override;
+
+private:
+    static constexpr uint64_t line_bytes = 64;
+    static constexpr uint64_t no_row = ~0ull;
+
+    struct bank_t {
+        uint64_t open_row = no_row;
+        /// the cycle the bank can take the next command
+        uint64_t ready_at = 0;
+    };
+
+    struct channel_t {
+        uint64_t bus_free_at = 0;
+        /// the refresh interval the open rows belong to
+        uint64_t refresh_epoch = 0;
+    };
+
+    config cfg;
+    uint64_t lines_per_row;
+    std::vector<bank_t> banks;
+    std::vector<channel_t> channels;
+
+    uint64_t row_hits = 0;
+    uint64_t row_misses = 0;
+    uint64_t row_conflicts = 0;
+    /// requests which waited for their bank, the data bus or a refresh
+    uint64_t bank_stalls = 0;
+    uint64_t bus_stalls = 0;
+    uint64_t refresh_stalls = 0;
+};
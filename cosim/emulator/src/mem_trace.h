@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/// Memory access trace of a cosim run (COSIM_mem_trace): the fetch, loads and stores of every committed insn as
+/// spike executed it, i.e. the stream the L1 caches see on the correct path, for cache_sweep and tlb_sweep.
+/// The addresses are virtual; SATP and SFENCE records carry what the TLBs need to translate them.
+/// File layout: one mem_trace_header, then mem_trace_record until EOF.
+/// This header has no spike/glog dependency so cosim/tools can use it.
+struct mem_trace_header {
+    static constexpr uint32_t magic = 0x4d454d52;  // "RMEM"
+    static constexpr uint32_t version = 2;
+
+    uint32_t file_magic;
+    uint32_t file_version;
+    uint32_t record_size;
+    uint32_t reserved;
+};
+
+struct mem_trace_record {
+    enum access_kind : uint8_t {
+        FETCH, LOAD, STORE, AMO,
+        /// the satp the following accesses translate with, addr is 0 while they are not translated
+        SATP,
+        /// an sfence.vma committed, addr is its rs1 and size 1 when rs1 is not x0
+        SFENCE
+    };
+
+    uint64_t cycle;
+    uint64_t addr;
+    uint8_t kind;
+    uint8_t size;
+    uint16_t reserved;
+    uint32_t reserved2;
+};
+
+class mem_trace_writer {
+public:
+    ~mem_trace_writer() { close(); }
+
+    bool open(const std::string &path) {
+      file = fopen(path.c_str(), "wb");
+      if (!file) return false;
+      setvbuf(file, nullptr, _IOFBF, 1 << 20);
+      mem_trace_header header{mem_trace_header::magic, mem_trace_header::version, sizeof(mem_trace_record), 0};
+      fwrite(&header, sizeof(header), 1, file);
+      return true;
+    }
+
+    void close() {
+      if (file) fclose(file);
+      file = nullptr;
+    }
+
+    /// stop recording without flushing, for a forked copy of the process whose buffer belongs to the original
+    void abandon() { file = nullptr; }
+
+    [[nodiscard]] bool enabled() const { return file != nullptr; }
+
+    void record(uint64_t cycle, uint64_t addr, mem_trace_record::access_kind kind, uint8_t size = 0) {
+      mem_trace_record r{cycle, addr, kind, size, 0, 0};
+      fwrite(&r, sizeof(r), 1, file);
+    }
+
+private:
+    FILE *file = nullptr;
+};
+
+/// Memory image of a cosim run (COSIM_mem_image), written at the end of the run so that tlb_sweep can walk the page
+/// tables of the program. File layout: one mem_image_header, then for every page which is not all zero its physical
+/// address as uint64_t followed by page_bytes bytes of data, until EOF.
+struct mem_image_header {
+    static constexpr uint32_t magic = 0x474d4952;  // "RIMG"
+    static constexpr uint32_t version = 1;
+
+    uint32_t file_magic;
+    uint32_t file_version;
+    uint32_t page_bytes;
+    uint32_t reserved;
+};
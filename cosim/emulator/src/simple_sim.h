@@ -1,8 +1,11 @@
 #pragma once
 
+#include "mem_trace.h"
 #include "mmu.h"
 #include "simif.h"
 #include <fmt/core.h>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <glog/logging.h>
 
@@ -23,30 +26,39 @@ public:
     }
 
     void load(const std::string &fname, const std::string &ename, size_t reset_vector) {
+      load_file(fname, reset_vector);
+      load_file(ename, 0x1000);
+    }
+
+    void load_file(const std::string &fname, size_t offset) {
       std::ifstream fs(fname, std::ifstream::binary);
       assert(fs.is_open());
-      size_t offset = reset_vector;
       while (!fs.eof()) {
         fs.read(&mem[offset], 1024);
         offset += fs.gcount();
       }
+    }
 
-      std::ifstream fs_init(ename, std::ifstream::binary);
-      assert(fs_init.is_open());
-      size_t cnt = 0x1000;
-      while (!fs_init.eof()) {
-        fs_init.read(&mem[cnt], 1024);
-      }
+    /// overwrite memory in place, used to swap programs without reallocating
+    void write(reg_t addr, const void *data, size_t len) {
+      assert(addr + len <= size);
+      memcpy(&mem[addr], data, len);
+    }
 
-      //print mem
-//    uint32_t addr = 0x80002000;
-//    for (int i = 0; i < 4; i++) {
-//      uint32_t insn = 0;
-//      for (int j = 0; j < 4; j++) {
-//        insn += (uint64_t) *addr_to_mem(addr + j + i * 4) << (j * 8);
-//      }
-//      LOG(INFO) << fmt::format("scan mem: {:08X} , at:{:08X}", insn, addr + i * 4);
-//    }
+    /// write the pages which are not all zero in the mem_image_header format of mem_trace.h
+    bool save_image(const std::string &path) const {
+      FILE *f = fopen(path.c_str(), "wb");
+      if (!f) return false;
+      constexpr uint32_t page_bytes = 4096;
+      static const char zero[page_bytes] = {};
+      mem_image_header header{mem_image_header::magic, mem_image_header::version, page_bytes, 0};
+      fwrite(&header, sizeof(header), 1, f);
+      for (uint64_t addr = 0; addr + page_bytes <= size; addr += page_bytes) {
+        if (memcmp(&mem[addr], zero, page_bytes) == 0) continue;
+        fwrite(&addr, sizeof(addr), 1, f);
+        fwrite(&mem[addr], page_bytes, 1, f);
+      }
+      return fclose(f) == 0;
     }
 
     // should return NULL for MMIO addresses
@@ -0,0 +1,63 @@
+#include <csignal>
+#include <cstdio>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+
+bool snapshot_keeper::take(uint64_t t) {
+  int fds[2];
+  if (pipe(fds) < 0) return false;
+  // anything still buffered would be written by the snapshot once more
+  fflush(nullptr);
+  pid_t pid = fork();
+  if (pid < 0) {
+    close(fds[0]);
+    close(fds[1]);
+    return false;
+  }
+  if (pid == 0) {
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    close(fds[1]);
+    // the older snapshots are the parent's, their pipes must only be open there for closing to discard them
+    for (auto &s: snapshots) close(s.fd);
+    snapshots.clear();
+    uint64_t failure;
+    if (read(fds[0], &failure, sizeof(failure)) != sizeof(failure)) _exit(0);
+    close(fds[0]);
+    is_resumed = true;
+    failure_t = failure;
+    return true;
+  }
+  close(fds[0]);
+  snapshots.push_back({pid, fds[1], t});
+  while (snapshots.size() > keep) {
+    discard(snapshots.front());
+    snapshots.pop_front();
+  }
+  return false;
+}
+
+bool snapshot_keeper::resume_latest(uint64_t failure, uint64_t &snapshot_t) {
+  if (snapshots.empty()) return false;
+  snapshot s = snapshots.back();
+  snapshots.pop_back();
+  discard_all();
+  fflush(nullptr);
+  bool resumed = write(s.fd, &failure, sizeof(failure)) == sizeof(failure);
+  close(s.fd);
+  waitpid(s.pid, nullptr, 0);
+  snapshot_t = s.t;
+  return resumed;
+}
+
+void snapshot_keeper::discard_all() {
+  for (auto &s: snapshots) discard(s);
+  snapshots.clear();
+}
+
+void snapshot_keeper::discard(const snapshot &s) {
+  close(s.fd);
+  waitpid(s.pid, nullptr, 0);
+}
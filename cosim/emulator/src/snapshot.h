@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <sys/types.h>
+
+/// Periodic in-memory snapshots of the whole cosim process, to re-simulate the window before a failure.
+/// A snapshot is a fork()ed copy of the process parked on a pipe: the Verilated model, spike and the pages of
+/// simple_sim the run dirtied since are kept copy-on-write, nothing is serialized. fork() only copies the calling
+/// thread, so this needs a single threaded model.
+class snapshot_keeper {
+public:
+    ~snapshot_keeper() { discard_all(); }
+
+    /// fork a snapshot of time t, keeping the latest `keep` ones.
+    /// @return false in the running process, true in a snapshot once it is resumed; failure_t is set then
+    bool take(uint64_t t);
+
+    /// resume the latest snapshot and wait until its re-simulation exits, the others are discarded.
+    /// @return false if there is no snapshot
+    bool resume_latest(uint64_t failure, uint64_t &snapshot_t);
+
+    void discard_all();
+
+    /// whether this process is a resumed snapshot
+    [[nodiscard]] bool resumed() const { return is_resumed; }
+
+    size_t keep = 2;
+    /// time of the failure a resumed snapshot re-simulates
+    uint64_t failure_t = 0;
+
+private:
+    struct snapshot {
+        pid_t pid;
+        /// resumes the snapshot with the failure time, closing it discards the snapshot
+        int fd;
+        uint64_t t;
+    };
+
+    static void discard(const snapshot &s);
+
+    std::deque<snapshot> snapshots;
+    bool is_resumed = false;
+};
@@ -1,6 +1,8 @@
 #include <fmt/core.h>
 #include <glog/logging.h>
 
+#include <algorithm>
+
 #include "disasm.h"
 #include "exceptions.h"
 #include "glog_exception_safe.h"
@@ -27,7 +29,7 @@ void SpikeEvent::pre_log_arch_changes() {
       block.addr = addr_align;
       block.remaining = true;
     }
-    LOG(INFO) << fmt::format("spike pre_log mem access on:{:08X} ; block_addr={:08X}", address, addr_align);
+    VLOG(1) << fmt::format("spike pre_log mem access on:{:08X} ; block_addr={:08X}", address, addr_align);
   }
 }
 
@@ -42,13 +44,16 @@ void SpikeEvent::log_arch_changes() {
     // xx0010 <- vreg
     // xx0011 <- vec
     // xx0100 <- csr
+    uint64_t value = (write_idx & 0xf) == 0b0000 ? data.v[0] & emuConfig.get_mask(xlen) : data.v[0];
+    impl->digest_check.spike_write(write_idx, value, digest);
+    if ((write_idx & 0xf) == 0b0001 && impl->fp_check.enabled()) impl->fp_check.spike_write(write_idx >> 4, value);
 
     if ((write_idx & 0xf) == 0b0000) {// scalar rf
       uint64_t rd_should_be_bits = proc.get_state()->XPR[rd_idx];
       if (rd_new_bits != rd_should_be_bits) {
         rd_new_bits = rd_should_be_bits;
         is_rd_written = true;
-        LOG(INFO) << fmt::format("Log Spike {:08X} with scalar rf change: x[{}] from {:08X} to {:08X}", pc, rd_idx,
+        VLOG(1) << fmt::format("Log Spike {:08X} with scalar rf change: x[{}] from {:08X} to {:08X}", pc, rd_idx,
                                  rd_old_bits, rd_new_bits);
       }
     }
@@ -62,7 +67,7 @@ void SpikeEvent::log_arch_changes() {
     uint64_t value = std::get<1>(mem_write);
     // Byte size_bytes
     uint8_t size_by_byte = std::get<2>(mem_write);
-    LOG(INFO)
+    VLOG(1)
         << fmt::format("spike detect mem write {:08X} on mem:{:08X} with size={}byte", value, address, size_by_byte);
     mem_access_record.all_writes[address] = {.size_by_byte = size_by_byte, .val = value};
   }
@@ -79,7 +84,7 @@ void SpikeEvent::log_arch_changes() {
     for (int i = 0; i < size_by_byte; ++i) {
       value += (uint64_t) impl->load(address + i) << (i * 8);
     }
-    LOG(INFO)
+    VLOG(1)
         << fmt::format("spike detect mem read {:08X} on mem:{:08X} with size={}byte", value, address, size_by_byte);
     mem_access_record.all_reads[address] = {.size_by_byte = size_by_byte, .val = value};
   }
@@ -99,6 +104,8 @@ void SpikeEvent::log_arch_changes() {
     }
   }
 
+  impl->digest_check.spike_retire(digest);
+
   state->log_reg_write.clear();
   state->log_mem_read.clear();
   state->log_mem_write.clear();
@@ -106,144 +113,68 @@ void SpikeEvent::log_arch_changes() {
 
 SpikeEvent::SpikeEvent(processor_t &proc, insn_fetch_t &fetch, VBridgeImpl *impl) : proc(proc), impl(impl) {
   auto &xr = proc.get_state()->XPR;
+  xlen = impl->xlen;
   pc = proc.get_state()->pc & emuConfig.get_mask(xlen);
   inst_bits = fetch.insn.bits();
   target_mem = -1;
-  is_committed = false;// j insn should be committed immediately cause it doesn't have wb stage.
+  // is_committed stays false but for j insns, they should be committed immediately cause they don't have wb stage.
 
   // extension depending parameter
-  is_compress = false;
-  if (fetch.insn.length() == 2) is_compress = true;
-  if (!is_compress) {
-    rs1_bits = xr[fetch.insn.rs1()];
-    rs2_bits = xr[fetch.insn.rs2()];
-    rd_idx = fetch.insn.rd();
-    opcode = clip(inst_bits, 0, 6);
-    uint8_t func7 = (inst_bits & 0xFE000000) >> 25;
-    // for j insn for x0;
-    if (opcode == 0b1101111 && rd_idx == 0) {
-      is_committed = true;
+  is_compress = fetch.insn.length() == 2;
+  decoded = riscv_decode(inst_bits, impl->xlen);
+  opcode = is_compress ? 0 : clip(inst_bits, 0, 6);
+  rs1_bits = xr[fetch.insn.rs1()];
+  rs2_bits = xr[fetch.insn.rs2()];
+  // rd_idx is the integer register the insn writes, 0 for none
+  rd_idx = 0;
+  if (decoded == nullptr) {
+    // custom insns, e.g. RoCC with xd
+    if (!is_compress) rd_idx = fetch.insn.rd();
+    VLOG(1) << fmt::format("insn {:08X} at {:08X} is not in the decode table", inst_bits, pc);
+  } else if (!decoded->has(riscv_insn_t::FP_RD)) {
+    switch (decoded->rd) {
+      case riscv_insn_t::RD: rd_idx = fetch.insn.rd(); break;
+      case riscv_insn_t::RD_C_RS2S: rd_idx = fetch.insn.rvc_rs2s(); break;
+      case riscv_insn_t::RD_C_RS1S: rd_idx = fetch.insn.rvc_rs1s(); break;
+      case riscv_insn_t::RD_RA: rd_idx = 1; break;
+      case riscv_insn_t::RD_NONE: break;
     }
-    // for integer/double load/store
-    is_load = (opcode == 0b11) || (opcode == 0b0000111);
-    is_store = opcode == 0b100011 || (opcode == 0b0100111);
-    is_amo = opcode == 0b0101111;
-
-    //decode for M extension
-    is_mutiCycle = (opcode == 0b0110011 || opcode == 0b0111011) && (func7 == 0b1);
+  }
+  // for j insn for x0;
+  if (opcode == 0b1101111 && rd_idx == 0) {
+    is_committed = true;
+  }
+  if (decoded != nullptr) {
+    is_load = decoded->has(riscv_insn_t::LOAD);
+    is_store = decoded->has(riscv_insn_t::STORE);
+    is_amo = decoded->has(riscv_insn_t::AMO);
+    is_mutiCycle = decoded->has(riscv_insn_t::LONG_LATENCY);
 
-    if (is_load) {
-      target_mem = rs1_bits + fetch.insn.i_imm();
-    }
-    if (is_store) target_mem = rs1_bits + fetch.insn.s_imm();
-    if (is_amo) target_mem = rs1_bits;
-  } else {//decode for C extension
-    uint8_t op = inst_bits & 0b11;
-    uint8_t func3 = (inst_bits & 0xE000) >> 13;
     uint64_t rs1s_bits = xr[fetch.insn.rvc_rs1s()];
     uint64_t sp_bits = xr[2];
-    switch (op) {
-      case 0:
-        rd_idx = 8 + ((inst_bits & 0b11100) >> 2);
-        if (func3 >= 5) {
-          is_store = true;
-          switch (func3) {
-            case 5:// C.FSD
-              target_mem = rs1s_bits + fetch.insn.rvc_ld_imm();
-              break;
-            case 6:// C.SW
-              target_mem = rs1s_bits + fetch.insn.rvc_lw_imm();
-              break;
-            case 7:// C.SD
-              target_mem = rs1s_bits + fetch.insn.rvc_ld_imm();
-              break;
-            default:
-              LOG(FATAL) << fmt::format("unknown compress func3");
-          }
-        } else if (func3 >= 1 && func3 <= 3) {// include all 0-> the illegal insn
-          is_load = true;
-          switch (func3) {
-            case 1:// C.FLD
-              target_mem = rs1s_bits + fetch.insn.rvc_ld_imm();
-              break;
-            case 2:// C.LW
-              target_mem = rs1s_bits + fetch.insn.rvc_lw_imm();
-              break;
-            case 3:// C.LD
-              target_mem = rs1s_bits + fetch.insn.rvc_ld_imm();
-              break;
-            default:
-              LOG(FATAL) << fmt::format("unknown compress func3");
-          }
-        } else {
-        }
-        // for store insn, no matter rd_idx
-        break;
-      case 1:// no load/store insn; 2 types rd_idx format
-        if (func3 <= 3) rd_idx = fetch.insn.rd();
-        else {
-          rd_idx = fetch.insn.rvc_rs1s();
-        }
-        break;
-      case 2:
-        if (func3 >= 5) {
-          is_store = true;
-          rd_idx = 0;
-          switch (func3) {
-            case 5:// C.FSDSP
-              target_mem = sp_bits + fetch.insn.rvc_sdsp_imm();
-              break;
-            case 6:// C.SWSP
-              target_mem = sp_bits + fetch.insn.rvc_swsp_imm();
-              break;
-            case 7:// C.SDSP
-              target_mem = sp_bits + fetch.insn.rvc_sdsp_imm();
-              break;
-            default:
-              LOG(FATAL) << fmt::format("unknown compress func3");
-          }
-        } else if (func3 >= 1 && func3 <= 3) {// for C.LWSP etc.
-          is_load = true;
-          rd_idx = fetch.insn.rd();
-          switch (func3) {
-            case 1:// C.FLDSP
-              target_mem = sp_bits + fetch.insn.rvc_ldsp_imm();
-              break;
-            case 2:// C.LWSP
-              target_mem = sp_bits + fetch.insn.rvc_lwsp_imm();
-              break;
-            case 3:// C.LDSP
-              target_mem = sp_bits + fetch.insn.rvc_ldsp_imm();
-              break;
-            default:
-              LOG(FATAL) << fmt::format("unknown compress func3");
-          }
-
-        } else if (func3 == 4 && (((inst_bits & 0x1000) >> 12) == 1) && (fetch.insn.rvc_rs1() != 0) &&
-                   (fetch.insn.rvc_rs2() == 0)) {
-          // C.JALR
-          LOG(INFO) << fmt::format("find C.JALR");
-          rd_idx = 1;// write x2
-
-        } else {
-          rd_idx = fetch.insn.rd();
-        }
-        break;
-      default:
-        LOG(FATAL) << fmt::format("unknown compress opcode");
+    switch (decoded->addr) {
+      case riscv_insn_t::ADDR_I: target_mem = rs1_bits + fetch.insn.i_imm(); break;
+      case riscv_insn_t::ADDR_S: target_mem = rs1_bits + fetch.insn.s_imm(); break;
+      case riscv_insn_t::ADDR_RS1: target_mem = rs1_bits; break;
+      case riscv_insn_t::ADDR_C_LW: target_mem = rs1s_bits + fetch.insn.rvc_lw_imm(); break;
+      case riscv_insn_t::ADDR_C_LD: target_mem = rs1s_bits + fetch.insn.rvc_ld_imm(); break;
+      case riscv_insn_t::ADDR_C_LWSP: target_mem = sp_bits + fetch.insn.rvc_lwsp_imm(); break;
+      case riscv_insn_t::ADDR_C_LDSP: target_mem = sp_bits + fetch.insn.rvc_ldsp_imm(); break;
+      case riscv_insn_t::ADDR_C_SWSP: target_mem = sp_bits + fetch.insn.rvc_swsp_imm(); break;
+      case riscv_insn_t::ADDR_C_SDSP: target_mem = sp_bits + fetch.insn.rvc_sdsp_imm(); break;
+      case riscv_insn_t::ADDR_NONE: break;
     }
   }
   rd_old_bits = proc.get_state()->XPR[rd_idx];
-  is_csr = opcode == 0b1110011;
-  is_issued = false;
-  is_trap = false;
+  rd_new_bits = rd_old_bits;
+  is_csr = decoded != nullptr && decoded->has(riscv_insn_t::CSR);
+  std::fill(std::begin(digest.has_write), std::end(digest.has_write), false);
 
   satp = proc.get_state()->satp->read();
 
   satp_ppn = satp & 0xFFFFFFFFFFF;
   satp_mode = clip(satp, 60, 63);
+  priv = proc.get_state()->prv;
 
   block.addr = -1;
-  disasm = proc.get_disassembler()->disassemble(fetch.insn);
-  xlen = impl->xlen;
 }
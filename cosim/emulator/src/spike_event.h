@@ -9,9 +9,12 @@
 #include "verilated_fst_c.h"
 
 #include "simple_sim.h"
+#include "flat_containers.h"
+#include "arch_digest.h"
 #include "vbridge_impl.h"
 #include "encoding.h"
 #include "emuconfig.h"
+#include "insn_decode.h"
 
 class VBridgeImpl;
 
@@ -21,6 +24,8 @@ struct Cacheblock {
     bool remaining;
 };
 
+/// SpikeEvents are constructed in place into the recycled slots of to_rtl_queue, so every field the constructor does
+/// not always assign has a default here: nothing of the previous insn in the slot may leak into the next one.
 struct SpikeEvent {
     SpikeEvent(processor_t &proc, insn_fetch_t &fetch, VBridgeImpl *impl);
 
@@ -30,34 +35,24 @@ struct SpikeEvent {
 
     void log_arch_changes();
 
-    commit_log_mem_t mem_read_info;
-
-    struct mem_log {
-        uint64_t addr;
-        uint64_t value;
-        uint8_t size;
-    };
-    std::vector<mem_log> log_mem_queue;
-
     processor_t &proc;
     VBridgeImpl *impl;
 
-    bool is_issued;
-    bool is_committed;
-
-    uint8_t opcode;
-    bool is_load;
-    bool is_store;
-    bool is_csr;
-    bool is_amo;
-    bool is_mutiCycle;
-
-    std::string disasm;
+    bool is_issued = false;
+    bool is_committed = false;
 
+    uint8_t opcode = 0;
+    bool is_load = false;
+    bool is_store = false;
+    bool is_csr = false;
+    bool is_amo = false;
+    bool is_mutiCycle = false;
 
     uint32_t pc;
     uint32_t inst_bits;
     bool is_compress;
+    /// the entry of inst_bits in the decode table generated from riscv-opcodes, nullptr for custom insns
+    const riscv_insn_t *decoded;
 
     uint64_t rs1_bits;
     uint64_t rs2_bits;
@@ -65,20 +60,24 @@ struct SpikeEvent {
     uint32_t rd_idx;
     uint64_t rd_old_bits;
     // rd idx and bits after insn
-    uint64_t rd_new_bits;
-    bool is_rd_written;
+    uint64_t rd_new_bits = 0;
+    bool is_rd_written = false;
 
     //csr
     uint64_t satp;
     uint64_t satp_ppn;
     uint8_t satp_mode;
+    /// privilege the insn executed in
+    uint8_t priv;
+
+    bool is_trap = false;
 
-    bool is_trap;
+    /// spike's register digests after this insn
+    digest_point digest;
 
     Cacheblock block;
 
     uint64_t target_mem;
-    std::list<Cacheblock> cache_queue;
     int xlen;
 
     struct {
@@ -92,7 +91,9 @@ struct SpikeEvent {
             reg_t val;
             bool executed = false;// set to true when rtl execute this mem access
         };
-        std::map<uint32_t, single_mem_write> all_writes;
-        std::map<uint32_t, single_mem_read> all_reads;
+        // log_arch_changes rejects any access off target_mem, so an insn has one address per map (an amo reads and
+        // writes the same one). Misaligned accesses spike splits into several addresses fail that check first.
+        fixed_map<uint32_t, single_mem_write, 4> all_writes;
+        fixed_map<uint32_t, single_mem_read, 4> all_reads;
     } mem_access_record;
 };
@@ -0,0 +1,146 @@
+#include <algorithm>
+
+#include <fmt/core.h>
+
+#include "tl_profile.h"
+
+const char *tl_profiler::kind_name(tl_kind kind) {
+  switch (kind) {
+    case GET: return "get";
+    case ACQUIRE: return "acquire";
+    case RELEASE: return "release";
+    default: return "?";
+  }
+}
+
+bool tl_profiler::open(const std::string &path, uint64_t cycles) {
+  file = fopen(path.c_str(), "w");
+  if (!file) return false;
+  interval = std::max<uint64_t>(cycles, 1);
+  fmt::print(file, "cycle,cycles,d_beats,d_utilization,mean_in_flight,max_in_flight");
+  for (int k = 0; k < nKinds; k++) {
+    const char *name = kind_name(static_cast<tl_kind>(k));
+    fmt::print(file, ",{0}_requests,{0}_completed,{0}_mean_latency", name);
+  }
+  fmt::print(file, "\n");
+  return true;
+}
+
+void tl_profiler::close() {
+  if (!file) return;
+  if (current.cycles) write_interval();
+  fclose(file);
+  file = nullptr;
+}
+
+int tl_profiler::bucket(uint64_t latency) {
+  return std::min(latency == 0 ? 0 : 64 - __builtin_clzll(latency), nBuckets - 1);
+}
+
+void tl_profiler::request(uint32_t source, tl_kind kind) {
+  in_flight_t &s = sources[kind == RELEASE][source % nSources];
+  // a source is reused only after its last beat, an unfinished transaction was lost in a reset of the bridge
+  if (s.active) in_flight--;
+  s = in_flight_t{now, kind, true, false};
+  in_flight++;
+  totals[source % nSources][kind].requests++;
+  current.requests[kind]++;
+}
+
+void tl_profiler::response(uint32_t source, bool release_ack, bool last) {
+  d_beats++;
+  current.d_beats++;
+  in_flight_t &s = sources[release_ack][source % nSources];
+  if (!s.active) return;
+  uint64_t latency = now - s.start;
+  if (!s.first_beat_seen) {
+    s.first_beat_seen = true;
+    first_beat_histogram[s.kind][bucket(latency)]++;
+  }
+  if (!last) return;
+  last_beat_histogram[s.kind][bucket(latency)]++;
+  totals_t &t = totals[source % nSources][s.kind];
+  t.completed++;
+  t.occupancy += latency;
+  current.completed[s.kind]++;
+  current.last_beat_latency[s.kind] += latency;
+  s.active = false;
+  in_flight--;
+}
+
+void tl_profiler::cycle() {
+  occupancy_histogram[std::min<uint32_t>(in_flight, nOccupancy - 1)]++;
+  current.occupancy += in_flight;
+  current.max_in_flight = std::max(current.max_in_flight, in_flight);
+  now++;
+  if (++current.cycles == interval) write_interval();
+}
+
+void tl_profiler::reset() {
+  for (auto &channel: sources) {
+    for (auto &s: channel) s.active = false;
+  }
+  in_flight = 0;
+}
+
+void tl_profiler::write_interval() {
+  auto cycles = (double) current.cycles;
+  fmt::print(file, "{},{},{},{:.4f},{:.4f},{}", now, current.cycles, current.d_beats, current.d_beats / cycles,
+             current.occupancy / cycles, current.max_in_flight);
+  for (int k = 0; k < nKinds; k++) {
+    double latency = current.completed[k] ? (double) current.last_beat_latency[k] / current.completed[k] : 0;
+    fmt::print(file, ",{},{},{:.1f}", current.requests[k], current.completed[k], latency);
+  }
+  fmt::print(file, "\n");
+  current = {};
+}
+
+std::string tl_profiler::summary() const {
+  auto histogram = [](const uint64_t (&h)[nBuckets]) {
+    std::string out;
+    for (int b = 0; b < nBuckets; b++) {
+      if (h[b] == 0) continue;
+      if (b == 0) {
+        out += fmt::format(" [0]={}", h[b]);
+      } else {
+        out += fmt::format(" [{},{})={}", 1ull << (b - 1), b == nBuckets - 1 ? std::string("inf") :
+                                                           std::to_string(1ull << b), h[b]);
+      }
+    }
+    return out;
+  };
+
+  std::string out;
+  uint64_t cycles = 0, occupancy = 0;
+  for (int n = 0; n < nOccupancy; n++) {
+    cycles += occupancy_histogram[n];
+    occupancy += n * occupancy_histogram[n];
+  }
+  uint64_t busy = cycles - occupancy_histogram[0];
+  out += fmt::format("\n  {} cycles, D channel {:.2f}% utilized, {:.3f} transactions in flight on average, {:.3f} "
+                     "while any is", cycles, cycles ? 100.0 * d_beats / cycles : 0.0,
+                     cycles ? (double) occupancy / cycles : 0.0, busy ? (double) occupancy / busy : 0.0);
+  out += "\n  cycles by transactions in flight:";
+  for (int n = 0; n < nOccupancy; n++) {
+    if (occupancy_histogram[n] == 0) continue;
+    out += fmt::format(" {}{}={}", n, n == nOccupancy - 1 ? "+" : "", occupancy_histogram[n]);
+  }
+  for (int k = 0; k < nKinds; k++) {
+    uint64_t requests = 0;
+    for (const auto &source: totals) requests += source[k].requests;
+    if (requests == 0) continue;
+    out += fmt::format("\n  {:7} {} requests, to first beat:{}", kind_name(static_cast<tl_kind>(k)), requests,
+                       histogram(first_beat_histogram[k]));
+    out += fmt::format("\n  {:7} to last beat:{}", "", histogram(last_beat_histogram[k]));
+  }
+  for (uint32_t s = 0; s < nSources; s++) {
+    for (int k = 0; k < nKinds; k++) {
+      const totals_t &t = totals[s][k];
+      if (t.requests == 0) continue;
+      out += fmt::format("\n  source {:2} {:7} {} requests, {} completed, {:.3f} in flight on average", s,
+                         kind_name(static_cast<tl_kind>(k)), t.requests, t.completed,
+                         cycles ? (double) t.occupancy / cycles : 0.0);
+    }
+  }
+  return out;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+/// Memory level parallelism and latency of the TileLink traffic between the tile and the bridge (COSIM_tl_profile).
+/// dpiPeekTL reports every A and C request the bridge answers, dpiPokeTL every D beat and the end of every cycle.
+/// Transactions are keyed by their channel and source id: the D$ acquires a block and releases the victim under the
+/// same source. The occupancy of each source tells how many misses of the D$ MSHRs and the I$ are in flight together.
+/// The uncached Get and PutFullData requests of the D$ are checked against spike but never answered by the bridge,
+/// they are not counted.
+///
+/// Everything is kept in fixed size arrays: the totals per source and kind, the log2 latency histograms from the
+/// request to the first and the last D beat per kind, and the histogram of the cycles spent with n transactions in
+/// flight. Every COSIM_tl_profile_interval cycles one CSV row of the interval is written; the totals are logged when
+/// the run ends.
+class tl_profiler {
+public:
+    enum tl_kind : uint8_t {
+        /// I$ refills
+        GET,
+        /// D$ refills
+        ACQUIRE,
+        /// D$ dirty writebacks on the C channel
+        RELEASE,
+        nKinds
+    };
+
+    static const char *kind_name(tl_kind kind);
+
+    ~tl_profiler() { close(); }
+
+    /// one row of the time series every given cycles
+    bool open(const std::string &path, uint64_t cycles);
+
+    /// write the partial last interval
+    void close();
+
+    /// stop recording without flushing, for a forked copy of the process whose buffer belongs to the original
+    void abandon() { file = nullptr; }
+
+    [[nodiscard]] bool enabled() const { return file != nullptr; }
+
+    /// an A or C request of the given source, RELEASE is the kind of the C channel
+    void request(uint32_t source, tl_kind kind);
+
+    /// a D beat to the given source, a ReleaseAck answers the C channel, last is its final beat
+    void response(uint32_t source, bool release_ack, bool last);
+
+    /// end of a cycle of the D channel
+    void cycle();
+
+    /// forget the transactions in flight, rtl is about to be reset. The totals are kept.
+    void reset();
+
+    /// the totals per kind and per source and the occupancy histogram
+    [[nodiscard]] std::string summary() const;
+
+private:
+    static constexpr uint32_t nSources = 64;
+    /// the A and C channels number their sources independently
+    static constexpr int nChannels = 2;
+    /// bucket b counts latencies in [2^(b-1), 2^b), bucket 0 counts 0
+    static constexpr int nBuckets = 16;
+    /// cycles with 0, 1, ... nOccupancy - 1 or more transactions in flight
+    static constexpr int nOccupancy = 16;
+
+    struct in_flight_t {
+        uint64_t start;
+        tl_kind kind;
+        bool active;
+        bool first_beat_seen;
+    };
+
+    struct totals_t {
+        uint64_t requests;
+        uint64_t completed;
+        /// sum of the cycles from request to last beat, i.e. the integral of the occupancy over time
+        uint64_t occupancy;
+    };
+
+    /// one row of the time series
+    struct interval_t {
+        uint64_t cycles;
+        uint64_t d_beats;
+        /// integral of the transactions in flight, divided by cycles it is the mean MLP of the interval
+        uint64_t occupancy;
+        uint32_t max_in_flight;
+        uint64_t requests[nKinds];
+        uint64_t completed[nKinds];
+        uint64_t last_beat_latency[nKinds];
+    };
+
+    static int bucket(uint64_t latency);
+
+    void write_interval();
+
+    FILE *file = nullptr;
+    uint64_t interval = 0;
+
+    uint64_t now = 0;
+    uint32_t in_flight = 0;
+    in_flight_t sources[nChannels][nSources] = {};
+
+    totals_t totals[nSources][nKinds] = {};
+    uint64_t first_beat_histogram[nKinds][nBuckets] = {};
+    uint64_t last_beat_histogram[nKinds][nBuckets] = {};
+    uint64_t occupancy_histogram[nOccupancy] = {};
+    uint64_t d_beats = 0;
+
+    interval_t current = {};
+};
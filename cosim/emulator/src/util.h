@@ -1,18 +1,35 @@
 #pragma once
 
 #include <cstdint>
+#include <cstdlib>
+#include <map>
+#include <string>
+
 #include "glog_exception_safe.h"
 
 /// @return: binary[a, b]
 inline uint64_t clip(uint64_t binary, int a, int b) { return (binary >> a) & ((1 << (b - a + 1)) - 1); }
 
-inline char *get_env_arg(const char *name) {
-  char *val = std::getenv(name);
+/// settings of the cosim instance this thread simulates, looked up before the process environment. cosim_main.cc
+/// sets them per test when several instances share the process.
+using cosim_env = std::map<std::string, std::string>;
+inline thread_local const cosim_env *instance_env = nullptr;
+
+inline const char *lookup_env(const char *name) {
+  if (instance_env) {
+    auto it = instance_env->find(name);
+    if (it != instance_env->end()) return it->second.c_str();
+  }
+  return std::getenv(name);
+}
+
+inline const char *get_env_arg(const char *name) {
+  const char *val = lookup_env(name);
   CHECK_S(val != nullptr) << fmt::format("cannot find environment of name '{}'", name);
   return val;
 }
 
-inline char *get_env_arg_default(const char *name, char *default_val) {
-  char *val = std::getenv(name);
+inline const char *get_env_arg_default(const char *name, const char *default_val) {
+  const char *val = lookup_env(name);
   return val == nullptr ? default_val : val;
-}
\ No newline at end of file
+}
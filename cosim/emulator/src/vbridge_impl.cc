@@ -1,10 +1,16 @@
 #include <fmt/core.h>
 #include <glog/logging.h>
 
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <mutex>
+
 #include "disasm.h"
 
 #include "verilated.h"
 
+#include "alloc_stats.h"
 #include "glog_exception_safe.h"
 #include "exceptions.h"
 #include "util.h"
@@ -14,6 +20,9 @@
 #include "util.h"
 
 
+/// set by SIGINT, lock free so the handler may store it
+static std::atomic<bool> vbridges_interrupted{false};
+
 /// convert TL style size to size_by_bytes
 inline uint32_t decode_size(uint32_t encoded_size) {
   return 1 << encoded_size;
@@ -35,6 +44,12 @@ void VBridgeImpl::init_spike() {
   auto state = proc.get_state();
   LOG(INFO) << fmt::format("Spike reset misa={:08X}", state->misa->read());
   LOG(INFO) << fmt::format("Spike reset mstatus={:08X}", state->mstatus->read());
+  if (fuzz_arg) {
+    sim.load_file(ebin, 0x1000);
+    fuzz_init();
+    return;
+  }
+  CHECK_S(!bin.empty()) << ": COSIM_bin is required unless COSIM_fuzz is set";
   // load binary to reset_vector
   sim.load(bin, ebin, reset_vector);
   LOG(INFO) << fmt::format(
@@ -43,28 +58,26 @@ void VBridgeImpl::init_spike() {
 }
 
 void VBridgeImpl::loop_until_se_queue_full() {
-  LOG(INFO) << fmt::format("Refilling Spike queue");
+  VLOG(1) << fmt::format("Refilling Spike queue");
   while (to_rtl_queue.size() < to_rtl_queue_size) {
     try {
-      std::optional<SpikeEvent> spike_event = spike_step();
-      if (spike_event.has_value()) {
-        SpikeEvent &se = spike_event.value();
-        to_rtl_queue.push_front(std::move(se));
-      }
+      spike_step();
     } catch (trap_t &trap) {
       LOG(FATAL) << fmt::format("spike trapped with {}", trap.name());
     }
   }
-  LOG(INFO) << fmt::format("to_rtl_queue is full now, start to simulate.");
-  for (auto se_iter = to_rtl_queue.rbegin(); se_iter != to_rtl_queue.rend(); se_iter++) {
-    LOG(INFO) << fmt::format("List: spike pc = {:08X}, write reg({}) from {:08x} to {:08X},commit={}", se_iter->pc,
-                             se_iter->rd_idx, se_iter->rd_old_bits, se_iter->rd_new_bits, se_iter->is_committed);
+  VLOG(1) << fmt::format("to_rtl_queue is full now, start to simulate.");
+  if (VLOG_IS_ON(1)) {
+    for (auto &se: to_rtl_queue) {
+      LOG(INFO) << fmt::format("List: spike pc = {:08X}, write reg({}) from {:08x} to {:08X},commit={}", se.pc,
+                               se.rd_idx, se.rd_old_bits, se.rd_new_bits, se.is_committed);
+    }
   }
 }
 
 // now we take all the instruction as spike event except csr insn
-std::optional<SpikeEvent> VBridgeImpl::create_spike_event(insn_fetch_t fetch) {
-  return SpikeEvent{proc, fetch, this};
+SpikeEvent &VBridgeImpl::create_spike_event(insn_fetch_t &fetch) {
+  return to_rtl_queue.emplace_back(proc, fetch, this);
 }
 
 // don't creat spike event for csr insn
@@ -72,7 +85,7 @@ std::optional<SpikeEvent> VBridgeImpl::create_spike_event(insn_fetch_t fetch) {
 // dealing with trap:
 // most traps are dealt by Spike when [proc.step(1)];
 // traps during fetch stage [fetch = proc.get_mmu()->load_insn(state->pc)] are dealt manually using try-catch block below.
-std::optional<SpikeEvent> VBridgeImpl::spike_step() {
+SpikeEvent *VBridgeImpl::spike_step() {
   auto state = proc.get_state();
   // to use pro.state, set some csr
   state->dcsr->halt = false;
@@ -80,33 +93,34 @@ std::optional<SpikeEvent> VBridgeImpl::spike_step() {
   auto pc_before = state->pc;
   try {
     auto fetch = proc.get_mmu()->load_insn(state->pc);
-    auto event = create_spike_event(fetch);
-    auto &xr = proc.get_state()->XPR;
-    LOG(INFO) << fmt::format("Spike start to execute pc=[{:08X}] insn = {:08X} DISASM:{}", pc_before, fetch.insn.bits(),
-                             proc.get_disassembler()->disassemble(fetch.insn));
-    auto &se = event.value();
+    auto &se = create_spike_event(fetch);
+    VLOG(1) << fmt::format("Spike start to execute pc=[{:08X}] insn = {:08X} DISASM:{}", pc_before, fetch.insn.bits(),
+                           proc.get_disassembler()->disassemble(fetch.insn));
     se.pre_log_arch_changes();
     proc.step(1);
     se.log_arch_changes();
+    if (flight.enabled()) {
+      flight.record(get_t(), flight_event::SPIKE_STEP, se.pc, se.rd_new_bits, se.inst_bits, se.rd_idx);
+    }
     // todo: detect exactly the trap
     // if a insn_after_pc = 0x80000004,set it as committed
     // set insn which traps as committed in case the queue stalls
     if (state->pc == 0x80000004) {
       se.is_trap = true;
-      LOG(INFO) << fmt::format("Trap happens at pc = {:08X} ", pc_before);
+      VLOG(1) << fmt::format("Trap happens at pc = {:08X} ", pc_before);
     }
-    LOG(INFO) << fmt::format("Spike after execute pc={:08X} ", state->pc);
-    return event;
+    VLOG(1) << fmt::format("Spike after execute pc={:08X} ", state->pc);
+    return &se;
   } catch (trap_t &trap) {
     LOG(INFO) << fmt::format("spike fetch trapped with {}", trap.name());
     proc.step(1);
     LOG(INFO) << fmt::format("Spike mcause={:08X}", state->mcause->read());
-    return {};
+    return nullptr;
   } catch (triggers::matched_t &t) {
     LOG(INFO) << fmt::format("spike fetch triggers ");
     proc.step(1);
     LOG(INFO) << fmt::format("Spike mcause={:08X}", state->mcause->read());
-    return {};
+    return nullptr;
   }
 }
 
@@ -119,29 +133,305 @@ uint8_t VBridgeImpl::load(uint64_t address) {
 }
 
 int VBridgeImpl::timeoutCheck() {
+  metrics.set_cycle(get_t());
+  if (vbridges_interrupted.load(std::memory_order_relaxed)) {
+    // like every other abort, a mismatch of the buffered f writes fails the run through the TRY of the caller
+    if (fp_check.enabled()) fp_check.flush();
+    terminated = true;
+    LOG(ERROR) << fmt::format("[{}] interrupted, finishing the simulation", get_t());
+    dump_flight_recorder("interrupted");
+    on_finish(false);
+    dpiFinish();
+    return 0;
+  }
+  if (fuzz) {
+    if (fuzz_reset_cycles == 0 && get_t() - fuzz_start_t > fuzz_timeout) {
+      LOG(FATAL_S) << fmt::format("fuzz program timeout, t={}, started at {}", get_t(), fuzz_start_t);
+    }
+    return 0;
+  }
   if (get_t() > timeout) {
-    LOG(FATAL_S) << fmt::format("Simulation timeout, t={}", get_t());
+    LOG(ERROR) << fmt::format("Simulation timeout, t={}", get_t());
+    throw TimeoutException();
+  }
+  if (watchdog.check(get_t())) {
+    LOG(FATAL_S) << fmt::format("hang detected, {}", watchdog.summary(get_t()));
+  }
+  if (snapshots_enabled) {
+    if (snapshots.resumed()) {
+      if (get_t() > snapshots.failure_t + snapshot_every) {
+        LOG(FATAL_S) << fmt::format("re-simulation passed the failure at t={} without failing", snapshots.failure_t);
+      }
+    } else if (get_t() >= next_snapshot_t) {
+      next_snapshot_t = get_t() + snapshot_every;
+      if (snapshots.take(get_t())) resume_failure_window();
+    }
   }
   return 0;
 }
 
+void VBridgeImpl::dump_flight_recorder(const char *reason) {
+  // a resumed snapshot leaves the outputs to the original process
+  if (!flight.enabled() || (snapshots_enabled && snapshots.resumed())) return;
+  if (flight.dump(flight_recorder_out, fmt::format("[{}] {}", get_t(), reason))) {
+    LOG(ERROR) << fmt::format("last events written to {}", flight_recorder_out);
+  } else {
+    LOG(ERROR) << fmt::format("cannot write the flight recorder to {}", flight_recorder_out);
+  }
+}
+
+void VBridgeImpl::resimulate_failure() {
+  if (!snapshots_enabled || snapshots.resumed()) return;
+  uint64_t failure_t = get_t(), snapshot_t;
+  LOG(INFO) << fmt::format("[{}] re-simulating the failure window with waves", failure_t);
+  if (!snapshots.resume_latest(failure_t, snapshot_t)) {
+    LOG(ERROR) << "no snapshot was taken before the failure, no waves written";
+    return;
+  }
+  LOG(INFO) << fmt::format("waves of t={} to the failure at t={} written to {}-failure.fst", snapshot_t, failure_t,
+                           wave);
+}
+
+void VBridgeImpl::resume_failure_window() {
+  LOG(INFO) << fmt::format("[{}] snapshot resumed to re-simulate up to the failure at t={}", get_t(),
+                           snapshots.failure_t);
+  // the original process has written this window already and owns the files, drop them without flushing
+  commit_trace_file = nullptr;
+  mem_trace.abandon();
+  tl_profile.abandon();
+  FLAGS_v = std::max(FLAGS_v, snapshot_verbosity);
+  ::dpiDumpWave((wave + "-failure.fst").c_str());
+}
+
+void VBridgeImpl::on_finish(bool passed) {
+  // a resumed snapshot only writes its waves, the metrics, coverage and images belong to the original process
+  if (snapshots_enabled && snapshots.resumed()) return;
+  LOG(INFO) << fmt::format("[{}] simulation finished, {} insns committed", get_t(), committed_insns);
+  if (fp_check.enabled()) LOG(INFO) << fmt::format("{} f register writes checked", fp_check.checked());
+  LOG(INFO) << "long latency writebacks:" << ll_board.summary();
+  metrics.set_status(passed ? sim_metrics_page_t::PASSED : sim_metrics_page_t::FAILED);
+  metrics.close();
+  if (commit_trace_file) {
+    fclose(commit_trace_file);
+    commit_trace_file = nullptr;
+  }
+  mem_trace.close();
+  if (mem_model) LOG(INFO) << "memory timing: " << mem_model->summary();
+  if (tl_profile.enabled()) {
+    LOG(INFO) << "TileLink traffic:" << tl_profile.summary();
+    tl_profile.close();
+  }
+  if (!mem_image_path.empty() && !sim.save_image(mem_image_path)) {
+    LOG(ERROR) << fmt::format("failed to write the memory image to {}", mem_image_path);
+  }
+  if (alloc_stats_enabled() && committed_insns > alloc_warmup_insns) {
+    uint64_t steady_insns = committed_insns - alloc_warmup_insns;
+    uint64_t steady_allocs = alloc_count() - alloc_count_at_warmup;
+    LOG(INFO) << fmt::format("steady state allocations: {} in {} insns ({:.4f} per insn)", steady_allocs,
+                             steady_insns, (double) steady_allocs / (double) steady_insns);
+  }
+  if (!coverage_path.empty()) {
+    if (coverage.save(coverage_path)) {
+      LOG(INFO) << fmt::format("isa coverage of {} insns written to {}, {} of {} bins covered", coverage.insns(),
+                               coverage_path, coverage.covered(), isa_coverage::nBins);
+    } else {
+      LOG(ERROR) << fmt::format("failed to write isa coverage to {}", coverage_path);
+    }
+  }
+}
+
+void VBridgeImpl::fuzz_init() {
+  uint64_t seed = std::stoul(get_env_arg_default("COSIM_fuzz_seed", "1"), nullptr, 10);
+  size_t len = std::stoul(get_env_arg_default("COSIM_fuzz_len", "200"), nullptr, 10);
+  uint64_t limit = std::stoul(fuzz_arg, nullptr, 10);
+  fuzz_timeout = std::stoul(get_env_arg_default("COSIM_fuzz_timeout", "0"), nullptr, 10);
+  // every insn may miss in both caches, be generous
+  if (fuzz_timeout == 0) fuzz_timeout = 20000 + 400 * len;
+  fuzz.emplace(seed, xlen, len, limit, reset_vector);
+  fuzz_start_ns = sim_metrics_t::now_ns();
+  LOG(INFO) << fmt::format("fuzz mode: seed={}, len={}, programs={}, timeout={}, xlen={}", seed, len, limit,
+                           fuzz_timeout, xlen);
+  // rtl is still in its initial reset
+  if (!fuzz_start_program(false)) throw ReturnException();
+}
+
+bool VBridgeImpl::fuzz_start_program(bool reset_rtl) {
+  const fuzz_program *p = fuzz->next();
+  if (p == nullptr) return false;
+
+  reset_bridge();
+  // overwrite the previous program in place, the stale tail beyond the new end loop is unreachable
+  auto image = p->image();
+  sim.write(reset_vector, image.data(), image.size());
+  proc.reset();
+  proc.get_mmu()->flush_icache();
+  proc.get_mmu()->flush_tlb();
+
+  fuzz_end_pc = p->end_pc(reset_vector);
+  fuzz_start_t = get_t();
+  if (reset_rtl) fuzz_reset_cycles = fuzz_reset_hold;
+  VLOG(1) << fmt::format("[{}] fuzz program of {} insns loaded, end pc={:08X}", get_t(), p->body.size(), fuzz_end_pc);
+  return true;
+}
+
+void VBridgeImpl::reset_bridge() {
+  to_rtl_queue.clear();
+  tl_banks.clear();
+  for (auto &fetch_bank: fetch_banks) fetch_bank.remaining = false;
+  for (auto &aquire_bank: aquire_banks) {
+    aquire_bank.remaining = false;
+    aquire_bank.is_releaseData = false;
+  }
+  beforeReturnAquire = 0;
+  isPokingAcquie = false;
+  isPokingFetch = false;
+  ll_board.reset();
+  tl_profile.reset();
+  fetch_ready_at = aquire_ready_at = 0;
+  flight.clear();
+  tl_outstanding = 0;
+  digest_check.reset();
+  fp_check.reset();
+}
+
+void VBridgeImpl::fuzz_program_done() {
+  fuzz->report(false, "");
+  if (!fuzz->minimizing() && fuzz->passed() % 1000 == 0) fuzz_log_rate();
+  if (fuzz_start_program(true)) return;
+  if (fuzz->done()) {
+    // the last candidate of the minimizer passed
+    fuzz_dump_failure();
+    LOG(FATAL_S) << fmt::format("fuzz found a failure: {}", fuzz->failure_what());
+  }
+  fuzz_log_rate();
+  throw ReturnException();
+}
+
+bool VBridgeImpl::fuzz_on_failure(const char *what) {
+  if (!fuzz || fuzz->done()) return false;
+  if (fuzz->minimizing()) {
+    VLOG(1) << fmt::format("fuzz candidate failed: {}", what);
+  } else {
+    LOG(ERROR) << fmt::format("[{}] fuzz program failed after {} passed: {}", get_t(), fuzz->passed(), what);
+    fuzz_log_rate();
+    LOG(INFO) << "minimizing the failing program";
+  }
+  fuzz->report(true, what);
+  if (fuzz_start_program(true)) return true;
+  fuzz_dump_failure();
+  return false;
+}
+
+bool VBridgeImpl::dpiFuzzReset() {
+  if (fuzz_reset_cycles == 0) return false;
+  fuzz_reset_cycles--;
+  return true;
+}
+
+void VBridgeImpl::fuzz_log_rate() {
+  double seconds = (double) (sim_metrics_t::now_ns() - fuzz_start_ns) * 1e-9;
+  LOG(INFO) << fmt::format("fuzz: {} programs passed in {:.1f}s, {:.1f} programs/s", fuzz->passed(), seconds,
+                           seconds > 0 ? (double) fuzz->passed() / seconds : 0);
+}
+
+void VBridgeImpl::fuzz_dump_failure() {
+  const fuzz_program &p = fuzz->smallest_failure();
+  auto image = p.image();
+  std::ofstream(fuzz_out + ".bin", std::ios::binary).write(reinterpret_cast<const char *>(image.data()),
+                                                           (std::streamsize) image.size());
+  std::ofstream listing(fuzz_out + ".S");
+  listing << "# " << fuzz->failure_what() << "\n";
+  auto code = p.code();
+  for (size_t i = 0; i < code.size(); i++) {
+    listing << fmt::format("{:08x}: {:08x}  {}\n", reset_vector + 4 * i, code[i],
+                           proc.get_disassembler()->disassemble(insn_t(code[i])));
+  }
+  LOG(ERROR) << fmt::format(
+      "fuzz failure minimized to {} insns in {} runs, written to {}.bin and {}.S; rerun with COSIM_bin={}.bin passaddress={:x}",
+      p.body.size(), fuzz->minimizer_runs(), fuzz_out, fuzz_out, fuzz_out, p.end_pc(reset_vector));
+}
+
 void VBridgeImpl::dpiInitCosim() {
-  google::InitGoogleLogging("emulator");
-  FLAGS_logtostderr = true;
+  // glog is shared by the instances of the process
+  static std::once_flag glog_initialized;
+  std::call_once(glog_initialized, [] {
+    google::InitGoogleLogging("emulator");
+    FLAGS_logtostderr = true;
+  });
 
   ctx = Verilated::threadContextp();
 
   init_spike();
 
+  if (!metrics_path.empty() && !metrics.open(metrics_path, "cosim")) {
+    LOG(ERROR) << fmt::format("cannot open {} for metrics, continuing without", metrics_path);
+  }
+
+  if (!commit_trace_path.empty()) {
+    commit_trace_file = fopen(commit_trace_path.c_str(), "wb");
+    if (commit_trace_file) {
+      setvbuf(commit_trace_file, nullptr, _IOFBF, 1 << 20);
+      commit_trace_header_t header{commit_trace_header_t::MAGIC, commit_trace_header_t::VERSION,
+                                   sizeof(commit_record_t), 0};
+      fwrite(&header, sizeof(header), 1, commit_trace_file);
+    } else {
+      LOG(ERROR) << fmt::format("cannot open {} for the commit trace, continuing without", commit_trace_path);
+    }
+  }
+
+  if (!mem_trace_path.empty() && !mem_trace.open(mem_trace_path)) {
+    LOG(ERROR) << fmt::format("cannot open {} for the memory trace, continuing without", mem_trace_path);
+  }
+
+  mem_model = mem_timing_model::create(mem_model_spec);
+
+  flight.configure(flight_recorder_events);
+
+  if (!tl_profile_path.empty() && !tl_profile.open(tl_profile_path, tl_profile_interval)) {
+    LOG(ERROR) << fmt::format("cannot open {} for the TileLink profile, continuing without", tl_profile_path);
+  }
+
+  // the cosim FPU has fLen = xLen
+  fp_check.configure(fp_check_enabled ? xlen : 0);
+  digest_check.configure_fp(fp_check_enabled ? xlen : 0);
+
+  // the fuzz mode has its own per program timeout
+  if (!fuzz) watchdog.configure(watchdog_limit);
+
+  if (snapshot_every) {
+    if (ctx->threads() > 1) {
+      LOG(ERROR) << fmt::format("snapshots need a single threaded model, this one has {} threads, continuing without",
+                                ctx->threads());
+    } else if (instance_env) {
+      LOG(ERROR) << "snapshots need a process of their own, this instance shares it, continuing without";
+    } else if (fuzz) {
+      LOG(ERROR) << "snapshots are not taken in fuzz mode, continuing without";
+    } else {
+      snapshots_enabled = true;
+      next_snapshot_t = snapshot_every;
+    }
+  }
+
   LOG(INFO) << fmt::format("[{}] dpiInitCosim", getCycle());
 
-  dpiDumpWave();
+  // with snapshots only the failure window is traced, an empty COSIM_wave traces nothing
+  if (!snapshots_enabled && !wave.empty()) dpiDumpWave();
 }
 
 void VBridgeImpl::dpiPeekTL(svBit miss, svBitVecVal pc, const TlAPeekInterface &tl_peek, const TlCPeekInterface &tl_c) {
   VLOG(3) << fmt::format("[{}] dpiPeekTL", get_t());
+  if (fuzz_reset_cycles) return;
 
   if (!tl_peek.a_valid && !tl_c.c_valid) return;
+  if (flight.enabled()) {
+    if (tl_c.c_valid) {
+      flight.record(get_t(), flight_event::TL_C, tl_c.c_bits_address, 0, tl_c.c_bits_source, tl_c.c_bits_opcode,
+                    tl_c.c_bits_size);
+    } else {
+      flight.record(get_t(), flight_event::TL_A, tl_peek.a_bits_address, tl_peek.a_bits_data, tl_peek.a_bits_source,
+                    tl_peek.a_bits_opcode, tl_peek.a_bits_size);
+    }
+  }
   if (tl_c.c_valid) {
     beforeReturnAquire = 1;
     LOG(INFO) << fmt::format("Find C channel for mem = {:08X}", tl_c.c_bits_address);
@@ -153,6 +443,9 @@ void VBridgeImpl::dpiPeekTL(svBit miss, svBitVecVal pc, const TlAPeekInterface &
       }
         // todo: check release data
       case TlOpcode::ReleaseData: {
+        tl_outstanding++;
+        if (tl_profile.enabled()) tl_profile.request(tl_c.c_bits_source, tl_profiler::RELEASE);
+        aquire_ready_at = tl_cycle + get_mem_req_cycles(tl_c.c_bits_address, 1u << tl_c.c_bits_size, true);
         aquire_banks[0].data = 0;
         aquire_banks[0].param = tl_c.c_bits_param;
         aquire_banks[0].source = tl_c.c_bits_source;
@@ -176,6 +469,9 @@ void VBridgeImpl::dpiPeekTL(svBit miss, svBitVecVal pc, const TlAPeekInterface &
     switch (opcode) {
       case TlOpcode::Get: {
         LOG(INFO) << fmt::format("fetch start at = {:08X}", addr);
+        tl_outstanding++;
+        if (tl_profile.enabled()) tl_profile.request(src, tl_profiler::GET);
+        fetch_ready_at = tl_cycle + get_mem_req_cycles(addr, 1u << size, false);
         for (int i = 0; i < emuConfig.get_beats(xlen); i++) {
           uint64_t insn = 0;
           for (int j = 0; j < emuConfig.get_xlenBytes(xlen); ++j) {
@@ -194,20 +490,20 @@ void VBridgeImpl::dpiPeekTL(svBit miss, svBitVecVal pc, const TlAPeekInterface &
   }
   // find corresponding SpikeEvent with addr
   SpikeEvent *se = nullptr;
-  for (auto se_iter = to_rtl_queue.rbegin(); se_iter != to_rtl_queue.rend(); se_iter++) {
-    if (addr == se_iter->block.addr) {
-      se = &(*se_iter);
-      LOG(INFO) << fmt::format("Find AcquireBlock from spikeEvent pc = {:08X}", se_iter->pc);
+  for (auto &se_iter: to_rtl_queue) {
+    if (addr == se_iter.block.addr) {
+      se = &se_iter;
+      LOG(INFO) << fmt::format("Find AcquireBlock from spikeEvent pc = {:08X}", se_iter.pc);
       break;
     }
   }
   // list the queue if error
   if (se == nullptr) {
-    for (auto se_iter = to_rtl_queue.rbegin(); se_iter != to_rtl_queue.rend(); se_iter++) {
+    for (auto &se_iter: to_rtl_queue) {
       LOG(INFO)
-          << fmt::format("List: spike pc = {:08X}, write reg({}) from {:08x} to {:08X}, is commit:{}", se_iter->pc,
-                         se_iter->rd_idx, se_iter->rd_old_bits, se_iter->rd_new_bits, se_iter->is_committed);
-      LOG(INFO) << fmt::format("List:spike block.addr = {:08X}", se_iter->block.addr);
+          << fmt::format("List: spike pc = {:08X}, write reg({}) from {:08x} to {:08X}, is commit:{}", se_iter.pc,
+                         se_iter.rd_idx, se_iter.rd_old_bits, se_iter.rd_new_bits, se_iter.is_committed);
+      LOG(INFO) << fmt::format("List:spike block.addr = {:08X}", se_iter.block.addr);
     }
     LOG(FATAL_S)
         << fmt::format("cannot find spike_event for tl_request; addr = {:08X}, pc = {:08X} , opcode = {}", addr, pc,
@@ -228,8 +524,8 @@ void VBridgeImpl::dpiPeekTL(svBit miss, svBitVecVal pc, const TlAPeekInterface &
       LOG(INFO)
           << fmt::format("[{}] receive rtl mem get req (addr={}, size={}byte), should return data {}", get_t(), addr,
                          decode_size(size), data);
-      tl_banks.emplace(
-          std::make_pair(addr, TLReqRecord{data, 1u << size, src, TLReqRecord::opType::Get, get_mem_req_cycles()}));
+      tl_banks.emplace(std::make_pair(addr, TLReqRecord{data, 1u << size, src, TLReqRecord::opType::Get,
+                                                        uncached_req_cycles}));
       mem_read->second.executed = true;
       break;
     }
@@ -251,13 +547,16 @@ void VBridgeImpl::dpiPeekTL(svBit miss, svBitVecVal pc, const TlAPeekInterface &
                        mem_write->second.size_by_byte, 1 << decode_size(size), addr, se->describe_insn());
 
       tl_banks.emplace(std::make_pair(addr, TLReqRecord{data, 1u << size, src, TLReqRecord::opType::PutFullData,
-                                                        get_mem_req_cycles()}));
+                                                        uncached_req_cycles}));
       mem_write->second.executed = true;
       break;
     }
 
     case TlOpcode::AcquireBlock: {
       beforeReturnAquire = 1;
+      tl_outstanding++;
+      if (tl_profile.enabled()) tl_profile.request(src, tl_profiler::ACQUIRE);
+      aquire_ready_at = tl_cycle + get_mem_req_cycles(addr, 1u << size, false);
       LOG(INFO) << fmt::format("Find AcquireBlock for mem = {:08X}", addr);
       for (int i = 0; i < emuConfig.get_beats(xlen); i++) {
         uint64_t data = 0;
@@ -284,7 +583,9 @@ void VBridgeImpl::dpiPokeTL(const TlPokeInterface &tl_poke) {
   uint8_t size = 0;
   uint16_t source = 0;
   uint16_t param = 0;
+  // beats are held back while the memory model has not delivered the data yet
   for (auto &fetch_bank: fetch_banks) {
+    if (tl_cycle < fetch_ready_at) break;
     if (isPokingAcquie) {
       isPokingAcquie = false;
       break;
@@ -298,10 +599,14 @@ void VBridgeImpl::dpiPokeTL(const TlPokeInterface &tl_poke) {
       size = 6;
       fetch_valid = true;
       isPokingFetch = true;
+      bool last = &fetch_bank == &fetch_banks[emuConfig.get_beats(xlen) - 1];
+      if (last) tl_outstanding--;
+      if (tl_profile.enabled()) tl_profile.response(source, false, last);
       break;
     }
   }
   for (auto &aquire_bank: aquire_banks) {
+    if (tl_cycle < aquire_ready_at) break;
     if (beforeReturnAquire) {
       beforeReturnAquire = 0;
       break;
@@ -316,8 +621,11 @@ void VBridgeImpl::dpiPokeTL(const TlPokeInterface &tl_poke) {
       *tl_poke.d_bits_data_low = aquire_bank.data;
       *tl_poke.d_bits_data_high = aquire_bank.data >> 32;
       *tl_poke.d_bits_param = 0;
-      aquire_bank.is_releaseData = false;
+      bool last = aquire_bank.is_releaseData || &aquire_bank == &aquire_banks[emuConfig.get_beats(xlen) - 1];
+      if (last) tl_outstanding--;
       source = aquire_bank.source;
+      if (tl_profile.enabled()) tl_profile.response(source, aquire_bank.is_releaseData, last);
+      aquire_bank.is_releaseData = false;
       size = aquire_bank.size;
       aqu_valid = true;
       isPokingAcquie = true;
@@ -330,6 +638,14 @@ void VBridgeImpl::dpiPokeTL(const TlPokeInterface &tl_poke) {
   *tl_poke.d_corrupt = 0;
   *tl_poke.d_bits_sink = 0;
   *tl_poke.d_bits_denied = 0;
+  if (flight.enabled() && (fetch_valid | aqu_valid)) {
+    uint64_t data = *tl_poke.d_bits_data_low + ((uint64_t) *tl_poke.d_bits_data_high << 32);
+    flight.record(get_t(), flight_event::TL_D, 0, data, source, *tl_poke.d_bits_opcode, size);
+  }
+  metrics.set_tl_outstanding(tl_outstanding);
+  if (tl_profile.enabled()) tl_profile.cycle();
+  tl_cycle++;
+  if (watchdog.enabled()) watchdog.tl(get_t(), tl_outstanding, fetch_valid | aqu_valid);
 }
 
 void VBridgeImpl::dpiRefillQueue() {
@@ -339,53 +655,136 @@ void VBridgeImpl::dpiRefillQueue() {
 // enter -> check rf write -> commit se -> pop se
 void VBridgeImpl::dpiCommitPeek(CommitPeekInterface cmInterface) {
   if (cmInterface.wb_valid == 0 && cmInterface.ll_wen == 0) return;
+  if (fuzz_reset_cycles) return;
   bool haveCommittedSe = false;
   uint64_t pc = cmInterface.wb_reg_pc;
+  if (flight.enabled()) {
+    uint8_t flags = (cmInterface.wb_valid ? flight_event::COMMIT_WB_VALID : 0) |
+                    (cmInterface.rf_wen ? flight_event::COMMIT_RF_WEN : 0) |
+                    (cmInterface.ll_wen ? flight_event::COMMIT_LL_WEN : 0) |
+                    (cmInterface.wb_set_sboard ? flight_event::COMMIT_SET_SBOARD : 0);
+    flight.record(get_t(), flight_event::COMMIT, pc,
+                  cmInterface.rf_wdata_low + ((uint64_t) cmInterface.rf_wdata_high << 32), cmInterface.wb_reg_inst,
+                  cmInterface.rf_waddr, flags);
+  }
 
   if(cmInterface.ll_wen){
     uint64_t wdata_low = cmInterface.rf_wdata_low;
     uint64_t wdata_high = cmInterface.rf_wdata_high;
     uint64_t wdata = wdata_low + (wdata_high << 32);
-    if (waitforMutiCycleInsn) {
-      if(cmInterface.rf_waddr == pendingInsn_waddr && wdata == pendingInsn_wdata){
-        waitforMutiCycleInsn = false;
-        LOG(INFO) << fmt::format("match mutiCycleInsn pc = {:08x}", pendingInsn_pc);
-      }
+    digest_check.rtl_ll_write(cmInterface.rf_waddr, wdata);
+    ll_board.writeback(get_t(), cmInterface.rf_waddr, wdata);
+    // an insn that does not write the register file may commit in the same cycle
+    if (!cmInterface.wb_valid) return;
+  }
+  VLOG(1) << fmt::format("RTL write back insn {:08X} time:={}", pc, get_t());
+  if (watchdog.enabled()) watchdog.commit(0, get_t(), pc, cmInterface.wb_reg_inst);
+  if (fuzz) {
+    if (pc == fuzz_end_pc) {
+      if (fp_check.enabled()) fp_check.flush();
+      fuzz_program_done();
+      return;
     }
-    return;
+  } else if (cmInterface.wb_reg_pc == pass_address) {
+    if (fp_check.enabled()) fp_check.flush();
+    throw ReturnException();
   }
-  LOG(INFO) << fmt::format("RTL write back insn {:08X} time:={}", pc, get_t());
-  if (cmInterface.wb_reg_pc == pass_address) { throw ReturnException(); }
-  // Check rf write info
-  if (cmInterface.rf_wen && (cmInterface.rf_waddr != 0)) {
+  // Check rf write info, rf_w* belong to ll_wen if it is set
+  if (cmInterface.rf_wen && !cmInterface.ll_wen && (cmInterface.rf_waddr != 0)) {
+    uint64_t wdata = cmInterface.rf_wdata_low + ((uint64_t) cmInterface.rf_wdata_high << 32);
+    // a long latency insn only reserves rd in the scoreboard, its value comes later with ll_wen.
+    // A csr insn takes spike's value when it is popped, like record_rf_access skips its write.
+    bool rtl_csr = clip(cmInterface.wb_reg_inst, 0, 6) == 0b1110011;
+    if (!cmInterface.wb_set_sboard && !rtl_csr) digest_check.rtl_write(cmInterface.rf_waddr, wdata);
     record_rf_access(cmInterface);
   }
 
   // set this spike event as committed
-  for (auto se_iter = to_rtl_queue.rbegin(); se_iter != to_rtl_queue.rend(); se_iter++) {
-    if (se_iter->pc == pc ) {
+  for (auto &se: to_rtl_queue) {
+    if (se.pc == pc ) {
       // mechanism to the insn which causes trap.
       // trapped insn will commit with the first insn after trap(0x80000004).
       // It demands the trap insn not to be the last one in the queue.
-      if (se_iter->pc == 0x80000004) {
-        for (auto se_it = to_rtl_queue.rbegin(); se_it != to_rtl_queue.rend(); se_it++) {
-          if (se_it->is_trap) se_it->is_committed = true;
+      if (se.pc == 0x80000004) {
+        for (auto &se_trap: to_rtl_queue) {
+          if (se_trap.is_trap) se_trap.is_committed = true;
         }
       }
-      se_iter->is_committed = true;
+      se.is_committed = true;
       haveCommittedSe = true;
-      LOG(INFO) << fmt::format("Set spike {:08X} as committed", se_iter->pc);
+      VLOG(1) << fmt::format("Set spike {:08X} as committed", se.pc);
       break;
     }
   }
 
   if (!haveCommittedSe) LOG(INFO) << fmt::format("RTL wb without se in pc =  {:08X}", pc);
   // pop the committed Event from the queue
-  for (int i = 0; i < to_rtl_queue_size; i++) {
-    if (to_rtl_queue.back().is_committed) {
-      LOG(INFO) << fmt::format("Pop SE pc = {:08X} ", to_rtl_queue.back().pc);
-      to_rtl_queue.pop_back();
-    }
+  while (!to_rtl_queue.empty() && to_rtl_queue.front().is_committed) {
+    auto &se = to_rtl_queue.front();
+    VLOG(1) << fmt::format("Pop SE pc = {:08X} ", se.pc);
+    digest_check.commit(se.pc, se.inst_bits, se.digest, se.is_mutiCycle, se.is_csr);
+    if (!coverage_path.empty()) coverage.record(se.inst_bits, se.decoded);
+    if (commit_trace_file) record_commit_trace(se);
+    if (mem_trace.enabled()) record_mem_trace(se);
+    to_rtl_queue.pop_front();
+  }
+
+  committed_insns++;
+  if (committed_insns == alloc_warmup_insns) alloc_count_at_warmup = alloc_count();
+  metrics.set_insns(committed_insns);
+  metrics.set_queue_depth(to_rtl_queue.size());
+}
+
+void VBridgeImpl::dpiFpWritePeek(const FpWritePeekInterface &fp) {
+  if (!fp_check.enabled() || fuzz_reset_cycles) return;
+  // both ports may write in the same cycle, they never write the same register then
+  if (fp.load_wen) {
+    uint64_t lo = fp.load_wdata_low + ((uint64_t) fp.load_wdata_high << 32);
+    fp_check.rtl_write(get_t(), fp.load_waddr, lo, fp.load_wdata_sign);
+    digest_check.rtl_fp_write(fp.load_waddr, lo, fp.load_wdata_sign);
+  }
+  if (fp.wb_wen) {
+    uint64_t lo = fp.wb_wdata_low + ((uint64_t) fp.wb_wdata_high << 32);
+    fp_check.rtl_write(get_t(), fp.wb_waddr, lo, fp.wb_wdata_sign);
+    digest_check.rtl_fp_write(fp.wb_waddr, lo, fp.wb_wdata_sign);
+  }
+}
+
+void VBridgeImpl::record_commit_trace(const SpikeEvent &se) {
+  commit_record_t r{};
+  r.cycle = get_t();
+  r.pc = se.pc;
+  r.inst = se.inst_bits;
+  r.flags = se.is_trap ? commit_record_t::EXCEPTION : commit_record_t::VALID;
+  if (!se.is_trap && se.is_rd_written) {
+    r.flags |= commit_record_t::WRITE_X;
+    r.rd = se.rd_idx;
+    r.wdata = se.rd_new_bits;
+  }
+  r.rs1_val = se.rs1_bits;
+  r.rs2_val = se.rs2_bits;
+  fwrite(&r, sizeof(r), 1, commit_trace_file);
+}
+
+void VBridgeImpl::record_mem_trace(const SpikeEvent &se) {
+  uint64_t t = get_t();
+  // Sv39 is the only mode rocket translates with, and machine mode never translates
+  uint64_t satp = se.satp_mode == 8 && se.priv != PRV_M ? se.satp : 0;
+  if (satp != mem_trace_satp) {
+    mem_trace.record(t, satp, mem_trace_record::SATP);
+    mem_trace_satp = satp;
+  }
+  mem_trace.record(t, se.pc, mem_trace_record::FETCH, se.is_compress ? 2 : 4);
+  // an amo reads and writes the same address, record it once
+  for (auto &[addr, read]: se.mem_access_record.all_reads) {
+    mem_trace.record(t, addr, se.is_amo ? mem_trace_record::AMO : mem_trace_record::LOAD, read.size_by_byte);
+  }
+  for (auto &[addr, write]: se.mem_access_record.all_writes) {
+    if (!se.is_amo) mem_trace.record(t, addr, mem_trace_record::STORE, write.size_by_byte);
+  }
+  if (!se.is_trap && (se.inst_bits & 0xfe007fff) == 0x12000073) {
+    bool has_rs1 = clip(se.inst_bits, 15, 19) != 0;
+    mem_trace.record(t, has_rs1 ? se.rs1_bits : 0, mem_trace_record::SFENCE, has_rs1);
   }
 }
 
@@ -403,29 +802,31 @@ void VBridgeImpl::record_rf_access(CommitPeekInterface cmInterface) {
 
   // exclude those rtl reg_write from csr insn
   if (rtl_csr) {
-    LOG(INFO) << fmt::format("RTL csr insn wirte reg({}) = {:08X}, pc = {:08X}", waddr, wdata, pc);
+    VLOG(1) << fmt::format("RTL csr insn wirte reg({}) = {:08X}, pc = {:08X}", waddr, wdata, pc);
     return;
   }
 
-  LOG(INFO) << fmt::format("RTL wirte reg({}) = {:08X}, pc = {:08X}", waddr, wdata, pc);
+  VLOG(1) << fmt::format("RTL wirte reg({}) = {:08X}, pc = {:08X}", waddr, wdata, pc);
 
   // find corresponding spike event
   SpikeEvent *se = nullptr;
-  for (auto se_iter = to_rtl_queue.rbegin(); se_iter != to_rtl_queue.rend(); se_iter++) {
-    if ((se_iter->pc == pc) && (se_iter->rd_idx == waddr) && (!se_iter->is_committed)) {
-      se = &(*se_iter);
+  for (auto &se_iter: to_rtl_queue) {
+    if ((se_iter.pc == pc) && (se_iter.rd_idx == waddr) && (!se_iter.is_committed)) {
+      se = &se_iter;
       break;
     }
   }
   if (se == nullptr) {
-    for (auto se_iter = to_rtl_queue.rbegin(); se_iter != to_rtl_queue.rend(); se_iter++) {
+    for (auto &se_iter: to_rtl_queue) {
       LOG(INFO)
-          << fmt::format("List: spike pc = {:08X}, write reg({}) from {:08x} to {:08X}, is commit:{}", se_iter->pc,
-                         se_iter->rd_idx, se_iter->rd_old_bits, se_iter->rd_new_bits, se_iter->is_committed);
+          << fmt::format("List: spike pc = {:08X}, write reg({}) from {:08x} to {:08X}, is commit:{}", se_iter.pc,
+                         se_iter.rd_idx, se_iter.rd_old_bits, se_iter.rd_new_bits, se_iter.is_committed);
     }
     LOG(FATAL_S)
         << fmt::format("RTL rf_write Cannot find se ; pc = {:08X} , waddr={:08X}, waddr=Reg({})", pc, waddr, waddr);
   }
+  // rtl decides which insns write back late: divides, loads that missed in the D$, RoCC
+  se->is_mutiCycle = cmInterface.wb_set_sboard;
   // start to check RTL rf_write with spike event
   // for non-store ins. check rf write
   // todo: why exclude store insn? store insn shouldn't write regfile., try to remove it
@@ -433,17 +834,75 @@ void VBridgeImpl::record_rf_access(CommitPeekInterface cmInterface) {
     CHECK_EQ_S(wdata, se->rd_new_bits & emuConfig.get_mask(xlen))
       << fmt::format("\n RTL write Reg({})={:08X} but Spike write={:08X}", waddr, wdata, se->rd_new_bits);
   } else if (se->is_mutiCycle) {
-      waitforMutiCycleInsn = true;
-      pendingInsn_pc = pc;
-      pendingInsn_waddr = se->rd_idx;
-      pendingInsn_wdata = se->rd_new_bits;
-      LOG(INFO) << fmt::format("Find MutiCycle Instruction pc={:08X}", pendingInsn_pc);
+    ll_board.issue(get_t(), waddr, se->rd_new_bits & emuConfig.get_mask(xlen), pc,
+                   ll_scoreboard::classify(se->decoded));
+    VLOG(1) << fmt::format("Find long latency insn pc={:08X}, {} in flight", pc, ll_board.outstanding());
   } else {
-    LOG(INFO) << fmt::format("Find Store insn");
+    VLOG(1) << fmt::format("Find Store insn");
+  }
+}
+
+namespace {
+    struct vbridge_entry {
+        VerilatedContext *context;
+        const cosim_env *env;
+        std::unique_ptr<VBridgeImpl> bridge;
+    };
+
+    std::mutex vbridges_mutex;
+    std::vector<vbridge_entry> vbridges;
+    /// bumped when a bridge is destroyed, a new context may reuse the address of the old one
+    std::atomic<uint64_t> vbridges_generation{0};
+
+    /// the last lookup of this thread, threads almost always call into one context
+    thread_local VerilatedContext *cached_context = nullptr;
+    thread_local VBridgeImpl *cached_bridge = nullptr;
+    thread_local uint64_t cached_generation = 0;
+
+    vbridge_entry &add_vbridge(VerilatedContext *context) {
+      // the members of VBridgeImpl read their settings through instance_env while it is constructed
+      vbridges.push_back(vbridge_entry{context, instance_env, std::make_unique<VBridgeImpl>()});
+      return vbridges.back();
+    }
+}
+
+VBridgeImpl &current_vbridge() {
+  VerilatedContext *context = Verilated::threadContextp();
+  uint64_t generation = vbridges_generation.load(std::memory_order_acquire);
+  if (context != cached_context || generation != cached_generation) {
+    std::lock_guard<std::mutex> lock(vbridges_mutex);
+    auto it = std::find_if(vbridges.begin(), vbridges.end(), [&](const auto &e) { return e.context == context; });
+    vbridge_entry &entry = it != vbridges.end() ? *it : add_vbridge(context);
+    cached_context = context;
+    cached_bridge = entry.bridge.get();
+    cached_generation = generation;
+    // the threads of the model of a context see the settings of its instance too
+    instance_env = entry.env;
   }
+  if (cached_bridge->scope) svSetScope(cached_bridge->scope);
+  return *cached_bridge;
 }
 
-VBridgeImpl vbridge_impl_instance;
+VBridgeImpl &create_vbridge(VerilatedContext *context) {
+  std::lock_guard<std::mutex> lock(vbridges_mutex);
+  return *add_vbridge(context).bridge;
+}
+
+void destroy_vbridge(VerilatedContext *context) {
+  std::unique_ptr<VBridgeImpl> bridge;
+  {
+    std::lock_guard<std::mutex> lock(vbridges_mutex);
+    auto it = std::find_if(vbridges.begin(), vbridges.end(), [&](const auto &e) { return e.context == context; });
+    if (it == vbridges.end()) return;
+    bridge = std::move(it->bridge);
+    vbridges.erase(it);
+    vbridges_generation.fetch_add(1, std::memory_order_release);
+  }
+}
+
+void interrupt_vbridges() {
+  vbridges_interrupted.store(true, std::memory_order_relaxed);
+}
 
 
 
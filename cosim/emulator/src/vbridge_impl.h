@@ -12,6 +12,20 @@
 #include "encoding.h"
 #include "spike_event.h"
 #include "emuconfig.h"
+#include "flat_containers.h"
+#include "flight_recorder.h"
+#include "arch_digest.h"
+#include "commit_trace.h"
+#include "fp_check.h"
+#include "fuzz.h"
+#include "hang_watchdog.h"
+#include "isa_coverage.h"
+#include "ll_scoreboard.h"
+#include "mem_timing.h"
+#include "mem_trace.h"
+#include "sim_metrics.h"
+#include "snapshot.h"
+#include "tl_profile.h"
 
 #include <svdpi.h>
 
@@ -66,6 +80,8 @@ public:
 
     void dpiCommitPeek(CommitPeekInterface cmInterface);
 
+    void dpiFpWritePeek(const FpWritePeekInterface &fp);
+
     void init_spike();
 
     uint64_t get_t();
@@ -74,10 +90,40 @@ public:
 
     int timeoutCheck();
 
+    /// called once when the simulation ends, either passed or aborted
+    void on_finish(bool passed);
+
+    /// polled by the Verbatim module every cycle, true while the fuzz mode holds rtl in reset
+    bool dpiFuzzReset();
+
+    /// give the fuzz mode a chance to take a failure of the current program and move on to the next one.
+    /// @return false if the simulation must abort
+    bool fuzz_on_failure(const char *what);
+
+    /// re-simulate the window from the latest snapshot up to a failure, with waves and verbose logging, before the
+    /// simulation aborts
+    void resimulate_failure();
+
+    /// format the last events of the flight recorder into COSIM_flight_recorder_out, the run is about to abort
+    void dump_flight_recorder(const char *reason);
+
     uint64_t getCycle() { return ctx->time(); }
 
     const int xlen = std::stoul(get_env_arg("xlen"), nullptr, 10);
 
+    /// incremental register digests of spike and rtl, fed by SpikeEvent, dpiCommitPeek and dpiFpWritePeek
+    digest_checker digest_check;
+
+    /// the FPU register file writes against spike's, fed by SpikeEvent and dpiFpWritePeek. COSIM_fp_check=0 turns
+    /// it and the f register digest off.
+    fp_write_checker fp_check;
+
+    /// the Verbatim module of this instance, which exports dpiDumpWave, dpiFinish and dpiError
+    svScope scope = nullptr;
+
+    /// the simulation passed or aborted, the remaining DPI calls are ignored
+    bool terminated = false;
+
 
 private:
 
@@ -86,13 +132,13 @@ private:
     processor_t proc;
 
     // verilator context
-    VerilatedContext *ctx;
+    VerilatedContext *ctx = nullptr;
     VerilatedFstC tfp;
 
     uint64_t _cycles;
 
-    /// file path of executable binary file, which will be executed.
-    const std::string bin = get_env_arg("COSIM_bin");
+    /// file path of executable binary file, which will be executed. Not used in fuzz mode.
+    const std::string bin = get_env_arg_default("COSIM_bin", "");
 
     const std::string ebin = get_env_arg("COSIM_entrance_bin");
 
@@ -104,12 +150,105 @@ private:
 
     const uint64_t timeout = std::stoul(get_env_arg("COSIM_timeout"), nullptr, 10);
 
-    const uint64_t pass_address = std::stoul(get_env_arg("passaddress"), nullptr, 16);
+    const uint64_t pass_address = std::stoul(get_env_arg_default("passaddress", "0"), nullptr, 16);
+
+    const bool fp_check_enabled = get_env_arg_default("COSIM_fp_check", "1") != "0";
+
+    // fuzz mode: random programs are run back to back in this process, rtl and spike are reset between them
+    // and the memory is overwritten in place. COSIM_fuzz is the number of programs, 0 to run until a failure.
+    const char *fuzz_arg = get_env_arg_default("COSIM_fuzz", nullptr);
+    std::optional<fuzz_session> fuzz;
+    /// failing programs are minimized and written to <COSIM_fuzz_out>.bin and .S
+    const std::string fuzz_out = get_env_arg_default("COSIM_fuzz_out", "fuzz-failure");
+    uint64_t fuzz_end_pc = 0;
+    uint64_t fuzz_start_t = 0;
+    /// per program timeout, in the time unit of COSIM_timeout
+    uint64_t fuzz_timeout = 0;
+    uint64_t fuzz_start_ns = 0;
+    /// cycles rtl is still held in reset, commits and TL requests of the old program are ignored meanwhile
+    int fuzz_reset_cycles = 0;
+    static constexpr int fuzz_reset_hold = 4;
+
+    void fuzz_init();
+
+    /// load the next program of the session and reset spike and the bridge, false if the session is over
+    bool fuzz_start_program(bool reset_rtl);
+
+    /// rtl committed the end loop of the current program
+    void fuzz_program_done();
+
+    void fuzz_dump_failure();
+
+    void fuzz_log_rate();
+
+    /// drop everything in flight, rtl is about to be reset
+    void reset_bridge();
+
+    /// where to write the isa coverage of this run, coverage is not collected when empty
+    const std::string coverage_path = get_env_arg_default("COSIM_coverage", "");
+
+    isa_coverage coverage;
+
+    /// commits written in the binary commit trace format of the emulator (commit_trace.h) when COSIM_commit_trace
+    /// names a file, e.g. for bp_sweep
+    const std::string commit_trace_path = get_env_arg_default("COSIM_commit_trace", "");
+    FILE *commit_trace_file = nullptr;
+
+    void record_commit_trace(const SpikeEvent &se);
+
+    /// fetches, loads and stores of the committed insns, written when COSIM_mem_trace names a file
+    const std::string mem_trace_path = get_env_arg_default("COSIM_mem_trace", "");
+    mem_trace_writer mem_trace;
+    /// satp of the last SATP record, 0 while untranslated
+    uint64_t mem_trace_satp = 0;
+    /// memory image saved at the end of the run when COSIM_mem_image names a file, for tlb_sweep to walk the page
+    /// tables of the memory trace
+    const std::string mem_image_path = get_env_arg_default("COSIM_mem_image", "");
+
+    void record_mem_trace(const SpikeEvent &se);
+
+    /// a snapshot of the process is taken every COSIM_snapshot_every time units, in the unit of COSIM_timeout. On a
+    /// failure the latest one re-simulates up to it, writing waves to <COSIM_wave>-failure.fst with VLOG level
+    /// COSIM_snapshot_verbosity, and the run itself writes no waves.
+    const uint64_t snapshot_every = std::stoul(get_env_arg_default("COSIM_snapshot_every", "0"), nullptr, 10);
+    const int snapshot_verbosity = std::stoi(get_env_arg_default("COSIM_snapshot_verbosity", "1"));
+    snapshot_keeper snapshots;
+    bool snapshots_enabled = false;
+    uint64_t next_snapshot_t = 0;
+
+    /// this process is the resumed snapshot: trace the window and leave the outputs to the original process
+    void resume_failure_window();
+
+    /// ends a hung run early instead of at COSIM_timeout: COSIM_watchdog time units without a commit or a TL
+    /// response to an outstanding request, or twice that many commits repeating a loop which touches no memory or csr
+    const uint64_t watchdog_limit = std::stoul(get_env_arg_default("COSIM_watchdog", "0"), nullptr, 10);
+    hang_watchdog_t watchdog;
+
+    /// the last COSIM_flight_recorder spike steps, TL beats and commits of each thread, 0 disables it
+    const size_t flight_recorder_events = std::stoul(get_env_arg_default("COSIM_flight_recorder", "16384"), nullptr,
+                                                     10);
+    const std::string flight_recorder_out = get_env_arg_default("COSIM_flight_recorder_out", "cosim-flight.log");
+    flight_recorder flight;
+
+    /// live counters for simtop, published when COSIM_metrics names a file
+    const std::string metrics_path = get_env_arg_default("COSIM_metrics", "");
+    sim_metrics_t metrics;
+    /// icache refills and acquire/release transactions whose D response is not finished
+    uint64_t tl_outstanding = 0;
+
+    /// occupancy and latency of the TileLink transactions, a CSV time series of COSIM_tl_profile_interval cycles is
+    /// written when COSIM_tl_profile names a file
+    const std::string tl_profile_path = get_env_arg_default("COSIM_tl_profile", "");
+    const uint64_t tl_profile_interval = std::stoul(get_env_arg_default("COSIM_tl_profile_interval", "10000"), nullptr,
+                                                    10);
+    tl_profiler tl_profile;
 
 
     //Spike
-    const size_t to_rtl_queue_size = 10;
-    std::list<SpikeEvent> to_rtl_queue;
+    static constexpr size_t to_rtl_queue_size = 10;
+    /// SpikeEvents are built in place and recycled by the ring, so stepping spike does not allocate.
+    /// front is the oldest event.
+    fixed_ring<SpikeEvent, to_rtl_queue_size> to_rtl_queue;
 
     std::map<reg_t, TLReqRecord> tl_banks;
     //todo: configure it
@@ -118,29 +257,62 @@ private:
 
     void loop_until_se_queue_full();
 
-    std::optional<SpikeEvent> spike_step();
+    /// step spike by one insn and append its SpikeEvent to to_rtl_queue, return nullptr if no event was created
+    SpikeEvent *spike_step();
 
-    std::optional<SpikeEvent> create_spike_event(insn_fetch_t fetch);
+    SpikeEvent &create_spike_event(insn_fetch_t &fetch);
 
     // methods for TL channel
     void receive_tl_req();
 
     void record_rf_access(CommitPeekInterface cmInterface);
 
+    /// the long latency insns committed by rtl whose ll_wen writeback is outstanding
+    ll_scoreboard ll_board;
+
     int beforeReturnAquire;
 
     bool isPokingAcquie;
     bool isPokingFetch;
 
-    bool waitforMutiCycleInsn;
-    uint32_t pendingInsn_pc;
-    uint32_t pendingInsn_waddr;
-    uint64_t pendingInsn_wdata;
-
-    int get_mem_req_cycles() {
-      return 1;
+    // allocation statistics
+    /// number of insns committed by rtl
+    uint64_t committed_insns = 0;
+    /// commits before we consider the run to be in steady state
+    static constexpr uint64_t alloc_warmup_insns = 1000;
+    uint64_t alloc_count_at_warmup = 0;
+
+    /// timing of the memory behind the TL responder, COSIM_mem_model selects it (mem_timing.h)
+    const std::string mem_model_spec = get_env_arg_default("COSIM_mem_model", "fixed");
+    std::unique_ptr<mem_timing_model> mem_model;
+    /// cycles of the D channel, the time base of mem_model
+    uint64_t tl_cycle = 0;
+    /// the D beats of the icache refill and of the acquire/release in flight are held back until then
+    uint64_t fetch_ready_at = 0;
+    uint64_t aquire_ready_at = 0;
+
+    /// only for the requests whose D beats are held back on fetch_ready_at or aquire_ready_at, the model keeps state
+    /// of every request it times
+    int get_mem_req_cycles(uint64_t addr, uint32_t bytes, bool write) {
+      return (int) mem_model->access(tl_cycle, addr, bytes, write);
     };
 
+    /// the remaining_cycles of the uncached requests recorded in tl_banks, which the bridge never answers
+    static constexpr int uncached_req_cycles = 1;
+
 };
 
-extern VBridgeImpl vbridge_impl_instance;
+/// The bridge of the VerilatedContext simulated by the calling thread, i.e. of the instance a DPI call comes from.
+/// Every context has its own VBridgeImpl, so several instances run in one process on their own threads, see
+/// cosim_main.cc. A context without bridge gets one configured from the process environment.
+VBridgeImpl &current_vbridge();
+
+/// create the bridge of a context with the settings of instance_env, before its model runs
+VBridgeImpl &create_vbridge(VerilatedContext *context);
+
+/// destroy the bridge of a context after its model is gone
+void destroy_vbridge(VerilatedContext *context);
+
+/// ask every bridge to dump its flight recorder and finish, which it does in its next timeoutCheck. Only sets a flag,
+/// so the SIGINT handler may call it
+void interrupt_vbridges();
@@ -0,0 +1,443 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "replacement.h"
+
+/// Trace-driven model of rocket's branch prediction: the BTB, BHT and RAS of BTB.scala, the predecode of
+/// Frontend.scala and the btb/bht updates of RocketCore.scala. It is run over the committed instruction stream, so it
+/// sees every prediction on the correct path in program order; wrong path fetches and the few cycles an update takes
+/// to reach the tables are not modeled. What it reports matches the "branch misprediction" and "control-flow target
+/// misprediction" perf events of the core.
+struct bp_config {
+    /// BTBParams, btb_entries == 0 is a core without BTB
+    unsigned btb_entries = 28;
+    /// matchBits of the BTB, i.e. max(nMatchBits, log2(icache set bytes))
+    unsigned match_bits = 14;
+    unsigned pages = 6;
+    unsigned ras = 6;
+    /// BHTParams, bht_entries == 0 is a BTB without BHT
+    unsigned bht_entries = 512;
+    unsigned counter_length = 1;
+    unsigned history_length = 8;
+    unsigned history_bits = 3;
+    /// RVC halves coreInstBytes and doubles fetchWidth, a fetch packet has 4 bytes either way
+    bool rvc = true;
+    /// c.jal only exists on RV32
+    unsigned xlen = 64;
+    unsigned vaddr_bits = 39;
+    /// the frontend installs entries for the jumps, returns and strongly taken branches it predicted by predecode
+    /// while the fetch queue runs low, which the model does not see: install them always or never
+    bool predecode_install = true;
+};
+
+struct bp_stats {
+    uint64_t insns = 0;
+    uint64_t branches = 0;
+    uint64_t jumps = 0;
+    uint64_t returns = 0;
+    /// fetch packets whose BTB lookup hit
+    uint64_t btb_hits = 0;
+    /// "branch misprediction": a branch went the other way than predicted
+    uint64_t direction_mispredicts = 0;
+    /// "control-flow target misprediction": a jump, or a branch going the predicted way, to the wrong target
+    uint64_t target_mispredicts = 0;
+    /// the BTB predicted an insn taken which is no control flow at all
+    uint64_t non_cfi_hits = 0;
+};
+
+/// how the core and the frontend see an insn
+struct bp_insn {
+    enum kind : uint8_t {
+        NONE, BRANCH, JAL, JALR
+    };
+    kind k;
+    bool call;
+    bool ret;
+    uint8_t len;
+    /// target of a BRANCH or JAL relative to the insn
+    int64_t offset;
+
+    static bp_insn decode(uint32_t inst, unsigned xlen);
+};
+
+class bp_model {
+public:
+    explicit bp_model(const bp_config &config);
+
+    /// the insn at pc retired (or trapped) and the next one retired at npc
+    void step(uint64_t pc, uint32_t inst, uint64_t npc, bool trap);
+
+    [[nodiscard]] const bp_stats &stats() const { return s; }
+
+private:
+    enum cfi_type : uint8_t {
+        CFI_BRANCH, CFI_JUMP, CFI_CALL, CFI_RET
+    };
+
+    struct bht_resp {
+        uint32_t history;
+        uint8_t value;
+    };
+
+    /// BTBResp of one fetch packet
+    struct btb_resp {
+        bool valid;
+        unsigned entry;
+        unsigned bridx;
+        cfi_type type;
+        bool taken;
+        uint64_t target;
+        bht_resp bht;
+    };
+
+    struct btb_entry {
+        bool valid = false;
+        uint64_t idx = 0;
+        unsigned idx_page = 0;
+        uint64_t tgt = 0;
+        unsigned tgt_page = 0;
+        unsigned bridx = 0;
+        cfi_type type = CFI_BRANCH;
+    };
+
+    btb_resp lookup(uint64_t fetch_pc);
+
+    /// r_btb_update of BTB.scala, entry is prediction.entry, entries.size() for none
+    void update(uint64_t pc, uint64_t br_pc, uint64_t target, cfi_type type, bool is_valid, unsigned entry);
+
+    [[nodiscard]] uint64_t page_of(uint64_t addr) const { return (addr & vaddr_mask) >> c.match_bits; }
+
+    [[nodiscard]] uint64_t idx_of(uint64_t addr) const { return (addr & match_mask) >> inst_shift; }
+
+    /// bit i is set when page i is valid and holds the page of addr
+    [[nodiscard]] uint32_t page_match(uint64_t addr) const;
+
+    [[nodiscard]] unsigned bht_index(uint64_t addr, uint32_t history) const;
+
+    void bht_update(uint64_t pc, const bht_resp &d, bool branch, bool taken, bool mispredict);
+
+    void ras_push(uint64_t addr);
+
+    void ras_pop();
+
+    [[nodiscard]] bool ras_empty() const { return ras_count == 0; }
+
+    void flush_btb();
+
+    const bp_config c;
+    bp_stats s;
+
+    unsigned inst_shift;
+    unsigned n_pages;
+    uint64_t vaddr_mask;
+    uint64_t match_mask;
+
+    std::vector<btb_entry> entries;
+    std::vector<uint64_t> pages;
+    uint32_t page_valid = 0;
+    unsigned next_page_repl = 0;
+    tree_plru repl;
+
+    std::vector<uint8_t> bht_table;
+    uint32_t history = 0;
+    unsigned bht_index_bits = 0;
+    uint64_t history_multiplier = 0;
+
+    std::vector<uint64_t> ras_stack;
+    unsigned ras_count = 0;
+    unsigned ras_pos = 0;
+
+    /// aligned address of the fetch packet the last insn came from, and its lookup
+    uint64_t packet = ~0ull;
+    btb_resp resp{};
+    /// the next insn is fetched from redirect_pc after a taken control flow, a misprediction or a trap
+    bool redirect = false;
+    uint64_t redirect_pc = 0;
+};
+
+// the model is shared by the tools as a header, every .cc of cosim/tools is an executable of its own
+
+inline bp_insn bp_insn::decode(uint32_t inst, unsigned xlen) {
+  auto bits = [inst](unsigned hi, unsigned lo) { return inst >> lo & ((1u << (hi - lo + 1)) - 1); };
+  auto sext = [](uint32_t v, unsigned width) { return (int64_t) (v ^ 1u << (width - 1)) - (1ll << (width - 1)); };
+  // x1 and x5 are the link registers
+  auto link = [](uint32_t r) { return (r & ~4u) == 1; };
+  bp_insn d{NONE, false, false, 4, 0};
+  if ((inst & 3) == 3) {
+    uint32_t rd = bits(11, 7);
+    switch (bits(6, 0)) {
+      case 0b1100011:
+        d.k = BRANCH;
+        d.offset = sext(bits(31, 31) << 12 | bits(7, 7) << 11 | bits(30, 25) << 5 | bits(11, 8) << 1, 13);
+        break;
+      case 0b1101111:
+        d.k = JAL;
+        d.call = rd & 1;
+        d.offset = sext(bits(31, 31) << 20 | bits(19, 12) << 12 | bits(20, 20) << 11 | bits(30, 21) << 1, 21);
+        break;
+      case 0b1100111:
+        d.k = JALR;
+        d.call = rd & 1;
+        d.ret = !d.call && link(bits(19, 15));
+        break;
+      default:
+        break;
+    }
+    return d;
+  }
+  d.len = 2;
+  uint32_t quadrant = bits(1, 0), funct3 = bits(15, 13);
+  if (quadrant == 1 && (funct3 == 5 || (funct3 == 1 && xlen == 32))) {  // c.j c.jal
+    d.k = JAL;
+    d.call = funct3 == 1;
+    d.offset = sext(bits(12, 12) << 11 | bits(8, 8) << 10 | bits(10, 9) << 8 | bits(6, 6) << 7 | bits(7, 7) << 6 |
+                    bits(2, 2) << 5 | bits(11, 11) << 4 | bits(5, 3) << 1, 12);
+  } else if (quadrant == 1 && funct3 >= 6) {  // c.beqz c.bnez
+    d.k = BRANCH;
+    d.offset = sext(bits(12, 12) << 8 | bits(6, 5) << 6 | bits(2, 2) << 5 | bits(11, 10) << 3 | bits(4, 3) << 1, 9);
+  } else if (quadrant == 2 && funct3 == 4 && bits(6, 2) == 0 && bits(11, 7) != 0) {  // c.jr c.jalr
+    d.k = JALR;
+    d.call = bits(12, 12);
+    d.ret = !d.call && link(bits(11, 7));
+  }
+  return d;
+}
+
+inline bp_model::bp_model(const bp_config &config)
+    : c(config), inst_shift(config.rvc ? 1 : 2), n_pages((config.pages + 1) / 2 * 2),
+      vaddr_mask(config.vaddr_bits >= 64 ? ~0ull : (1ull << config.vaddr_bits) - 1),
+      match_mask((1ull << config.match_bits) - 1), entries(config.btb_entries), pages(n_pages),
+      repl(config.btb_entries), bht_table(config.btb_entries ? config.bht_entries : 0),
+      ras_stack(config.btb_entries ? config.ras : 0) {
+  while ((1u << bht_index_bits) < c.bht_entries) bht_index_bits++;
+  history_multiplier = (uint64_t) (std::sqrt(3.0) / 2 * std::ldexp(1.0, (int) c.history_length));
+}
+
+inline uint32_t bp_model::page_match(uint64_t addr) const {
+  uint64_t p = page_of(addr);
+  uint32_t hit = 0;
+  for (unsigned i = 0; i < n_pages; i++)
+    if ((page_valid >> i & 1) && pages[i] == p) hit |= 1u << i;
+  return hit;
+}
+
+inline unsigned bp_model::bht_index(uint64_t addr, uint32_t hist) const {
+  uint64_t mask = c.bht_entries - 1;
+  uint64_t hi = addr >> 2;  // log2(fetchBytes)
+  uint64_t hashed_addr = (hi & mask) ^ (hi >> bht_index_bits & 3);
+  uint64_t hashed_history = hist;
+  if (c.history_length != c.history_bits)
+    hashed_history = (history_multiplier * hist) >> (c.history_length - c.history_bits) & ((1u << c.history_bits) - 1);
+  return (hashed_addr ^ hashed_history << (bht_index_bits - c.history_bits)) & mask;
+}
+
+inline bp_model::btb_resp bp_model::lookup(uint64_t fetch_pc) {
+  btb_resp r{};
+  r.entry = entries.size();
+  if (!bht_table.empty()) r.bht = {history, bht_table[bht_index(fetch_pc, history)]};
+  if (entries.empty()) return r;
+  uint64_t idx = idx_of(fetch_pc);
+  unsigned n_hit = 0, hit = 0;
+  for (unsigned i = 0; i < entries.size(); i++) {
+    if (entries[i].valid && entries[i].idx == idx) {
+      n_hit++;
+      hit = i;
+    }
+  }
+  if (n_hit >= 2) {
+    // if multiple entries for same PC land in BTB, rtl zaps them; what it predicts meanwhile is a mix of both
+    for (auto &e: entries)
+      if (e.valid && e.idx == idx) e.valid = false;
+    return r;
+  }
+  const btb_entry &e = entries[hit];
+  if (n_hit == 0 || !(page_match(fetch_pc) >> e.idx_page & 1)) return r;
+  s.btb_hits++;
+  r.valid = true;
+  r.entry = hit;
+  r.bridx = e.bridx;
+  r.type = e.type;
+  r.taken = bht_table.empty() || e.type != CFI_BRANCH || (r.bht.value & 1);
+  uint64_t tgt_page = page_valid >> e.tgt_page & 1 ? pages[e.tgt_page] : 0;
+  r.target = tgt_page << c.match_bits | e.tgt << inst_shift;
+  if (e.type == CFI_RET && !ras_empty()) r.target = ras_stack[ras_pos];
+  if (r.taken) repl.access(hit);
+  return r;
+}
+
+inline void bp_model::update(uint64_t pc, uint64_t br_pc, uint64_t target, cfi_type type, bool is_valid,
+                             unsigned entry) {
+  const uint32_t all = (1u << n_pages) - 1;
+  auto rotate = [&](uint32_t oh) { return (oh << 1 | oh >> (n_pages - 1)) & all; };
+  auto oh_to_uint = [&](uint32_t oh) {
+    unsigned u = 0;
+    for (unsigned i = 0; i < n_pages; i++)
+      if (oh >> i & 1) u |= i;
+    return u;
+  };
+
+  // the page replacement of BTB.scala, the pages of pc and target are kept in neighbouring banks
+  uint32_t page_hit = page_match(target);
+  uint32_t update_page_hit = page_match(pc);
+  bool do_idx_page_repl = update_page_hit == 0;
+  uint32_t idx_page_repl = rotate(page_hit) | (page_hit ? 0 : 1u << next_page_repl);
+  uint32_t idx_page_update_oh = update_page_hit ? update_page_hit : idx_page_repl;
+  unsigned idx_page_update = oh_to_uint(idx_page_update_oh);
+  uint32_t idx_page_repl_en = do_idx_page_repl ? idx_page_repl : 0;
+  bool same_page = page_of(pc) == page_of(target);
+  bool do_tgt_page_repl = !same_page && page_hit == 0;
+  uint32_t tgt_page_repl = same_page ? idx_page_update_oh : rotate(idx_page_update_oh);
+  unsigned tgt_page_update = oh_to_uint(page_hit | (page_hit ? 0 : tgt_page_repl));
+  uint32_t tgt_page_repl_en = do_tgt_page_repl ? tgt_page_repl : 0;
+  if (do_idx_page_repl || do_tgt_page_repl) {
+    unsigned next = next_page_repl + (do_idx_page_repl && do_tgt_page_repl ? 2 : 1);
+    next_page_repl = next >= n_pages ? next & 1 : next;
+  }
+
+  unsigned waddr = entry < entries.size() ? entry : repl.way();
+  repl.access(waddr);
+  btb_entry &e = entries[waddr];
+  e.valid = is_valid;
+  e.idx = idx_of(pc);
+  e.idx_page = idx_page_update;
+  e.tgt = idx_of(target);
+  e.tgt_page = tgt_page_update;
+  e.bridx = c.rvc ? br_pc >> inst_shift & 1 : 0;
+  e.type = type;
+
+  bool idx_writes_even = !(idx_page_update & 1);
+  for (unsigned i = 0; i < n_pages; i++) {
+    bool idx_bank = (i % 2 == 0) == idx_writes_even;
+    if ((idx_bank ? idx_page_repl_en : tgt_page_repl_en) >> i & 1) pages[i] = page_of(idx_bank ? pc : target);
+  }
+  page_valid |= idx_page_repl_en | tgt_page_repl_en;
+}
+
+inline void bp_model::bht_update(uint64_t pc, const bht_resp &d, bool branch, bool taken, bool mispredict) {
+  if (bht_table.empty()) return;
+  uint32_t history_mask = (1u << c.history_length) - 1;
+  if (branch) {
+    uint8_t v = d.value;
+    bht_table[bht_index(pc, d.history)] =
+        c.counter_length == 1 ? taken : (taken ^ (v & 1)) << 1 | (v == 1 || ((v >> 1 & 1) && taken));
+    if (mispredict) history = ((uint32_t) taken << (c.history_length - 1) | d.history >> 1) & history_mask;
+  } else if (mispredict) {
+    history = d.history;
+  }
+}
+
+inline void bp_model::ras_push(uint64_t addr) {
+  if (ras_stack.empty()) return;
+  if (ras_count < ras_stack.size()) ras_count++;
+  ras_pos = (ras_pos + 1) % ras_stack.size();
+  ras_stack[ras_pos] = addr;
+}
+
+inline void bp_model::ras_pop() {
+  if (ras_empty()) return;
+  ras_count--;
+  ras_pos = (ras_pos + ras_stack.size() - 1) % ras_stack.size();
+}
+
+inline void bp_model::flush_btb() {
+  for (auto &e: entries) e.valid = false;
+  resp.valid = false;
+  resp.taken = false;
+}
+
+inline void bp_model::step(uint64_t pc, uint32_t inst, uint64_t npc, bool trap) {
+  const bp_insn d = bp_insn::decode(inst, c.xlen);
+  const uint64_t seq_pc = pc + d.len;
+  // the halfword of an RVI insn the frontend scans it at, BTB entries are tagged with its fetch packet
+  const uint64_t br_pc = c.rvc ? pc + d.len - 2 : pc;
+  const uint64_t aligned = br_pc & ~3ull;
+
+  auto fetch = [&](uint64_t parcel) {
+    uint64_t p = parcel & ~3ull;
+    if (!redirect && p == packet) return;
+    resp = lookup(redirect ? redirect_pc : p);
+    packet = p;
+    redirect = false;
+  };
+  fetch(pc);
+  if (c.rvc && d.len == 4) {
+    if (resp.valid && resp.bridx == (pc >> 1 & 1)) {
+      // the BTB predicted the middle of an RVI insn, the frontend flushes it and refetches
+      s.non_cfi_hits++;
+      flush_btb();
+    }
+    fetch(br_pc);
+  }
+
+  // the prediction of the frontend: the BTB entry of the packet, or else the predecode
+  const unsigned idx = c.rvc ? br_pc >> 1 & 1 : 0;
+  const bool bht_taken = resp.bht.value & 1;
+  bool taken_predicted = false;
+  bool target_known = true;
+  uint64_t target = seq_pc;
+  if (resp.valid && resp.bridx == idx) {
+    taken_predicted = resp.taken;
+    target = resp.target;
+  } else if (!entries.empty() && !(resp.valid && resp.taken)) {
+    bool install = false;
+    cfi_type type = d.ret ? CFI_RET : d.call ? CFI_CALL : d.k == bp_insn::BRANCH ? CFI_BRANCH : CFI_JUMP;
+    if (d.k == bp_insn::BRANCH && bht_taken) {
+      taken_predicted = true;
+      target = pc + d.offset;
+      install = resp.bht.value == 1;  // strongly_taken
+    } else if (d.k == bp_insn::JAL) {
+      taken_predicted = true;
+      target = pc + d.offset;
+      install = true;
+    } else if (d.k == bp_insn::JALR) {
+      // without a BTB entry only a return has a target, other indirect jumps go down the wrong path
+      taken_predicted = true;
+      target_known = d.ret && !ras_empty();
+      if (target_known) target = ras_stack[ras_pos];
+      install = target_known;
+    }
+    if (install && !resp.valid && c.predecode_install) update(aligned, br_pc, target, type, true, entries.size());
+  }
+  if (!entries.empty()) {
+    if (d.call) ras_push(seq_pc);
+    else if (d.ret) ras_pop();
+    if (d.k == bp_insn::BRANCH && !bht_table.empty())
+      history = ((uint32_t) bht_taken << (c.history_length - 1) | history >> 1) & ((1u << c.history_length) - 1);
+  }
+
+  if (trap) {
+    // the exception is taken in wb, the predictor is not updated
+    redirect = true;
+    redirect_pc = npc;
+    return;
+  }
+
+  // resolution in the mem stage of the core
+  s.insns++;
+  const bool cfi = d.k != bp_insn::NONE;
+  const bool taken = d.k == bp_insn::BRANCH ? npc != seq_pc : cfi;
+  if (d.k == bp_insn::BRANCH) s.branches++;
+  else if (d.ret) s.returns++;
+  else if (cfi) s.jumps++;
+  // npc of the core, insns like xret redirect from wb instead
+  const uint64_t core_npc = cfi ? npc : seq_pc;
+  const uint64_t predicted_npc = taken_predicted ? target : seq_pc;
+  const bool wrong_npc = !target_known || ((predicted_npc ^ core_npc) & vaddr_mask) != 0;
+  if (wrong_npc) {
+    if (d.k == bp_insn::BRANCH && taken != taken_predicted) s.direction_mispredicts++;
+    else if (cfi) s.target_mispredicts++;
+    else s.non_cfi_hits++;
+    if (!entries.empty() && (!cfi || taken)) {
+      cfi_type type = d.call ? CFI_CALL : d.ret ? CFI_RET : d.k == bp_insn::BRANCH ? CFI_BRANCH : CFI_JUMP;
+      update(aligned, br_pc, core_npc, type, cfi, resp.valid ? resp.entry : entries.size());
+    }
+  }
+  bht_update(aligned, resp.bht, d.k == bp_insn::BRANCH, taken, wrong_npc);
+  if (wrong_npc || npc != seq_pc) {
+    redirect = true;
+    redirect_pc = npc;
+  }
+}
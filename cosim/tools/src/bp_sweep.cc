@@ -0,0 +1,265 @@
+// Sweeps branch predictor configurations over one commit trace with the trace-driven model of bp_model.h.
+//
+// bp_sweep [-j THREADS] [--hart=ID] [--xlen=32|64] [--hpm=TRACE] [KEY=V1,V2,...]... TRACE
+//
+// TRACE is a commit trace of the emulator (--commit-trace) or of the cosim (COSIM_commit_trace). Every KEY=V1,V2,...
+// lists the values of one parameter and the product of all lists is swept; parameters which are not given keep
+// rocket's defaults:
+//
+//   btb=28 match=14 pages=6 ras=6 bht=512 ctr=1 hist=8 hbits=3 rvc=1 install=1 vaddr=39
+//
+// One CSV row per configuration is printed, configurations run in parallel on THREADS threads (all cores by default).
+// With --hpm, the misprediction counters of an HPM trace (--hpm-trace) of the run which wrote TRACE are compared with
+// the first configuration, which should be the one the RTL was built with.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "bp_model.h"
+#include "commit_trace.h"
+#include "hpm_trace.h"
+
+struct trace_insn {
+    uint64_t cycle;
+    uint64_t pc;
+    uint32_t inst;
+    bool trap;
+};
+
+struct param {
+    const char *key;
+    unsigned (*get)(const bp_config &);
+    void (*set)(bp_config &, unsigned);
+};
+
+static const param params[] = {
+    {"btb", [](const bp_config &c) { return c.btb_entries; }, [](bp_config &c, unsigned v) { c.btb_entries = v; }},
+    {"match", [](const bp_config &c) { return c.match_bits; }, [](bp_config &c, unsigned v) { c.match_bits = v; }},
+    {"pages", [](const bp_config &c) { return c.pages; }, [](bp_config &c, unsigned v) { c.pages = v; }},
+    {"ras", [](const bp_config &c) { return c.ras; }, [](bp_config &c, unsigned v) { c.ras = v; }},
+    {"bht", [](const bp_config &c) { return c.bht_entries; }, [](bp_config &c, unsigned v) { c.bht_entries = v; }},
+    {"ctr", [](const bp_config &c) { return c.counter_length; },
+     [](bp_config &c, unsigned v) { c.counter_length = v; }},
+    {"hist", [](const bp_config &c) { return c.history_length; },
+     [](bp_config &c, unsigned v) { c.history_length = v; }},
+    {"hbits", [](const bp_config &c) { return c.history_bits; }, [](bp_config &c, unsigned v) { c.history_bits = v; }},
+    {"rvc", [](const bp_config &c) { return (unsigned) c.rvc; }, [](bp_config &c, unsigned v) { c.rvc = v; }},
+    {"install", [](const bp_config &c) { return (unsigned) c.predecode_install; },
+     [](bp_config &c, unsigned v) { c.predecode_install = v; }},
+    {"vaddr", [](const bp_config &c) { return c.vaddr_bits; }, [](bp_config &c, unsigned v) { c.vaddr_bits = v; }},
+};
+
+static void usage(const char *program_name) {
+  fmt::print("Usage: {} [-j THREADS] [--hart=ID] [--xlen=32|64] [--hpm=TRACE] [KEY=V1,V2,...]... TRACE\n",
+             program_name);
+  fmt::print("KEY is one of");
+  for (auto &p: params) fmt::print(" {}", p.key);
+  fmt::print("\n");
+}
+
+static bool is_pow2(unsigned v) { return v && !(v & (v - 1)); }
+
+static std::string check(const bp_config &c) {
+  unsigned bht_bits = 0;
+  while ((1u << bht_bits) < c.bht_entries) bht_bits++;
+  if (c.bht_entries && !is_pow2(c.bht_entries)) return "bht must be a power of 2";
+  if (c.counter_length != 1 && c.counter_length != 2) return "ctr must be 1 or 2";
+  if (c.history_length == 0 || c.history_length > 31) return "hist must be in 1..31";
+  if (c.history_bits > c.history_length || (c.bht_entries && c.history_bits > bht_bits))
+    return "hbits must not exceed hist or log2(bht)";
+  if (c.pages == 0 || c.pages > 31) return "pages must be in 1..31";
+  if (c.vaddr_bits > 64 || c.match_bits < 2 || c.match_bits >= c.vaddr_bits) return "match must be in 2..vaddr-1";
+  return "";
+}
+
+static bool parse_values(const char *list, std::vector<unsigned> &values) {
+  for (const char *p = list; *p;) {
+    char *end;
+    unsigned long v = strtoul(p, &end, 0);
+    if (end == p || (*end && *end != ',')) return false;
+    values.push_back(v);
+    p = *end ? end + 1 : end;
+  }
+  return !values.empty();
+}
+
+static bool load_trace(const char *path, long hart, std::vector<trace_insn> &insns) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fmt::print(stderr, "Unable to open {}\n", path);
+    return false;
+  }
+  commit_trace_header_t header{};
+  if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != commit_trace_header_t::MAGIC ||
+      header.version != commit_trace_header_t::VERSION || header.record_size != sizeof(commit_record_t)) {
+    fmt::print(stderr, "{} is not a commit trace of this version\n", path);
+    fclose(f);
+    return false;
+  }
+  std::vector<commit_record_t> records(commit_trace_t::CHUNK_RECORDS);
+  size_t n;
+  while ((n = fread(records.data(), sizeof(commit_record_t), records.size(), f)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      const commit_record_t &r = records[i];
+      if (r.hartid != hart || (r.flags & commit_record_t::LATE_WRITE)) continue;
+      insns.push_back({r.cycle, r.pc, r.inst, (r.flags & commit_record_t::EXCEPTION) != 0});
+    }
+  }
+  fclose(f);
+  // records of several simulation threads are grouped per buffer
+  auto by_cycle = [](const trace_insn &a, const trace_insn &b) { return a.cycle < b.cycle; };
+  if (!std::is_sorted(insns.begin(), insns.end(), by_cycle))
+    std::stable_sort(insns.begin(), insns.end(), by_cycle);
+  return true;
+}
+
+struct hpm_totals {
+    uint64_t insns = 0;
+    uint64_t direction_mispredicts = 0;
+    uint64_t target_mispredicts = 0;
+};
+
+static bool load_hpm(const char *path, long hart, hpm_totals &totals) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fmt::print(stderr, "Unable to open {}\n", path);
+    return false;
+  }
+  hpm_trace_header_t header{};
+  std::vector<hpm_event_desc_t> events;
+  if (fread(&header, sizeof(header), 1, f) == 1 && header.magic == hpm_trace_header_t::MAGIC &&
+      header.version == hpm_trace_header_t::VERSION && header.n_events <= hpm_trace_t::MAX_EVENTS) {
+    events.resize(header.n_events);
+    if (fread(events.data(), sizeof(hpm_event_desc_t), events.size(), f) != events.size()) events.clear();
+  }
+  if (events.empty()) {
+    fmt::print(stderr, "{} is not an HPM trace of this version\n", path);
+    fclose(f);
+    return false;
+  }
+  hpm_sample_t s{};
+  std::vector<uint32_t> counts(events.size());
+  while (fread(&s, sizeof(s), 1, f) == 1 && fread(counts.data(), sizeof(uint32_t), counts.size(), f) == counts.size()) {
+    if (s.hartid != hart) continue;
+    for (size_t i = 0; i < events.size(); i++) {
+      if (events[i].set == 0 && strcmp(events[i].name, "exception") != 0) totals.insns += counts[i];
+      else if (strcmp(events[i].name, "branch misprediction") == 0) totals.direction_mispredicts += counts[i];
+      else if (strcmp(events[i].name, "control-flow target misprediction") == 0) totals.target_mispredicts += counts[i];
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static double mpki(uint64_t n, uint64_t insns) { return insns ? 1000.0 * (double) n / (double) insns : 0; }
+
+static double error_percent(uint64_t model, uint64_t rtl) {
+  return rtl ? 100.0 * ((double) model - (double) rtl) / (double) rtl : 0;
+}
+
+int main(int argc, char **argv) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  long hart = 0;
+  unsigned xlen = 64;
+  const char *hpm_path = nullptr;
+  const char *path = nullptr;
+  std::vector<std::vector<unsigned>> grid(std::size(params));
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) threads = std::max(1, atoi(argv[++i]));
+    else if (strncmp(argv[i], "--hart=", 7) == 0) hart = atol(argv[i] + 7);
+    else if (strncmp(argv[i], "--xlen=", 7) == 0) xlen = atoi(argv[i] + 7);
+    else if (strncmp(argv[i], "--hpm=", 6) == 0) hpm_path = argv[i] + 6;
+    else if (argv[i][0] == '-') {
+      usage(argv[0]);
+      return strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1;
+    } else if (const char *eq = strchr(argv[i], '=')) {
+      std::string key(argv[i], eq - argv[i]);
+      auto it = std::find_if(std::begin(params), std::end(params), [&](const param &p) { return key == p.key; });
+      if (it == std::end(params) || !parse_values(eq + 1, grid[it - params])) {
+        usage(argv[0]);
+        return 1;
+      }
+    } else path = argv[i];
+  }
+  if (!path || (xlen != 32 && xlen != 64)) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  bp_config base;
+  base.xlen = xlen;
+  base.vaddr_bits = xlen == 32 ? 32 : 39;
+  std::vector<bp_config> configs{base};
+  for (size_t p = 0; p < std::size(params); p++) {
+    if (grid[p].empty()) continue;
+    std::vector<bp_config> expanded;
+    for (auto &c: configs) {
+      for (unsigned v: grid[p]) {
+        expanded.push_back(c);
+        params[p].set(expanded.back(), v);
+      }
+    }
+    configs.swap(expanded);
+  }
+  for (auto &c: configs) {
+    std::string error = check(c);
+    if (!error.empty()) {
+      fmt::print(stderr, "invalid configuration: {}\n", error);
+      return 1;
+    }
+  }
+
+  std::vector<trace_insn> insns;
+  if (!load_trace(path, hart, insns)) return 1;
+  if (insns.size() < 2) {
+    fmt::print(stderr, "{} has no insns of hart {}\n", path, hart);
+    return 1;
+  }
+  hpm_totals rtl;
+  if (hpm_path && !load_hpm(hpm_path, hart, rtl)) return 1;
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<bp_stats> results(configs.size());
+  std::atomic<size_t> next{0};
+  auto worker = [&] {
+    for (size_t i; (i = next.fetch_add(1)) < configs.size();) {
+      bp_model model(configs[i]);
+      for (size_t j = 0; j + 1 < insns.size(); j++)
+        model.step(insns[j].pc, insns[j].inst, insns[j + 1].pc, insns[j].trap);
+      results[i] = model.stats();
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < std::min<size_t>(threads, configs.size()); t++) pool.emplace_back(worker);
+  for (auto &t: pool) t.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (auto &p: params) fmt::print("{},", p.key);
+  fmt::print("insns,branches,jumps,returns,btb_hits,branch_mispredicts,target_mispredicts,non_cfi_hits,mpki\n");
+  for (size_t i = 0; i < configs.size(); i++) {
+    for (auto &p: params) fmt::print("{},", p.get(configs[i]));
+    const bp_stats &s = results[i];
+    fmt::print("{},{},{},{},{},{},{},{},{:.3f}\n", s.insns, s.branches, s.jumps, s.returns, s.btb_hits,
+               s.direction_mispredicts, s.target_mispredicts, s.non_cfi_hits,
+               mpki(s.direction_mispredicts + s.target_mispredicts, s.insns));
+  }
+  fmt::print(stderr, "{} configurations over {} insns in {:.1f}s\n", configs.size(), insns.size(), seconds);
+
+  if (hpm_path) {
+    const bp_stats &s = results[0];
+    fmt::print(stderr, "rtl:   {} insns, {} branch ({:.3f} mpki), {} target ({:.3f} mpki) mispredicts\n", rtl.insns,
+               rtl.direction_mispredicts, mpki(rtl.direction_mispredicts, rtl.insns), rtl.target_mispredicts,
+               mpki(rtl.target_mispredicts, rtl.insns));
+    fmt::print(stderr, "model: {} insns, {} branch ({:+.1f}%), {} target ({:+.1f}%) mispredicts\n", s.insns,
+               s.direction_mispredicts, error_percent(s.direction_mispredicts, rtl.direction_mispredicts),
+               s.target_mispredicts, error_percent(s.target_mispredicts, rtl.target_mispredicts));
+  }
+  return 0;
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "mem_trace.h"
+#include "replacement.h"
+
+/// Trace-driven model of rocket's L1 caches: the set associative tag arrays of ICache.scala, DCache.scala and
+/// NBDcache.scala with their replacement policy, a write-back write-allocate data cache, and the MSHRs bounding the
+/// misses in flight. It counts what the "I$ miss" and "D$ miss" perf events count, the acquires of the cache.
+struct cache_config {
+    enum replacement_policy : uint8_t {
+        RANDOM, LRU, PLRU
+    };
+
+    /// a data cache sees loads, stores and amos, an instruction cache the fetches
+    bool icache = false;
+    unsigned sets = 64;
+    unsigned ways = 4;
+    unsigned block_bytes = 64;
+    /// refill width: bytes per beat of the TileLink D channel
+    unsigned beat_bytes = 8;
+    /// misses in flight, 1 for the blocking ICache.scala and DCache.scala, nMSHRs for NBDcache.scala
+    unsigned mshrs = 1;
+    /// replacementPolicy of DCacheParams, ICache.scala is always random
+    replacement_policy replacement = RANDOM;
+    /// cycles from the acquire to the first beat of the grant
+    unsigned miss_latency = 20;
+    /// fetchBytes, the fetches of one packet are one icache access
+    unsigned fetch_bytes = 4;
+};
+
+struct cache_stats {
+    uint64_t accesses = 0;
+    uint64_t misses = 0;
+    uint64_t load_misses = 0;
+    uint64_t store_misses = 0;
+    /// dirty victims released
+    uint64_t writebacks = 0;
+    uint64_t refill_beats = 0;
+    /// misses which found every MSHR busy
+    uint64_t mshr_stalls = 0;
+    /// cycles those misses waited for a free MSHR; the trace cycles are those of the run which wrote it, so this is
+    /// a relative measure across configurations
+    uint64_t stall_cycles = 0;
+
+    [[nodiscard]] uint64_t traffic_bytes(const cache_config &c) const {
+      return (misses + writebacks) * c.block_bytes;
+    }
+};
+
+class cache_model {
+public:
+    explicit cache_model(const cache_config &config)
+        : c(config), tags(config.sets * config.ways), valid(tags.size()), dirty(tags.size()), random(config.ways) {
+      if (c.replacement == cache_config::LRU) lru.assign(c.sets, true_lru(c.ways));
+      if (c.replacement == cache_config::PLRU) plru.assign(c.sets, tree_plru(c.ways));
+    }
+
+    void access(const mem_trace_record &r) {
+      if (r.kind > mem_trace_record::AMO) return;
+      bool fetch = r.kind == mem_trace_record::FETCH;
+      if (fetch != c.icache) return;
+      if (fetch) {
+        uint64_t packet = r.addr / c.fetch_bytes;
+        if (packet == last_packet) return;
+        last_packet = packet;
+      }
+      s.accesses++;
+      bool write = r.kind == mem_trace_record::STORE || r.kind == mem_trace_record::AMO;
+      uint64_t block = r.addr / c.block_bytes;
+      unsigned set = block % c.sets;
+      uint64_t tag = block / c.sets;
+      size_t base = (size_t) set * c.ways;
+      for (unsigned w = 0; w < c.ways; w++) {
+        if (valid[base + w] && tags[base + w] == tag) {
+          touch(set, w);
+          if (write) dirty[base + w] = true;
+          return;
+        }
+      }
+      miss(r.cycle);
+      if (write) s.store_misses++;
+      else if (!fetch) s.load_misses++;
+      // rtl replaces the way the policy picks, invalid ways are not preferred
+      unsigned w = victim(set);
+      if (valid[base + w] && dirty[base + w]) s.writebacks++;
+      tags[base + w] = tag;
+      valid[base + w] = true;
+      dirty[base + w] = write;
+      touch(set, w);
+    }
+
+    [[nodiscard]] const cache_stats &stats() const { return s; }
+
+private:
+    void miss(uint64_t cycle) {
+      s.misses++;
+      unsigned beats = std::max(1u, c.block_bytes / c.beat_bytes);
+      s.refill_beats += beats;
+      random.miss();
+      // the waits so far delay the rest of the trace
+      cycle += s.stall_cycles;
+      // misses in flight, ordered by the cycle their refill completes
+      while (!in_flight.empty() && in_flight.front() <= cycle) in_flight.erase(in_flight.begin());
+      uint64_t issue = cycle;
+      if (in_flight.size() >= c.mshrs) {
+        s.mshr_stalls++;
+        issue = in_flight.front();
+        s.stall_cycles += issue - cycle;
+        in_flight.erase(in_flight.begin());
+      }
+      in_flight.insert(std::upper_bound(in_flight.begin(), in_flight.end(), issue + c.miss_latency + beats),
+                       issue + c.miss_latency + beats);
+    }
+
+    unsigned victim(unsigned set) const {
+      switch (c.replacement) {
+        case cache_config::LRU: return lru[set].way();
+        case cache_config::PLRU: return plru[set].way();
+        default: return random.way(c.ways);
+      }
+    }
+
+    void touch(unsigned set, unsigned way) {
+      if (c.replacement == cache_config::LRU) lru[set].access(way);
+      else if (c.replacement == cache_config::PLRU) plru[set].access(way);
+    }
+
+    const cache_config c;
+    cache_stats s;
+
+    std::vector<uint64_t> tags;
+    std::vector<bool> valid;
+    std::vector<bool> dirty;
+    lfsr_random random;
+    std::vector<true_lru> lru;
+    std::vector<tree_plru> plru;
+    std::vector<uint64_t> in_flight;
+    uint64_t last_packet = ~0ull;
+};
@@ -0,0 +1,309 @@
+// Sweeps L1 cache geometries over one memory access trace with the trace-driven model of cache_model.h.
+//
+// cache_sweep [-j THREADS] [--hpm=TRACE] [--hart=ID] [KEY=V1,V2,...]... TRACE
+//
+// TRACE is a memory trace of the cosim (COSIM_mem_trace) or a spike commit log (spike --log-commits). Every
+// KEY=V1,V2,... lists the values of one parameter and the product of all lists is swept; parameters which are not
+// given keep rocket's defaults:
+//
+//   side=d sets=64 ways=4 block=64 beat=8 mshrs=1 repl=random latency=20
+//
+// side is i or d, repl is random, lru or plru; the icache is only swept with random. The trace is decoded once, in
+// chunks, and every chunk is handed to all configurations in parallel on THREADS threads (all cores by default), so
+// the trace is never held in memory.
+// One CSV row per configuration is printed. With --hpm, the "I$ miss" and "D$ miss" counters of an HPM trace
+// (--hpm-trace) of the run the trace came from are compared with the first icache and dcache configuration, which
+// should be the ones the RTL was built with.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "cache_model.h"
+#include "hpm_trace.h"
+
+struct param {
+    const char *key;
+    unsigned (*get)(const cache_config &);
+    void (*set)(cache_config &, unsigned);
+    /// names of the values, nullptr for numbers
+    const char *const *names;
+};
+
+static const char *const side_names[] = {"d", "i", nullptr};
+static const char *const repl_names[] = {"random", "lru", "plru", nullptr};
+
+static const param params[] = {
+    {"side", [](const cache_config &c) { return (unsigned) c.icache; }, [](cache_config &c, unsigned v) { c.icache = v; },
+     side_names},
+    {"sets", [](const cache_config &c) { return c.sets; }, [](cache_config &c, unsigned v) { c.sets = v; }, nullptr},
+    {"ways", [](const cache_config &c) { return c.ways; }, [](cache_config &c, unsigned v) { c.ways = v; }, nullptr},
+    {"block", [](const cache_config &c) { return c.block_bytes; }, [](cache_config &c, unsigned v) { c.block_bytes = v; },
+     nullptr},
+    {"beat", [](const cache_config &c) { return c.beat_bytes; }, [](cache_config &c, unsigned v) { c.beat_bytes = v; },
+     nullptr},
+    {"mshrs", [](const cache_config &c) { return c.mshrs; }, [](cache_config &c, unsigned v) { c.mshrs = v; }, nullptr},
+    {"repl", [](const cache_config &c) { return (unsigned) c.replacement; },
+     [](cache_config &c, unsigned v) { c.replacement = (cache_config::replacement_policy) v; }, repl_names},
+    {"latency", [](const cache_config &c) { return c.miss_latency; },
+     [](cache_config &c, unsigned v) { c.miss_latency = v; }, nullptr},
+};
+
+static void usage(const char *program_name) {
+  fmt::print("Usage: {} [-j THREADS] [--hpm=TRACE] [--hart=ID] [KEY=V1,V2,...]... TRACE\n", program_name);
+  fmt::print("KEY is one of");
+  for (auto &p: params) fmt::print(" {}", p.key);
+  fmt::print("\n");
+}
+
+static bool is_pow2(unsigned v) { return v && !(v & (v - 1)); }
+
+static std::string check(const cache_config &c) {
+  if (!is_pow2(c.sets)) return "sets must be a power of 2";
+  if (c.ways == 0 || c.ways > 256) return "ways must be in 1..256";
+  if (!is_pow2(c.block_bytes) || c.block_bytes < 8) return "block must be a power of 2 of at least 8";
+  if (!is_pow2(c.beat_bytes) || c.beat_bytes > c.block_bytes) return "beat must be a power of 2 up to block";
+  if (c.mshrs == 0) return "mshrs must be at least 1";
+  return "";
+}
+
+static bool parse_values(const param &p, const char *list, std::vector<unsigned> &values) {
+  for (const char *s = list; *s;) {
+    const char *end = strchr(s, ',');
+    if (!end) end = s + strlen(s);
+    std::string token(s, end - s);
+    if (p.names) {
+      unsigned v = 0;
+      while (p.names[v] && token != p.names[v]) v++;
+      if (!p.names[v]) return false;
+      values.push_back(v);
+    } else {
+      char *parsed;
+      unsigned long v = strtoul(token.c_str(), &parsed, 0);
+      if (token.empty() || *parsed) return false;
+      values.push_back(v);
+    }
+    s = *end ? end + 1 : end;
+  }
+  return !values.empty();
+}
+
+/// reads a cosim memory trace, or the fetches and memory accesses of a spike commit log
+class trace_reader {
+public:
+    bool open(const char *path, long hart) {
+      file = fopen(path, "rb");
+      if (!file) return false;
+      this->hart = hart;
+      mem_trace_header header{};
+      binary = fread(&header, sizeof(header), 1, file) == 1 && header.file_magic == mem_trace_header::magic &&
+               header.file_version == mem_trace_header::version && header.record_size == sizeof(mem_trace_record);
+      if (!binary) rewind(file);
+      return true;
+    }
+
+    ~trace_reader() {
+      if (file) fclose(file);
+    }
+
+    /// decode up to max records, false at the end of the trace
+    bool read(std::vector<mem_trace_record> &chunk, size_t max) {
+      chunk.clear();
+      if (binary) {
+        chunk.resize(max);
+        chunk.resize(fread(chunk.data(), sizeof(mem_trace_record), max, file));
+        return !chunk.empty();
+      }
+      char line[4096];
+      while (chunk.size() + 4 < max && fgets(line, sizeof(line), file)) parse_commit(line, chunk);
+      return !chunk.empty();
+    }
+
+private:
+    /// core   0: 3 0x0000000080000010 (0x0000b283) x5  0x0000000000000000 mem 0x0000000080002000
+    /// core   0: 3 0x0000000080000014 (0x00513023) mem 0x0000000080002000 0x0000000000000000
+    void parse_commit(const char *line, std::vector<mem_trace_record> &chunk) {
+      unsigned core;
+      int n = 0;
+      if (sscanf(line, " core %u: %n", &core, &n) != 1 || (long) core != hart) return;
+      const char *p = line + n;
+      if (p[0] >= '0' && p[0] <= '3' && p[1] == ' ') p += 2;  // privilege level of --log-commits
+      char *end;
+      uint64_t pc = strtoull(p, &end, 16);
+      if (end == p || strncmp(end, " (0x", 4) != 0) return;
+      uint32_t inst = strtoul(end + 4, &end, 16);
+      chunk.push_back({cycle, pc, mem_trace_record::FETCH, (uint8_t) ((inst & 3) == 3 ? 4 : 2), 0, 0});
+      uint32_t opcode = inst & 0x7f;
+      bool amo = (inst & 3) == 3 && opcode == 0b0101111;
+      bool amo_recorded = false;
+      for (const char *m = strstr(end, " mem "); m; m = strstr(m + 1, " mem ")) {
+        uint64_t addr = strtoull(m + 5, &end, 16);
+        // a store logs the value after the address
+        bool store = end[0] == ' ' && end[1] == '0' && end[2] == 'x';
+        if (amo) {
+          if (!amo_recorded) chunk.push_back({cycle, addr, mem_trace_record::AMO, 0, 0, 0});
+          amo_recorded = true;
+        } else {
+          chunk.push_back({cycle, addr, store ? mem_trace_record::STORE : mem_trace_record::LOAD, 0, 0, 0});
+        }
+      }
+      // a commit log has no time, one insn per cycle keeps the mshr estimate meaningful relative to each other
+      cycle++;
+    }
+
+    FILE *file = nullptr;
+    bool binary = false;
+    long hart = 0;
+    uint64_t cycle = 0;
+};
+
+struct hpm_totals {
+    uint64_t icache_misses = 0;
+    uint64_t dcache_misses = 0;
+};
+
+static bool load_hpm(const char *path, long hart, hpm_totals &totals) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fmt::print(stderr, "Unable to open {}\n", path);
+    return false;
+  }
+  hpm_trace_header_t header{};
+  std::vector<hpm_event_desc_t> events;
+  if (fread(&header, sizeof(header), 1, f) == 1 && header.magic == hpm_trace_header_t::MAGIC &&
+      header.version == hpm_trace_header_t::VERSION && header.n_events <= hpm_trace_t::MAX_EVENTS) {
+    events.resize(header.n_events);
+    if (fread(events.data(), sizeof(hpm_event_desc_t), events.size(), f) != events.size()) events.clear();
+  }
+  if (events.empty()) {
+    fmt::print(stderr, "{} is not an HPM trace of this version\n", path);
+    fclose(f);
+    return false;
+  }
+  hpm_sample_t s{};
+  std::vector<uint32_t> counts(events.size());
+  while (fread(&s, sizeof(s), 1, f) == 1 && fread(counts.data(), sizeof(uint32_t), counts.size(), f) == counts.size()) {
+    if (s.hartid != hart) continue;
+    for (size_t i = 0; i < events.size(); i++) {
+      if (strcmp(events[i].name, "I$ miss") == 0) totals.icache_misses += counts[i];
+      else if (strcmp(events[i].name, "D$ miss") == 0) totals.dcache_misses += counts[i];
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static double error_percent(uint64_t model, uint64_t rtl) {
+  return rtl ? 100.0 * ((double) model - (double) rtl) / (double) rtl : 0;
+}
+
+int main(int argc, char **argv) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  long hart = 0;
+  const char *hpm_path = nullptr;
+  const char *path = nullptr;
+  std::vector<std::vector<unsigned>> grid(std::size(params));
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) threads = std::max(1, atoi(argv[++i]));
+    else if (strncmp(argv[i], "--hart=", 7) == 0) hart = atol(argv[i] + 7);
+    else if (strncmp(argv[i], "--hpm=", 6) == 0) hpm_path = argv[i] + 6;
+    else if (argv[i][0] == '-') {
+      usage(argv[0]);
+      return strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1;
+    } else if (const char *eq = strchr(argv[i], '=')) {
+      std::string key(argv[i], eq - argv[i]);
+      auto it = std::find_if(std::begin(params), std::end(params), [&](const param &p) { return key == p.key; });
+      if (it == std::end(params) || !parse_values(*it, eq + 1, grid[it - params])) {
+        usage(argv[0]);
+        return 1;
+      }
+    } else path = argv[i];
+  }
+  if (!path) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<cache_config> configs{cache_config()};
+  for (size_t p = 0; p < std::size(params); p++) {
+    if (grid[p].empty()) continue;
+    std::vector<cache_config> expanded;
+    for (auto &c: configs) {
+      for (unsigned v: grid[p]) {
+        expanded.push_back(c);
+        params[p].set(expanded.back(), v);
+      }
+    }
+    configs.swap(expanded);
+  }
+  // ICache.scala only has random replacement
+  configs.erase(std::remove_if(configs.begin(), configs.end(), [](const cache_config &c) {
+    return c.icache && c.replacement != cache_config::RANDOM;
+  }), configs.end());
+  for (auto &c: configs) {
+    std::string error = check(c);
+    if (!error.empty()) {
+      fmt::print(stderr, "invalid configuration: {}\n", error);
+      return 1;
+    }
+  }
+
+  trace_reader reader;
+  if (!reader.open(path, hart)) {
+    fmt::print(stderr, "Unable to open {}\n", path);
+    return 1;
+  }
+  hpm_totals rtl;
+  if (hpm_path && !load_hpm(hpm_path, hart, rtl)) return 1;
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<cache_model> models(configs.begin(), configs.end());
+  unsigned n_threads = std::min<size_t>(threads, models.size());
+  std::vector<mem_trace_record> chunk;
+  uint64_t records = 0;
+  while (reader.read(chunk, 1 << 20)) {
+    records += chunk.size();
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < n_threads; t++) {
+      pool.emplace_back([&, t] {
+        for (size_t m = t; m < models.size(); m += n_threads)
+          for (auto &r: chunk) models[m].access(r);
+      });
+    }
+    for (auto &t: pool) t.join();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (auto &p: params) fmt::print("{},", p.key);
+  fmt::print("kib,accesses,misses,miss_rate,load_misses,store_misses,writebacks,traffic_kib,mshr_stalls,stall_cycles\n");
+  for (size_t i = 0; i < configs.size(); i++) {
+    const cache_config &c = configs[i];
+    for (auto &p: params) {
+      unsigned v = p.get(c);
+      if (p.names) fmt::print("{},", p.names[v]);
+      else fmt::print("{},", v);
+    }
+    const cache_stats &s = models[i].stats();
+    fmt::print("{},{},{},{:.4f},{},{},{},{},{},{}\n", c.sets * c.ways * c.block_bytes / 1024, s.accesses, s.misses,
+               s.accesses ? (double) s.misses / (double) s.accesses : 0.0, s.load_misses, s.store_misses,
+               s.writebacks, s.traffic_bytes(c) / 1024, s.mshr_stalls, s.stall_cycles);
+  }
+  fmt::print(stderr, "{} configurations over {} accesses in {:.1f}s\n", configs.size(), records, seconds);
+
+  if (hpm_path) {
+    for (bool icache: {true, false}) {
+      auto it = std::find_if(configs.begin(), configs.end(), [&](const cache_config &c) { return c.icache == icache; });
+      if (it == configs.end()) continue;
+      uint64_t model = models[it - configs.begin()].stats().misses;
+      uint64_t measured = icache ? rtl.icache_misses : rtl.dcache_misses;
+      fmt::print(stderr, "{}$ misses: rtl {}, model {} ({:+.1f}%)\n", icache ? "I" : "D", measured, model,
+                 error_percent(model, measured));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,115 @@
+// Merges the isa coverage files written by cosim runs (COSIM_coverage) across regression shards.
+//
+// coverage_merge [-o MERGED] [--select] FILE...
+//
+// Prints a report of the merged coverage. With --select, also prints a greedy subset of the input runs which
+// covers every bin the whole set covers, in the order they add coverage, so the regression list can be trimmed
+// to the tests that actually contribute.
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "isa_coverage.h"
+
+static void usage(const char *program_name) {
+  fmt::print("Usage: {} [-o MERGED] [--select] FILE...\n", program_name);
+}
+
+static void print_section(const isa_coverage &cov, const char *name, uint32_t begin, uint32_t end) {
+  fmt::print("{:<8} {:>5} / {:<5} bins covered\n", name, cov.covered(begin, end), end - begin);
+}
+
+static void report(const isa_coverage &cov) {
+  fmt::print("{} insns\n\n", cov.insns());
+  print_section(cov, "op", isa_coverage::OP, isa_coverage::EXT);
+  print_section(cov, "rd", isa_coverage::RD, isa_coverage::RS1);
+  print_section(cov, "rs1", isa_coverage::RS1, isa_coverage::RS2);
+  print_section(cov, "rs2", isa_coverage::RS2, isa_coverage::IMM_POS);
+  print_section(cov, "imm", isa_coverage::IMM_POS, isa_coverage::CSR);
+  print_section(cov, "csr", isa_coverage::CSR, isa_coverage::nBins);
+
+  fmt::print("\nextensions:\n");
+  for (uint32_t e = 0; e < isa_coverage::nExt; e++) {
+    fmt::print("  {:<10} {}\n", isa_coverage::ext_name(e), cov.bins[isa_coverage::EXT + e]);
+  }
+
+  fmt::print("\nop ids:\n");
+  for (uint32_t i = 0; i < isa_coverage::nOpIds; i++) {
+    if (uint64_t n = cov.bins[isa_coverage::OP + i]) fmt::print("  {:<20} {}\n", isa_coverage::op_name(i), n);
+  }
+
+  fmt::print("\ncsrs:\n");
+  for (uint32_t i = 0; i < isa_coverage::nCsrs; i++) {
+    if (uint64_t n = cov.bins[isa_coverage::CSR + i]) fmt::print("  {:#05x}  {}\n", i, n);
+  }
+}
+
+// greedy set cover: repeatedly take the run adding the most still uncovered bins
+static void select(const std::vector<std::string> &names, const std::vector<std::unique_ptr<isa_coverage>> &runs) {
+  std::vector<bool> covered(isa_coverage::nBins, false);
+  std::vector<bool> taken(runs.size(), false);
+  fmt::print("\nselected runs:\n");
+  while (true) {
+    size_t best = runs.size();
+    uint32_t best_gain = 0;
+    for (size_t r = 0; r < runs.size(); r++) {
+      if (taken[r]) continue;
+      uint32_t gain = 0;
+      for (uint32_t i = 0; i < isa_coverage::nBins; i++) gain += !covered[i] && runs[r]->bins[i] != 0;
+      if (gain > best_gain) {
+        best = r;
+        best_gain = gain;
+      }
+    }
+    if (best == runs.size()) break;
+    taken[best] = true;
+    for (uint32_t i = 0; i < isa_coverage::nBins; i++) covered[i] = covered[i] || runs[best]->bins[i] != 0;
+    fmt::print("  {} (+{} bins)\n", names[best], best_gain);
+  }
+  size_t n_taken = std::count(taken.begin(), taken.end(), true);
+  fmt::print("{} of {} runs cover everything\n", n_taken, runs.size());
+}
+
+int main(int argc, char **argv) {
+  std::string output;
+  bool do_select = false;
+  std::vector<std::string> inputs;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) output = argv[++i];
+    else if (strcmp(argv[i], "--select") == 0) do_select = true;
+    else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+      usage(argv[0]);
+      return 0;
+    } else inputs.emplace_back(argv[i]);
+  }
+  if (inputs.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  auto merged = std::make_unique<isa_coverage>();
+  std::vector<std::unique_ptr<isa_coverage>> runs;
+  for (auto &path: inputs) {
+    auto cov = std::make_unique<isa_coverage>();
+    if (!cov->load(path)) {
+      fmt::print(stderr, "cannot read coverage file {}\n", path);
+      return 1;
+    }
+    merged->merge(*cov);
+    if (do_select) runs.push_back(std::move(cov));
+  }
+
+  report(*merged);
+  if (do_select) select(inputs, runs);
+
+  if (!output.empty() && !merged->save(output)) {
+    fmt::print(stderr, "cannot write merged coverage to {}\n", output);
+    return 1;
+  }
+  return 0;
+}
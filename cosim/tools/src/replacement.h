@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/// rocket-chip's PseudoLRU: a tree whose lower ways are the larger subtree when the number of ways is no power of 2
+class tree_plru {
+public:
+    explicit tree_plru(unsigned ways) : ways(ways), left_older(ways > 1 ? ways - 1 : 0, false) {}
+
+    void access(unsigned way) {
+      unsigned base = 0, n = ways, node = 0;
+      while (n > 1) {
+        unsigned lower = lower_ways(n);
+        if (way - base >= lower) {
+          left_older[node] = false;
+          node += lower;
+          base += lower;
+          n -= lower;
+        } else {
+          left_older[node] = true;
+          node += 1;
+          n = lower;
+        }
+      }
+    }
+
+    [[nodiscard]] unsigned way() const {
+      unsigned base = 0, n = ways, node = 0;
+      while (n > 1) {
+        unsigned lower = lower_ways(n);
+        if (left_older[node]) {
+          node += lower;
+          base += lower;
+          n -= lower;
+        } else {
+          node += 1;
+          n = lower;
+        }
+      }
+      return base;
+    }
+
+private:
+    /// a subtree of n ways has n - 1 nodes: its root, then the nodes of the lower ways, then those of the upper ways
+    static unsigned lower_ways(unsigned n) {
+      unsigned lower = 1;
+      while (lower * 2 < n) lower *= 2;
+      return lower;
+    }
+
+    unsigned ways;
+    std::vector<bool> left_older;
+};
+
+/// true LRU of one set, ways ordered from the most to the least recently used
+class true_lru {
+public:
+    explicit true_lru(unsigned ways) : order(ways) {
+      for (unsigned i = 0; i < ways; i++) order[i] = i;
+    }
+
+    void access(unsigned way) {
+      unsigned i = 0;
+      while (order[i] != way) i++;
+      for (; i > 0; i--) order[i] = order[i - 1];
+      order[0] = way;
+    }
+
+    [[nodiscard]] unsigned way() const { return order.back(); }
+
+private:
+    std::vector<uint8_t> order;
+};
+
+/// RandomReplacement of rocket-chip: a 16 bit LFSR advanced on every miss. The policy is the same as rtl's, the
+/// sequence is not, rtl starts from a random state.
+class lfsr_random {
+public:
+    explicit lfsr_random(unsigned ways) : mask(ways > 1 ? ways - 1 : 0) {
+      while (mask & (mask + 1)) mask |= mask >> 1;
+    }
+
+    void miss() {
+      uint16_t bit = (state ^ state >> 2 ^ state >> 3 ^ state >> 5) & 1;  // x^16 + x^14 + x^13 + x^11 + 1
+      state = state >> 1 | bit << 15;
+    }
+
+    /// for a way count which is no power of 2 rtl partitions the LFSR range, the model takes the modulo
+    [[nodiscard]] unsigned way(unsigned ways) const { return (state & mask) % ways; }
+
+private:
+    uint16_t state = 1;
+    unsigned mask;
+};
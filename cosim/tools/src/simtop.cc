@@ -0,0 +1,143 @@
+// Watches the live counters published by emulator (--metrics) and cosim (COSIM_metrics) runs.
+//
+// simtop [-i SECONDS] [-n COUNT] PATH...
+//
+// Every PATH is a metrics file, or a directory whose metrics files are all shown (e.g. /dev/shm).
+// Rates are computed from two consecutive samples; a running job whose cycle count did not move is flagged STALLED.
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "sim_metrics.h"
+
+struct sample {
+    uint64_t t_ns;
+    uint64_t cycle;
+    uint64_t insns;
+};
+
+static void usage(const char *program_name) {
+  fmt::print("Usage: {} [-i SECONDS] [-n COUNT] PATH...\n", program_name);
+}
+
+static const sim_metrics_page_t *map_page(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) return nullptr;
+  struct stat st{};
+  if (fstat(fd, &st) != 0 || st.st_size != sizeof(sim_metrics_page_t)) {
+    close(fd);
+    return nullptr;
+  }
+  void *p = mmap(nullptr, sizeof(sim_metrics_page_t), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) return nullptr;
+  auto *page = static_cast<const sim_metrics_page_t *>(p);
+  if (page->magic != sim_metrics_page_t::MAGIC || page->version != sim_metrics_page_t::VERSION) {
+    munmap(p, sizeof(sim_metrics_page_t));
+    return nullptr;
+  }
+  return page;
+}
+
+static std::vector<std::string> expand(const std::vector<std::string> &paths) {
+  std::vector<std::string> files;
+  for (auto &path: paths) {
+    DIR *dir = opendir(path.c_str());
+    if (!dir) {
+      files.push_back(path);
+      continue;
+    }
+    while (struct dirent *e = readdir(dir)) {
+      if (e->d_name[0] != '.') files.push_back(path + "/" + e->d_name);
+    }
+    closedir(dir);
+  }
+  return files;
+}
+
+static double rss_mb(int pid) {
+  FILE *f = fopen(fmt::format("/proc/{}/statm", pid).c_str(), "r");
+  if (!f) return 0;
+  unsigned long size = 0, resident = 0;
+  int n = fscanf(f, "%lu %lu", &size, &resident);
+  fclose(f);
+  return n == 2 ? (double) resident * sysconf(_SC_PAGESIZE) / (1 << 20) : 0;
+}
+
+static const char *state_of(const sim_metrics_page_t *page, bool moved) {
+  // a finished run leaves its page behind with the final status
+  switch (page->status.load(std::memory_order_relaxed)) {
+    case sim_metrics_page_t::PASSED: return "PASSED";
+    case sim_metrics_page_t::FAILED: return "FAILED";
+    default:
+      if (kill(page->pid, 0) != 0 && errno == ESRCH) return "DEAD";
+      return moved ? "RUNNING" : "STALLED";
+  }
+}
+
+int main(int argc, char **argv) {
+  double interval = 1.0;
+  long count = 0;
+  std::vector<std::string> paths;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-i") == 0 && i + 1 < argc) interval = atof(argv[++i]);
+    else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) count = atol(argv[++i]);
+    else if (strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0) {
+      usage(argv[0]);
+      return 0;
+    } else paths.emplace_back(argv[i]);
+  }
+  if (paths.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::map<std::string, const sim_metrics_page_t *> pages;
+  std::map<std::string, sample> last;
+  for (long iter = 0; count == 0 || iter < count; iter++) {
+    for (auto &file: expand(paths)) {
+      if (!pages.count(file))
+        if (auto *page = map_page(file)) pages[file] = page;
+    }
+
+    fmt::print("{:<8} {:<8} {:>14} {:>14} {:>6} {:>10} {:>5} {:>4} {:>8} {:>9}  {}\n", "pid", "kind", "cycle", "insns",
+               "ipc", "khz", "queue", "tl", "rss_mb", "elapsed_s", "state");
+    for (auto &[file, page]: pages) {
+      sample now{sim_metrics_t::now_ns(), page->cycle.load(std::memory_order_relaxed),
+                 page->insns.load(std::memory_order_relaxed)};
+      double khz = 0, ipc = 0;
+      bool moved = true;
+      if (auto it = last.find(file); it != last.end()) {
+        double dt = (double) (now.t_ns - it->second.t_ns) * 1e-9;
+        uint64_t dcycle = now.cycle - it->second.cycle;
+        moved = dcycle != 0;
+        khz = dt > 0 ? (double) dcycle / dt / 1e3 : 0;
+        ipc = dcycle ? (double) (now.insns - it->second.insns) / (double) dcycle : 0;
+      }
+      last[file] = now;
+      fmt::print("{:<8} {:<8} {:>14} {:>14} {:>6.3f} {:>10.1f} {:>5} {:>4} {:>8.1f} {:>9.1f}  {}\n", page->pid,
+                 page->kind, now.cycle, now.insns, ipc, khz, page->queue_depth.load(std::memory_order_relaxed),
+                 page->tl_outstanding.load(std::memory_order_relaxed), rss_mb(page->pid),
+                 (double) (now.t_ns - page->start_ns) * 1e-9, state_of(page, moved));
+    }
+    fmt::print("\n");
+    fflush(stdout);
+    if (count == 0 || iter + 1 < count)
+      std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+  }
+  return 0;
+}
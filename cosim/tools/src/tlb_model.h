@@ -0,0 +1,343 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+#include "mem_trace.h"
+#include "replacement.h"
+
+/// Physical memory of a cosim run as saved to COSIM_mem_image, pages which are not in the image read as zero
+class mem_image {
+public:
+    bool load(const char *path) {
+      FILE *f = fopen(path, "rb");
+      if (!f) return false;
+      mem_image_header header{};
+      bool ok = fread(&header, sizeof(header), 1, f) == 1 && header.file_magic == mem_image_header::magic &&
+                header.file_version == mem_image_header::version && header.page_bytes >= 8 &&
+                !(header.page_bytes & (header.page_bytes - 1));
+      if (ok) {
+        page_bytes = header.page_bytes;
+        uint64_t addr;
+        while (fread(&addr, sizeof(addr), 1, f) == 1) {
+          size_t offset = data.size();
+          data.resize(offset + page_bytes);
+          if (fread(&data[offset], page_bytes, 1, f) != 1) {
+            ok = false;
+            break;
+          }
+          pages[addr / page_bytes] = offset;
+        }
+      }
+      fclose(f);
+      return ok;
+    }
+
+    [[nodiscard]] uint64_t read64(uint64_t addr) const {
+      auto it = pages.find(addr / page_bytes);
+      if (it == pages.end()) return 0;
+      uint64_t v;
+      memcpy(&v, &data[it->second + (addr & (page_bytes - 8))], sizeof(v));
+      return v;
+    }
+
+    [[nodiscard]] size_t n_pages() const { return pages.size(); }
+
+private:
+    uint64_t page_bytes = 4096;
+    std::unordered_map<uint64_t, size_t> pages;
+    std::vector<uint8_t> data;
+};
+
+/// nTLBSets, nTLBWays, nTLBBasePageSectors and nTLBSuperpages of ICacheParams and DCacheParams
+struct l1_tlb_config {
+    unsigned sets = 1;
+    unsigned ways = 32;
+    /// 4KiB pages per sectored entry, an entry holds ways / sectors tags
+    unsigned sectors = 4;
+    /// fully associative entries holding 1GiB and 2MiB pages only
+    unsigned superpages = 4;
+};
+
+struct tlb_config {
+    l1_tlb_config itlb;
+    l1_tlb_config dtlb;
+    /// nL2TLBEntries and nL2TLBWays of RocketCoreParams, no L2 TLB with 0 entries
+    unsigned l2_entries = 0;
+    unsigned l2_ways = 1;
+    /// nPTECacheEntries of RocketCoreParams, the non-leaf PTEs the PTW keeps
+    unsigned pte_cache_entries = 8;
+};
+
+struct tlb_stats {
+    uint64_t itlb_accesses = 0;
+    uint64_t itlb_misses = 0;
+    uint64_t dtlb_accesses = 0;
+    uint64_t dtlb_misses = 0;
+    /// L1 misses the L2 TLB answered, the others are walked: the "L2 TLB miss" event counts the walks
+    uint64_t l2_hits = 0;
+    uint64_t walks = 0;
+    /// levels of a walk the PTE cache skipped
+    uint64_t pte_cache_hits = 0;
+    /// PTEs the PTW loaded through the dcache
+    uint64_t pte_reads = 0;
+    /// walks which found no valid leaf, nothing is refilled for them
+    uint64_t faults = 0;
+    uint64_t superpage_refills = 0;
+
+    [[nodiscard]] uint64_t traffic_bytes() const { return pte_reads * 8; }
+};
+
+/// One L1 TLB of TLB.scala: sectored entries for 4KiB pages, nSets sets of ways / sectors entries with a
+/// PseudoLRU per set, and the fully associative superpage entries with their own PseudoLRU. Permissions are not
+/// modelled, a hit is a hit.
+class l1_tlb {
+public:
+    explicit l1_tlb(const l1_tlb_config &config)
+        : c(config), entries_per_set(std::max(1u, config.ways / config.sectors)),
+          sectored(config.sets * entries_per_set), sectored_plru(config.sets, tree_plru(entries_per_set)),
+          superpage(config.superpages), superpage_plru(config.superpages) {}
+
+    bool lookup(uint64_t vpn) {
+      for (unsigned i = 0; i < superpage.size(); i++) {
+        if (superpage[i].valid && superpage[i].matches(vpn)) {
+          superpage_plru.access(i);
+          return true;
+        }
+      }
+      unsigned set = (vpn / c.sectors) % c.sets;
+      for (unsigned i = 0; i < entries_per_set; i++) {
+        auto &e = sectored[set * entries_per_set + i];
+        if (e.valid && e.tag == vpn / c.sectors) {
+          // a sector hit updates the replacement state even when the page itself misses
+          sectored_plru[set].access(i);
+          return e.valid >> (vpn % c.sectors) & 1;
+        }
+      }
+      return false;
+    }
+
+    /// the PTW answered with a leaf at level 0 (1GiB) to 2 (4KiB)
+    void refill(uint64_t vpn, unsigned level) {
+      if (level < 2 && !superpage.empty()) {
+        unsigned i = 0;
+        while (i < superpage.size() && superpage[i].valid) i++;
+        if (i == superpage.size()) i = superpage_plru.way();
+        superpage[i] = {true, level, vpn};
+        superpage_plru.access(i);
+        return;
+      }
+      // without superpage entries the 4KiB page of the superpage which missed is installed
+      unsigned set = (vpn / c.sectors) % c.sets;
+      unsigned way = entries_per_set;
+      for (unsigned i = 0; i < entries_per_set && way == entries_per_set; i++) {
+        auto &e = sectored[set * entries_per_set + i];
+        if (e.valid && e.tag == vpn / c.sectors) way = i;
+      }
+      if (way == entries_per_set) {
+        way = 0;
+        while (way < entries_per_set && sectored[set * entries_per_set + way].valid) way++;
+        if (way == entries_per_set) way = sectored_plru[set].way();
+        sectored[set * entries_per_set + way] = {0, vpn / c.sectors};
+      }
+      sectored[set * entries_per_set + way].valid |= 1u << (vpn % c.sectors);
+      sectored_plru[set].access(way);
+    }
+
+    void flush() {
+      for (auto &e: sectored) e.valid = 0;
+      for (auto &e: superpage) e.valid = false;
+    }
+
+    /// sfence.vma with an address invalidates the entries of that page only
+    void flush(uint64_t vpn) {
+      for (auto &e: sectored) {
+        if (e.tag == vpn / c.sectors) e.valid &= ~(1u << (vpn % c.sectors));
+      }
+      for (auto &e: superpage) {
+        if (e.matches(vpn)) e.valid = false;
+      }
+    }
+
+private:
+    struct sectored_entry {
+        /// one bit per sector
+        uint32_t valid;
+        uint64_t tag;
+    };
+
+    struct superpage_entry {
+        bool valid;
+        unsigned level;
+        uint64_t vpn;
+
+        [[nodiscard]] bool matches(uint64_t v) const {
+          unsigned shift = 9 * (2 - level);
+          return (v >> shift) == (vpn >> shift);
+        }
+    };
+
+    const l1_tlb_config c;
+    const unsigned entries_per_set;
+    std::vector<sectored_entry> sectored;
+    std::vector<tree_plru> sectored_plru;
+    std::vector<superpage_entry> superpage;
+    tree_plru superpage_plru;
+};
+
+/// Trace-driven model of rocket's address translation for Sv39: the ITLB and DTLB of TLB.scala in front of the
+/// shared PTW of PTW.scala with its L2 TLB and PTE cache. The walks read the page tables from a memory image of the
+/// run, so the image has to hold the tables the trace translated with; tables which change during the run are only
+/// seen in their final state.
+class tlb_model {
+public:
+    tlb_model(const tlb_config &config, const mem_image &memory)
+        : c(config), memory(memory), itlb(config.itlb), dtlb(config.dtlb),
+          l2_sets(config.l2_entries ? config.l2_entries / config.l2_ways : 0), l2(config.l2_entries),
+          l2_plru(l2_sets, tree_plru(config.l2_ways)), pte_cache(config.pte_cache_entries),
+          pte_cache_plru(config.pte_cache_entries) {}
+
+    void access(const mem_trace_record &r) {
+      switch (r.kind) {
+        case mem_trace_record::SATP:
+          root = r.addr & ((1ull << 44) - 1);
+          translating = r.addr != 0;
+          return;
+        case mem_trace_record::SFENCE:
+          if (r.size) {
+            itlb.flush(r.addr >> 12);
+            dtlb.flush(r.addr >> 12);
+          } else {
+            itlb.flush();
+            dtlb.flush();
+          }
+          // the PTW drops its L2 TLB and PTE cache on every sfence
+          for (auto &e: l2) e.valid = false;
+          for (auto &e: pte_cache) e.valid = false;
+          return;
+        case mem_trace_record::FETCH:
+          if (!translating) return;
+          s.itlb_accesses++;
+          if (!itlb.lookup(vpn(r.addr))) {
+            s.itlb_misses++;
+            miss(itlb, vpn(r.addr));
+          }
+          return;
+        default:
+          if (!translating) return;
+          s.dtlb_accesses++;
+          if (!dtlb.lookup(vpn(r.addr))) {
+            s.dtlb_misses++;
+            miss(dtlb, vpn(r.addr));
+          }
+      }
+    }
+
+    [[nodiscard]] const tlb_stats &stats() const { return s; }
+
+private:
+    static uint64_t vpn(uint64_t addr) { return (addr >> 12) & ((1ull << 27) - 1); }
+
+    void miss(l1_tlb &tlb, uint64_t vpn) {
+      int level = l2_lookup(vpn) ? 2 : walk(vpn);
+      if (level < 0) return;
+      if (level < 2) s.superpage_refills++;
+      tlb.refill(vpn, level);
+    }
+
+    bool l2_lookup(uint64_t vpn) {
+      if (!l2_sets) return false;
+      unsigned set = vpn % l2_sets;
+      for (unsigned w = 0; w < c.l2_ways; w++) {
+        auto &e = l2[set * c.l2_ways + w];
+        if (e.valid && e.tag == vpn / l2_sets) {
+          l2_plru[set].access(w);
+          s.l2_hits++;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    /// the level of the leaf, -1 for a page fault
+    int walk(uint64_t vpn) {
+      s.walks++;
+      uint64_t ppn = root;
+      for (unsigned level = 0; level < 3; level++) {
+        uint64_t addr = (ppn << 12) + ((vpn >> (9 * (2 - level))) & 0x1ff) * 8;
+        if (level < 2 && pte_cache_lookup(addr, ppn)) {
+          s.pte_cache_hits++;
+          continue;
+        }
+        uint64_t pte = memory.read64(addr);
+        s.pte_reads++;
+        bool v = pte & 1, r = pte & 2, w = pte & 4, x = pte & 8;
+        uint64_t next = (pte >> 10) & ((1ull << 44) - 1);
+        if (!v || (!r && w)) break;
+        if (r || x) {
+          if (level == 2) l2_refill(vpn);
+          return (int) level;
+        }
+        if (level < 2) pte_cache_refill(addr, next);
+        ppn = next;
+      }
+      s.faults++;
+      return -1;
+    }
+
+    bool pte_cache_lookup(uint64_t addr, uint64_t &ppn) {
+      for (unsigned i = 0; i < pte_cache.size(); i++) {
+        if (pte_cache[i].valid && pte_cache[i].tag == addr) {
+          pte_cache_plru.access(i);
+          ppn = pte_cache[i].data;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    void pte_cache_refill(uint64_t addr, uint64_t ppn) {
+      if (pte_cache.empty()) return;
+      unsigned i = 0;
+      while (i < pte_cache.size() && pte_cache[i].valid) i++;
+      if (i == pte_cache.size()) i = pte_cache_plru.way();
+      pte_cache[i] = {true, addr, ppn};
+      pte_cache_plru.access(i);
+    }
+
+    /// only 4KiB leaves go to the L2 TLB
+    void l2_refill(uint64_t vpn) {
+      if (!l2_sets) return;
+      unsigned set = vpn % l2_sets;
+      unsigned w = 0;
+      while (w < c.l2_ways && l2[set * c.l2_ways + w].valid) w++;
+      if (w == c.l2_ways) w = l2_plru[set].way();
+      l2[set * c.l2_ways + w] = {true, vpn / l2_sets, 0};
+      l2_plru[set].access(w);
+    }
+
+    struct tagged_entry {
+        bool valid;
+        uint64_t tag;
+        uint64_t data;
+    };
+
+    const tlb_config c;
+    const mem_image &memory;
+    tlb_stats s;
+
+    l1_tlb itlb;
+    l1_tlb dtlb;
+    unsigned l2_sets;
+    std::vector<tagged_entry> l2;
+    std::vector<tree_plru> l2_plru;
+    std::vector<tagged_entry> pte_cache;
+    tree_plru pte_cache_plru;
+
+    uint64_t root = 0;
+    bool translating = false;
+};
@@ -0,0 +1,263 @@
+// Sweeps TLB and page table walker configurations over one memory trace with the Sv39 model of tlb_model.h.
+//
+// tlb_sweep [-j THREADS] [--hpm=TRACE] [--hart=ID] --image=IMAGE [KEY=V1,V2,...]... TRACE
+//
+// TRACE is a memory trace of the cosim (COSIM_mem_trace) and IMAGE the memory image of the same run
+// (COSIM_mem_image), the walks read the page tables from it. Every KEY=V1,V2,... lists the values of one parameter
+// and the product of all lists is swept; parameters which are not given keep rocket's defaults:
+//
+//   isets=1 iways=32 isectors=4 isuper=4 dsets=1 dways=32 dsectors=4 dsuper=4 l2=0 l2ways=1 ptec=8
+//
+// i* and d* are the ITLB and DTLB, l2 and l2ways the L2 TLB of the PTW and ptec its PTE cache entries. The trace is
+// decoded once, in chunks, and every chunk is handed to all configurations in parallel on THREADS threads (all
+// cores by default).
+// One CSV row per configuration is printed. With --hpm, the "ITLB miss", "DTLB miss" and "L2 TLB miss" counters of
+// an HPM trace (--hpm-trace) of the run the trace came from are compared with the first configuration, which should
+// be the one the RTL was built with.
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "hpm_trace.h"
+#include "tlb_model.h"
+
+struct param {
+    const char *key;
+    unsigned tlb_config::*field;
+    unsigned l1_tlb_config::*l1_field;
+    l1_tlb_config tlb_config::*l1;
+
+    [[nodiscard]] unsigned get(const tlb_config &c) const { return field ? c.*field : c.*l1.*l1_field; }
+
+    void set(tlb_config &c, unsigned v) const {
+      if (field) c.*field = v;
+      else c.*l1.*l1_field = v;
+    }
+};
+
+static const param params[] = {
+    {"isets", nullptr, &l1_tlb_config::sets, &tlb_config::itlb},
+    {"iways", nullptr, &l1_tlb_config::ways, &tlb_config::itlb},
+    {"isectors", nullptr, &l1_tlb_config::sectors, &tlb_config::itlb},
+    {"isuper", nullptr, &l1_tlb_config::superpages, &tlb_config::itlb},
+    {"dsets", nullptr, &l1_tlb_config::sets, &tlb_config::dtlb},
+    {"dways", nullptr, &l1_tlb_config::ways, &tlb_config::dtlb},
+    {"dsectors", nullptr, &l1_tlb_config::sectors, &tlb_config::dtlb},
+    {"dsuper", nullptr, &l1_tlb_config::superpages, &tlb_config::dtlb},
+    {"l2", &tlb_config::l2_entries, nullptr, nullptr},
+    {"l2ways", &tlb_config::l2_ways, nullptr, nullptr},
+    {"ptec", &tlb_config::pte_cache_entries, nullptr, nullptr},
+};
+
+static void usage(const char *program_name) {
+  fmt::print("Usage: {} [-j THREADS] [--hpm=TRACE] [--hart=ID] --image=IMAGE [KEY=V1,V2,...]... TRACE\n",
+             program_name);
+  fmt::print("KEY is one of");
+  for (auto &p: params) fmt::print(" {}", p.key);
+  fmt::print("\n");
+}
+
+static bool is_pow2(unsigned v) { return v && !(v & (v - 1)); }
+
+static std::string check(const l1_tlb_config &c) {
+  if (!is_pow2(c.sets)) return "tlb sets must be a power of 2";
+  if (!is_pow2(c.sectors) || c.sectors > 32) return "tlb sectors must be a power of 2 up to 32";
+  if (c.ways < c.sectors || c.ways % c.sectors) return "tlb ways must be a multiple of the sectors";
+  return "";
+}
+
+static std::string check(const tlb_config &c) {
+  for (auto *l1: {&c.itlb, &c.dtlb}) {
+    std::string error = check(*l1);
+    if (!error.empty()) return error;
+  }
+  if (c.l2_entries && (c.l2_ways == 0 || c.l2_entries % c.l2_ways || !is_pow2(c.l2_entries / c.l2_ways)))
+    return "l2 entries / l2ways must be a power of 2";
+  return "";
+}
+
+static bool parse_values(const char *list, std::vector<unsigned> &values) {
+  for (const char *s = list; *s;) {
+    const char *end = strchr(s, ',');
+    if (!end) end = s + strlen(s);
+    std::string token(s, end - s);
+    char *parsed;
+    unsigned long v = strtoul(token.c_str(), &parsed, 0);
+    if (token.empty() || *parsed) return false;
+    values.push_back(v);
+    s = *end ? end + 1 : end;
+  }
+  return !values.empty();
+}
+
+struct hpm_totals {
+    uint64_t itlb_misses = 0;
+    uint64_t dtlb_misses = 0;
+    uint64_t l2_misses = 0;
+};
+
+static bool load_hpm(const char *path, long hart, hpm_totals &totals) {
+  FILE *f = fopen(path, "rb");
+  if (!f) {
+    fmt::print(stderr, "Unable to open {}\n", path);
+    return false;
+  }
+  hpm_trace_header_t header{};
+  std::vector<hpm_event_desc_t> events;
+  if (fread(&header, sizeof(header), 1, f) == 1 && header.magic == hpm_trace_header_t::MAGIC &&
+      header.version == hpm_trace_header_t::VERSION && header.n_events <= hpm_trace_t::MAX_EVENTS) {
+    events.resize(header.n_events);
+    if (fread(events.data(), sizeof(hpm_event_desc_t), events.size(), f) != events.size()) events.clear();
+  }
+  if (events.empty()) {
+    fmt::print(stderr, "{} is not an HPM trace of this version\n", path);
+    fclose(f);
+    return false;
+  }
+  hpm_sample_t s{};
+  std::vector<uint32_t> counts(events.size());
+  while (fread(&s, sizeof(s), 1, f) == 1 && fread(counts.data(), sizeof(uint32_t), counts.size(), f) == counts.size()) {
+    if (s.hartid != hart) continue;
+    for (size_t i = 0; i < events.size(); i++) {
+      if (strcmp(events[i].name, "ITLB miss") == 0) totals.itlb_misses += counts[i];
+      else if (strcmp(events[i].name, "DTLB miss") == 0) totals.dtlb_misses += counts[i];
+      else if (strcmp(events[i].name, "L2 TLB miss") == 0) totals.l2_misses += counts[i];
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static double error_percent(uint64_t model, uint64_t rtl) {
+  return rtl ? 100.0 * ((double) model - (double) rtl) / (double) rtl : 0;
+}
+
+static double rate(uint64_t n, uint64_t of) { return of ? (double) n / (double) of : 0; }
+
+int main(int argc, char **argv) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  long hart = 0;
+  const char *hpm_path = nullptr;
+  const char *image_path = nullptr;
+  const char *path = nullptr;
+  std::vector<std::vector<unsigned>> grid(std::size(params));
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) threads = std::max(1, atoi(argv[++i]));
+    else if (strncmp(argv[i], "--hart=", 7) == 0) hart = atol(argv[i] + 7);
+    else if (strncmp(argv[i], "--hpm=", 6) == 0) hpm_path = argv[i] + 6;
+    else if (strncmp(argv[i], "--image=", 8) == 0) image_path = argv[i] + 8;
+    else if (argv[i][0] == '-') {
+      usage(argv[0]);
+      return strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1;
+    } else if (const char *eq = strchr(argv[i], '=')) {
+      std::string key(argv[i], eq - argv[i]);
+      auto it = std::find_if(std::begin(params), std::end(params), [&](const param &p) { return key == p.key; });
+      if (it == std::end(params) || !parse_values(eq + 1, grid[it - params])) {
+        usage(argv[0]);
+        return 1;
+      }
+    } else path = argv[i];
+  }
+  if (!path || !image_path) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<tlb_config> configs{tlb_config()};
+  for (size_t p = 0; p < std::size(params); p++) {
+    if (grid[p].empty()) continue;
+    std::vector<tlb_config> expanded;
+    for (auto &c: configs) {
+      for (unsigned v: grid[p]) {
+        expanded.push_back(c);
+        params[p].set(expanded.back(), v);
+      }
+    }
+    configs.swap(expanded);
+  }
+  for (auto &c: configs) {
+    std::string error = check(c);
+    if (!error.empty()) {
+      fmt::print(stderr, "invalid configuration: {}\n", error);
+      return 1;
+    }
+  }
+
+  mem_image memory;
+  if (!memory.load(image_path)) {
+    fmt::print(stderr, "{} is not a memory image of this version\n", image_path);
+    return 1;
+  }
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    fmt::print(stderr, "Unable to open {}\n", path);
+    return 1;
+  }
+  mem_trace_header header{};
+  if (fread(&header, sizeof(header), 1, file) != 1 || header.file_magic != mem_trace_header::magic ||
+      header.file_version != mem_trace_header::version || header.record_size != sizeof(mem_trace_record)) {
+    fmt::print(stderr, "{} is not a memory trace of this version\n", path);
+    fclose(file);
+    return 1;
+  }
+  hpm_totals rtl;
+  if (hpm_path && !load_hpm(hpm_path, hart, rtl)) {
+    fclose(file);
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<tlb_model> models;
+  models.reserve(configs.size());
+  for (auto &c: configs) models.emplace_back(c, memory);
+  unsigned n_threads = std::min<size_t>(threads, models.size());
+  std::vector<mem_trace_record> chunk(1 << 20);
+  uint64_t records = 0;
+  while (true) {
+    chunk.resize(1 << 20);
+    chunk.resize(fread(chunk.data(), sizeof(mem_trace_record), chunk.size(), file));
+    if (chunk.empty()) break;
+    records += chunk.size();
+    std::vector<std::thread> pool;
+    for (unsigned t = 0; t < n_threads; t++) {
+      pool.emplace_back([&, t] {
+        for (size_t m = t; m < models.size(); m += n_threads)
+          for (auto &r: chunk) models[m].access(r);
+      });
+    }
+    for (auto &t: pool) t.join();
+  }
+  fclose(file);
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  for (auto &p: params) fmt::print("{},", p.key);
+  fmt::print("itlb_accesses,itlb_misses,itlb_miss_rate,dtlb_accesses,dtlb_misses,dtlb_miss_rate,l2_hits,walks,"
+             "pte_cache_hits,pte_reads,traffic_kib,faults,superpage_refills\n");
+  for (size_t i = 0; i < configs.size(); i++) {
+    for (auto &p: params) fmt::print("{},", p.get(configs[i]));
+    const tlb_stats &s = models[i].stats();
+    fmt::print("{},{},{:.5f},{},{},{:.5f},{},{},{},{},{},{},{}\n", s.itlb_accesses, s.itlb_misses,
+               rate(s.itlb_misses, s.itlb_accesses), s.dtlb_accesses, s.dtlb_misses,
+               rate(s.dtlb_misses, s.dtlb_accesses), s.l2_hits, s.walks, s.pte_cache_hits, s.pte_reads,
+               s.traffic_bytes() / 1024, s.faults, s.superpage_refills);
+  }
+  fmt::print(stderr, "{} configurations over {} records and {} image pages in {:.1f}s\n", configs.size(), records,
+             memory.n_pages(), seconds);
+
+  if (hpm_path) {
+    const tlb_stats &s = models.front().stats();
+    fmt::print(stderr, "ITLB misses: rtl {}, model {} ({:+.1f}%)\n", rtl.itlb_misses, s.itlb_misses,
+               error_percent(s.itlb_misses, rtl.itlb_misses));
+    fmt::print(stderr, "DTLB misses: rtl {}, model {} ({:+.1f}%)\n", rtl.dtlb_misses, s.dtlb_misses,
+               error_percent(s.dtlb_misses, rtl.dtlb_misses));
+    fmt::print(stderr, "L2 TLB misses: rtl {}, model {} ({:+.1f}%)\n", rtl.l2_misses, s.walks,
+               error_percent(s.walks, rtl.l2_misses));
+  }
+  return 0;
+}
@@ -0,0 +1,36 @@
+package cosim.units
+
+import chisel3.RawModule
+import chisel3.stage.ChiselGeneratorAnnotation
+import firrtl.AnnotationSeq
+import firrtl.stage.FirrtlCircuitAnnotation
+import mainargs._
+import org.chipsalliance.rocket.MulDivParams
+
+object Main {
+  /** Elaborates every unit harness into `dir/<top>/<top>.fir`, the tops which cosim/units/harness verilates. */
+  @main def elaborate(@arg(name = "dir") dir: String, @arg("xlen") xlen: Int, @arg("lanes") lanes: Int) = {
+    // the MulDiv of CosimConfig
+    val mulDiv = MulDivParams(mulUnroll = xlen, mulEarlyOut = true, divEarlyOut = true)
+    Seq(
+      () => new ALUHarness(xlen, lanes),
+      () => new ABLUHarness(xlen, lanes),
+      () => new BitManipCryptoHarness(xlen, lanes),
+      () => new MulDivHarness(xlen, lanes, mulDiv)
+    ).foreach(emit(os.Path(dir), _))
+  }
+
+  def emit(dir: os.Path, gen: () => RawModule): Unit = {
+    Seq(
+      new chisel3.stage.phases.Elaborate,
+      new chisel3.tests.elaborate.Convert
+    ).foldLeft(Seq(ChiselGeneratorAnnotation(gen)): AnnotationSeq) { case (annos, stage) => stage.transform(annos) }
+      .foreach {
+        case FirrtlCircuitAnnotation(circuit) =>
+          os.write(dir / circuit.main / s"${circuit.main}.fir", circuit.serialize, createFolders = true)
+        case _ =>
+      }
+  }
+
+  def main(args: Array[String]): Unit = ParserForMethods(this).runOrExit(args)
+}
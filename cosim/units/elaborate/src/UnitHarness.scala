@@ -0,0 +1,136 @@
+package cosim.units
+
+import chisel3._
+import chisel3.util.Cat
+import org.chipsalliance.rocket._
+import org.chipsalliance.rocket.ScalarOpConstants._
+
+/** Operands and results of `lanes` copies of a unit, lane i in bits [i*w, (i+1)*w) of every port. `op` indexes the
+  * function list of the harness, the order of the op tables in cosim/units/harness/src/unit_ops.h.
+  */
+class UnitHarnessIO(xLen: Int, lanes: Int) extends Bundle {
+  val op = Input(UInt((lanes * 8).W))
+  val dw = Input(UInt(lanes.W))
+  val in1 = Input(UInt((lanes * xLen).W))
+  val in2 = Input(UInt((lanes * xLen).W))
+  val out = Output(UInt((lanes * xLen).W))
+  val cmp = Output(UInt(lanes.W))
+}
+
+abstract class UnitHarness(val xLen: Int, val lanes: Int) extends Module {
+  val io = IO(new UnitHarnessIO(xLen, lanes))
+
+  def fns: Seq[UInt]
+
+  def op(i: Int): UInt = VecInit(fns)(io.op(i * 8 + 7, i * 8))
+  def in1(i: Int): UInt = io.in1((i + 1) * xLen - 1, i * xLen)
+  def in2(i: Int): UInt = io.in2((i + 1) * xLen - 1, i * xLen)
+
+  def connect(out: Seq[UInt], cmp: Seq[Bool]): Unit = {
+    io.out := Cat(out.reverse)
+    io.cmp := Cat(cmp.reverse)
+  }
+}
+
+class ALUHarness(xLen: Int, lanes: Int) extends UnitHarness(xLen, lanes) {
+  val aluFn = new ALUFN
+  import aluFn._
+  def fns = Seq(FN_ADD, FN_SUB, FN_SL, FN_SR, FN_SRA, FN_XOR, FN_OR, FN_AND,
+    FN_SEQ, FN_SNE, FN_SLT, FN_SGE, FN_SLTU, FN_SGEU)
+
+  val alus = Seq.tabulate(lanes) { i =>
+    val alu = Module(new ALU(SZ_DW, xLen, DW_64, DW_32))
+    alu.io.fn := op(i)
+    alu.io.dw := io.dw(i)
+    alu.io.in1 := in1(i)
+    alu.io.in2 := in2(i)
+    alu
+  }
+  connect(alus.map(_.io.out), alus.map(_.io.cmp_out))
+}
+
+class ABLUHarness(xLen: Int, lanes: Int) extends UnitHarness(xLen, lanes) {
+  val aluFn = new ABLUFN
+  import aluFn._
+  def fns = Seq(FN_ADD, FN_SUB, FN_SL, FN_SR, FN_SRA, FN_XOR, FN_OR, FN_AND,
+    FN_SEQ, FN_SNE, FN_SLT, FN_SGE, FN_SLTU, FN_SGEU,
+    FN_ADDUW, FN_SLLIUW, FN_SH1ADD, FN_SH1ADDUW, FN_SH2ADD, FN_SH2ADDUW, FN_SH3ADD, FN_SH3ADDUW,
+    FN_ROR, FN_ROL, FN_ANDN, FN_ORN, FN_XNOR, FN_REV8, FN_ORCB, FN_SEXTB, FN_SEXTH, FN_ZEXTH,
+    FN_MAX, FN_MAXU, FN_MIN, FN_MINU, FN_CPOP, FN_CLZ, FN_CTZ,
+    FN_BCLR, FN_BEXT, FN_BINV, FN_BSET,
+    FN_BREV8, FN_PACK, FN_PACKH, FN_ZIP, FN_UNZIP)
+
+  val ablus = Seq.tabulate(lanes) { i =>
+    val ablu = Module(new ABLU(SZ_DW, xLen, DW_64, usingBitManipCrypto = true))
+    ablu.io.fn := op(i)
+    ablu.io.dw := io.dw(i)
+    ablu.io.in1 := in1(i)
+    ablu.io.in2 := in2(i)
+    ablu
+  }
+  connect(ablus.map(_.io.out), ablus.map(_.io.cmp_out))
+}
+
+class BitManipCryptoHarness(xLen: Int, lanes: Int) extends UnitHarness(xLen, lanes) {
+  val aluFn = new ABLUFN
+  import aluFn._
+  def fns = Seq(FN_CLMUL, FN_CLMULR, FN_CLMULH, FN_XPERM8, FN_XPERM4)
+
+  val units = Seq.tabulate(lanes) { i =>
+    val unit = Module(new BitManipCrypto(xLen, usingBitManipCrypto = true))
+    unit.io.fn := op(i)
+    unit.io.dw := io.dw(i)
+    unit.io.rs1 := in1(i)
+    unit.io.rs2 := in2(i)
+    unit
+  }
+  connect(units.map(_.io.rd), Seq.fill(lanes)(false.B))
+}
+
+/** The iterative MulDiv of every lane takes its operands on `start` and holds its result until the next one, `done`
+  * is set for the lanes which responded and `cycles` (8 bits a lane) counts the cycles from start to the response.
+  * The operands must stay stable until every lane is done.
+  */
+class MulDivHarness(xLen: Int, lanes: Int, cfg: MulDivParams) extends UnitHarness(xLen, lanes) {
+  val aluFn = new ALUFN
+  import aluFn._
+  def fns = Seq(FN_MUL, FN_MULH, FN_MULHSU, FN_MULHU, FN_DIV, FN_DIVU, FN_REM, FN_REMU)
+
+  val start = IO(Input(Bool()))
+  val done = IO(Output(UInt(lanes.W)))
+  val cycles = IO(Output(UInt((lanes * 8).W)))
+
+  val lanesState = Seq.tabulate(lanes) { i =>
+    val muldiv = Module(new MulDiv(cfg, xLen, aluFn = aluFn))
+    val pending = RegInit(false.B)
+    val responded = RegInit(false.B)
+    val result = Reg(UInt(xLen.W))
+    val count = RegInit(0.U(8.W))
+
+    muldiv.io.req.valid := pending
+    muldiv.io.req.bits.fn := op(i)
+    muldiv.io.req.bits.dw := io.dw(i)
+    muldiv.io.req.bits.in1 := in1(i)
+    muldiv.io.req.bits.in2 := in2(i)
+    muldiv.io.req.bits.tag := 0.U
+    muldiv.io.kill := false.B
+    muldiv.io.resp.ready := true.B
+
+    when (start) {
+      pending := true.B
+      responded := false.B
+      count := 0.U
+    } .otherwise {
+      when (muldiv.io.req.fire) { pending := false.B }
+      when (!responded && count =/= 255.U) { count := count + 1.U }
+      when (muldiv.io.resp.fire) {
+        responded := true.B
+        result := muldiv.io.resp.bits.data
+      }
+    }
+    (result, responded, count)
+  }
+  connect(lanesState.map(_._1), Seq.fill(lanes)(false.B))
+  done := Cat(lanesState.map(_._2).reverse)
+  cycles := Cat(lanesState.map(_._3).reverse)
+}
@@ -0,0 +1,327 @@
+// Batched random testing of the verilated ALU, ABLU, BitManipCrypto and MulDiv of rocket against the reference
+// model of unit_reference.h, without a core around them.
+//
+// unit_harness [-j THREADS] [--ops=N] [--seed=N] [--units=alu,ablu,bmc,muldiv] [--max-mismatches=N]
+//
+// Every unit runs N ops (16M by default) in shards of SHARD_OPS; shards of all units are spread over THREADS threads
+// (all cores by default), every thread verilates its own copy of each unit. A shard is a sequence of blocks of
+// BLOCK_OPS ops of one function, the reference computes a block at once and the harness feeds it UNIT_LANES ops at a
+// time to the lanes of the unit. Operands mix corner values, small values, sparse bit patterns and random values;
+// ops with a W variant take it every other block on rv64. The summary gives ops per second per thread and unit, and
+// the average MulDiv latency. Exits with 1 if any result mismatched.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "VABLUHarness.h"
+#include "VALUHarness.h"
+#include "VBitManipCryptoHarness.h"
+#include "VMulDivHarness.h"
+#include "unit_ops.h"
+#include "unit_ports.h"
+#include "unit_reference.h"
+
+#ifndef UNIT_LANES
+#define UNIT_LANES 16
+#endif
+#ifndef UNIT_XLEN
+#define UNIT_XLEN 64
+#endif
+
+static constexpr unsigned LANES = UNIT_LANES;
+static constexpr unsigned XLEN = UNIT_XLEN;
+static constexpr size_t BLOCK_OPS = 1024;
+static constexpr size_t SHARD_OPS = 64 * BLOCK_OPS;
+/// a MulDiv lane which has not responded after this many cycles is a mismatch
+static constexpr unsigned MULDIV_TIMEOUT = 1000;
+
+static_assert(BLOCK_OPS % LANES == 0);
+
+struct splitmix64 {
+    uint64_t state;
+
+    uint64_t operator()() {
+      uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+      z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+      z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+      return z ^ (z >> 31);
+    }
+};
+
+static const uint64_t corner_values[] = {
+    0, 1, 2, 3, ~0ull, ~1ull, 0x7f, 0x80, 0xff, 0x100, 0x7fff, 0x8000, 0xffff, 0x7fffffff, 0x80000000, 0xffffffff,
+    0x100000000, 0xffffffff80000000, 0x7fffffffffffffff, 0x8000000000000000, 0x8000000000000001,
+};
+
+static uint64_t operand(splitmix64 &rng) {
+  uint64_t r = rng();
+  uint64_t v;
+  switch (r & 7) {
+    case 0:
+    case 1: v = corner_values[(r >> 3) % std::size(corner_values)]; break;
+    // shift amounts, bit indices and small signed values
+    case 2: v = int64_t(int8_t(r >> 3)); break;
+    // few set bits for clz, ctz, cpop and the carry chains
+    case 3: v = rng() & rng() & rng(); break;
+    case 4: v = rng() >> ((r >> 3) & 63); break;
+    default: v = rng(); break;
+  }
+  return XLEN == 32 ? uint32_t(v) : v;
+}
+
+struct unit_stats {
+    uint64_t ops = 0;
+    uint64_t mismatches = 0;
+    /// thread time spent in the shards of the unit
+    double seconds = 0;
+    uint64_t latency_cycles = 0;
+};
+
+struct options {
+    uint64_t ops_per_unit = 16 << 20;
+    uint64_t seed = 1;
+    uint64_t max_mismatches = 10;
+};
+
+static std::mutex report_mutex;
+static std::atomic<uint64_t> mismatches_printed{0};
+
+struct block {
+    unit_kind unit;
+    unsigned op_index;
+    bool w;
+    std::array<uint64_t, BLOCK_OPS> a, b, expected;
+};
+
+static void report_mismatch(const options &opts, const block &blk, size_t i, const char *port, uint64_t expected,
+                            uint64_t got) {
+  if (mismatches_printed++ >= opts.max_mismatches) return;
+  std::lock_guard<std::mutex> lock(report_mutex);
+  const unit_op_info &info = unit_op_infos[unit_descs[blk.unit].ops[blk.op_index]];
+  fmt::print(stderr, "{} {}{} 0x{:x}, 0x{:x}: {} is 0x{:x}, expected 0x{:x}\n", unit_descs[blk.unit].name, info.name,
+             blk.w ? " (W)" : "", blk.a[i], blk.b[i], port, got, expected);
+}
+
+/// Drive the op, dw and operands of lanes [0, n) from ops [first, first + n) of a block.
+template<typename M>
+static void drive(M &top, const block &blk, size_t first) {
+  for (unsigned l = 0; l < LANES; l++) {
+    put_field(top.io_op, l * 8, 8, blk.op_index);
+    put_field(top.io_dw, l, 1, !blk.w);
+    put_field(top.io_in1, l * XLEN, XLEN, blk.a[first + l]);
+    put_field(top.io_in2, l * XLEN, XLEN, blk.b[first + l]);
+  }
+}
+
+template<typename M>
+static uint64_t check(const options &opts, M &top, const block &blk, size_t first) {
+  uint8_t flags = unit_op_infos[unit_descs[blk.unit].ops[blk.op_index]].flags;
+  uint64_t mismatches = 0;
+  for (unsigned l = 0; l < LANES; l++) {
+    uint64_t expected = blk.expected[first + l];
+    if (flags & unit_op_info::OUT) {
+      uint64_t out = get_field(top.io_out, l * XLEN, XLEN);
+      if (out != expected) {
+        mismatches++;
+        report_mismatch(opts, blk, first + l, "out", expected, out);
+      }
+    }
+    if (flags & unit_op_info::CMP) {
+      uint64_t cmp = get_field(top.io_cmp, l, 1);
+      if (cmp != (expected & 1)) {
+        mismatches++;
+        report_mismatch(opts, blk, first + l, "cmp", expected & 1, cmp);
+      }
+    }
+  }
+  return mismatches;
+}
+
+/// the combinational units settle within one eval
+template<typename M>
+static void run_block(const options &opts, M &top, const block &blk, unit_stats &stats) {
+  for (size_t first = 0; first < BLOCK_OPS; first += LANES) {
+    drive(top, blk, first);
+    top.eval();
+    stats.mismatches += check(opts, top, blk, first);
+  }
+}
+
+static void tick(VMulDivHarness &top) {
+  top.clock = 0;
+  top.eval();
+  top.clock = 1;
+  top.eval();
+}
+
+static void run_block(const options &opts, VMulDivHarness &top, const block &blk, unit_stats &stats) {
+  const uint64_t all = LANES == 64 ? ~0ull : (1ull << LANES) - 1;
+  for (size_t first = 0; first < BLOCK_OPS; first += LANES) {
+    drive(top, blk, first);
+    top.start = 1;
+    tick(top);
+    top.start = 0;
+    unsigned cycles = 0;
+    while (get_field(top.done, 0, LANES) != all && cycles++ < MULDIV_TIMEOUT) tick(top);
+    uint64_t done = get_field(top.done, 0, LANES);
+    for (unsigned l = 0; l < LANES; l++) {
+      if (!(done >> l & 1)) {
+        stats.mismatches++;
+        report_mismatch(opts, blk, first + l, "response", 1, 0);
+      } else {
+        stats.latency_cycles += get_field(top.cycles, l * 8, 8);
+      }
+    }
+    stats.mismatches += check(opts, top, blk, first);
+  }
+}
+
+/// one verilated copy of every unit, owned by a thread
+struct unit_models {
+    VerilatedContext context;
+    std::unique_ptr<VALUHarness> alu;
+    std::unique_ptr<VABLUHarness> ablu;
+    std::unique_ptr<VBitManipCryptoHarness> bmc;
+    std::unique_ptr<VMulDivHarness> muldiv;
+
+    template<typename M>
+    M &get(std::unique_ptr<M> &model, const char *name) {
+      if (!model) {
+        model = std::make_unique<M>(&context, name);
+        model->clock = 0;
+        model->reset = 1;
+        model->eval();
+        model->clock = 1;
+        model->eval();
+        model->reset = 0;
+        model->clock = 0;
+        model->eval();
+      }
+      return *model;
+    }
+
+    void run(const options &opts, const block &blk, unit_stats &stats) {
+      switch (blk.unit) {
+        case UNIT_ALU: return run_block(opts, get(alu, "alu"), blk, stats);
+        case UNIT_ABLU: return run_block(opts, get(ablu, "ablu"), blk, stats);
+        case UNIT_BMC: return run_block(opts, get(bmc, "bmc"), blk, stats);
+        case UNIT_MULDIV: return run_block(opts, get(muldiv, "muldiv"), blk, stats);
+        case UNIT_COUNT: break;
+      }
+    }
+};
+
+static void run_shard(const options &opts, unit_models &models, unit_kind unit, uint64_t shard, unit_stats &stats) {
+  const unit_desc &desc = unit_descs[unit];
+  std::vector<unsigned> valid;
+  for (unsigned i = 0; i < desc.n_ops; i++)
+    if (unit_op_infos[desc.ops[i]].valid(XLEN)) valid.push_back(i);
+
+  splitmix64 rng{opts.seed ^ (uint64_t(unit) << 56) ^ (shard * 0x2545f4914f6cdd1dull)};
+  auto blk = std::make_unique<block>();
+  std::array<uint32_t, 3 * BLOCK_OPS> scratch;
+  uint64_t ops = std::min<uint64_t>(SHARD_OPS, opts.ops_per_unit - shard * SHARD_OPS);
+  for (uint64_t done = 0; done < ops; done += BLOCK_OPS) {
+    blk->unit = unit;
+    blk->op_index = valid[rng() % valid.size()];
+    unit_op op = desc.ops[blk->op_index];
+    blk->w = XLEN == 64 && (unit_op_infos[op].flags & unit_op_info::W) && (rng() & 1);
+    for (size_t i = 0; i < BLOCK_OPS; i++) {
+      blk->a[i] = operand(rng);
+      blk->b[i] = operand(rng);
+    }
+    unit_reference_batch(XLEN, blk->w, op, blk->a.data(), blk->b.data(), blk->expected.data(), BLOCK_OPS,
+                         scratch.data());
+    models.run(opts, *blk, stats);
+    stats.ops += BLOCK_OPS;
+  }
+}
+
+static void usage(const char *program_name) {
+  fmt::print("Usage: {} [-j THREADS] [--ops=N] [--seed=N] [--units=alu,ablu,bmc,muldiv] [--max-mismatches=N]\n",
+             program_name);
+}
+
+int main(int argc, char **argv) {
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+  options opts;
+  std::vector<unit_kind> units;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) threads = std::max(1, atoi(argv[++i]));
+    else if (strncmp(argv[i], "--ops=", 6) == 0) opts.ops_per_unit = strtoull(argv[i] + 6, nullptr, 0);
+    else if (strncmp(argv[i], "--seed=", 7) == 0) opts.seed = strtoull(argv[i] + 7, nullptr, 0);
+    else if (strncmp(argv[i], "--max-mismatches=", 17) == 0) opts.max_mismatches = strtoull(argv[i] + 17, nullptr, 0);
+    else if (strncmp(argv[i], "--units=", 8) == 0) {
+      for (const char *p = argv[i] + 8; *p;) {
+        size_t len = strcspn(p, ",");
+        unit_kind unit;
+        if (!parse_unit(p, len, unit)) {
+          usage(argv[0]);
+          return 1;
+        }
+        units.push_back(unit);
+        p += len + (p[len] == ',');
+      }
+    } else {
+      usage(argv[0]);
+      return strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1;
+    }
+  }
+  if (units.empty())
+    for (unsigned u = 0; u < UNIT_COUNT; u++) units.push_back((unit_kind) u);
+  opts.ops_per_unit = (opts.ops_per_unit + BLOCK_OPS - 1) / BLOCK_OPS * BLOCK_OPS;
+
+  // shards of the units interleaved, so that the slow MulDiv does not end up alone on the last threads
+  uint64_t shards_per_unit = (opts.ops_per_unit + SHARD_OPS - 1) / SHARD_OPS;
+  std::vector<std::pair<unit_kind, uint64_t>> shards;
+  for (uint64_t s = 0; s < shards_per_unit; s++)
+    for (unit_kind u: units) shards.emplace_back(u, s);
+
+  std::array<unit_stats, UNIT_COUNT> totals;
+  std::mutex totals_mutex;
+  std::atomic<size_t> next{0};
+  auto start = std::chrono::steady_clock::now();
+  auto worker = [&]() {
+    unit_models models;
+    for (size_t s; (s = next++) < shards.size();) {
+      unit_stats stats;
+      auto shard_start = std::chrono::steady_clock::now();
+      run_shard(opts, models, shards[s].first, shards[s].second, stats);
+      stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - shard_start).count();
+      std::lock_guard<std::mutex> lock(totals_mutex);
+      unit_stats &total = totals[shards[s].first];
+      total.ops += stats.ops;
+      total.mismatches += stats.mismatches;
+      total.seconds += stats.seconds;
+      total.latency_cycles += stats.latency_cycles;
+    }
+  };
+  std::vector<std::thread> pool;
+  for (unsigned t = 0; t < std::min<size_t>(threads, shards.size()); t++) pool.emplace_back(worker);
+  for (auto &t: pool) t.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  uint64_t ops = 0, mismatches = 0;
+  for (unit_kind u: units) {
+    const unit_stats &s = totals[u];
+    fmt::print("{}: {} ops, {} mismatches, {:.2f} Mops/s per thread", unit_descs[u].name, s.ops, s.mismatches,
+               s.seconds > 0 ? s.ops / s.seconds / 1e6 : 0.0);
+    if (u == UNIT_MULDIV) fmt::print(", average latency {:.1f} cycles", s.ops ? (double) s.latency_cycles / s.ops : 0.0);
+    fmt::print("\n");
+    ops += s.ops;
+    mismatches += s.mismatches;
+  }
+  fmt::print("rv{} x {} lanes: {} ops on {} threads in {:.2f}s, {:.2f} Mops/s, {} mismatches\n", XLEN, LANES, ops,
+             pool.size(), seconds, seconds > 0 ? ops / seconds / 1e6 : 0.0, mismatches);
+  return mismatches ? 1 : 0;
+}
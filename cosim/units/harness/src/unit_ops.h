@@ -0,0 +1,153 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+/// The functions of the unit harnesses of cosim/units/elaborate; the op port of a harness indexes its table below,
+/// which must list the FN_* constants in the order of the `fns` of the harness.
+enum unit_op {
+    OP_ADD, OP_SUB, OP_SL, OP_SR, OP_SRA, OP_XOR, OP_OR, OP_AND,
+    OP_SEQ, OP_SNE, OP_SLT, OP_SGE, OP_SLTU, OP_SGEU,
+    OP_ADDUW, OP_SLLIUW, OP_SH1ADD, OP_SH1ADDUW, OP_SH2ADD, OP_SH2ADDUW, OP_SH3ADD, OP_SH3ADDUW,
+    OP_ROR, OP_ROL, OP_ANDN, OP_ORN, OP_XNOR, OP_REV8, OP_ORCB, OP_SEXTB, OP_SEXTH, OP_ZEXTH,
+    OP_MAX, OP_MAXU, OP_MIN, OP_MINU, OP_CPOP, OP_CLZ, OP_CTZ,
+    OP_BCLR, OP_BEXT, OP_BINV, OP_BSET,
+    OP_BREV8, OP_PACK, OP_PACKH, OP_ZIP, OP_UNZIP,
+    OP_CLMUL, OP_CLMULR, OP_CLMULH, OP_XPERM8, OP_XPERM4,
+    OP_MUL, OP_MULH, OP_MULHSU, OP_MULHU, OP_DIV, OP_DIVU, OP_REM, OP_REMU,
+    OP_COUNT
+};
+
+struct unit_op_info {
+    enum : uint8_t {
+        RV32 = 1, RV64 = 2,
+        /// the op with DW_32 is the W variant of rv64 (addw, clzw, divuw, ...)
+        W = 4,
+        /// the result is on io.out, io.cmp, or both
+        OUT = 8, CMP = 16,
+    };
+
+    const char *name;
+    uint8_t flags;
+
+    [[nodiscard]] bool valid(unsigned xlen) const { return flags & (xlen == 32 ? RV32 : RV64); }
+};
+
+static constexpr uint8_t ANY = unit_op_info::RV32 | unit_op_info::RV64;
+
+static const unit_op_info unit_op_infos[OP_COUNT] = {
+    {"add", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"sub", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"sll", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"srl", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"sra", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"xor", ANY | unit_op_info::OUT},
+    {"or", ANY | unit_op_info::OUT},
+    {"and", ANY | unit_op_info::OUT},
+    // io.out of the branch comparisons is whatever the unit computes on the way, only SLT and SLTU write it
+    {"seq", ANY | unit_op_info::CMP},
+    {"sne", ANY | unit_op_info::CMP},
+    {"slt", ANY | unit_op_info::OUT | unit_op_info::CMP},
+    {"sge", ANY | unit_op_info::CMP},
+    {"sltu", ANY | unit_op_info::OUT | unit_op_info::CMP},
+    {"sgeu", ANY | unit_op_info::CMP},
+    {"add.uw", unit_op_info::RV64 | unit_op_info::OUT},
+    {"slli.uw", unit_op_info::RV64 | unit_op_info::OUT},
+    {"sh1add", ANY | unit_op_info::OUT},
+    {"sh1add.uw", unit_op_info::RV64 | unit_op_info::OUT},
+    {"sh2add", ANY | unit_op_info::OUT},
+    {"sh2add.uw", unit_op_info::RV64 | unit_op_info::OUT},
+    {"sh3add", ANY | unit_op_info::OUT},
+    {"sh3add.uw", unit_op_info::RV64 | unit_op_info::OUT},
+    {"ror", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"rol", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"andn", ANY | unit_op_info::OUT},
+    {"orn", ANY | unit_op_info::OUT},
+    {"xnor", ANY | unit_op_info::OUT},
+    {"rev8", ANY | unit_op_info::OUT},
+    {"orc.b", ANY | unit_op_info::OUT},
+    {"sext.b", ANY | unit_op_info::OUT},
+    {"sext.h", ANY | unit_op_info::OUT},
+    {"zext.h", ANY | unit_op_info::OUT},
+    {"max", ANY | unit_op_info::OUT},
+    {"maxu", ANY | unit_op_info::OUT},
+    {"min", ANY | unit_op_info::OUT},
+    {"minu", ANY | unit_op_info::OUT},
+    {"cpop", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"clz", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"ctz", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"bclr", ANY | unit_op_info::OUT},
+    {"bext", ANY | unit_op_info::OUT},
+    {"binv", ANY | unit_op_info::OUT},
+    {"bset", ANY | unit_op_info::OUT},
+    {"brev8", ANY | unit_op_info::OUT},
+    {"pack", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"packh", ANY | unit_op_info::OUT},
+    {"zip", unit_op_info::RV32 | unit_op_info::OUT},
+    {"unzip", unit_op_info::RV32 | unit_op_info::OUT},
+    {"clmul", ANY | unit_op_info::OUT},
+    {"clmulr", ANY | unit_op_info::OUT},
+    {"clmulh", ANY | unit_op_info::OUT},
+    {"xperm8", ANY | unit_op_info::OUT},
+    {"xperm4", ANY | unit_op_info::OUT},
+    {"mul", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"mulh", ANY | unit_op_info::OUT},
+    {"mulhsu", ANY | unit_op_info::OUT},
+    {"mulhu", ANY | unit_op_info::OUT},
+    {"div", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"divu", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"rem", ANY | unit_op_info::W | unit_op_info::OUT},
+    {"remu", ANY | unit_op_info::W | unit_op_info::OUT},
+};
+
+/// the harnesses, in the order the harness binary knows them
+enum unit_kind : uint8_t {
+    UNIT_ALU, UNIT_ABLU, UNIT_BMC, UNIT_MULDIV, UNIT_COUNT
+};
+
+static const unit_op alu_ops[] = {
+    OP_ADD, OP_SUB, OP_SL, OP_SR, OP_SRA, OP_XOR, OP_OR, OP_AND,
+    OP_SEQ, OP_SNE, OP_SLT, OP_SGE, OP_SLTU, OP_SGEU,
+};
+
+static const unit_op ablu_ops[] = {
+    OP_ADD, OP_SUB, OP_SL, OP_SR, OP_SRA, OP_XOR, OP_OR, OP_AND,
+    OP_SEQ, OP_SNE, OP_SLT, OP_SGE, OP_SLTU, OP_SGEU,
+    OP_ADDUW, OP_SLLIUW, OP_SH1ADD, OP_SH1ADDUW, OP_SH2ADD, OP_SH2ADDUW, OP_SH3ADD, OP_SH3ADDUW,
+    OP_ROR, OP_ROL, OP_ANDN, OP_ORN, OP_XNOR, OP_REV8, OP_ORCB, OP_SEXTB, OP_SEXTH, OP_ZEXTH,
+    OP_MAX, OP_MAXU, OP_MIN, OP_MINU, OP_CPOP, OP_CLZ, OP_CTZ,
+    OP_BCLR, OP_BEXT, OP_BINV, OP_BSET,
+    OP_BREV8, OP_PACK, OP_PACKH, OP_ZIP, OP_UNZIP,
+};
+
+static const unit_op bmc_ops[] = {
+    OP_CLMUL, OP_CLMULR, OP_CLMULH, OP_XPERM8, OP_XPERM4,
+};
+
+static const unit_op muldiv_ops[] = {
+    OP_MUL, OP_MULH, OP_MULHSU, OP_MULHU, OP_DIV, OP_DIVU, OP_REM, OP_REMU,
+};
+
+struct unit_desc {
+    const char *name;
+    const unit_op *ops;
+    unsigned n_ops;
+};
+
+static const unit_desc unit_descs[UNIT_COUNT] = {
+    {"alu", alu_ops, (unsigned) std::size(alu_ops)},
+    {"ablu", ablu_ops, (unsigned) std::size(ablu_ops)},
+    {"bmc", bmc_ops, (unsigned) std::size(bmc_ops)},
+    {"muldiv", muldiv_ops, (unsigned) std::size(muldiv_ops)},
+};
+
+inline bool parse_unit(const char *name, size_t len, unit_kind &unit) {
+  for (unsigned u = 0; u < UNIT_COUNT; u++) {
+    if (strlen(unit_descs[u].name) == len && strncmp(unit_descs[u].name, name, len) == 0) {
+      unit = (unit_kind) u;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+#include <verilated.h>
+
+/// Lane fields of the packed ports of the unit harnesses. Verilator declares a port of up to 64 bits as an integer
+/// and a wider one as VlWide, lanes sit at multiples of their width, a field is at most 64 bits.
+template<typename T>
+inline std::enable_if_t<std::is_integral_v<T>> put_field(T &port, unsigned lsb, unsigned width, uint64_t value) {
+  uint64_t mask = (width >= 64 ? ~0ull : (1ull << width) - 1) << lsb;
+  port = T((uint64_t(port) & ~mask) | ((value << lsb) & mask));
+}
+
+template<typename T>
+inline std::enable_if_t<std::is_integral_v<T>, uint64_t> get_field(const T &port, unsigned lsb, unsigned width) {
+  return (uint64_t(port) >> lsb) & (width >= 64 ? ~0ull : (1ull << width) - 1);
+}
+
+template<std::size_t N>
+inline void put_field(VlWide<N> &port, unsigned lsb, unsigned width, uint64_t value) {
+  for (unsigned done = 0; done < width;) {
+    unsigned bit = lsb + done, off = bit % 32;
+    unsigned n = std::min(32 - off, width - done);
+    uint32_t mask = (n == 32 ? ~0u : (1u << n) - 1) << off;
+    port[bit / 32] = (port[bit / 32] & ~mask) | ((uint32_t(value >> done) << off) & mask);
+    done += n;
+  }
+}
+
+template<std::size_t N>
+inline uint64_t get_field(const VlWide<N> &port, unsigned lsb, unsigned width) {
+  uint64_t value = 0;
+  for (unsigned done = 0; done < width;) {
+    unsigned bit = lsb + done, off = bit % 32;
+    unsigned n = std::min(32 - off, width - done);
+    uint32_t mask = n == 32 ? ~0u : (1u << n) - 1;
+    value |= uint64_t((port[bit / 32] >> off) & mask) << done;
+    done += n;
+  }
+  return value;
+}
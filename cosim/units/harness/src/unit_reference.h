@@ -0,0 +1,208 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#ifdef __PCLMUL__
+#include <wmmintrin.h>
+#endif
+
+#include "unit_ops.h"
+
+/// Reference model of the unit harnesses, the ISA semantics of every op of unit_ops.h for an xlen of 32 (U =
+/// uint32_t) or 64 (U = uint64_t). A batch applies one op to n operand pairs: the switch on the op is outside of the
+/// loop and the loop body is a branch-free lambda, which the compiler unrolls and vectorizes for the -march it
+/// targets (AVX2 on a current x86 host), so the reference keeps up with several verilated units per thread.
+template<typename U>
+struct unit_reference {
+    static_assert(std::is_same_v<U, uint32_t> || std::is_same_v<U, uint64_t>);
+
+    using S = std::make_signed_t<U>;
+    /// twice the width, for the high half of products
+    using UU = std::conditional_t<std::is_same_v<U, uint32_t>, uint64_t, unsigned __int128>;
+    using SS = std::conditional_t<std::is_same_v<U, uint32_t>, int64_t, __int128>;
+
+    static constexpr unsigned XLEN = sizeof(U) * 8;
+    static constexpr U MSB = U(1) << (XLEN - 1);
+
+    static U sll(U a, U b) { return a << (b & (XLEN - 1)); }
+    static U srl(U a, U b) { return a >> (b & (XLEN - 1)); }
+    static U sra(U a, U b) { return U(S(a) >> (b & (XLEN - 1))); }
+    static U ror(U a, U b) {
+      unsigned s = b & (XLEN - 1);
+      return (a >> s) | (a << ((XLEN - s) & (XLEN - 1)));
+    }
+    static U rol(U a, U b) {
+      unsigned s = b & (XLEN - 1);
+      return (a << s) | (a >> ((XLEN - s) & (XLEN - 1)));
+    }
+    static U clz(U a) { return a ? U(XLEN == 64 ? __builtin_clzll(a) : __builtin_clz(a)) : XLEN; }
+    static U ctz(U a) { return a ? U(XLEN == 64 ? __builtin_ctzll(a) : __builtin_ctz(a)) : XLEN; }
+    static U cpop(U a) { return XLEN == 64 ? __builtin_popcountll(a) : __builtin_popcount(a); }
+    static U rev8(U a) { return XLEN == 64 ? U(__builtin_bswap64(a)) : U(__builtin_bswap32(a)); }
+
+    static U orcb(U a) {
+      U r = 0;
+      for (unsigned i = 0; i < XLEN; i += 8) r |= ((a >> i) & 0xff) ? U(0xff) << i : 0;
+      return r;
+    }
+
+    static U brev8(U a) {
+      U r = 0;
+      for (unsigned i = 0; i < 8; i++) r |= ((a >> i) & U(0x0101010101010101ull)) << (7 - i);
+      return r;
+    }
+
+    static U zip(U a) {
+      U r = 0;
+      for (unsigned i = 0; i < XLEN / 2; i++) r |= ((a >> i) & 1) << (2 * i) | ((a >> (i + XLEN / 2)) & 1) << (2 * i + 1);
+      return r;
+    }
+
+    static U unzip(U a) {
+      U r = 0;
+      for (unsigned i = 0; i < XLEN / 2; i++) r |= ((a >> (2 * i)) & 1) << i | ((a >> (2 * i + 1)) & 1) << (i + XLEN / 2);
+      return r;
+    }
+
+    static U pack(U a, U b) {
+      constexpr unsigned H = XLEN / 2;
+      return (a & ((U(1) << H) - 1)) | b << H;
+    }
+
+    /// the 2 * XLEN bit carry-less product
+    static UU clmul_wide(U a, U b) {
+#ifdef __PCLMUL__
+      if constexpr (XLEN == 64) {
+        __m128i p = _mm_clmulepi64_si128(_mm_cvtsi64_si128((long long) a), _mm_cvtsi64_si128((long long) b), 0);
+        return UU(uint64_t(_mm_cvtsi128_si64(_mm_srli_si128(p, 8)))) << 64 | uint64_t(_mm_cvtsi128_si64(p));
+      }
+#endif
+      UU r = 0;
+      for (unsigned i = 0; i < XLEN; i++) r ^= (b >> i & 1) ? UU(a) << i : 0;
+      return r;
+    }
+
+    static U xperm8(U a, U b) {
+      U r = 0;
+      for (unsigned i = 0; i < XLEN; i += 8) {
+        unsigned idx = (b >> i) & 0xff;
+        r |= idx < XLEN / 8 ? ((a >> (idx * 8)) & 0xff) << i : 0;
+      }
+      return r;
+    }
+
+    static U xperm4(U a, U b) {
+      U r = 0;
+      for (unsigned i = 0; i < XLEN; i += 4) {
+        unsigned idx = (b >> i) & 0xf;
+        r |= idx < XLEN / 4 ? ((a >> (idx * 4)) & 0xf) << i : 0;
+      }
+      return r;
+    }
+
+    static U div(U a, U b) {
+      if (b == 0) return ~U(0);
+      if (a == MSB && b == ~U(0)) return a;
+      return U(S(a) / S(b));
+    }
+    static U divu(U a, U b) { return b ? a / b : ~U(0); }
+    static U rem(U a, U b) {
+      if (b == 0) return a;
+      if (a == MSB && b == ~U(0)) return 0;
+      return U(S(a) % S(b));
+    }
+    static U remu(U a, U b) { return b ? a % b : a; }
+
+    template<typename F>
+    static void map(const U *a, const U *b, U *out, size_t n, F f) {
+      for (size_t i = 0; i < n; i++) out[i] = f(a[i], b[i]);
+    }
+
+    /// out[i] = op(a[i], b[i]), comparisons return 0 or 1
+    static void batch(unit_op op, const U *a, const U *b, U *out, size_t n) {
+      switch (op) {
+        case OP_ADD: return map(a, b, out, n, [](U x, U y) { return U(x + y); });
+        case OP_SUB: return map(a, b, out, n, [](U x, U y) { return U(x - y); });
+        case OP_SL: return map(a, b, out, n, sll);
+        case OP_SR: return map(a, b, out, n, srl);
+        case OP_SRA: return map(a, b, out, n, sra);
+        case OP_XOR: return map(a, b, out, n, [](U x, U y) { return U(x ^ y); });
+        case OP_OR: return map(a, b, out, n, [](U x, U y) { return U(x | y); });
+        case OP_AND: return map(a, b, out, n, [](U x, U y) { return U(x & y); });
+        case OP_SEQ: return map(a, b, out, n, [](U x, U y) { return U(x == y); });
+        case OP_SNE: return map(a, b, out, n, [](U x, U y) { return U(x != y); });
+        case OP_SLT: return map(a, b, out, n, [](U x, U y) { return U(S(x) < S(y)); });
+        case OP_SGE: return map(a, b, out, n, [](U x, U y) { return U(S(x) >= S(y)); });
+        case OP_SLTU: return map(a, b, out, n, [](U x, U y) { return U(x < y); });
+        case OP_SGEU: return map(a, b, out, n, [](U x, U y) { return U(x >= y); });
+        case OP_ADDUW: return map(a, b, out, n, [](U x, U y) { return U(U(uint32_t(x)) + y); });
+        case OP_SLLIUW: return map(a, b, out, n, [](U x, U y) { return sll(U(uint32_t(x)), y); });
+        case OP_SH1ADD: return map(a, b, out, n, [](U x, U y) { return U((x << 1) + y); });
+        case OP_SH1ADDUW: return map(a, b, out, n, [](U x, U y) { return U((U(uint32_t(x)) << 1) + y); });
+        case OP_SH2ADD: return map(a, b, out, n, [](U x, U y) { return U((x << 2) + y); });
+        case OP_SH2ADDUW: return map(a, b, out, n, [](U x, U y) { return U((U(uint32_t(x)) << 2) + y); });
+        case OP_SH3ADD: return map(a, b, out, n, [](U x, U y) { return U((x << 3) + y); });
+        case OP_SH3ADDUW: return map(a, b, out, n, [](U x, U y) { return U((U(uint32_t(x)) << 3) + y); });
+        case OP_ROR: return map(a, b, out, n, ror);
+        case OP_ROL: return map(a, b, out, n, rol);
+        case OP_ANDN: return map(a, b, out, n, [](U x, U y) { return U(x & ~y); });
+        case OP_ORN: return map(a, b, out, n, [](U x, U y) { return U(x | ~y); });
+        case OP_XNOR: return map(a, b, out, n, [](U x, U y) { return U(~(x ^ y)); });
+        case OP_REV8: return map(a, b, out, n, [](U x, U) { return rev8(x); });
+        case OP_ORCB: return map(a, b, out, n, [](U x, U) { return orcb(x); });
+        case OP_SEXTB: return map(a, b, out, n, [](U x, U) { return U(S(int8_t(x))); });
+        case OP_SEXTH: return map(a, b, out, n, [](U x, U) { return U(S(int16_t(x))); });
+        case OP_ZEXTH: return map(a, b, out, n, [](U x, U) { return U(uint16_t(x)); });
+        case OP_MAX: return map(a, b, out, n, [](U x, U y) { return S(x) < S(y) ? y : x; });
+        case OP_MAXU: return map(a, b, out, n, [](U x, U y) { return x < y ? y : x; });
+        case OP_MIN: return map(a, b, out, n, [](U x, U y) { return S(x) < S(y) ? x : y; });
+        case OP_MINU: return map(a, b, out, n, [](U x, U y) { return x < y ? x : y; });
+        case OP_CPOP: return map(a, b, out, n, [](U x, U) { return cpop(x); });
+        case OP_CLZ: return map(a, b, out, n, [](U x, U) { return clz(x); });
+        case OP_CTZ: return map(a, b, out, n, [](U x, U) { return ctz(x); });
+        case OP_BCLR: return map(a, b, out, n, [](U x, U y) { return U(x & ~sll(1, y)); });
+        case OP_BEXT: return map(a, b, out, n, [](U x, U y) { return U(srl(x, y) & 1); });
+        case OP_BINV: return map(a, b, out, n, [](U x, U y) { return U(x ^ sll(1, y)); });
+        case OP_BSET: return map(a, b, out, n, [](U x, U y) { return U(x | sll(1, y)); });
+        case OP_BREV8: return map(a, b, out, n, [](U x, U) { return brev8(x); });
+        case OP_PACK: return map(a, b, out, n, pack);
+        case OP_PACKH: return map(a, b, out, n, [](U x, U y) { return U((x & 0xff) | (y & 0xff) << 8); });
+        case OP_ZIP: return map(a, b, out, n, [](U x, U) { return zip(x); });
+        case OP_UNZIP: return map(a, b, out, n, [](U x, U) { return unzip(x); });
+        case OP_CLMUL: return map(a, b, out, n, [](U x, U y) { return U(clmul_wide(x, y)); });
+        case OP_CLMULR: return map(a, b, out, n, [](U x, U y) { return U(clmul_wide(x, y) >> (XLEN - 1)); });
+        case OP_CLMULH: return map(a, b, out, n, [](U x, U y) { return U(clmul_wide(x, y) >> XLEN); });
+        case OP_XPERM8: return map(a, b, out, n, xperm8);
+        case OP_XPERM4: return map(a, b, out, n, xperm4);
+        case OP_MUL: return map(a, b, out, n, [](U x, U y) { return U(x * y); });
+        case OP_MULH: return map(a, b, out, n, [](U x, U y) { return U(UU(SS(S(x)) * SS(S(y))) >> XLEN); });
+        case OP_MULHSU: return map(a, b, out, n, [](U x, U y) { return U(UU(SS(S(x)) * SS(UU(y))) >> XLEN); });
+        case OP_MULHU: return map(a, b, out, n, [](U x, U y) { return U(UU(x) * UU(y) >> XLEN); });
+        case OP_DIV: return map(a, b, out, n, div);
+        case OP_DIVU: return map(a, b, out, n, divu);
+        case OP_REM: return map(a, b, out, n, rem);
+        case OP_REMU: return map(a, b, out, n, remu);
+        case OP_COUNT: break;
+      }
+    }
+};
+
+/// A batch of xlen-bit operands held in uint64_t, with the W variant of rv64 computed as the rv32 op on the low
+/// halves and sign-extended, which is what DW_32 selects in the units.
+inline void unit_reference_batch(unsigned xlen, bool w, unit_op op, const uint64_t *a, const uint64_t *b,
+                                 uint64_t *out, size_t n, uint32_t *scratch) {
+  if (xlen == 64 && !w) {
+    unit_reference<uint64_t>::batch(op, a, b, out, n);
+    return;
+  }
+  uint32_t *a32 = scratch, *b32 = scratch + n, *out32 = scratch + 2 * n;
+  for (size_t i = 0; i < n; i++) {
+    a32[i] = uint32_t(a[i]);
+    b32[i] = uint32_t(b[i]);
+  }
+  unit_reference<uint32_t>::batch(op, a32, b32, out32, n);
+  if (xlen == 64) for (size_t i = 0; i < n; i++) out[i] = uint64_t(int64_t(int32_t(out32[i])));
+  else for (size_t i = 0; i < n; i++) out[i] = out32[i];
+}
@@ -4,6 +4,8 @@
 #include <vpi_user.h>
 #include <svdpi.h>
 
+#include "dtm_replay.h"
+
 dtm_t* dtm;
 
 extern "C" int debug_tick
@@ -29,6 +31,7 @@ extern "C" int debug_tick
   dtm_t::resp resp_bits;
   resp_bits.resp = debug_resp_bits_resp;
   resp_bits.data = debug_resp_bits_data;
+  dtm_replay.record(debug_req_ready, debug_resp_valid, debug_resp_bits_resp, debug_resp_bits_data);
 
   dtm->tick
   (
@@ -0,0 +1,90 @@
+// See LICENSE.SiFive for license details.
+
+// Render a binary commit trace written by the emulator (--commit-trace) as
+// the text the "C%d:" commit printf would have produced, already piped
+// through spike-dasm:
+//
+//   C0: 1234 [1] pc=[0000000080000000] W[r10=0000000000000001][1] R[r10=0000000000000000] R[r11=0000000000000001] inst=[00b50533] add a0, a0, a1
+//
+// Long latency write backs, which the printf does not show, are rendered as
+//
+//   C0: 1240 late W[r14=ffffffff80000000]
+//
+// Usage: commit_render [--isa=ISA] [--hart=ID] TRACE
+// Link against spike's libdisasm.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#include "commit_trace.h"
+#include "disasm.h"
+
+static void usage(const char* program_name)
+{
+  fprintf(stderr, "Usage: %s [--isa=ISA] [--hart=ID] TRACE\n", program_name);
+}
+
+int main(int argc, char** argv)
+{
+  std::string isa_string = "rv64gc";
+  long hart = -1;
+  const char* path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--isa=", 6) == 0)
+      isa_string = argv[i] + 6;
+    else if (strncmp(argv[i], "--hart=", 7) == 0)
+      hart = atol(argv[i] + 7);
+    else if (argv[i][0] == '-') {
+      usage(argv[0]);
+      return strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1;
+    } else
+      path = argv[i];
+  }
+  if (!path) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "Unable to open %s\n", path);
+    return 1;
+  }
+  commit_trace_header_t header;
+  if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != commit_trace_header_t::MAGIC ||
+      header.version != commit_trace_header_t::VERSION || header.record_size != sizeof(commit_record_t)) {
+    fprintf(stderr, "%s is not a commit trace of this version\n", path);
+    return 1;
+  }
+
+  isa_parser_t isa(isa_string.c_str(), "msu");
+  disassembler_t disassembler(&isa);
+  int digits = isa.get_max_xlen() / 4;
+
+  static commit_record_t records[commit_trace_t::CHUNK_RECORDS];
+  size_t n;
+  while ((n = fread(records, sizeof(commit_record_t), commit_trace_t::CHUNK_RECORDS, f)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      const commit_record_t& r = records[i];
+      if (hart >= 0 && r.hartid != hart)
+        continue;
+      if (r.flags & commit_record_t::LATE_WRITE) {
+        printf("C%u: %u late W[r%u=%0*llx]\n", r.hartid, r.timer, r.rd, digits, (unsigned long long)r.wdata);
+        continue;
+      }
+      bool wen = r.flags & commit_record_t::WRITE_X;
+      printf("C%u: %u [%d] pc=[%0*llx] W[r%u=%0*llx][%d] R[r%u=%0*llx] R[r%u=%0*llx] inst=[%08x] %s\n",
+             r.hartid, r.timer, (r.flags & commit_record_t::VALID) != 0,
+             digits, (unsigned long long)r.pc,
+             r.rd, digits, wen ? (unsigned long long)r.wdata : 0ull, wen,
+             r.rs1, digits, (unsigned long long)r.rs1_val,
+             r.rs2, digits, (unsigned long long)r.rs2_val,
+             r.inst, disassembler.disassemble(r.inst).c_str());
+    }
+  }
+  fclose(f);
+  return 0;
+}
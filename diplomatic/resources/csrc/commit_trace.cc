@@ -0,0 +1,170 @@
+// See LICENSE.SiFive for license details.
+
+#include "commit_trace.h"
+#include "hang_watchdog.h"
+
+commit_trace_t commit_trace;
+
+// defined by the emulator main loop
+extern double sc_time_stamp();
+
+bool commit_trace_t::open(const std::string& path)
+{
+  file = fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  commit_trace_header_t header = {commit_trace_header_t::MAGIC, commit_trace_header_t::VERSION,
+                                  sizeof(commit_record_t), 0};
+  fwrite(&header, sizeof(header), 1, file);
+  stopping = false;
+  writer_thread = std::thread(&commit_trace_t::writer, this);
+  return true;
+}
+
+void commit_trace_t::close()
+{
+  if (!file)
+    return;
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    for (chunk_t** slot : slots) {
+      if (*slot && (*slot)->n)
+        full.push_back(*slot);
+      else if (*slot)
+        free_chunks.push_back(*slot);
+      *slot = NULL;
+    }
+    stopping = true;
+  }
+  full_cv.notify_one();
+  writer_thread.join();
+  fclose(file);
+  file = NULL;
+  for (chunk_t* chunk : free_chunks)
+    delete chunk;
+  free_chunks.clear();
+  allocated = 0;
+}
+
+commit_trace_t::chunk_t*& commit_trace_t::local_chunk()
+{
+  static thread_local chunk_t* chunk = NULL;
+  static thread_local bool registered = false;
+  if (!registered) {
+    std::unique_lock<std::mutex> guard(lock);
+    slots.push_back(&chunk);
+    registered = true;
+  }
+  return chunk;
+}
+
+commit_trace_t::chunk_t* commit_trace_t::acquire()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  while (free_chunks.empty() && allocated == MAX_CHUNKS)
+    free_cv.wait(guard);
+  chunk_t* chunk;
+  if (free_chunks.empty()) {
+    chunk = new chunk_t;
+    allocated++;
+  } else {
+    chunk = free_chunks.back();
+    free_chunks.pop_back();
+  }
+  chunk->n = 0;
+  return chunk;
+}
+
+void commit_trace_t::submit(chunk_t* chunk)
+{
+  {
+    std::unique_lock<std::mutex> guard(lock);
+    full.push_back(chunk);
+  }
+  full_cv.notify_one();
+}
+
+void commit_trace_t::writer()
+{
+  std::unique_lock<std::mutex> guard(lock);
+  while (true) {
+    while (full.empty() && !stopping)
+      full_cv.wait(guard);
+    if (full.empty())
+      break;
+    chunk_t* chunk = full.front();
+    full.pop_front();
+    guard.unlock();
+    fwrite(chunk->records, sizeof(commit_record_t), chunk->n, file);
+    guard.lock();
+    written += chunk->n;
+    free_chunks.push_back(chunk);
+    free_cv.notify_one();
+  }
+  fflush(file);
+}
+
+extern "C" void commit_trace_retire
+(
+  int           hartid,
+  int           timer,
+  char          priv,
+  unsigned char valid,
+  unsigned char excpt,
+  long long     pc,
+  int           inst,
+  unsigned char wrenx,
+  unsigned char wrenf,
+  char          wrdst,
+  long long     wrdata,
+  char          rd0src,
+  long long     rd0val,
+  char          rd1src,
+  long long     rd1val
+)
+{
+  // the metrics and the watchdog of the emulator tap the retires whether or not they are traced
+  if (valid)
+    commit_trace.count_retire();
+  if (valid && hang_watchdog.enabled())
+    hang_watchdog.commit(hartid, (uint64_t)sc_time_stamp(), pc, inst);
+  if (!commit_trace.enabled())
+    return;
+  commit_record_t r;
+  r.cycle = (uint64_t)sc_time_stamp();
+  r.pc = pc;
+  r.wdata = wrdata;
+  r.rs1_val = rd0val;
+  r.rs2_val = rd1val;
+  r.inst = inst;
+  r.timer = timer;
+  r.hartid = hartid;
+  r.priv = priv;
+  r.rd = wrdst;
+  r.rs1 = rd0src;
+  r.rs2 = rd1src;
+  r.flags = (valid ? commit_record_t::VALID : 0) | (excpt ? commit_record_t::EXCEPTION : 0) |
+            (wrenx ? commit_record_t::WRITE_X : 0) | (wrenf ? commit_record_t::WRITE_F : 0);
+  r.reserved = 0;
+  commit_trace.record(r);
+}
+
+extern "C" void commit_trace_late_write
+(
+  int       hartid,
+  int       timer,
+  char      wrdst,
+  long long wrdata
+)
+{
+  if (!commit_trace.enabled())
+    return;
+  commit_record_t r = {};
+  r.cycle = (uint64_t)sc_time_stamp();
+  r.wdata = wrdata;
+  r.timer = timer;
+  r.hartid = hartid;
+  r.rd = wrdst;
+  r.flags = commit_record_t::WRITE_X | commit_record_t::LATE_WRITE;
+  commit_trace.record(r);
+}
@@ -0,0 +1,131 @@
+// See LICENSE.SiFive for license details.
+
+#ifndef COMMIT_TRACE_H
+#define COMMIT_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Binary commit trace of the emulator, fed by vsrc/CommitTrace.v from the
+// core's CoreMonitorBundle. It replaces formatting the "C%d: ..." printf on
+// the simulation thread: a retire is a fixed size record appended to a
+// buffer owned by the calling thread, full buffers are handed to a writer
+// thread. Disassembly only happens when the trace is rendered with
+// commit_render.
+//
+// File layout: one commit_trace_header_t, then commit_record_t until EOF.
+// Records of one simulation thread are in order; with several threads
+// (verilator --threads) records are grouped per buffer, sort by cycle.
+
+struct commit_trace_header_t
+{
+  static const uint32_t MAGIC = 0x52544352; // "RCTR"
+  static const uint32_t VERSION = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t record_size;
+  uint32_t reserved;
+};
+
+struct commit_record_t
+{
+  enum flag_t : uint8_t {
+    VALID = 1,       // retired without exception
+    EXCEPTION = 2,
+    WRITE_X = 4,     // wdata is written to x[rd]
+    WRITE_F = 8,     // wdata is written to f[rd]
+    LATE_WRITE = 16  // long latency write back, only rd and wdata are set
+  };
+
+  uint64_t cycle;
+  uint64_t pc;
+  uint64_t wdata;
+  uint64_t rs1_val;
+  uint64_t rs2_val;
+  uint32_t inst;
+  uint32_t timer;
+  uint16_t hartid;
+  uint8_t priv;
+  uint8_t rd;
+  uint8_t rs1;
+  uint8_t rs2;
+  uint8_t flags;
+  uint8_t reserved;
+};
+
+class commit_trace_t
+{
+public:
+  // records per buffer, one buffer is one write()
+  static const size_t CHUNK_RECORDS = 4096;
+  // buffers allocated at most, the simulation waits for the writer beyond that
+  static const size_t MAX_CHUNKS = 64;
+
+  commit_trace_t() : file(NULL), stopping(false), allocated(0), written(0), retires(0) {}
+  ~commit_trace_t() { close(); }
+
+  bool open(const std::string& path);
+
+  // flush every thread's buffer, wait for the writer and close the file.
+  // The simulation must not record concurrently.
+  void close();
+
+  bool enabled() const { return file != NULL; }
+
+  void record(const commit_record_t& r)
+  {
+    chunk_t*& chunk = local_chunk();
+    if (!chunk)
+      chunk = acquire();
+    chunk->records[chunk->n++] = r;
+    if (chunk->n == CHUNK_RECORDS) {
+      submit(chunk);
+      chunk = NULL;
+    }
+  }
+
+  uint64_t records_written() const { return written; }
+
+  // insns retired without exception on the commit taps, traced or not
+  void count_retire() { retires.fetch_add(1, std::memory_order_relaxed); }
+  uint64_t retired() const { return retires.load(std::memory_order_relaxed); }
+
+private:
+  struct chunk_t
+  {
+    size_t n;
+    commit_record_t records[CHUNK_RECORDS];
+  };
+
+  chunk_t*& local_chunk();
+  chunk_t* acquire();
+  void submit(chunk_t* chunk);
+  void writer();
+
+  FILE* file;
+  std::thread writer_thread;
+  std::mutex lock;
+  std::condition_variable full_cv;
+  std::condition_variable free_cv;
+  std::deque<chunk_t*> full;
+  std::vector<chunk_t*> free_chunks;
+  // the buffer slot of every thread that recorded, flushed by close()
+  std::vector<chunk_t**> slots;
+  bool stopping;
+  size_t allocated;
+  uint64_t written;
+  std::atomic<uint64_t> retires;
+};
+
+extern commit_trace_t commit_trace;
+
+#endif
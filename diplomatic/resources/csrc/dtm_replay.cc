@@ -0,0 +1,18 @@
+// See LICENSE.SiFive for license details.
+
+#include "dtm_replay.h"
+
+#include <fesvr/dtm.h>
+
+dtm_replay_t dtm_replay;
+
+void dtm_replay_t::replay(dtm_t* dtm) const
+{
+  for (const dtm_tick_t& t : ticks) {
+    dtm_t::resp resp_bits;
+    resp_bits.resp = t.resp;
+    resp_bits.data = t.data;
+    for (uint32_t i = 0; i < t.repeat; i++)
+      dtm->tick(t.req_ready, t.resp_valid, resp_bits);
+  }
+}
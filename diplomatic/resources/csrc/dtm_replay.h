@@ -0,0 +1,66 @@
+// See LICENSE.SiFive for license details.
+
+#ifndef DTM_REPLAY_H
+#define DTM_REPLAY_H
+
+#include <stdint.h>
+
+#include <vector>
+
+class dtm_t;
+
+// The inputs debug_tick gave the dtm_t, run length encoded, for emulator
+// checkpoints. dtm_t serves the program from a host thread whose state
+// cannot be saved, but that state only changes through tick(): a checkpoint
+// carries these inputs and a restored emulator replays them into a fresh
+// dtm_t, which brings it to the state it had when the checkpoint was taken.
+// Host side effects of the program (console output, files written through
+// the proxy) happen again during the replay.
+
+struct dtm_tick_t
+{
+  uint32_t data;
+  uint32_t repeat;
+  uint8_t req_ready;
+  uint8_t resp_valid;
+  uint8_t resp;
+  uint8_t reserved;
+};
+
+class dtm_replay_t
+{
+public:
+  dtm_replay_t() : recording(false) {}
+
+  void start_recording() { recording = true; }
+
+  void record(bool req_ready, bool resp_valid, int resp, uint32_t data)
+  {
+    if (!recording)
+      return;
+    // dtm_t only reads the response while it is valid
+    dtm_tick_t t = {resp_valid ? data : 0, 1, req_ready, resp_valid, (uint8_t) (resp_valid ? resp : 0), 0};
+    if (!ticks.empty()) {
+      dtm_tick_t& last = ticks.back();
+      if (last.data == t.data && last.req_ready == t.req_ready && last.resp_valid == t.resp_valid &&
+          last.resp == t.resp && last.repeat != UINT32_MAX) {
+        last.repeat++;
+        return;
+      }
+    }
+    ticks.push_back(t);
+  }
+
+  // feed every recorded input to dtm, which must be freshly made with the
+  // arguments of the recorded run
+  void replay(dtm_t* dtm) const;
+
+  std::vector<dtm_tick_t> ticks;
+
+private:
+  bool recording;
+};
+
+extern dtm_replay_t dtm_replay;
+
+#endif
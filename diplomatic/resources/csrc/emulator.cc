@@ -6,15 +6,32 @@
 #include <memory>
 #include "verilated_vcd_c.h"
 #endif
+#if VM_SAVABLE
+#include "verilated_save.h"
+#include <glob.h>
+#endif
 #include <fesvr/dtm.h>
 #include "remote_bitbang.h"
+#include "sim_metrics.h"
+#include "commit_trace.h"
+#include "hpm_trace.h"
+#include "dtm_replay.h"
+#include "hang_watchdog.h"
+#include "rocc_dpi.h"
+#include <algorithm>
 #include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
 #include <fcntl.h>
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <getopt.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 
 // For option parsing, which is split across this file, Verilog, and
 // FESVR's HTIF, a few external files must be pulled in. The list of
@@ -37,10 +54,20 @@ extern remote_bitbang_t * jtag;
 static uint64_t trace_count = 0;
 bool verbose;
 bool done_reset;
+hang_watchdog_t hang_watchdog;
+#if VM_TRACE
+static VerilatedVcdC * vcd = NULL;
+static uint64_t start = 0;
+#endif
+#if VM_SAVABLE
+static uint64_t checkpoint_every = 0;
+static const char * checkpoint_prefix = "checkpoint";
+#endif
 
 void handle_sigterm(int sig)
 {
-  dtm->stop();
+  if (dtm)
+    dtm->stop();
 }
 
 double sc_time_stamp()
@@ -74,6 +101,30 @@ EMULATOR OPTIONS\n\
                            automatically.\n\
   -V, --verbose            Enable all Chisel printfs (cycle-by-cycle info)\n\
        +verbose\n\
+  -M, --metrics=FILE       Publish live counters in shared memory FILE\n\
+       +metrics=FILE       (e.g. /dev/shm/emu.0), read them with simtop; insns\n\
+                           are counted on a core built with commitTrace\n\
+  -T, --commit-trace=FILE  Write a binary commit trace to FILE, render it with\n\
+       +commit-trace=FILE  commit_render (needs a core built with commitTrace)\n\
+  -H, --hpm-trace=FILE     Sample all perf events into FILE, summarize it with\n\
+       +hpm-trace=FILE     hpm_report (needs a core built with hpmTrace)\n\
+  -I, --hpm-interval=CYCLES  Sample every CYCLES cycles (default 10000)\n\
+       +hpm-interval=CYCLES\n\
+  -W, --watchdog=CYCLES    Fail early when nothing retires for CYCLES cycles or\n\
+       +watchdog=CYCLES    a hart repeats CYCLES retires of a loop which\n\
+                           neither loads, stores nor accesses a csr (needs a\n\
+                           core built with commitTrace)\n\
+  -S, --server=SOCKET      Keep the model resident and run the tests requested\n\
+                           on the local socket SOCKET ('-' for stdin), see\n\
+                           SERVER MODE below; no BINARY is given\n\
+  -F, --fork=VARIANTS      At --fork-at, fork VARIANTS copies of the simulation\n\
+       +fork=VARIANTS      which continue with seeds SEED+1.. and summarize them\n\
+  -A, --fork-at=CYCLE      Cycle of the fork, the prefix is simulated once\n\
+       +fork-at=CYCLE\n\
+  -a, --rocc=MODEL[:KEY=VALUE,...]  Run the C++ RoCC model MODEL in the\n\
+       +rocc=MODEL[:KEY=VALUE,...]  DpiRoCCExample unit, KEY is one of\n\
+                           latency, interval, queue and outstanding\n\
+                           (see rocc_dpi.h)\n\
 ", stdout);
 #if VM_TRACE == 0
   fputs("\
@@ -85,6 +136,22 @@ EMULATOR DEBUG OPTIONS (only supported in debug build -- try `make debug`)\n",
   -v, --vcd=FILE,          Write vcd trace to FILE (or '-' for stdout)\n\
   -x, --dump-start=CYCLE   Start VCD tracing at CYCLE\n\
        +dump-start\n\
+", stdout);
+#if VM_SAVABLE == 0
+  fputs("\
+\n\
+EMULATOR CHECKPOINT OPTIONS (only supported in a savable build -- verilate\n\
+with --savable and compile with -DVM_SAVABLE=1)\n",
+        stdout);
+#endif
+  fputs("\
+  -C, --checkpoint-every=CYCLES  Save a checkpoint every CYCLES cycles\n\
+       +checkpoint-every=CYCLES\n\
+  -K, --checkpoint=PREFIX  Name the checkpoints PREFIX.CYCLE (default checkpoint)\n\
+       +checkpoint=PREFIX\n\
+  -R, --restore=FILE       Resume from checkpoint FILE instead of reset, or from\n\
+       +restore=FILE       the latest one at or before CYCLE for PREFIX@CYCLE;\n\
+                           give the arguments of the run which saved it\n\
 ", stdout);
   fputs("\n" PLUSARG_USAGE_OPTIONS, stdout);
   fputs("\n" HTIF_USAGE_OPTIONS, stdout);
@@ -98,13 +165,304 @@ EMULATOR DEBUG OPTIONS (only supported in debug build -- try `make debug`)\n",
 "  - run a bare metal test to generate a VCD waveform:\n"
 "    %s -v rv64ui-p-add.vcd $RISCV/riscv64-unknown-elf/share/riscv-tests/isa/rv64ui-p-add\n"
 #endif
+#if VM_SAVABLE
+"  - trace cycles 2000000000 on from the checkpoint of a long run taken before:\n"
+"    %s -R checkpoint@2000000000 -v late.vcd -x 2000000000 pk hello\n"
+#endif
 "  - run an ELF (you wrote, called 'hello') using the proxy kernel:\n"
-"    %s pk hello\n",
+"    %s pk hello\n"
+"\n"
+"SERVER MODE\n"
+"  Every request is one line of [+max-cycles=CYCLES] [PLUSARG]... BINARY [TARGET OPTION]...\n"
+"  which resets the model, loads BINARY through the debug module and runs it. One line\n"
+"  STATUS CODE CYCLES BINARY is answered per request, STATUS being PASSED, FAILED,\n"
+"  HUNG or TIMEOUT. The line quit stops the server. Plusargs the Verilog reads at elaboration keep\n"
+"  the values of the command line, and memory the BINARY does not load keeps the contents\n"
+"  the previous test left.\n"
+"  - run two tests on one model:\n"
+"    printf 'rv64ui-p-add\\nrv64ui-p-sub\\n' | %s --server=-\n",
          program_name, program_name, program_name
 #if VM_TRACE
          , program_name
 #endif
-         );
+#if VM_SAVABLE
+         , program_name
+#endif
+         , program_name);
+}
+
+#if VM_SAVABLE
+// A checkpoint holds the cycle, the drand48 state, the dtm_t inputs so far
+// (see dtm_replay.h) and the Verilated model, which includes the backing
+// memory of the harness.
+static void save_checkpoint(TEST_HARNESS *tile, uint64_t cycle)
+{
+  std::string path = std::string(checkpoint_prefix) + "." + std::to_string(cycle);
+  VerilatedSave os;
+  os.open(path.c_str());
+  if (!os.isOpen()) {
+    fprintf(stderr, "Unable to open %s for checkpoint, continuing without\n", path.c_str());
+    return;
+  }
+  // seed48 only reads the state by replacing it
+  unsigned short scratch[3] = {0, 0, 0}, rand48[3];
+  memcpy(rand48, seed48(scratch), sizeof(rand48));
+  seed48(rand48);
+  uint64_t n_ticks = dtm_replay.ticks.size();
+  os.write(&cycle, sizeof(cycle));
+  os.write(rand48, sizeof(rand48));
+  os.write(&n_ticks, sizeof(n_ticks));
+  os.write(dtm_replay.ticks.data(), n_ticks * sizeof(dtm_tick_t));
+  os << *tile;
+  os.close();
+  if (verbose)
+    fprintf(stderr, "checkpoint %s written\n", path.c_str());
+}
+
+// PREFIX@CYCLE names the latest checkpoint PREFIX.N with N <= CYCLE
+static std::string find_checkpoint(const char *arg)
+{
+  const char *at = strrchr(arg, '@');
+  if (!at)
+    return arg;
+  std::string prefix(arg, at - arg);
+  uint64_t target = strtoull(at + 1, NULL, 10), best = 0;
+  std::string found;
+  glob_t matches;
+  if (glob((prefix + ".*").c_str(), 0, NULL, &matches) == 0) {
+    for (size_t i = 0; i < matches.gl_pathc; i++) {
+      char *end;
+      uint64_t cycle = strtoull(matches.gl_pathv[i] + prefix.size() + 1, &end, 10);
+      if (*end == '\0' && cycle <= target && (found.empty() || cycle > best)) {
+        best = cycle;
+        found = matches.gl_pathv[i];
+      }
+    }
+    globfree(&matches);
+  }
+  return found;
+}
+
+// The model, the RNG and dtm, which must be freshly made, are brought to the
+// state of the checkpoint; returns its cycle
+static bool restore_checkpoint(TEST_HARNESS *tile, const std::string &path, uint64_t &cycle)
+{
+  VerilatedRestore os;
+  os.open(path.c_str());
+  if (!os.isOpen())
+    return false;
+  unsigned short rand48[3];
+  uint64_t n_ticks;
+  os.read(&cycle, sizeof(cycle));
+  os.read(rand48, sizeof(rand48));
+  os.read(&n_ticks, sizeof(n_ticks));
+  dtm_replay.ticks.resize(n_ticks);
+  os.read(dtm_replay.ticks.data(), n_ticks * sizeof(dtm_tick_t));
+  os >> *tile;
+  os.close();
+  seed48(rand48);
+  dtm_replay.replay(dtm);
+  return true;
+}
+#endif
+
+struct fork_result_t
+{
+  int variant;
+  unsigned seed;
+  int code;
+  uint64_t cycles;
+};
+
+// fork() the simulation into variants copy-on-write children, which return
+// their variant number and the pipe to write their fork_result_t to; the
+// parent returns -1 and the pipe to read the results from
+static int fork_variants(int variants, int *results_fd)
+{
+  int fds[2];
+  if (pipe(fds) < 0) {
+    perror("pipe");
+    exit(1);
+  }
+  // nothing buffered before the fork must be written by every child
+  fflush(stdout);
+  fflush(stderr);
+  for (int i = 0; i < variants; i++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(fds[0]);
+      *results_fd = fds[1];
+      return i;
+    }
+    if (pid < 0) {
+      perror("fork");
+      break;
+    }
+  }
+  close(fds[1]);
+  *results_fd = fds[0];
+  return -1;
+}
+
+// Collect the results of the children, a child which died without one counts
+// as failed. Returns the exit code of the first failing variant.
+static int summarize_variants(int variants, int results_fd, uint64_t fork_cycle)
+{
+  std::vector<fork_result_t> results;
+  fork_result_t r;
+  while (read(results_fd, &r, sizeof(r)) == sizeof(r))
+    results.push_back(r);
+  close(results_fd);
+  while (wait(NULL) > 0)
+    ;
+  int ret = 0, passed = 0;
+  fprintf(stderr, "*** FORKED *** %d variants at cycle %ld\n", variants, fork_cycle);
+  for (const fork_result_t &v : results) {
+    fprintf(stderr, "  variant %d (seed %u): %s (code = %d) after %lu cycles\n", v.variant, v.seed,
+            v.code ? "FAILED" : "PASSED", v.code, v.cycles);
+    if (v.code && !ret)
+      ret = v.code;
+    passed += !v.code;
+  }
+  if ((int) results.size() < variants && !ret)
+    ret = 1;
+  fprintf(stderr, "%d of %d variants passed, %d did not report\n", passed, variants,
+          variants - (int) results.size());
+  return ret;
+}
+
+// Run the tile from cycle, which is 0 for a reset, until the test finishes
+// or max_cycles elapse, returns the cycle it stopped at
+static uint64_t run(TEST_HARNESS *tile, uint64_t cycle, uint64_t max_cycles, sim_metrics_t &metrics)
+{
+#ifdef SIM_CLOCK_MODELS
+  // vsrc/sim/AsyncResetReg.v is reset by the level of the reset signal and
+  // the clock edges under it, the synchronous reset cycles reset it.
+  uint64_t async_reset_cycles = 0;
+#else
+  // The initial block in AsyncResetReg is either racy or is not handled
+  // correctly by Verilator when the reset signal isn't a top-level pin.
+  // So guarantee that all the AsyncResetRegs will see a rising edge of
+  // the reset signal instead of relying on the initial block.
+  uint64_t async_reset_cycles = 2;
+#endif
+
+  // Rocket-chip requires synchronous reset to be asserted for several cycles.
+  uint64_t sync_reset_cycles = 10;
+
+  done_reset = false;
+  hang_watchdog.restart(trace_count);
+  while (cycle < max_cycles) {
+    if (done_reset && (dtm->done() || jtag->done() || tile->io_success))
+      break;
+    if (hang_watchdog.enabled() && hang_watchdog.check(trace_count))
+      break;
+
+    tile->clock = 0;
+    tile->reset = cycle < async_reset_cycles*2 ? cycle % 2 :
+      cycle < async_reset_cycles*2 + sync_reset_cycles;
+    done_reset = !tile->reset;
+    tile->eval();
+#if VM_TRACE
+    bool dump = vcd && trace_count >= start;
+    if (dump)
+      vcd->dump(static_cast<vluint64_t>(trace_count * 2));
+#endif
+
+    tile->clock = cycle >= async_reset_cycles*2;
+    tile->eval();
+#if VM_TRACE
+    if (dump)
+      vcd->dump(static_cast<vluint64_t>(trace_count * 2 + 1));
+#endif
+    cycle++;
+    trace_count++;
+    metrics.set_cycle(trace_count);
+    metrics.set_insns(commit_trace.retired());
+#if VM_SAVABLE
+    if (checkpoint_every && cycle % checkpoint_every == 0)
+      save_checkpoint(tile, cycle);
+#endif
+  }
+  return cycle;
+}
+
+static bool is_htif_plusarg(const std::string &arg)
+{
+  static struct option htif_long_options [] = { HTIF_LONG_OPTIONS };
+  for (struct option * o = &htif_long_options[0]; o->name; o++) {
+    if (arg.substr(1, strlen(o->name)) == o->name)
+      return true;
+  }
+  return false;
+}
+
+// Serve the test requests read from in, one per line, answering on out.
+// The harness, the jtag socket and the trace files are set up once, a dtm_t
+// is made per test since it owns the loaded program.
+static int serve(TEST_HARNESS *tile, FILE *in, FILE *out, char *program_name,
+                 uint64_t default_max_cycles, sim_metrics_t &metrics)
+{
+  char line[4096];
+  while (fgets(line, sizeof(line), in)) {
+    std::istringstream tokens(line);
+    std::vector<std::string> args;
+    for (std::string token; tokens >> token;)
+      args.push_back(token);
+    if (args.empty())
+      continue;
+    if (args[0] == "quit")
+      return 1;
+
+    uint64_t max_cycles = default_max_cycles;
+    std::vector<char *> plusargs = { program_name };
+    std::vector<char *> htif_args = { program_name };
+    size_t i = 0;
+    for (; i < args.size() && args[i][0] == '+'; i++) {
+      if (args[i].substr(0, 12) == "+max-cycles=")
+        max_cycles = atoll(args[i].c_str() + 12);
+      else if (is_htif_plusarg(args[i]))
+        htif_args.push_back(&args[i][0]);
+      else
+        plusargs.push_back(&args[i][0]);
+    }
+    if (i == args.size()) {
+      fprintf(out, "FAILED 1 0 (no binary)\n");
+      fflush(out);
+      continue;
+    }
+    std::string binary = args[i];
+    for (; i < args.size(); i++)
+      htif_args.push_back(&args[i][0]);
+    htif_args.push_back(NULL);
+
+    Verilated::commandArgs(plusargs.size(), plusargs.data());
+    Verilated::gotFinish(false);
+    dtm = new dtm_t(htif_args.size() - 1, htif_args.data());
+    uint64_t cycles = run(tile, 0, max_cycles, metrics);
+
+    const char * status = "PASSED";
+    int code = 0;
+    if (dtm->exit_code()) {
+      status = "FAILED";
+      code = dtm->exit_code();
+    } else if (hang_watchdog.check(trace_count)) {
+      status = "HUNG";
+      code = 3;
+      if (verbose)
+        fprintf(stderr, "%s hung: %s\n", binary.c_str(), hang_watchdog.summary(trace_count).c_str());
+    } else if (cycles == max_cycles) {
+      status = "TIMEOUT";
+      code = 2;
+    }
+    if (verbose)
+      fprintf(stderr, "%s %s after %lu cycles\n", binary.c_str(), status, cycles);
+    fprintf(out, "%s %d %lu %s\n", status, code, cycles, binary.c_str());
+    fflush(out);
+    delete dtm;
+    dtm = NULL;
+  }
+  return 0;
 }
 
 int main(int argc, char** argv)
@@ -117,10 +475,23 @@ int main(int argc, char** argv)
   uint16_t rbb_port = 0;
 #if VM_TRACE
   FILE * vcdfile = NULL;
-  uint64_t start = 0;
 #endif
   char ** htif_argv = NULL;
   int verilog_plusargs_legal = 1;
+  const char * metrics_file = NULL;
+  const char * commit_trace_file = NULL;
+  const char * hpm_trace_file = NULL;
+  uint32_t hpm_interval = 10000;
+  const char * server_socket = NULL;
+  int fork_count = 0;
+  uint64_t fork_at = 0;
+  int fork_variant = -1;
+  int fork_fd = -1;
+  const char * rocc_spec = NULL;
+#if VM_SAVABLE
+  const char * restore = NULL;
+#endif
+  sim_metrics_t metrics;
 
   while (1) {
     static struct option long_options[] = {
@@ -130,17 +501,35 @@ int main(int argc, char** argv)
       {"seed",        required_argument, 0, 's' },
       {"rbb-port",    required_argument, 0, 'r' },
       {"verbose",     no_argument,       0, 'V' },
+      {"metrics",     required_argument, 0, 'M' },
+      {"commit-trace", required_argument, 0, 'T' },
+      {"hpm-trace",   required_argument, 0, 'H' },
+      {"hpm-interval", required_argument, 0, 'I' },
+      {"server",      required_argument, 0, 'S' },
+      {"watchdog",    required_argument, 0, 'W' },
+      {"fork",        required_argument, 0, 'F' },
+      {"fork-at",     required_argument, 0, 'A' },
+      {"rocc",        required_argument, 0, 'a' },
 #if VM_TRACE
       {"vcd",         required_argument, 0, 'v' },
       {"dump-start",  required_argument, 0, 'x' },
+#endif
+#if VM_SAVABLE
+      {"checkpoint-every", required_argument, 0, 'C' },
+      {"checkpoint",  required_argument, 0, 'K' },
+      {"restore",     required_argument, 0, 'R' },
 #endif
       HTIF_LONG_OPTIONS
     };
     int option_index = 0;
-#if VM_TRACE
-    int c = getopt_long(argc, argv, "-chm:s:r:v:Vx:", long_options, &option_index);
+#if VM_TRACE && VM_SAVABLE
+    int c = getopt_long(argc, argv, "-chm:s:r:v:VM:T:H:I:S:F:A:a:W:x:C:K:R:", long_options, &option_index);
+#elif VM_TRACE
+    int c = getopt_long(argc, argv, "-chm:s:r:v:VM:T:H:I:S:F:A:a:W:x:", long_options, &option_index);
+#elif VM_SAVABLE
+    int c = getopt_long(argc, argv, "-chm:s:r:VM:T:H:I:S:F:A:a:W:C:K:R:", long_options, &option_index);
 #else
-    int c = getopt_long(argc, argv, "-chm:s:r:V", long_options, &option_index);
+    int c = getopt_long(argc, argv, "-chm:s:r:VM:T:H:I:S:F:A:a:W:", long_options, &option_index);
 #endif
     if (c == -1) break;
  retry:
@@ -153,6 +542,15 @@ int main(int argc, char** argv)
       case 's': random_seed = atoi(optarg); break;
       case 'r': rbb_port = atoi(optarg);    break;
       case 'V': verbose = true;             break;
+      case 'M': metrics_file = optarg;      break;
+      case 'T': commit_trace_file = optarg; break;
+      case 'H': hpm_trace_file = optarg;    break;
+      case 'I': hpm_interval = atol(optarg); break;
+      case 'S': server_socket = optarg;     break;
+      case 'W': hang_watchdog.configure(atoll(optarg)); break;
+      case 'F': fork_count = atoi(optarg);  break;
+      case 'A': fork_at = atoll(optarg);    break;
+      case 'a': rocc_spec = optarg;         break;
 #if VM_TRACE
       case 'v': {
         vcdfile = strcmp(optarg, "-") == 0 ? stdout : fopen(optarg, "w");
@@ -163,6 +561,11 @@ int main(int argc, char** argv)
         break;
       }
       case 'x': start = atoll(optarg);      break;
+#endif
+#if VM_SAVABLE
+      case 'C': checkpoint_every = atoll(optarg); break;
+      case 'K': checkpoint_prefix = optarg; break;
+      case 'R': restore = optarg;           break;
 #endif
       // Process legacy '+' EMULATOR arguments by replacing them with
       // their getopt equivalents
@@ -178,11 +581,57 @@ int main(int argc, char** argv)
           c = 'm';
           optarg = optarg+12;
         }
+        else if (arg.substr(0, 9) == "+metrics=") {
+          c = 'M';
+          optarg = optarg+9;
+        }
+        else if (arg.substr(0, 14) == "+commit-trace=") {
+          c = 'T';
+          optarg = optarg+14;
+        }
+        else if (arg.substr(0, 11) == "+hpm-trace=") {
+          c = 'H';
+          optarg = optarg+11;
+        }
+        else if (arg.substr(0, 14) == "+hpm-interval=") {
+          c = 'I';
+          optarg = optarg+14;
+        }
+        else if (arg.substr(0, 10) == "+watchdog=") {
+          c = 'W';
+          optarg = optarg+10;
+        }
+        else if (arg.substr(0, 6) == "+fork=") {
+          c = 'F';
+          optarg = optarg+6;
+        }
+        else if (arg.substr(0, 9) == "+fork-at=") {
+          c = 'A';
+          optarg = optarg+9;
+        }
+        else if (arg.substr(0, 6) == "+rocc=") {
+          c = 'a';
+          optarg = optarg+6;
+        }
 #if VM_TRACE
         else if (arg.substr(0, 12) == "+dump-start=") {
           c = 'x';
           optarg = optarg+12;
         }
+#endif
+#if VM_SAVABLE
+        else if (arg.substr(0, 18) == "+checkpoint-every=") {
+          c = 'C';
+          optarg = optarg+18;
+        }
+        else if (arg.substr(0, 12) == "+checkpoint=") {
+          c = 'K';
+          optarg = optarg+12;
+        }
+        else if (arg.substr(0, 9) == "+restore=") {
+          c = 'R';
+          optarg = optarg+9;
+        }
 #endif
         else if (arg.substr(0, 12) == "+cycle-count")
           c = 'c';
@@ -236,7 +685,7 @@ int main(int argc, char** argv)
   }
 
 done_processing:
-  if (optind == argc) {
+  if (optind == argc && !server_socket) {
     std::cerr << "No binary specified for emulator\n";
     usage(argv[0]);
     return 1;
@@ -248,6 +697,32 @@ done_processing:
 
   if (verbose)
     fprintf(stderr, "using random seed %u\n", random_seed);
+  if (server_socket && htif_argc > 1) {
+    std::cerr << "No binary is given in server mode, send it as a request\n";
+    return 1;
+  }
+  if (fork_count > 0) {
+    bool single_writer = metrics_file || commit_trace_file || hpm_trace_file;
+#if VM_TRACE
+    single_writer |= vcdfile != NULL;
+#endif
+#if VM_SAVABLE
+    // every variant would save the same PREFIX.CYCLE checkpoints
+    single_writer |= checkpoint_every != 0;
+#endif
+    if (server_socket || single_writer || fork_at == 0) {
+      std::cerr << "--fork needs --fork-at and no server, metrics, trace, vcd or checkpoint output\n";
+      return 1;
+    }
+  }
+#if VM_SAVABLE
+  if (server_socket && (checkpoint_every || restore)) {
+    std::cerr << "Checkpoints are not supported in server mode\n";
+    return 1;
+  }
+  if (checkpoint_every)
+    dtm_replay.start_recording();
+#endif
 
   srand(random_seed);
   srand48(random_seed);
@@ -263,47 +738,93 @@ done_processing:
   if (vcdfile) {
     tile->trace(tfp.get(), 99);  // Trace 99 levels of hierarchy
     tfp->open("");
+    vcd = tfp.get();
   }
 #endif
 
   jtag = new remote_bitbang_t(rbb_port);
-  dtm = new dtm_t(htif_argc, htif_argv);
+  if (!server_socket)
+    dtm = new dtm_t(htif_argc, htif_argv);
 
   signal(SIGTERM, handle_sigterm);
 
-  // The initial block in AsyncResetReg is either racy or is not handled
-  // correctly by Verilator when the reset signal isn't a top-level pin.
-  // So guarantee that all the AsyncResetRegs will see a rising edge of
-  // the reset signal instead of relying on the initial block.
-  int async_reset_cycles = 2;
+  if (metrics_file && !metrics.open(metrics_file, "emulator"))
+    fprintf(stderr, "Unable to open %s for metrics, continuing without\n", metrics_file);
 
-  // Rocket-chip requires synchronous reset to be asserted for several cycles.
-  int sync_reset_cycles = 10;
+  if (commit_trace_file && !commit_trace.open(commit_trace_file)) {
+    std::cerr << "Unable to open " << commit_trace_file << " for commit trace\n";
+    return 1;
+  }
 
-  while (trace_count < max_cycles) {
-    if (done_reset && (dtm->done() || jtag->done() || tile->io_success))
-      break;
+  if (hpm_trace_file && !hpm_trace.open(hpm_trace_file, hpm_interval)) {
+    std::cerr << "Unable to open " << hpm_trace_file << " for HPM trace\n";
+    return 1;
+  }
 
-    tile->clock = 0;
-    tile->reset = trace_count < async_reset_cycles*2 ? trace_count % 2 :
-      trace_count < async_reset_cycles*2 + sync_reset_cycles;
-    done_reset = !tile->reset;
-    tile->eval();
-#if VM_TRACE
-    bool dump = tfp && trace_count >= start;
-    if (dump)
-      tfp->dump(static_cast<vluint64_t>(trace_count * 2));
-#endif
+  if (rocc_spec && !rocc_bridges.configure(rocc_spec))
+    return 1;
 
-    tile->clock = trace_count >= async_reset_cycles*2;
-    tile->eval();
-#if VM_TRACE
-    if (dump)
-      tfp->dump(static_cast<vluint64_t>(trace_count * 2 + 1));
+  if (server_socket) {
+    if (strcmp(server_socket, "-") == 0) {
+      serve(tile, stdin, stdout, argv[0], max_cycles, metrics);
+    } else {
+      int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+      struct sockaddr_un addr = {};
+      addr.sun_family = AF_UNIX;
+      strncpy(addr.sun_path, server_socket, sizeof(addr.sun_path) - 1);
+      unlink(server_socket);
+      if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 || listen(fd, 1) < 0) {
+        std::cerr << "Unable to listen on " << server_socket << "\n";
+        return 1;
+      }
+      // one client at a time, until one of them sends quit
+      int quit = 0;
+      while (!quit) {
+        int client = accept(fd, NULL, NULL);
+        if (client < 0)
+          break;
+        FILE *in = fdopen(client, "r");
+        FILE *out = fdopen(dup(client), "w");
+        quit = serve(tile, in, out, argv[0], max_cycles, metrics);
+        fclose(in);
+        fclose(out);
+      }
+      close(fd);
+      unlink(server_socket);
+    }
+  } else {
+#if VM_SAVABLE
+    if (restore) {
+      std::string path = find_checkpoint(restore);
+      if (path.empty() || !restore_checkpoint(tile, path, trace_count)) {
+        std::cerr << "Unable to restore checkpoint " << restore << "\n";
+        return 1;
+      }
+      if (verbose)
+        fprintf(stderr, "restored %s at cycle %ld\n", path.c_str(), trace_count);
+    }
 #endif
-    trace_count++;
+    if (fork_count > 0) {
+      trace_count = run(tile, trace_count, std::min(fork_at, max_cycles), metrics);
+      // a test which finished before the fork is reported as it is
+      bool running = trace_count == fork_at && !dtm->done() && !jtag->done() && !tile->io_success;
+      if (running) {
+        fork_variant = fork_variants(fork_count, &fork_fd);
+        if (fork_variant >= 0) {
+          random_seed += fork_variant + 1;
+          srand(random_seed);
+          srand48(random_seed);
+          Verilated::randSeed(random_seed);
+        }
+      }
+    }
+    if (fork_fd < 0 || fork_variant >= 0)
+      trace_count = run(tile, trace_count, max_cycles, metrics);
   }
 
+  // final blocks flush what the taps counted since their last sample
+  tile->final();
+
 #if VM_TRACE
   if (tfp)
     tfp->close();
@@ -311,7 +832,16 @@ done_processing:
     fclose(vcdfile);
 #endif
 
-  if (dtm->exit_code())
+  if (server_socket)
+  {
+    if (verbose || print_cycles)
+      fprintf(stderr, "*** SERVED *** Stopped after %ld cycles\n", trace_count);
+  }
+  else if (fork_fd >= 0 && fork_variant < 0)
+  {
+    ret = summarize_variants(fork_count, fork_fd, trace_count);
+  }
+  else if (dtm->exit_code())
   {
     fprintf(stderr, "*** FAILED *** via dtm (code = %d, seed %d) after %ld cycles\n", dtm->exit_code(), random_seed, trace_count);
     ret = dtm->exit_code();
@@ -321,6 +851,12 @@ done_processing:
     fprintf(stderr, "*** FAILED *** via jtag (code = %d, seed %d) after %ld cycles\n", jtag->exit_code(), random_seed, trace_count);
     ret = jtag->exit_code();
   }
+  else if (hang_watchdog.check(trace_count))
+  {
+    fprintf(stderr, "*** FAILED *** via watchdog (%s, seed %d)\n", hang_watchdog.summary(trace_count).c_str(),
+            random_seed);
+    ret = 3;
+  }
   else if (trace_count == max_cycles)
   {
     fprintf(stderr, "*** FAILED *** via trace_count (timeout, seed %d) after %ld cycles\n", random_seed, trace_count);
@@ -331,6 +867,27 @@ done_processing:
     fprintf(stderr, "*** PASSED *** Completed after %ld cycles\n", trace_count);
   }
 
+  if (fork_variant >= 0) {
+    fork_result_t result = {fork_variant, random_seed, ret, trace_count};
+    if (write(fork_fd, &result, sizeof(result)) != sizeof(result))
+      perror("write");
+    close(fork_fd);
+  }
+
+  if (commit_trace.enabled()) {
+    commit_trace.close();
+    if (verbose || print_cycles)
+      fprintf(stderr, "%lu records written to commit trace %s\n", commit_trace.records_written(), commit_trace_file);
+  }
+
+  hpm_trace.close();
+
+  if (rocc_spec)
+    rocc_bridges.report(stderr);
+
+  metrics.set_status(ret ? sim_metrics_page_t::FAILED : sim_metrics_page_t::PASSED);
+  metrics.close();
+
   if (dtm) delete dtm;
   if (jtag) delete jtag;
   if (tile) delete tile;
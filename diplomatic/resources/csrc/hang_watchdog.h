@@ -0,0 +1,224 @@
+// See LICENSE.SiFive for license details.
+
+#ifndef HANG_WATCHDOG_H
+#define HANG_WATCHDOG_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+// Early termination of hung tests, shared by the emulator and the cosim,
+// instead of running them into the global cycle limit. A test is hung when
+//   - no hart committed for limit cycles since the last commit,
+//   - a hart committed limit insns twice in a row from the same set of pcs
+//     within SPIN_BYTES of code, and none of them could see or change the
+//     outside: no load, store, amo, csr access or wfi. Loops polling mtime,
+//     an mmio register or a flag in memory, and wfi waits for an interrupt,
+//     are not spins,
+//   - TileLink requests were outstanding for limit cycles without a
+//     response beat. Only harnesses reporting their requests through tl()
+//     check this, the cosim does, the emulator has no TileLink taps.
+// The commit check is armed by the first commit, a harness without commit
+// taps never trips it. A limit of 0 disables the watchdog.
+//
+// Every hart keeps its own spin state behind its own lock, the harts of a
+// multithreaded model commit from different threads.
+
+class hang_watchdog_t
+{
+public:
+  static const uint64_t SPIN_BYTES = 256;
+  // harts from MAX_HARTS on only count for the commit check
+  static const int MAX_HARTS = 64;
+
+  hang_watchdog_t() : limit(0) { restart(0); }
+
+  void configure(uint64_t cycles) { limit = cycles; }
+  bool enabled() const { return limit != 0; }
+
+  // forget the progress so far, a new test starts at cycle
+  void restart(uint64_t cycle)
+  {
+    commits = 0;
+    last_commit_cycle = cycle;
+    last_commit_hart = 0;
+    spinning = -1;
+    for (int i = 0; i < MAX_HARTS; i++) {
+      std::lock_guard<std::mutex> guard(harts[i].lock);
+      harts[i].reset();
+    }
+    tl_outstanding = 0;
+    last_tl_progress = cycle;
+  }
+
+  void commit(int hartid, uint64_t cycle, uint64_t pc, uint32_t inst)
+  {
+    commits.fetch_add(1, std::memory_order_relaxed);
+    last_commit_cycle.store(cycle, std::memory_order_relaxed);
+    last_commit_hart.store(hartid, std::memory_order_relaxed);
+    if (hartid < 0 || hartid >= MAX_HARTS)
+      return;
+    hart_t &h = harts[hartid];
+    std::lock_guard<std::mutex> guard(h.lock);
+    h.last_pc = pc;
+    if (h.window_commits == 0) {
+      h.window_first = pc;
+      h.window_lo = h.window_hi = pc;
+      h.window_outside = false;
+      memset(h.window_pcs, 0, sizeof(h.window_pcs));
+    }
+    if (pc < h.window_lo) h.window_lo = pc;
+    if (pc > h.window_hi) h.window_hi = pc;
+    // the pcs of a spin stay within SPIN_BYTES of the first one
+    uint64_t slot = (pc - h.window_first + SPIN_BYTES) / 2;
+    if (slot < 2 * SPIN_BYTES / 2)
+      h.window_pcs[slot / 64] |= 1ull << (slot % 64);
+    else
+      h.window_outside = true;
+    h.window_outside |= touches_outside(inst);
+    if (++h.window_commits == limit)
+      h.end_window(hartid, spinning);
+  }
+
+  // TileLink requests outstanding after cycle, responded if a response beat
+  // was sent in it
+  void tl(uint64_t cycle, uint64_t outstanding, bool responded)
+  {
+    if (responded || !outstanding)
+      last_tl_progress = cycle;
+    tl_outstanding = outstanding;
+  }
+
+  // why the test is hung at cycle, NULL while it makes progress
+  const char* check(uint64_t cycle) const
+  {
+    if (!limit)
+      return NULL;
+    if (commits.load(std::memory_order_relaxed) && cycle - last_commit_cycle.load(std::memory_order_relaxed) > limit)
+      return "no commit";
+    if (spinning.load(std::memory_order_acquire) >= 0)
+      return "spin loop";
+    if (tl_outstanding && cycle - last_tl_progress > limit)
+      return "TileLink request without response";
+    return NULL;
+  }
+
+  std::string summary(uint64_t cycle)
+  {
+    const char *why = check(cycle);
+    int last_hart = last_commit_hart.load(std::memory_order_relaxed);
+    uint64_t last_pc = 0;
+    if (last_hart >= 0 && last_hart < MAX_HARTS) {
+      std::lock_guard<std::mutex> guard(harts[last_hart].lock);
+      last_pc = harts[last_hart].last_pc;
+    }
+    char buf[512];
+    int n = snprintf(buf, sizeof(buf), "%s at cycle %lu: %lu commits, the last at cycle %lu on hart %d pc 0x%lx",
+                     why ? why : "no hang", (unsigned long) cycle, (unsigned long) commits.load(),
+                     (unsigned long) last_commit_cycle.load(), last_hart, (unsigned long) last_pc);
+    int spinner = spinning.load(std::memory_order_acquire);
+    if (spinner >= 0 && n < (int) sizeof(buf)) {
+      std::lock_guard<std::mutex> guard(harts[spinner].lock);
+      n += snprintf(buf + n, sizeof(buf) - n, ", hart %d repeated %lu commits within pc 0x%lx-0x%lx without touching "
+                    "memory or csrs", spinner, (unsigned long) limit, (unsigned long) harts[spinner].spin_lo,
+                    (unsigned long) harts[spinner].spin_hi);
+    }
+    if (tl_outstanding && n < (int) sizeof(buf))
+      snprintf(buf + n, sizeof(buf) - n, ", %lu TileLink requests outstanding, the last response at cycle %lu",
+               (unsigned long) tl_outstanding, (unsigned long) last_tl_progress);
+    return buf;
+  }
+
+  // a store, fp store or amo, the insns which can write tohost
+  static bool is_store(uint32_t inst)
+  {
+    uint32_t opcode = inst & 0x7f;
+    return (inst & 3) == 3 ? opcode == 0x23 || opcode == 0x27 || opcode == 0x2f
+                           : (inst & 0xe003) == 0xc000 || (inst & 0xe003) == 0xe000 || (inst & 0xe003) == 0xa000 ||
+                             (inst & 0xe003) == 0xc002 || (inst & 0xe003) == 0xe002 || (inst & 0xe003) == 0xa002;
+  }
+
+  // a store or amo, a load or fp load, a csr access or wfi: the insns through
+  // which a loop can see or change anything outside the hart's registers
+  static bool touches_outside(uint32_t inst)
+  {
+    if (is_store(inst))
+      return true;
+    if ((inst & 3) != 3)
+      return (inst & 0xe003) == 0x4000 || (inst & 0xe003) == 0x6000 || (inst & 0xe003) == 0x2000 ||
+             (inst & 0xe003) == 0x4002 || (inst & 0xe003) == 0x6002 || (inst & 0xe003) == 0x2002;
+    uint32_t opcode = inst & 0x7f;
+    return opcode == 0x03 || opcode == 0x07 ||
+           (opcode == 0x73 && ((inst >> 12) & 7) != 0) || inst == 0x10500073;
+  }
+
+private:
+  struct hart_t
+  {
+    std::mutex lock;
+    uint64_t last_pc;
+    uint64_t window_commits;
+    uint64_t window_first;
+    uint64_t window_lo;
+    uint64_t window_hi;
+    bool window_outside;
+    // the pcs of the window, in halfwords from window_first - SPIN_BYTES
+    uint64_t window_pcs[2 * SPIN_BYTES / 2 / 64];
+    // the pcs of the last window without an outside access, in halfwords
+    // from prev_lo, valid if prev_lo != 0
+    uint64_t prev_lo;
+    uint64_t prev_pcs[SPIN_BYTES / 2 / 64];
+    uint64_t spin_lo;
+    uint64_t spin_hi;
+
+    void reset()
+    {
+      last_pc = 0;
+      window_commits = 0;
+      prev_lo = 0;
+    }
+
+    // a spin if the window repeats the pcs of the one before, exactly
+    void end_window(int hartid, std::atomic<int> &spinning)
+    {
+      window_commits = 0;
+      if (window_outside || window_hi - window_lo >= SPIN_BYTES) {
+        prev_lo = 0;
+        return;
+      }
+      uint64_t pcs[SPIN_BYTES / 2 / 64] = {};
+      for (uint64_t slot = 0; slot < 2 * SPIN_BYTES / 2; slot++) {
+        if (window_pcs[slot / 64] & (1ull << (slot % 64))) {
+          uint64_t at = (window_first - SPIN_BYTES + 2 * slot - window_lo) / 2;
+          pcs[at / 64] |= 1ull << (at % 64);
+        }
+      }
+      if (prev_lo == window_lo && !memcmp(prev_pcs, pcs, sizeof(pcs))) {
+        spin_lo = window_lo;
+        spin_hi = window_hi;
+        int none = -1;
+        spinning.compare_exchange_strong(none, hartid, std::memory_order_release);
+      }
+      prev_lo = window_lo;
+      memcpy(prev_pcs, pcs, sizeof(pcs));
+    }
+  };
+
+  uint64_t limit;
+  std::atomic<uint64_t> commits;
+  std::atomic<uint64_t> last_commit_cycle;
+  std::atomic<int> last_commit_hart;
+  // the first hart found spinning, -1 while none is
+  std::atomic<int> spinning;
+  hart_t harts[MAX_HARTS];
+  uint64_t tl_outstanding;
+  uint64_t last_tl_progress;
+};
+
+extern hang_watchdog_t hang_watchdog;
+
+#endif
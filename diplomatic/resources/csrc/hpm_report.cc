@@ -0,0 +1,169 @@
+// See LICENSE.SiFive for license details.
+
+// Turn an HPM trace written by the emulator (--hpm-trace) into per interval
+// IPC, miss rates and a stall breakdown, as CSV on stdout:
+//
+//   cycle,hart,cycles,insns,ipc,<set 1 event> %cycles...,<set 2 event> mpki...,D$ miss %mem
+//
+// Set 0 events are the retired instruction classes, their sum (without
+// "exception") is the instruction count. Set 1 events are stall causes,
+// reported as a share of the cycles; set 2 events are misses, reported per
+// thousand instructions.
+//
+// Usage: hpm_report [-m SAMPLES] [--hart=ID] [--summary] TRACE
+//   -m SAMPLES   merge SAMPLES consecutive samples of a hart into one interval
+//   --summary    only print the totals of every hart
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "hpm_trace.h"
+
+struct interval_t
+{
+  uint64_t cycle = 0;
+  uint64_t cycles = 0;
+  uint32_t samples = 0;
+  std::vector<uint64_t> counts;
+};
+
+static std::vector<hpm_event_desc_t> events;
+
+static int find_event(const char* name)
+{
+  for (size_t i = 0; i < events.size(); i++)
+    if (strcmp(events[i].name, name) == 0)
+      return i;
+  return -1;
+}
+
+static void usage(const char* program_name)
+{
+  fprintf(stderr, "Usage: %s [-m SAMPLES] [--hart=ID] [--summary] TRACE\n", program_name);
+}
+
+static void print_header()
+{
+  printf("cycle,hart,cycles,insns,ipc");
+  for (auto& e : events)
+    if (e.set == 1)
+      printf(",%s %%cycles", e.name);
+  for (auto& e : events)
+    if (e.set == 2)
+      printf(",%s mpki", e.name);
+  printf(",D$ miss %%mem\n");
+}
+
+static void print_interval(uint32_t hart, const interval_t& iv)
+{
+  static const int exception = find_event("exception");
+  static const int dcache_miss = find_event("D$ miss");
+  static const int mem_ops[] = {find_event("load"), find_event("store"), find_event("amo")};
+
+  uint64_t insns = 0;
+  for (size_t i = 0; i < events.size(); i++)
+    if (events[i].set == 0 && (int)i != exception)
+      insns += iv.counts[i];
+  uint64_t mem = 0;
+  for (int i : mem_ops)
+    if (i >= 0)
+      mem += iv.counts[i];
+
+  printf("%llu,%u,%llu,%llu,%.4f", (unsigned long long)iv.cycle, hart, (unsigned long long)iv.cycles,
+         (unsigned long long)insns, iv.cycles ? (double)insns / iv.cycles : 0.0);
+  for (size_t i = 0; i < events.size(); i++)
+    if (events[i].set == 1)
+      printf(",%.2f", iv.cycles ? 100.0 * iv.counts[i] / iv.cycles : 0.0);
+  for (size_t i = 0; i < events.size(); i++)
+    if (events[i].set == 2)
+      printf(",%.3f", insns ? 1000.0 * iv.counts[i] / insns : 0.0);
+  printf(",%.2f\n", dcache_miss >= 0 && mem ? 100.0 * iv.counts[dcache_miss] / mem : 0.0);
+}
+
+static void accumulate(interval_t& into, const hpm_sample_t& s, const std::vector<uint32_t>& counts)
+{
+  into.cycle = s.cycle;
+  into.cycles += s.cycles;
+  into.samples++;
+  into.counts.resize(counts.size());
+  for (size_t i = 0; i < counts.size(); i++)
+    into.counts[i] += counts[i];
+}
+
+int main(int argc, char** argv)
+{
+  uint32_t merge = 1;
+  long hart = -1;
+  bool summary = false;
+  const char* path = NULL;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-m") == 0 && i + 1 < argc)
+      merge = atoi(argv[++i]);
+    else if (strncmp(argv[i], "--hart=", 7) == 0)
+      hart = atol(argv[i] + 7);
+    else if (strcmp(argv[i], "--summary") == 0)
+      summary = true;
+    else if (argv[i][0] == '-') {
+      usage(argv[0]);
+      return strcmp(argv[i], "-h") == 0 || strcmp(argv[i], "--help") == 0 ? 0 : 1;
+    } else
+      path = argv[i];
+  }
+  if (!path || merge == 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  FILE* f = fopen(path, "rb");
+  if (!f) {
+    fprintf(stderr, "Unable to open %s\n", path);
+    return 1;
+  }
+  hpm_trace_header_t header;
+  if (fread(&header, sizeof(header), 1, f) != 1 || header.magic != hpm_trace_header_t::MAGIC ||
+      header.version != hpm_trace_header_t::VERSION || header.n_events > hpm_trace_t::MAX_EVENTS) {
+    fprintf(stderr, "%s is not an HPM trace of this version\n", path);
+    return 1;
+  }
+  events.resize(header.n_events);
+  if (fread(events.data(), sizeof(hpm_event_desc_t), events.size(), f) != events.size()) {
+    fprintf(stderr, "%s is truncated\n", path);
+    return 1;
+  }
+
+  if (!summary)
+    print_header();
+  std::map<uint32_t, interval_t> open_intervals, totals;
+  hpm_sample_t s;
+  std::vector<uint32_t> counts(events.size());
+  while (fread(&s, sizeof(s), 1, f) == 1 && fread(counts.data(), sizeof(uint32_t), counts.size(), f) == counts.size()) {
+    if (hart >= 0 && s.hartid != hart)
+      continue;
+    accumulate(totals[s.hartid], s, counts);
+    if (summary)
+      continue;
+    interval_t& iv = open_intervals[s.hartid];
+    accumulate(iv, s, counts);
+    if (iv.samples == merge) {
+      print_interval(s.hartid, iv);
+      iv = interval_t();
+    }
+  }
+  fclose(f);
+  if (!summary) {
+    for (auto& it : open_intervals)
+      if (it.second.samples)
+        print_interval(it.first, it.second);
+    return 0;
+  }
+
+  print_header();
+  for (auto& it : totals)
+    print_interval(it.first, it.second);
+  return 0;
+}
@@ -0,0 +1,95 @@
+// See LICENSE.SiFive for license details.
+
+#include "hpm_trace.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <svdpi.h>
+
+hpm_trace_t hpm_trace;
+
+// defined by the emulator main loop
+extern double sc_time_stamp();
+
+bool hpm_trace_t::open(const std::string& path, uint32_t interval)
+{
+  file = fopen(path.c_str(), "wb");
+  if (!file)
+    return false;
+  this->interval = interval;
+  header_written = false;
+  events.clear();
+  return true;
+}
+
+void hpm_trace_t::close()
+{
+  if (!file)
+    return;
+  // a core without taps still leaves a valid, empty trace
+  if (!header_written)
+    write_header();
+  fclose(file);
+  file = NULL;
+}
+
+void hpm_trace_t::write_header()
+{
+  hpm_trace_header_t header = {hpm_trace_header_t::MAGIC, hpm_trace_header_t::VERSION, (uint32_t)events.size(),
+                               interval};
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(events.data(), sizeof(hpm_event_desc_t), events.size(), file);
+  header_written = true;
+}
+
+uint32_t hpm_trace_t::init(uint32_t hartid, uint32_t n_events, const char* names)
+{
+  if (!file || interval == 0)
+    return 0;
+  if (header_written) {
+    if (n_events != events.size()) {
+      fprintf(stderr, "hpm trace: hart %u has %u events, expected %zu; not sampled\n", hartid, n_events,
+              events.size());
+      return 0;
+    }
+    return interval;
+  }
+
+  // names is "set:name,set:name,..."
+  const char* p = names;
+  for (uint32_t i = 0; i < n_events && i < MAX_EVENTS; i++) {
+    hpm_event_desc_t desc;
+    memset(&desc, 0, sizeof(desc));
+    char* end;
+    desc.set = strtoul(p, &end, 10);
+    p = *end == ':' ? end + 1 : end;
+    size_t len = strcspn(p, ",");
+    memcpy(desc.name, p, len < sizeof(desc.name) - 1 ? len : sizeof(desc.name) - 1);
+    events.push_back(desc);
+    p += len;
+    if (*p == ',')
+      p++;
+  }
+  write_header();
+  return interval;
+}
+
+void hpm_trace_t::sample(uint32_t hartid, uint32_t cycles, const uint32_t* counts)
+{
+  if (!file || !header_written)
+    return;
+  hpm_sample_t s = {(uint64_t)sc_time_stamp(), hartid, cycles};
+  fwrite(&s, sizeof(s), 1, file);
+  fwrite(counts, sizeof(uint32_t), events.size(), file);
+}
+
+extern "C" int hpm_trace_init(int hartid, int n_events, const char* events)
+{
+  return hpm_trace.init(hartid, n_events, events);
+}
+
+extern "C" void hpm_trace_sample(int hartid, int cycles, const svBitVecVal* counts)
+{
+  // svBitVecVal is 32 bits, so counts[i] is the count of event i
+  hpm_trace.sample(hartid, cycles, counts);
+}
@@ -0,0 +1,72 @@
+// See LICENSE.SiFive for license details.
+
+#ifndef HPM_TRACE_H
+#define HPM_TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <string>
+#include <vector>
+
+// Time series of the core's performance events, fed by vsrc/HpmTap.v which
+// counts every event of the core's EventSets in simulation and hands the
+// counts over every interval. Summarize it with hpm_report.
+//
+// File layout: hpm_trace_header_t, n_events hpm_event_desc_t, then one
+// hpm_sample_t followed by n_events uint32_t counts per sample until EOF.
+
+struct hpm_trace_header_t
+{
+  static const uint32_t MAGIC = 0x4d504852; // "RHPM"
+  static const uint32_t VERSION = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t n_events;
+  uint32_t interval;
+};
+
+struct hpm_event_desc_t
+{
+  uint32_t set;     // index of the EventSet, set 0 holds the retired instruction classes
+  char name[60];
+};
+
+struct hpm_sample_t
+{
+  uint64_t cycle;   // emulator cycle at the end of the sample
+  uint32_t hartid;
+  uint32_t cycles;  // core clock cycles covered by the sample
+};
+
+class hpm_trace_t
+{
+public:
+  static const uint32_t MAX_EVENTS = 64;
+
+  hpm_trace_t() : file(NULL), interval(0), header_written(false) {}
+  ~hpm_trace_t() { close(); }
+
+  bool open(const std::string& path, uint32_t interval);
+  void close();
+  bool enabled() const { return file != NULL; }
+
+  // a tap registers its events, every hart must report the same ones.
+  // Returns the sample interval, 0 to leave the tap idle.
+  uint32_t init(uint32_t hartid, uint32_t n_events, const char* events);
+
+  void sample(uint32_t hartid, uint32_t cycles, const uint32_t* counts);
+
+private:
+  void write_header();
+
+  FILE* file;
+  uint32_t interval;
+  bool header_written;
+  std::vector<hpm_event_desc_t> events;
+};
+
+extern hpm_trace_t hpm_trace;
+
+#endif
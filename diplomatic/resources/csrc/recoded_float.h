@@ -0,0 +1,184 @@
+// See LICENSE.SiFive for license details.
+
+#ifndef RECODED_FLOAT_H
+#define RECODED_FLOAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// The recoded floating point format of berkeley-hardfloat, which rocket's
+// FPU keeps in its register file, and the NaN boxing of FPU.scala on top of
+// it. A recoded value of an EXP/SIG format has EXP + SIG + 1 bits: the sign,
+// an EXP + 1 bit exponent whose top 3 bits encode zero (000), subnormal and
+// normal (001 to 101), infinity (110) and NaN (111), and the SIG - 1 bit
+// fraction. Recoded doubles are 65 bits, their values are split into lo
+// (bits 63..0) and hi (bit 64, the sign), hi is 0 for the narrower formats.
+//
+// The scalar conversions are bit for bit those of recFNFromFN, fNFromRecFN,
+// FPU.recode and FPU.ieee. The batch conversions apply them to arrays in
+// loops without branches, which the compiler vectorizes for the target
+// (AVX2 with -march=native): the cosim unrecodes the register file writes of
+// the FPU in batches to compare them against spike.
+
+template <unsigned EXP, unsigned SIG>
+struct recoded_format_t
+{
+  static const unsigned IEEE_WIDTH = EXP + SIG;
+  static const unsigned RECODED_WIDTH = EXP + SIG + 1;
+
+  static constexpr uint64_t mask(unsigned bits) { return bits >= 64 ? ~0ull : (1ull << bits) - 1; }
+
+  static uint64_t sign(uint64_t lo, uint64_t hi)
+  {
+    if constexpr (EXP + SIG == 64)
+      return hi & 1;
+    else
+      return (lo >> (EXP + SIG)) & 1;
+  }
+
+  // the top 3 exponent bits are 111
+  static bool is_nan(uint64_t lo) { return ((lo >> (EXP + SIG - 3)) & 7) == 7; }
+
+  // fNFromRecFN, written with masks rather than branches so that the batch
+  // loops vectorize
+  static uint64_t ieee(uint64_t lo, uint64_t hi)
+  {
+    const uint64_t shift_mask = SIG - 1 <= 16 ? 15 : SIG - 1 <= 32 ? 31 : 63;  // log2Up(SIG - 1) bits
+    uint64_t exp = (lo >> (SIG - 1)) & mask(EXP + 1);
+    uint64_t fract = lo & mask(SIG - 1);
+    uint64_t code = exp >> (EXP - 2);
+    uint64_t is_zero = code == 0;
+    uint64_t is_special = (code >> 1) == 3;
+    uint64_t is_inf = is_special & ~code & 1;
+    uint64_t is_subnormal = 0 - (uint64_t) (exp < (1ull << (EXP - 1)) + 2);
+    uint64_t sig = (is_zero ^ 1) << (SIG - 1) | fract;
+
+    uint64_t denorm_fract = ((sig >> 1) >> ((1 - exp) & shift_mask)) & mask(SIG - 1);
+    uint64_t exp_out = (~is_subnormal & (exp - ((1ull << (EXP - 1)) + 1)) & mask(EXP)) | ((0 - is_special) & mask(EXP));
+    uint64_t fract_out = (is_subnormal & denorm_fract) | (~is_subnormal & (0 - (is_inf ^ 1)) & fract);
+    return sign(lo, hi) << (EXP + SIG - 1) | exp_out << (SIG - 1) | fract_out;
+  }
+
+  // recFNFromFN, of the low IEEE_WIDTH bits of in
+  static uint64_t recode(uint64_t in, uint64_t* hi)
+  {
+    uint64_t sign = (in >> (EXP + SIG - 1)) & 1;
+    uint64_t exp_in = (in >> (SIG - 1)) & mask(EXP);
+    uint64_t fract_in = in & mask(SIG - 1);
+    bool is_zero_exp = exp_in == 0;
+    bool is_zero_fract = fract_in == 0;
+    // countLeadingZeros of hardfloat is SIG - 2 for a zero fraction
+    unsigned norm_dist = is_zero_fract ? SIG - 2 : __builtin_clzll(fract_in) - (64 - (SIG - 1));
+    uint64_t subnorm_fract = ((fract_in << norm_dist) & mask(SIG - 2)) << 1;
+    uint64_t adjusted_exp = ((is_zero_exp ? norm_dist ^ mask(EXP + 1) : exp_in) +
+                             ((1ull << (EXP - 1)) | (is_zero_exp ? 2 : 1))) & mask(EXP + 1);
+    bool is_zero = is_zero_exp && is_zero_fract;
+    bool is_nan = (adjusted_exp >> (EXP - 1)) == 3 && !is_zero_fract;
+
+    uint64_t exp_out = ((is_zero ? 0 : adjusted_exp >> (EXP - 2)) | (is_nan ? 1 : 0)) << (EXP - 2) |
+                       (adjusted_exp & mask(EXP - 2));
+    uint64_t body = exp_out << (SIG - 1) | (is_zero_exp ? subnorm_fract : fract_in);
+    if constexpr (EXP + SIG == 64) {
+      *hi = sign;
+      return body;
+    } else {
+      *hi = 0;
+      return sign << (EXP + SIG) | body;
+    }
+  }
+
+  static void ieee_batch(const uint64_t* lo, const uint64_t* hi, uint64_t* out, size_t n)
+  {
+    for (size_t i = 0; i < n; i++)
+      out[i] = ieee(lo[i], hi[i]);
+  }
+
+  static void recode_batch(const uint64_t* in, uint64_t* lo, uint64_t* hi, size_t n)
+  {
+    for (size_t i = 0; i < n; i++)
+      lo[i] = recode(in[i], &hi[i]);
+  }
+};
+
+typedef recoded_format_t<5, 11> recoded_half_t;
+typedef recoded_format_t<8, 24> recoded_single_t;
+typedef recoded_format_t<11, 53> recoded_double_t;
+
+// The register file of an FPU whose floatTypes range from MIN_FLEN to FLEN
+// (16, 32 or 64): a narrower value is NaN-boxed in the widest format with
+// its own recoding swizzled into the NaN payload.
+template <unsigned MIN_FLEN, unsigned FLEN>
+struct fpu_recoding_t
+{
+  static_assert(MIN_FLEN <= FLEN && (FLEN == 16 || FLEN == 32 || FLEN == 64));
+
+  typedef recoded_format_t<FLEN == 16 ? 5 : FLEN == 32 ? 8 : 11, FLEN == 16 ? 11 : FLEN == 32 ? 24 : 53> format;
+  typedef fpu_recoding_t<MIN_FLEN, (FLEN > MIN_FLEN ? FLEN / 2 : FLEN)> prev;
+  static const unsigned SIG = FLEN == 16 ? 11 : FLEN == 32 ? 24 : 53;
+  static const unsigned PREV_RECODED_WIDTH = FLEN / 2 + 1;
+
+  // FPU.ieee(x, maxType), the IEEE value a store or fmv.x of FLEN bits sees
+  static uint64_t ieee(uint64_t lo, uint64_t hi)
+  {
+    uint64_t unrecoded = format::ieee(lo, hi);
+    if constexpr (FLEN == MIN_FLEN) {
+      return unrecoded;
+    } else {
+      uint64_t prev_recoded = ((lo >> (PREV_RECODED_WIDTH - 2)) & 1) << (PREV_RECODED_WIDTH - 1) |
+                              ((lo >> (SIG - 1)) & 1) << (PREV_RECODED_WIDTH - 2) |
+                              (lo & format::mask(PREV_RECODED_WIDTH - 2));
+      uint64_t low = format::is_nan(lo) ? prev::ieee(prev_recoded, 0) : unrecoded & format::mask(FLEN / 2);
+      return (unrecoded >> (FLEN / 2)) << (FLEN / 2) | low;
+    }
+  }
+
+  // FPU.recode(x, tag) of an FLEN bit load or fmv of a value of width bits,
+  // the bits above width are filled with ones as for a NaN-boxed value
+  static uint64_t recode(uint64_t in, unsigned width, uint64_t* hi)
+  {
+    if (width < FLEN)
+      in |= format::mask(FLEN) & ~format::mask(width);
+    return box(in, hi);
+  }
+
+  static void ieee_batch(const uint64_t* lo, const uint64_t* hi, uint64_t* out, size_t n)
+  {
+    for (size_t i = 0; i < n; i++)
+      out[i] = ieee(lo[i], hi[i]);
+  }
+
+private:
+  template <unsigned, unsigned> friend struct fpu_recoding_t;
+
+  // helper of FPU.recode: box(t.recode(x), t, helper(x, prevT), prevT)
+  static uint64_t box(uint64_t in, uint64_t* hi)
+  {
+    uint64_t x = format::recode(in, hi);
+    if constexpr (FLEN == MIN_FLEN) {
+      return x;
+    } else {
+      uint64_t prev_hi;
+      uint64_t y = prev::box(in, &prev_hi);
+      if (!format::is_nan(x))
+        return x;
+      // FPU.box(x, xt, y, yt), the fraction bits of x between the two
+      // widths are kept and their and-reduction replaces exponent bit
+      // EXP + SIG - 4
+      constexpr unsigned yr = PREV_RECODED_WIDTH;
+      constexpr unsigned top = FLEN;
+      uint64_t mid = (x >> (yr - 1)) & format::mask(SIG - yr);
+      bool mid_ones = mid == format::mask(SIG - yr);
+      uint64_t swizzled = (x & format::mask(top - 4) & ~format::mask(SIG)) |
+                          (uint64_t) mid_ones << (top - 4) |
+                          ((y >> (yr - 2)) & 1) << (SIG - 1) |
+                          mid << (yr - 1) |
+                          ((y >> (yr - 1)) & 1) << (yr - 2) |
+                          (y & format::mask(yr - 2));
+      // the sign and the top 3 exponent bits are those of x, the sign of a
+      // double is already in hi
+      return swizzled | (x & format::mask(top + 1) & ~format::mask(top - 3));
+    }
+  }
+};
+
+#endif
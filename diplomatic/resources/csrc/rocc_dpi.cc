@@ -0,0 +1,369 @@
+// See LICENSE.SiFive for license details.
+
+#include "rocc_dpi.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <svdpi.h>
+
+#include <algorithm>
+
+rocc_bridges_t rocc_bridges;
+
+// defined by the emulator main loop
+extern double sc_time_stamp();
+
+// M_XRD and M_XWR of MemoryOpConstants
+static const unsigned M_XRD = 0;
+static const unsigned M_XWR = 1;
+
+static std::map<std::string, rocc_factory_t>& registry()
+{
+  static std::map<std::string, rocc_factory_t> factories;
+  return factories;
+}
+
+rocc_registration_t::rocc_registration_t(const char* name, rocc_factory_t factory)
+{
+  registry()[name] = factory;
+}
+
+std::string rocc_bridge_t::models()
+{
+  std::string names;
+  for (auto& m : registry())
+    names += (names.empty() ? "" : ", ") + m.first;
+  return names;
+}
+
+rocc_bridge_t::~rocc_bridge_t()
+{
+  delete model;
+}
+
+bool rocc_bridge_t::configure(const std::string& spec)
+{
+  size_t colon = spec.find(':');
+  std::string model_name = spec.substr(0, colon);
+  if (model_name.empty())
+    model_name = "accumulator";
+  auto factory = registry().find(model_name);
+  if (factory == registry().end()) {
+    fprintf(stderr, "rocc: unknown model %s, known are %s\n", model_name.c_str(), models().c_str());
+    return false;
+  }
+
+  std::string keys = colon == std::string::npos ? "" : spec.substr(colon + 1);
+  for (size_t pos = 0; pos < keys.size();) {
+    size_t end = keys.find(',', pos);
+    if (end == std::string::npos)
+      end = keys.size();
+    std::string kv = keys.substr(pos, end - pos);
+    size_t eq = kv.find('=');
+    char* parsed = NULL;
+    unsigned long value = eq == std::string::npos ? 0 : strtoul(kv.c_str() + eq + 1, &parsed, 0);
+    std::string key = kv.substr(0, eq);
+    if (!parsed || *parsed || parsed == kv.c_str() + eq + 1) {
+      fprintf(stderr, "rocc: expected KEY=VALUE, got %s\n", kv.c_str());
+      return false;
+    }
+    if (key == "latency")
+      latency = value;
+    else if (key == "interval" && value > 0)
+      interval = value;
+    else if (key == "queue" && value > 0)
+      queue = value;
+    else if (key == "outstanding" && value > 0 && value <= MAX_TAGS)
+      outstanding = value;
+    else {
+      fprintf(stderr, "rocc: invalid %s\n", kv.c_str());
+      return false;
+    }
+    pos = end + 1;
+  }
+
+  delete model;
+  name = model_name;
+  model = factory->second();
+  reset();
+  return true;
+}
+
+void rocc_bridge_t::reset()
+{
+  next_accept = 0;
+  out = outputs_t();
+  executing.clear();
+  responses.clear();
+  mem_reqs.clear();
+  free_tags.clear();
+  for (unsigned t = 0; t < outstanding; t++)
+    free_tags.push_back(t);
+  issued.assign(MAX_TAGS, 0);
+  if (model)
+    model->reset();
+}
+
+int rocc_bridge_t::request(const mem_req_t& req)
+{
+  if (free_tags.empty())
+    return -1;
+  mem_reqs.push_back(req);
+  mem_reqs.back().tag = free_tags.front();
+  free_tags.pop_front();
+  uint64_t in_flight = outstanding - free_tags.size();
+  if (in_flight > stats.max_outstanding)
+    stats.max_outstanding = in_flight;
+  return mem_reqs.back().tag;
+}
+
+int rocc_bridge_t::load(uint64_t addr, unsigned size_log2, bool is_signed)
+{
+  stats.loads++;
+  return request({addr, 0, 0, M_XRD, size_log2, is_signed});
+}
+
+int rocc_bridge_t::store(uint64_t addr, uint64_t data, unsigned size_log2)
+{
+  stats.stores++;
+  return request({addr, data, 0, M_XWR, size_log2, false});
+}
+
+void rocc_bridge_t::respond(uint64_t data)
+{
+  if (executing.empty()) {
+    fprintf(stderr, "rocc: %s responded at cycle %lu without a command\n", name.c_str(), (unsigned long) now);
+    return;
+  }
+  const executing_t& e = executing.front();
+  uint64_t ready = std::max(now, e.accepted + latency);
+  stats.command_latency += ready - e.accepted;
+  if (e.cmd.xd())
+    responses.push_back({ready, e.cmd.rd(), data});
+  executing.pop_front();
+}
+
+rocc_bridge_t::outputs_t rocc_bridge_t::tick(const inputs_t& in)
+{
+  now = sc_time_stamp();
+  if (!model)
+    configure("");
+  if (in.reset) {
+    reset();
+    return out;
+  }
+
+  if (out.busy)
+    stats.busy_cycles++;
+  if (out.resp_valid && in.resp_ready)
+    responses.pop_front();
+  if (out.mem_req_valid && in.mem_req_ready) {
+    issued[mem_reqs.front().tag] = now;
+    mem_reqs.pop_front();
+  }
+  // SimpleHellaCacheIF replays nacked requests itself, a tag is free again
+  // with the response of its request, the one of a store without data
+  if (in.mem_resp_valid && in.mem_resp_tag < MAX_TAGS) {
+    free_tags.push_back(in.mem_resp_tag);
+    if (in.mem_resp_has_data) {
+      stats.mem_latency += now - issued[in.mem_resp_tag];
+      model->mem_response(*this, in.mem_resp_tag, in.mem_resp_data);
+    }
+  }
+  if (in.cmd_valid && out.cmd_ready) {
+    stats.commands++;
+    executing.push_back({in.cmd, now});
+    next_accept = now + interval;
+    model->command(*this, in.cmd);
+  } else if (in.cmd_valid) {
+    stats.cmd_stall_cycles++;
+  }
+  model->tick(*this);
+
+  out.cmd_ready = now + 1 >= next_accept && executing.size() < queue;
+  out.resp_valid = !responses.empty() && responses.front().ready <= now + 1;
+  if (out.resp_valid) {
+    out.resp_rd = responses.front().rd;
+    out.resp_data = responses.front().data;
+  }
+  out.mem_req_valid = !mem_reqs.empty();
+  if (out.mem_req_valid) {
+    const mem_req_t& r = mem_reqs.front();
+    out.mem_req_addr = r.addr;
+    out.mem_req_tag = r.tag;
+    out.mem_req_cmd = r.cmd;
+    out.mem_req_size = r.size;
+    out.mem_req_signed = r.is_signed;
+    out.mem_req_data = r.data;
+  }
+  out.busy = !executing.empty() || !responses.empty() || free_tags.size() < outstanding;
+  return out;
+}
+
+void rocc_bridge_t::report(FILE* f, const std::string& where) const
+{
+  fprintf(f, "rocc %s at %s: %lu commands, %lu busy cycles, %lu stall cycles, average command latency %.1f\n",
+          name.c_str(), where.c_str(), (unsigned long) stats.commands, (unsigned long) stats.busy_cycles,
+          (unsigned long) stats.cmd_stall_cycles,
+          stats.commands ? (double) stats.command_latency / stats.commands : 0.0);
+  fprintf(f, "rocc %s at %s: %lu loads, %lu stores, average load latency %.1f, up to %lu in flight\n",
+          name.c_str(), where.c_str(), (unsigned long) stats.loads, (unsigned long) stats.stores,
+          stats.loads ? (double) stats.mem_latency / stats.loads : 0.0, (unsigned long) stats.max_outstanding);
+}
+
+rocc_bridges_t::~rocc_bridges_t()
+{
+  for (auto& b : bridges)
+    delete b.second;
+}
+
+bool rocc_bridges_t::configure(const std::string& spec)
+{
+  rocc_bridge_t check;
+  if (!check.configure(spec))
+    return false;
+  this->spec = spec;
+  return true;
+}
+
+rocc_bridge_t* rocc_bridges_t::create(const std::string& scope)
+{
+  rocc_bridge_t* bridge = new rocc_bridge_t;
+  bridge->configure(spec);
+  // the harts of a multithreaded model tick their first cycle concurrently
+  std::lock_guard<std::mutex> guard(lock);
+  bridges.push_back(std::make_pair(scope, bridge));
+  return bridge;
+}
+
+void rocc_bridges_t::report(FILE* f)
+{
+  std::lock_guard<std::mutex> guard(lock);
+  for (auto& b : bridges)
+    b.second->report(f, b.first);
+}
+
+// the accumulator of vsrc/RoccBlackBox.v: rd = acc += rs1 + rs2
+class rocc_accumulator_t : public rocc_accelerator_t
+{
+public:
+  void reset() { acc = 0; }
+  void command(rocc_port_t& port, const rocc_command_t& cmd)
+  {
+    acc += cmd.rs1 + cmd.rs2;
+    port.respond(acc);
+  }
+
+private:
+  uint64_t acc = 0;
+};
+
+static rocc_registration_t accumulator("accumulator", [] () -> rocc_accelerator_t* { return new rocc_accumulator_t; });
+
+// rd = the sum of the rs2 doublewords at rs1, loaded with as many requests in
+// flight as the bridge allows; commands execute one after the other
+class rocc_memsum_t : public rocc_accelerator_t
+{
+public:
+  void reset() { jobs.clear(); }
+  void command(rocc_port_t& port, const rocc_command_t& cmd) { jobs.push_back({cmd.rs1, cmd.rs2, cmd.rs2, 0}); }
+
+  void mem_response(rocc_port_t& port, int tag, uint64_t data)
+  {
+    if (jobs.empty())
+      return;
+    jobs.front().sum += data;
+    jobs.front().to_return--;
+  }
+
+  void tick(rocc_port_t& port)
+  {
+    if (jobs.empty())
+      return;
+    job_t& job = jobs.front();
+    if (job.to_issue && port.can_issue()) {
+      port.load(job.addr, 3);
+      job.addr += 8;
+      job.to_issue--;
+    }
+    if (!job.to_return) {
+      port.respond(job.sum);
+      jobs.pop_front();
+    }
+  }
+
+private:
+  struct job_t
+  {
+    uint64_t addr;
+    uint64_t to_issue;
+    uint64_t to_return;
+    uint64_t sum;
+  };
+
+  std::deque<job_t> jobs;
+};
+
+static rocc_registration_t memsum("memsum", [] () -> rocc_accelerator_t* { return new rocc_memsum_t; });
+
+extern "C" void rocc_dpi_tick(
+  svBit reset,
+  svBit cmd_valid,
+  int cmd_inst,
+  long long cmd_rs1,
+  long long cmd_rs2,
+  svBit resp_ready,
+  svBit mem_req_ready,
+  svBit mem_resp_valid,
+  int mem_resp_tag,
+  svBit mem_resp_has_data,
+  long long mem_resp_data,
+  svBit exception,
+  svBit* cmd_ready,
+  svBit* resp_valid,
+  char* resp_rd,
+  long long* resp_data,
+  svBit* mem_req_valid,
+  long long* mem_req_addr,
+  int* mem_req_tag,
+  char* mem_req_cmd,
+  char* mem_req_size,
+  svBit* mem_req_signed,
+  long long* mem_req_data,
+  svBit* busy,
+  svBit* interrupt)
+{
+  rocc_bridge_t::inputs_t in;
+  in.reset = reset;
+  in.cmd_valid = cmd_valid;
+  in.cmd = {(uint32_t) cmd_inst, (uint64_t) cmd_rs1, (uint64_t) cmd_rs2};
+  in.resp_ready = resp_ready;
+  in.mem_req_ready = mem_req_ready;
+  in.mem_resp_valid = mem_resp_valid;
+  in.mem_resp_tag = mem_resp_tag;
+  in.mem_resp_has_data = mem_resp_has_data;
+  in.mem_resp_data = mem_resp_data;
+
+  // every instance keeps its bridge as the user data of its scope
+  svScope scope = svGetScope();
+  rocc_bridge_t* bridge = (rocc_bridge_t*) svGetUserData(scope, (void*) &rocc_bridges);
+  if (!bridge) {
+    bridge = rocc_bridges.create(svGetNameFromScope(scope));
+    svPutUserData(scope, (void*) &rocc_bridges, bridge);
+  }
+
+  rocc_bridge_t::outputs_t out = bridge->tick(in);
+  *cmd_ready = out.cmd_ready;
+  *resp_valid = out.resp_valid;
+  *resp_rd = out.resp_rd;
+  *resp_data = out.resp_data;
+  *mem_req_valid = out.mem_req_valid;
+  *mem_req_addr = out.mem_req_addr;
+  *mem_req_tag = out.mem_req_tag;
+  *mem_req_cmd = out.mem_req_cmd;
+  *mem_req_size = out.mem_req_size;
+  *mem_req_signed = out.mem_req_signed;
+  *mem_req_data = out.mem_req_data;
+  *busy = out.busy;
+  *interrupt = 0;
+}
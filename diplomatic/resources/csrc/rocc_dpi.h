@@ -0,0 +1,210 @@
+// See LICENSE.SiFive for license details.
+
+#ifndef ROCC_DPI_H
+#define ROCC_DPI_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// RoCC accelerators written in C++, driven by vsrc/RoccDpiBlackBox.v (the
+// DpiRoCCExample unit) through the real rocket pipeline and dcache. The
+// emulator picks one with --rocc=NAME[:KEY=VALUE,...]; the keys shape its
+// timing independently of the model:
+//   latency=N      cycles from accepting a command to its response (0)
+//   interval=N     cycles between two accepted commands (1)
+//   queue=N        commands accepted while earlier ones are executing (4)
+//   outstanding=N  memory requests in flight (8, at most MAX_TAGS); the
+//                  DpiRoCCExample memInflight bounds the ones at the dcache
+// A model sees every accepted command, every memory response and every cycle
+// through rocc_accelerator_t and acts through rocc_port_t. Every RoCC instance
+// of the model, one per hart, gets its own bridge and model.
+
+struct rocc_command_t
+{
+  uint32_t inst;
+  uint64_t rs1;
+  uint64_t rs2;
+
+  unsigned funct() const { return inst >> 25; }
+  unsigned rd() const { return (inst >> 7) & 0x1f; }
+  bool xd() const { return (inst >> 14) & 1; }
+  unsigned opcode() const { return inst & 0x7f; }
+};
+
+class rocc_port_t
+{
+public:
+  virtual ~rocc_port_t() {}
+
+  virtual uint64_t cycle() const = 0;
+  // whether a load or store can be issued this cycle
+  virtual bool can_issue() const = 0;
+  // queue a request of 1 << size_log2 bytes, returns its tag or -1 when
+  // every tag is in flight
+  virtual int load(uint64_t addr, unsigned size_log2, bool is_signed = false) = 0;
+  virtual int store(uint64_t addr, uint64_t data, unsigned size_log2) = 0;
+  // write rd of the oldest command still executing and retire it, every
+  // command retires with exactly one respond (rd is ignored without xd)
+  virtual void respond(uint64_t data) = 0;
+};
+
+class rocc_accelerator_t
+{
+public:
+  virtual ~rocc_accelerator_t() {}
+
+  virtual void reset() {}
+  virtual void command(rocc_port_t& port, const rocc_command_t& cmd) = 0;
+  // the data of a load, stores complete silently with their response
+  virtual void mem_response(rocc_port_t& port, int tag, uint64_t data) {}
+  virtual void tick(rocc_port_t& port) {}
+};
+
+typedef rocc_accelerator_t* (*rocc_factory_t)();
+
+// models register themselves under a name by defining a static instance
+struct rocc_registration_t
+{
+  rocc_registration_t(const char* name, rocc_factory_t factory);
+};
+
+struct rocc_stats_t
+{
+  uint64_t commands = 0;
+  uint64_t busy_cycles = 0;
+  // cycles a command waited for cmd_ready
+  uint64_t cmd_stall_cycles = 0;
+  uint64_t loads = 0;
+  uint64_t stores = 0;
+  // cycles from a load leaving the model to its response, summed
+  uint64_t mem_latency = 0;
+  uint64_t max_outstanding = 0;
+  uint64_t command_latency = 0;
+};
+
+class rocc_bridge_t : public rocc_port_t
+{
+public:
+  static const unsigned MAX_TAGS = 64;
+
+  rocc_bridge_t() : model(NULL), now(0) {}
+  ~rocc_bridge_t();
+
+  // NAME[:KEY=VALUE,...], an empty spec is the accumulator of RoccBlackBox.v
+  bool configure(const std::string& spec);
+  void report(FILE* out, const std::string& where) const;
+  static std::string models();
+
+  uint64_t cycle() const { return now; }
+  bool can_issue() const { return !free_tags.empty(); }
+  int load(uint64_t addr, unsigned size_log2, bool is_signed);
+  int store(uint64_t addr, uint64_t data, unsigned size_log2);
+  void respond(uint64_t data);
+
+  struct inputs_t
+  {
+    bool reset;
+    bool cmd_valid;
+    rocc_command_t cmd;
+    bool resp_ready;
+    bool mem_req_ready;
+    bool mem_resp_valid;
+    unsigned mem_resp_tag;
+    bool mem_resp_has_data;
+    uint64_t mem_resp_data;
+  };
+
+  struct outputs_t
+  {
+    bool cmd_ready;
+    bool resp_valid;
+    unsigned resp_rd;
+    uint64_t resp_data;
+    bool mem_req_valid;
+    uint64_t mem_req_addr;
+    unsigned mem_req_tag;
+    unsigned mem_req_cmd;
+    unsigned mem_req_size;
+    bool mem_req_signed;
+    uint64_t mem_req_data;
+    bool busy;
+  };
+
+  // one clock edge: the handshakes of in against the last outputs, then the
+  // outputs of the next cycle
+  outputs_t tick(const inputs_t& in);
+
+private:
+  struct mem_req_t
+  {
+    uint64_t addr;
+    uint64_t data;
+    unsigned tag;
+    unsigned cmd;
+    unsigned size;
+    bool is_signed;
+  };
+
+  struct executing_t
+  {
+    rocc_command_t cmd;
+    uint64_t accepted;
+  };
+
+  struct response_t
+  {
+    uint64_t ready;
+    unsigned rd;
+    uint64_t data;
+  };
+
+  void reset();
+  int request(const mem_req_t& req);
+
+  std::string name;
+  rocc_accelerator_t* model;
+  unsigned latency = 0;
+  unsigned interval = 1;
+  unsigned queue = 4;
+  unsigned outstanding = 8;
+
+  uint64_t now;
+  uint64_t next_accept = 0;
+  outputs_t out = {};
+  std::deque<executing_t> executing;
+  std::deque<response_t> responses;
+  std::deque<mem_req_t> mem_reqs;
+  // handed out oldest first: a tag is only reused after every other free one,
+  // long after the dcache and SimpleHellaCacheIF are done with it
+  std::deque<unsigned> free_tags;
+  std::vector<uint64_t> issued;
+  rocc_stats_t stats;
+};
+
+// the bridges of the RoCC instances, created on their first cycle
+class rocc_bridges_t
+{
+public:
+  ~rocc_bridges_t();
+
+  // the spec every instance is configured with, false if it is invalid
+  bool configure(const std::string& spec);
+  // the bridge of the instance at the hierarchical name scope
+  rocc_bridge_t* create(const std::string& scope);
+  void report(FILE* out);
+
+private:
+  std::string spec;
+  std::mutex lock;
+  std::vector<std::pair<std::string, rocc_bridge_t*> > bridges;
+};
+
+extern rocc_bridges_t rocc_bridges;
+
+#endif
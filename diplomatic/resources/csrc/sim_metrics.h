@@ -0,0 +1,115 @@
+// See LICENSE.SiFive for license details.
+
+#ifndef SIM_METRICS_H
+#define SIM_METRICS_H
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <new>
+#include <string>
+
+// Live counters of a running simulation, published through a file mapped
+// shared (put it on a tmpfs such as /dev/shm) so a reader such as
+// cosim/tools/src/simtop.cc can watch many jobs without disturbing them.
+//
+// The simulation only does relaxed stores into the mapping: no locks and no
+// syscalls on the hot path. Rates (IPC, KHz) and RSS are derived by the reader.
+
+struct sim_metrics_page_t
+{
+  static const uint32_t MAGIC = 0x4d54524b; // "KRTM"
+  static const uint32_t VERSION = 1;
+
+  enum status_t : uint64_t { RUNNING = 0, PASSED = 1, FAILED = 2 };
+
+  uint32_t magic;
+  uint32_t version;
+  int32_t pid;
+  char kind[20];                  // "emulator" or "cosim"
+  uint64_t start_ns;              // CLOCK_MONOTONIC when the run started
+
+  std::atomic<uint64_t> status;
+  std::atomic<uint64_t> cycle;
+  std::atomic<uint64_t> insns;    // committed instructions, 0 if not observable
+  std::atomic<uint64_t> queue_depth;
+  std::atomic<uint64_t> tl_outstanding;
+};
+
+class sim_metrics_t
+{
+public:
+  sim_metrics_t() : page(&dummy), fd(-1) {}
+
+  ~sim_metrics_t() { close(); }
+
+  // Create the page at path. On failure the counters keep going to a private
+  // dummy page, so writers never have to check whether metrics are enabled.
+  bool open(const std::string& path, const char* kind)
+  {
+    // the page a previous run left is unlinked, not truncated under the
+    // watchers which still map it
+    unlink(path.c_str());
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+      return false;
+    if (ftruncate(fd, sizeof(sim_metrics_page_t)) != 0) {
+      ::close(fd);
+      fd = -1;
+      return false;
+    }
+    void* p = mmap(NULL, sizeof(sim_metrics_page_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      fd = -1;
+      return false;
+    }
+    sim_metrics_page_t* shared = new (p) sim_metrics_page_t();
+    shared->pid = getpid();
+    strncpy(shared->kind, kind, sizeof(shared->kind) - 1);
+    shared->start_ns = now_ns();
+    shared->version = sim_metrics_page_t::VERSION;
+    // the magic is written last, a reader ignores the page until then
+    std::atomic_thread_fence(std::memory_order_release);
+    shared->magic = sim_metrics_page_t::MAGIC;
+    page = shared;
+    return true;
+  }
+
+  // Unmap the page. The file stays with the final status for watchers, the
+  // next run opening the same path replaces it.
+  void close()
+  {
+    if (fd < 0)
+      return;
+    munmap(page, sizeof(sim_metrics_page_t));
+    ::close(fd);
+    page = &dummy;
+    fd = -1;
+  }
+
+  void set_cycle(uint64_t v) { page->cycle.store(v, std::memory_order_relaxed); }
+  void set_insns(uint64_t v) { page->insns.store(v, std::memory_order_relaxed); }
+  void set_queue_depth(uint64_t v) { page->queue_depth.store(v, std::memory_order_relaxed); }
+  void set_tl_outstanding(uint64_t v) { page->tl_outstanding.store(v, std::memory_order_relaxed); }
+  void set_status(sim_metrics_page_t::status_t v) { page->status.store(v, std::memory_order_relaxed); }
+
+  static uint64_t now_ns()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+  }
+
+private:
+  sim_metrics_page_t* page;
+  sim_metrics_page_t dummy;
+  int fd;
+};
+
+#endif
@@ -0,0 +1,110 @@
+// See LICENSE.SiFive for license details.
+//VCS coverage exclude_file
+
+import "DPI-C" function void commit_trace_retire
+(
+  input int     hartid,
+  input int     timer,
+  input byte    priv,
+  input bit     valid,
+  input bit     excpt,
+  input longint pc,
+  input int     inst,
+  input bit     wrenx,
+  input bit     wrenf,
+  input byte    wrdst,
+  input longint wrdata,
+  input byte    rd0src,
+  input longint rd0val,
+  input byte    rd1src,
+  input longint rd1val
+);
+
+import "DPI-C" function void commit_trace_late_write
+(
+  input int     hartid,
+  input int     timer,
+  input byte    wrdst,
+  input longint wrdata
+);
+
+// Hands every retire of a CoreMonitorBundle, and the long latency write backs
+// of a second one, to the emulator's binary commit trace (csrc/commit_trace.cc).
+module CommitTrace #(
+  parameter XLEN = 64,
+  parameter DLEN = 64
+) (
+  input             commit_clock,
+  input             commit_reset,
+  input             commit_excpt,
+  input [2:0]       commit_priv_mode,
+  input [XLEN-1:0]  commit_hartid,
+  input [31:0]      commit_timer,
+  input             commit_valid,
+  input [XLEN-1:0]  commit_pc,
+  input [4:0]       commit_wrdst,
+  input [DLEN-1:0]  commit_wrdata,
+  input             commit_wrenx,
+  input             commit_wrenf,
+  input [4:0]       commit_rd0src,
+  input [XLEN-1:0]  commit_rd0val,
+  input [4:0]       commit_rd1src,
+  input [XLEN-1:0]  commit_rd1val,
+  input [31:0]      commit_inst,
+
+  input             late_clock,
+  input             late_reset,
+  input             late_excpt,
+  input [2:0]       late_priv_mode,
+  input [XLEN-1:0]  late_hartid,
+  input [31:0]      late_timer,
+  input             late_valid,
+  input [XLEN-1:0]  late_pc,
+  input [4:0]       late_wrdst,
+  input [DLEN-1:0]  late_wrdata,
+  input             late_wrenx,
+  input             late_wrenf,
+  input [4:0]       late_rd0src,
+  input [XLEN-1:0]  late_rd0val,
+  input [4:0]       late_rd1src,
+  input [XLEN-1:0]  late_rd1val,
+  input [31:0]      late_inst
+);
+
+  wire [63:0] __pc = commit_pc;
+  wire [63:0] __wrdata = commit_wrdata;
+  wire [63:0] __rd0val = commit_rd0val;
+  wire [63:0] __rd1val = commit_rd1val;
+  wire [63:0] __late_wrdata = late_wrdata;
+
+  always @(posedge commit_clock) begin
+    if (!commit_reset && (commit_valid || commit_excpt)) begin
+      commit_trace_retire(
+        commit_hartid[31:0],
+        commit_timer,
+        {5'b0, commit_priv_mode},
+        commit_valid,
+        commit_excpt,
+        __pc,
+        commit_inst,
+        commit_wrenx,
+        commit_wrenf,
+        {3'b0, commit_wrdst},
+        __wrdata,
+        {3'b0, commit_rd0src},
+        __rd0val,
+        {3'b0, commit_rd1src},
+        __rd1val
+      );
+    end
+    if (!late_reset && late_wrenx && late_wrdst != 5'b0) begin
+      commit_trace_late_write(
+        late_hartid[31:0],
+        late_timer,
+        {3'b0, late_wrdst},
+        __late_wrdata
+      );
+    end
+  end
+
+endmodule
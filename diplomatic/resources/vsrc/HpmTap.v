@@ -0,0 +1,61 @@
+// See LICENSE.SiFive for license details.
+//VCS coverage exclude_file
+
+import "DPI-C" function int hpm_trace_init
+(
+  input int    hartid,
+  input int    n_events,
+  input string events
+);
+
+import "DPI-C" function void hpm_trace_sample
+(
+  input int         hartid,
+  input int         cycles,
+  input bit [2047:0] counts
+);
+
+// Counts up to 64 events and hands the counts of the last `cycles` cycles to
+// the emulator (csrc/hpm_trace.cc) every interval, and the counts of the last
+// partial interval when the simulation finishes. hpm_trace_init returns the
+// interval, nothing is counted when it is 0.
+module HpmTap #(
+  parameter N_EVENTS = 1,
+  parameter EVENTS = ""
+) (
+  input                clock,
+  input                reset,
+  input [31:0]         hartid,
+  input [N_EVENTS-1:0] events
+);
+
+  bit started = 1'b0;
+  int interval = 0;
+  int elapsed = 0;
+  bit [2047:0] counts = 2048'b0;
+
+  always @(posedge clock) begin
+    if (!reset) begin
+      if (!started) begin
+        interval = hpm_trace_init(hartid, N_EVENTS, EVENTS);
+        started = 1'b1;
+      end
+      if (interval != 0) begin
+        for (int i = 0; i < N_EVENTS; i++)
+          counts[i*32 +: 32] = counts[i*32 +: 32] + {31'b0, events[i]};
+        elapsed = elapsed + 1;
+        if (elapsed == interval) begin
+          hpm_trace_sample(hartid, elapsed, counts);
+          counts = 2048'b0;
+          elapsed = 0;
+        end
+      end
+    end
+  end
+
+  final begin
+    if (elapsed != 0)
+      hpm_trace_sample(hartid, elapsed, counts);
+  end
+
+endmodule
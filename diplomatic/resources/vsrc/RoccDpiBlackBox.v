@@ -0,0 +1,285 @@
+// See LICENSE.SiFive for license details.
+//VCS coverage exclude_file
+
+import "DPI-C" context function void rocc_dpi_tick
+(
+  input  bit     reset,
+  input  bit     cmd_valid,
+  input  int     cmd_inst,
+  input  longint cmd_rs1,
+  input  longint cmd_rs2,
+  input  bit     resp_ready,
+  input  bit     mem_req_ready,
+  input  bit     mem_resp_valid,
+  input  int     mem_resp_tag,
+  input  bit     mem_resp_has_data,
+  input  longint mem_resp_data,
+  input  bit     exception,
+  output bit     cmd_ready,
+  output bit     resp_valid,
+  output byte    resp_rd,
+  output longint resp_data,
+  output bit     mem_req_valid,
+  output longint mem_req_addr,
+  output int     mem_req_tag,
+  output byte    mem_req_cmd,
+  output byte    mem_req_size,
+  output bit     mem_req_signed,
+  output longint mem_req_data,
+  output bit     busy,
+  output bit     interrupt
+);
+
+// A RoCC unit whose behaviour is a C++ model of the emulator (csrc/rocc_dpi.h),
+// instantiated by DpiRoCCExample with the ports of RoccBlackBox. rocc_dpi_tick
+// sees the inputs of every cycle and returns the registered outputs of the
+// next one; as a context function it finds the model of its own instance.
+// Memory requests go through the SimpleHellaCacheIF of the tile, which
+// replays nacks and keeps at most memInflight of them in flight, so s1/s2
+// kill and s1 data are unused; the PTW and FPU ports are tied off.
+module RoccDpiBlackBox
+  #( parameter xLen = 64,
+     PRV_SZ = 2,
+     coreMaxAddrBits = 40,
+     dcacheReqTagBits = 9,
+     M_SZ = 5,
+     mem_req_bits_size_width = 2,
+     coreDataBits = 64,
+     coreDataBytes = 8,
+     paddrBits = 32,
+     vaddrBitsExtended = 40,
+     FPConstants_RM_SZ = 3,
+     fLen = 64,
+     FPConstants_FLAGS_SZ  = 5)
+  ( input clock,
+    input reset,
+    output rocc_cmd_ready,
+    input rocc_cmd_valid,
+    input [6:0] rocc_cmd_bits_inst_funct,
+    input [4:0] rocc_cmd_bits_inst_rs2,
+    input [4:0] rocc_cmd_bits_inst_rs1,
+    input rocc_cmd_bits_inst_xd,
+    input rocc_cmd_bits_inst_xs1,
+    input rocc_cmd_bits_inst_xs2,
+    input [4:0] rocc_cmd_bits_inst_rd,
+    input [6:0] rocc_cmd_bits_inst_opcode,
+    input [xLen-1:0] rocc_cmd_bits_rs1,
+    input [xLen-1:0] rocc_cmd_bits_rs2,
+    input rocc_cmd_bits_status_debug,
+    input rocc_cmd_bits_status_cease,
+    input rocc_cmd_bits_status_wfi,
+    input [31:0] rocc_cmd_bits_status_isa,
+    input [PRV_SZ-1:0] rocc_cmd_bits_status_dprv,
+    input rocc_cmd_bits_status_dv,
+    input [PRV_SZ-1:0] rocc_cmd_bits_status_prv,
+    input rocc_cmd_bits_status_v,
+    input rocc_cmd_bits_status_sd,
+    input [22:0] rocc_cmd_bits_status_zero2,
+    input rocc_cmd_bits_status_mpv,
+    input rocc_cmd_bits_status_gva,
+    input rocc_cmd_bits_status_mbe,
+    input rocc_cmd_bits_status_sbe,
+    input [1:0] rocc_cmd_bits_status_sxl,
+    input [1:0] rocc_cmd_bits_status_uxl,
+    input rocc_cmd_bits_status_sd_rv32,
+    input [7:0] rocc_cmd_bits_status_zero1,
+    input rocc_cmd_bits_status_tsr,
+    input rocc_cmd_bits_status_tw,
+    input rocc_cmd_bits_status_tvm,
+    input rocc_cmd_bits_status_mxr,
+    input rocc_cmd_bits_status_sum,
+    input rocc_cmd_bits_status_mprv,
+    input [1:0] rocc_cmd_bits_status_xs,
+    input [1:0] rocc_cmd_bits_status_fs,
+    input [1:0] rocc_cmd_bits_status_vs,
+    input [1:0] rocc_cmd_bits_status_mpp,
+    input [0:0] rocc_cmd_bits_status_spp,
+    input rocc_cmd_bits_status_mpie,
+    input rocc_cmd_bits_status_ube,
+    input rocc_cmd_bits_status_spie,
+    input rocc_cmd_bits_status_upie,
+    input rocc_cmd_bits_status_mie,
+    input rocc_cmd_bits_status_hie,
+    input rocc_cmd_bits_status_sie,
+    input rocc_cmd_bits_status_uie,
+    input rocc_resp_ready,
+    output rocc_resp_valid,
+    output [4:0] rocc_resp_bits_rd,
+    output [xLen-1:0] rocc_resp_bits_data,
+    input rocc_mem_req_ready,
+    output rocc_mem_req_valid,
+    output [coreMaxAddrBits-1:0] rocc_mem_req_bits_addr,
+    output [dcacheReqTagBits-1:0] rocc_mem_req_bits_tag,
+    output [M_SZ-1:0] rocc_mem_req_bits_cmd,
+    output [mem_req_bits_size_width-1:0] rocc_mem_req_bits_size,
+    output rocc_mem_req_bits_signed,
+    output rocc_mem_req_bits_phys,
+    output rocc_mem_req_bits_no_alloc,
+    output rocc_mem_req_bits_no_xcpt,
+    output [1:0] rocc_mem_req_bits_dprv,
+    output rocc_mem_req_bits_dv,
+    output [coreDataBits-1:0] rocc_mem_req_bits_data,
+    output [coreDataBytes-1:0] rocc_mem_req_bits_mask,
+    output rocc_mem_s1_kill,
+    output [coreDataBits-1:0] rocc_mem_s1_data_data,
+    output [coreDataBytes-1:0] rocc_mem_s1_data_mask,
+    input rocc_mem_s2_nack,
+    input rocc_mem_s2_nack_cause_raw,
+    output rocc_mem_s2_kill,
+    input rocc_mem_s2_uncached,
+    input [paddrBits-1:0] rocc_mem_s2_paddr,
+    input [vaddrBitsExtended-1:0] rocc_mem_s2_gpa,
+    input rocc_mem_s2_gpa_is_pte,
+    input rocc_mem_resp_valid,
+    input [coreMaxAddrBits-1:0] rocc_mem_resp_bits_addr,
+    input [dcacheReqTagBits-1:0] rocc_mem_resp_bits_tag,
+    input [M_SZ-1:0] rocc_mem_resp_bits_cmd,
+    input [mem_req_bits_size_width-1:0] rocc_mem_resp_bits_size,
+    input rocc_mem_resp_bits_signed,
+    input [coreDataBits-1:0] rocc_mem_resp_bits_data,
+    input [coreDataBytes-1:0] rocc_mem_resp_bits_mask,
+    input rocc_mem_resp_bits_replay,
+    input rocc_mem_resp_bits_has_data,
+    input [coreDataBits-1:0] rocc_mem_resp_bits_data_word_bypass,
+    input [coreDataBits-1:0] rocc_mem_resp_bits_data_raw,
+    input [coreDataBits-1:0] rocc_mem_resp_bits_store_data,
+    input [1:0] rocc_mem_resp_bits_dprv,
+    input rocc_mem_resp_bits_dv,
+    input rocc_mem_replay_next,
+    input rocc_mem_s2_xcpt_ma_ld,
+    input rocc_mem_s2_xcpt_ma_st,
+    input rocc_mem_s2_xcpt_pf_ld,
+    input rocc_mem_s2_xcpt_pf_st,
+    input rocc_mem_s2_xcpt_gf_ld,
+    input rocc_mem_s2_xcpt_gf_st,
+    input rocc_mem_s2_xcpt_ae_ld,
+    input rocc_mem_s2_xcpt_ae_st,
+    input rocc_mem_ordered,
+    input rocc_mem_perf_acquire,
+    input rocc_mem_perf_release,
+    input rocc_mem_perf_grant,
+    input rocc_mem_perf_tlbMiss,
+    input rocc_mem_perf_blocked,
+    input rocc_mem_perf_canAcceptStoreThenLoad,
+    input rocc_mem_perf_canAcceptStoreThenRMW,
+    input rocc_mem_perf_canAcceptLoadThenLoad,
+    input rocc_mem_perf_storeBufferEmptyAfterLoad,
+    input rocc_mem_perf_storeBufferEmptyAfterStore,
+    output rocc_mem_keep_clock_enabled,
+    input rocc_mem_clock_enabled,
+    output rocc_busy,
+    output rocc_interrupt,
+    input rocc_exception,
+    input rocc_fpu_req_ready,
+    output rocc_fpu_req_valid,
+    output rocc_fpu_req_bits_ldst,
+    output rocc_fpu_req_bits_wen,
+    output rocc_fpu_req_bits_ren1,
+    output rocc_fpu_req_bits_ren2,
+    output rocc_fpu_req_bits_ren3,
+    output rocc_fpu_req_bits_swap12,
+    output rocc_fpu_req_bits_swap23,
+    output [1:0] rocc_fpu_req_bits_typeTagIn,
+    output [1:0] rocc_fpu_req_bits_typeTagOut,
+    output rocc_fpu_req_bits_fromint,
+    output rocc_fpu_req_bits_toint,
+    output rocc_fpu_req_bits_fastpipe,
+    output rocc_fpu_req_bits_fma,
+    output rocc_fpu_req_bits_div,
+    output rocc_fpu_req_bits_sqrt,
+    output rocc_fpu_req_bits_wflags,
+    output [FPConstants_RM_SZ-1:0] rocc_fpu_req_bits_rm,
+    output [1:0] rocc_fpu_req_bits_fmaCmd,
+    output [1:0] rocc_fpu_req_bits_typ,
+    output [1:0] rocc_fpu_req_bits_fmt,
+    output [fLen:0] rocc_fpu_req_bits_in1,
+    output [fLen:0] rocc_fpu_req_bits_in2,
+    output [fLen:0] rocc_fpu_req_bits_in3,
+    output rocc_fpu_resp_ready,
+    input rocc_fpu_resp_valid,
+    input [fLen:0] rocc_fpu_resp_bits_data,
+    input [FPConstants_FLAGS_SZ-1:0] rocc_fpu_resp_bits_exc );
+
+  bit cmd_ready_r = 1'b0;
+  bit resp_valid_r = 1'b0;
+  byte resp_rd_r = 8'b0;
+  longint resp_data_r = 64'b0;
+  bit mem_req_valid_r = 1'b0;
+  longint mem_req_addr_r = 64'b0;
+  int mem_req_tag_r = 0;
+  byte mem_req_cmd_r = 8'b0;
+  byte mem_req_size_r = 8'b0;
+  bit mem_req_signed_r = 1'b0;
+  longint mem_req_data_r = 64'b0;
+  bit busy_r = 1'b0;
+  bit interrupt_r = 1'b0;
+  reg [1:0] dprv = 2'b0;
+  reg dv = 1'b0;
+
+  always @(posedge clock) begin
+    // requests are translated with the privilege of the command which caused them
+    if (rocc_cmd_valid && rocc_cmd_ready) begin
+      dprv <= rocc_cmd_bits_status_dprv;
+      dv <= rocc_cmd_bits_status_dv;
+    end
+    rocc_dpi_tick(
+      reset,
+      rocc_cmd_valid,
+      {rocc_cmd_bits_inst_funct, rocc_cmd_bits_inst_rs2, rocc_cmd_bits_inst_rs1, rocc_cmd_bits_inst_xd,
+       rocc_cmd_bits_inst_xs1, rocc_cmd_bits_inst_xs2, rocc_cmd_bits_inst_rd, rocc_cmd_bits_inst_opcode},
+      longint'(rocc_cmd_bits_rs1),
+      longint'(rocc_cmd_bits_rs2),
+      rocc_resp_ready,
+      rocc_mem_req_ready,
+      rocc_mem_resp_valid,
+      int'(rocc_mem_resp_bits_tag),
+      rocc_mem_resp_bits_has_data,
+      longint'(rocc_mem_resp_bits_data),
+      rocc_exception,
+      cmd_ready_r,
+      resp_valid_r,
+      resp_rd_r,
+      resp_data_r,
+      mem_req_valid_r,
+      mem_req_addr_r,
+      mem_req_tag_r,
+      mem_req_cmd_r,
+      mem_req_size_r,
+      mem_req_signed_r,
+      mem_req_data_r,
+      busy_r,
+      interrupt_r);
+  end
+
+  assign rocc_cmd_ready = cmd_ready_r;
+
+  assign rocc_resp_valid = resp_valid_r;
+  assign rocc_resp_bits_rd = resp_rd_r[4:0];
+  assign rocc_resp_bits_data = resp_data_r[xLen-1:0];
+
+  assign rocc_mem_req_valid = mem_req_valid_r;
+  assign rocc_mem_req_bits_addr = mem_req_addr_r[coreMaxAddrBits-1:0];
+  assign rocc_mem_req_bits_tag = mem_req_tag_r[dcacheReqTagBits-1:0];
+  assign rocc_mem_req_bits_cmd = mem_req_cmd_r[M_SZ-1:0];
+  assign rocc_mem_req_bits_size = mem_req_size_r[mem_req_bits_size_width-1:0];
+  assign rocc_mem_req_bits_signed = mem_req_signed_r;
+  assign rocc_mem_req_bits_phys = 1'b0;
+  assign rocc_mem_req_bits_no_alloc = 1'b0;
+  assign rocc_mem_req_bits_no_xcpt = 1'b0;
+  assign rocc_mem_req_bits_dprv = dprv;
+  assign rocc_mem_req_bits_dv = dv;
+  assign rocc_mem_req_bits_data = mem_req_data_r[coreDataBits-1:0];
+  assign rocc_mem_req_bits_mask = {coreDataBytes{1'b0}};
+  assign rocc_mem_s1_kill = 1'b0;
+  assign rocc_mem_s1_data_data = {coreDataBits{1'b0}};
+  assign rocc_mem_s1_data_mask = {coreDataBytes{1'b0}};
+  assign rocc_mem_s2_kill = 1'b0;
+  assign rocc_mem_keep_clock_enabled = 1'b1;
+
+  assign rocc_busy = busy_r;
+  assign rocc_interrupt = interrupt_r;
+
+  assign rocc_fpu_req_valid = 1'b0;
+  assign rocc_fpu_resp_ready = 1'b1;
+
+endmodule
@@ -0,0 +1,40 @@
+// See LICENSE.SiFive for license details.
+
+/** Simulation model of AsyncResetReg for Verilator, selected by the cosim
+  * emulator build in place of ../AsyncResetReg.v.
+  *
+  * While rst is high the output is the reset value and every edge of clk
+  * resets the register, so a reset held over a clock edge, as every harness
+  * holds it, resets it without a rising edge of rst. No initial block has to
+  * guess the reset at time 0 and the harness needs no extra async reset
+  * pulses.
+  *
+  *  @param d Data input
+  *  @param q Data Output
+  *  @param clk Clock Input
+  *  @param rst Reset Input
+  *  @param en Write Enable Input
+  */
+
+module AsyncResetReg (d, q, en, clk, rst);
+parameter RESET_VALUE = 0;
+
+input  wire d;
+output wire q;
+input  wire en;
+input  wire clk;
+input  wire rst;
+
+   reg q_r;
+
+   always @(posedge clk or posedge rst) begin
+      if (rst) begin
+         q_r <= RESET_VALUE[0];
+      end else if (en) begin
+         q_r <= d;
+      end
+   end
+
+   assign q = rst ? RESET_VALUE[0] : q_r;
+
+endmodule // AsyncResetReg
@@ -0,0 +1,27 @@
+// See LICENSE.SiFive for license details.
+
+/** Simulation model of ClockDivider2 for Verilator, selected by the cosim
+  * emulator build in place of ../ClockDivider2.v.
+  *
+  * The divided clock is the input clock gated on every other cycle, the
+  * enable toggling on the falling edge. It rises on the same edges as the
+  * blocking assignment of the original, in the same evaluation as the input
+  * clock, but is high for half an input cycle only: logic on the falling
+  * edge of the divided clock sees it earlier.
+  *
+  *  @param clk_out Divided Clock
+  *  @param clk_in  Clock Input
+  */
+
+module ClockDivider2 (output clk_out, input clk_in);
+
+   reg en;
+
+   initial en = 1'b1;
+   always @(negedge clk_in) begin
+      en <= ~en;
+   end
+
+   assign clk_out = clk_in & en;
+
+endmodule // ClockDivider2
@@ -0,0 +1,25 @@
+// See LICENSE.SiFive for license details.
+
+/** Simulation model of ClockDivider3 for Verilator, selected by the cosim
+  * emulator build in place of ../ClockDivider3.v.
+  *
+  * The divided clock is the input clock gated on every third cycle, like
+  * the original it rises on the first input edge and every third one after
+  * it. It is high for half an input cycle instead of two.
+  *
+  *  @param clk_out Divided Clock
+  *  @param clk_in  Clock Input
+  */
+
+module ClockDivider3 (output clk_out, input clk_in);
+
+   reg [1:0] phase;
+
+   initial phase = 2'd0;
+   always @(negedge clk_in) begin
+      phase <= phase == 2'd2 ? 2'd0 : phase + 2'd1;
+   end
+
+   assign clk_out = clk_in & (phase == 2'd0);
+
+endmodule // ClockDivider3
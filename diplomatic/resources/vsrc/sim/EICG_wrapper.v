@@ -0,0 +1,34 @@
+// See LICENSE.SiFive for license details.
+
+/** Simulation model of EICG_wrapper for Verilator, selected by the cosim
+  * emulator build in place of ../EICG_wrapper.v.
+  *
+  * The enable is captured by a flop on the falling edge of the input clock
+  * instead of a latch which is open while it is low. The enable of a clock
+  * gate is launched by the rising edge of the same clock, so both hold the
+  * same value at the next rising edge and the gated clock pulses on the same
+  * edges; there is no combinational loop left for Verilator to iterate.
+  *
+  *  @param out     Gated Clock
+  *  @param en      Clock Enable
+  *  @param test_en Test Mode Clock Enable
+  *  @param in      Clock Input
+  */
+
+module EICG_wrapper(
+  output out,
+  input en,
+  input test_en,
+  input in
+);
+
+  reg en_latched;
+
+  initial en_latched = 1'b0;
+  always @(negedge in) begin
+     en_latched <= en || test_en;
+  end
+
+  assign out = en_latched && in;
+
+endmodule
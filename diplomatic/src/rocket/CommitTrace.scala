@@ -0,0 +1,21 @@
+// See LICENSE.SiFive for license details.
+
+package org.chipsalliance.rocket
+
+import chisel3._
+import chisel3.experimental.IntParam
+import chisel3.util.HasBlackBoxResource
+import freechips.rocketchip.util._
+
+/** Streams retired instructions to the emulator's binary commit trace through DPI,
+  * see csrc/commit_trace.h. `commit` samples retires, `late` long latency write backs.
+  */
+class CommitTrace(xLen: Int, fLen: Int)
+  extends BlackBox(Map("XLEN" -> IntParam(xLen), "DLEN" -> IntParam(xLen max fLen)))
+  with HasBlackBoxResource {
+  val io = IO(new Bundle {
+    val commit = Input(new CoreMonitorBundle(xLen, fLen))
+    val late = Input(new CoreMonitorBundle(xLen, fLen))
+  })
+  addResource("/vsrc/CommitTrace.v")
+}
@@ -19,6 +19,8 @@ class EventSet(val gate: (UInt, UInt) => Bool, val events: Seq[(String, () => Bo
     for (((name, _), i) <- events.zipWithIndex)
       when (check(1.U << i)) { printf(s"Event $name\n") }
   }
+  /** every event gated on its own, as a counter selecting only that event would count it */
+  def sample(): Seq[Bool] = events.indices.map(i => check(1.U << i))
   def withCovers: Unit = {
     events.zipWithIndex.foreach {
       case ((name, func), i) => property.cover(gate((1.U << i), (func() << i)), name)
@@ -51,6 +53,10 @@ class EventSets(val eventSets: Seq[EventSet]) {
 
   def cover() = eventSets.foreach { _.withCovers }
 
+  /** "set:name" of every event, in the bit order of sample() */
+  def names: Seq[String] = eventSets.zipWithIndex.flatMap { case (e, set) => e.events.map(ev => s"$set:${ev._1}") }
+  def sample(): UInt = VecInit(eventSets.flatMap(_.sample())).asUInt
+
   private def eventSetIdBits = log2Ceil(eventSets.size)
   private def maxEventSetIdBits = 8
 
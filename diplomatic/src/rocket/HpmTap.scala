@@ -0,0 +1,24 @@
+// See LICENSE.SiFive for license details.
+
+package org.chipsalliance.rocket
+
+import chisel3._
+import chisel3.experimental.{IntParam, StringParam}
+import chisel3.util.HasBlackBoxResource
+
+/** Counts every event of an [[EventSets]] in simulation and hands the counts to the emulator's
+  * HPM trace through DPI every interval, see csrc/hpm_trace.h.
+  */
+class HpmTap(names: Seq[String])
+  extends BlackBox(Map("N_EVENTS" -> IntParam(names.size), "EVENTS" -> StringParam(names.mkString(","))))
+  with HasBlackBoxResource {
+  require(names.size <= 64, s"HpmTap samples at most 64 events, got ${names.size}")
+  require(names.forall(!_.contains(",")), "event names must not contain ','")
+  val io = IO(new Bundle {
+    val clock = Input(Clock())
+    val reset = Input(Bool())
+    val hartid = Input(UInt(32.W))
+    val events = Input(UInt(names.size.W))
+  })
+  addResource("/vsrc/HpmTap.v")
+}
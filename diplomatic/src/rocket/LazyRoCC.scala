@@ -57,7 +57,8 @@ class RoCCIO(val nPTWPorts: Int)(implicit p: Parameters) extends RoCCCoreIO()(p)
 abstract class LazyRoCC(
       val opcodes: OpcodeSet,
       val nPTWPorts: Int = 0,
-      val usesFPU: Boolean = false
+      val usesFPU: Boolean = false,
+      val memInflight: Int = 2
     )(implicit p: Parameters) extends LazyModule {
   val module: LazyRoCCModuleImp
   val atlNode: TLNode = TLIdentityNode()
@@ -89,7 +90,7 @@ trait HasLazyRoCCModule extends CanHavePTWModule
     outer.roccs.zipWithIndex.foreach { case (rocc, i) =>
       rocc.module.io.ptw ++=: ptwPorts
       rocc.module.io.cmd <> cmdRouter.io.out(i)
-      val dcIF = Module(new SimpleHellaCacheIF()(outer.p))
+      val dcIF = Module(new SimpleHellaCacheIF(rocc.memInflight)(outer.p))
       dcIF.io.requestor <> rocc.module.io.mem
       dcachePorts += dcIF.io.cache
       respArb.io.in(i) <> Queue(rocc.module.io.resp)
@@ -331,8 +332,8 @@ class CharacterCountExampleModuleImp(outer: CharacterCountExample)(implicit p: P
   tl_out.e.valid := false.B
 }
 
-class BlackBoxExample(opcodes: OpcodeSet, blackBoxFile: String)(implicit p: Parameters)
-    extends LazyRoCC(opcodes) {
+class BlackBoxExample(opcodes: OpcodeSet, blackBoxFile: String, memInflight: Int = 2)(implicit p: Parameters)
+    extends LazyRoCC(opcodes, memInflight = memInflight) {
   override lazy val module = new BlackBoxExampleModuleImp(this, blackBoxFile)
 }
 
@@ -383,6 +384,12 @@ class BlackBoxExampleModuleImp(outer: BlackBoxExample, blackBoxFile: String)(imp
 
 }
 
+/** A RoCC unit modelled in C++ by the emulator, see csrc/rocc_dpi.h; memInflight bounds the requests it has in flight
+  * at the dcache.
+  */
+class DpiRoCCExample(opcodes: OpcodeSet, memInflight: Int = 8)(implicit p: Parameters)
+    extends BlackBoxExample(opcodes, "RoccDpiBlackBox", memInflight)
+
 class OpcodeSet(val opcodes: Seq[UInt]) {
   def |(set: OpcodeSet) =
     new OpcodeSet(this.opcodes ++ set.opcodes)
@@ -51,7 +51,9 @@ case class RocketCoreParams(
   mvendorid: Int = 0, // 0 means non-commercial implementation
   mimpid: Int = 0x20181004, // release date in BCD
   mulDiv: Option[MulDivParams] = Some(MulDivParams()),
-  fpu: Option[FPUParams] = Some(FPUParams())
+  fpu: Option[FPUParams] = Some(FPUParams()),
+  commitTrace: Boolean = false, // stream retires to the emulator through DPI instead of the commit printf
+  hpmTrace: Boolean = false // sample every perf event into the emulator's HPM trace through DPI
 ) extends CoreParams {
   val lgPauseCycles = 5
   val haveFSDirty = false
@@ -985,6 +987,14 @@ class Rocket(tile: RocketTile)(implicit p: Parameters) extends CoreModule()(p)
   val icache_blocked = !(io.imem.resp.valid || RegNext(io.imem.resp.valid))
   csr.io.counters foreach { c => c.inc := RegNext(perfEvents.evaluate(c.eventSel)) }
 
+  if (rocketParams.hpmTrace) {
+    val hpmTap = Module(new HpmTap(perfEvents.names))
+    hpmTap.io.clock := clock
+    hpmTap.io.reset := reset
+    hpmTap.io.hartid := io.hartid
+    hpmTap.io.events := perfEvents.sample()
+  }
+
   val coreMonitorBundle = Wire(new CoreMonitorBundle(xLen, fLen))
 
   coreMonitorBundle.clock := clock
@@ -1031,7 +1041,7 @@ class Rocket(tile: RocketTile)(implicit p: Parameters) extends CoreModule()(p)
       printf ("x%d p%d 0x%x\n", rf_waddr, rf_waddr, rf_wdata)
     }
   }
-  else {
+  else if (!rocketParams.commitTrace) {
     when (csr.io.trace(0).valid) {
       printf("C%d: %d [%d] pc=[%x] W[r%d=%x][%d] R[r%d=%x] R[r%d=%x] inst=[%x] DASM(%x)\n",
          io.hartid, coreMonitorBundle.timer, coreMonitorBundle.valid,
@@ -1068,6 +1078,12 @@ class Rocket(tile: RocketTile)(implicit p: Parameters) extends CoreModule()(p)
   xrfWriteBundle.excpt := false.B
   xrfWriteBundle.priv_mode := csr.io.trace(0).priv
 
+  if (rocketParams.commitTrace) {
+    val commitTrace = Module(new CommitTrace(xLen, fLen))
+    commitTrace.io.commit := coreMonitorBundle
+    commitTrace.io.late := xrfWriteBundle
+  }
+
   PlusArg.timeout(
     name = "max_core_cycles",
     docstring = "Kill the emulation after INT rdtime cycles. Off if 0."
@@ -91,8 +91,8 @@ class SimpleHellaCacheIFReplayQueue(depth: Int)
   when (nack_head || replay_complete) { replaying := false.B }
 }
 
-// exposes a sane decoupled request interface
-class SimpleHellaCacheIF(implicit p: Parameters) extends Module
+// exposes a sane decoupled request interface, with up to depth requests in flight
+class SimpleHellaCacheIF(depth: Int = 2)(implicit p: Parameters) extends Module
 {
   val io = IO(new Bundle {
     val requestor = Flipped(new HellaCacheIO())
@@ -100,7 +100,7 @@ class SimpleHellaCacheIF(implicit p: Parameters) extends Module
   })
   io <> DontCare
 
-  val replayq = Module(new SimpleHellaCacheIFReplayQueue(2))
+  val replayq = Module(new SimpleHellaCacheIFReplayQueue(depth))
   val req_arb = Module(new Arbiter(new HellaCacheReq, 2))
 
   val req_helper = DecoupledHelper(
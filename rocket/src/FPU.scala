@@ -798,15 +798,15 @@ class FPU(hartId: Int, xLen: Int, p: FPUParams, usingClockGating: Boolean, enabl
 
   // regfile
   val regfile = Mem(32, Bits((p.fLen+1).W))
+  val load_wb_wdata = recode(load_wb_data, load_wb_typeTag)
   when (load_wb) {
-    val wdata = recode(load_wb_data, load_wb_typeTag)
-    regfile(load_wb_tag) := wdata
-    assert(consistent(wdata))
+    regfile(load_wb_tag) := load_wb_wdata
+    assert(consistent(load_wb_wdata))
     if (enableCommitLog)
       printf("f%d p%d 0x%x\n", load_wb_tag, load_wb_tag + 32.U, load_wb_data)
     frfWriteBundle(0).wrdst := load_wb_tag
     frfWriteBundle(0).wrenf := true.B
-    frfWriteBundle(0).wrdata := ieee(wdata)
+    frfWriteBundle(0).wrdata := ieee(load_wb_wdata)
   }
 
   val ex_rs = ex_ra.map(a => regfile(a))
@@ -952,7 +952,8 @@ class FPU(hartId: Int, xLen: Int, p: FPUParams, usingClockGating: Boolean, enabl
   val wtypeTag = Mux(divSqrt_wen, divSqrt_typeTag, wbInfo(0).typeTag)
   val wdata = box(Mux(divSqrt_wen, divSqrt_wdata, VecInit(pipes.map(_.res.data): Seq[UInt])(wbInfo(0).pipeid)), wtypeTag)
   val wexc = VecInit(pipes.map(_.res.exc): Seq[UInt])(wbInfo(0).pipeid)
-  when ((!wbInfo(0).cp && wen(0)) || divSqrt_wen) {
+  val wb_wen = (!wbInfo(0).cp && wen(0)) || divSqrt_wen
+  when (wb_wen) {
     assert(consistent(wdata))
     regfile(waddr) := wdata
     if (enableCommitLog) {
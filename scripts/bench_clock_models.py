@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+
+# Benchmark of the Verilator thread speedup of the cosim emulator with the clocking blackboxes of
+# diplomatic/resources/vsrc against their simulation models in vsrc/sim, on the gated-clock config
+# (COSIM_CLOCK_GATE=1). Every variant is built once with mill, copied aside, and runs the same test REPEAT
+# times; the fastest run counts. Prints one CSV row per variant.
+#
+# bench_clock_models.py [--xlen 64] [--threads 1,2,4,8] [--repeat 3] BIN ENTRANCE_BIN PASS_ADDRESS
+#
+# BIN, ENTRANCE_BIN and PASS_ADDRESS are those tests.riscvtests.run passes in COSIM_bin, COSIM_entrance_bin and
+# passaddress, a longer test gives steadier numbers. No waves are written.
+
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def build(xlen, models, threads, dest):
+    env = dict(os.environ, COSIM_CLOCK_GATE="1", SIM_CLOCK_MODELS=models, EMULATOR_THREADS=str(threads))
+    out = subprocess.run(["mill", "-i", "show", f"cosim.emulator[{xlen}].elf"], env=env, check=True,
+                         stdout=subprocess.PIPE, text=True).stdout
+    # show prints the PathRef as "ref:<hash>:<path>"
+    path = out.strip().strip('"').split(":")[-1]
+    shutil.copy(path, dest)
+    return dest
+
+
+def run(elf, xlen, args, repeat):
+    env = dict(os.environ,
+               COSIM_bin=args.bin,
+               COSIM_entrance_bin=args.entrance_bin,
+               COSIM_wave="",
+               COSIM_reset_vector="80000000",
+               COSIM_timeout="100000000",
+               passaddress=args.pass_address,
+               xlen=xlen)
+    best = None
+    for _ in range(repeat):
+        start = time.monotonic()
+        p = subprocess.run([elf], env=env, stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+        seconds = time.monotonic() - start
+        if p.returncode != 0:
+            sys.exit(f"{elf} failed with exit code {p.returncode}")
+        best = seconds if best is None else min(best, seconds)
+    return best
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--xlen", default="64")
+    parser.add_argument("--threads", default="1,2,4,8")
+    parser.add_argument("--repeat", type=int, default=3)
+    parser.add_argument("bin")
+    parser.add_argument("entrance_bin")
+    parser.add_argument("pass_address")
+    args = parser.parse_args()
+    threads = [int(t) for t in args.threads.split(",")]
+
+    results = {}
+    with tempfile.TemporaryDirectory() as tmp:
+        for models in ["0", "1"]:
+            for t in threads:
+                elf = build(args.xlen, models, t, os.path.join(tmp, f"TestBench-{models}-{t}"))
+                results[models, t] = run(elf, args.xlen, args, args.repeat)
+
+    baseline = results["0", threads[0]]
+    print("clock_models,threads,seconds,thread_speedup,speedup")
+    for (models, t), seconds in results.items():
+        print(f"{'sim' if models == '1' else 'blackbox'},{t},{seconds:.2f},"
+              f"{results[models, threads[0]] / seconds:.2f},{baseline / seconds:.2f}")
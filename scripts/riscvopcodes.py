@@ -1,8 +1,138 @@
 #!/usr/bin/env python3
 
+import re
+
 from constants import *
 from parse import *
 
+# extensions rocket decodes, see IDecode.scala and RVC.scala
+cxx_extensions = ["i", "m", "a", "f", "d", "zfh", "d_zfh", "c", "c_d", "c_f", "zicsr", "zifencei", "system", "s",
+                  "svinval", "h", "zba", "zbb", "zbc", "zbs", "zbkb", "zbkc", "zbkx", "zknd", "zkne", "zknh", "zksed",
+                  "zksh"]
+cxx_fp_extensions = ["f", "d", "q", "zfh", "d_zfh", "q_zfh", "c_d", "c_f"]
+# fp insns whose rd is an integer register
+cxx_int_rd = re.compile(r"^(fmv\.x\.|fclass\.|fcvt\.(w|wu|l|lu)\.|feq\.|flt\.|fle\.)")
+cxx_rvc_addr = {
+    "c.lw": "ADDR_C_LW", "c.flw": "ADDR_C_LW", "c.sw": "ADDR_C_LW", "c.fsw": "ADDR_C_LW",
+    "c.ld": "ADDR_C_LD", "c.fld": "ADDR_C_LD", "c.sd": "ADDR_C_LD", "c.fsd": "ADDR_C_LD",
+    "c.lwsp": "ADDR_C_LWSP", "c.flwsp": "ADDR_C_LWSP", "c.ldsp": "ADDR_C_LDSP", "c.fldsp": "ADDR_C_LDSP",
+    "c.swsp": "ADDR_C_SWSP", "c.fswsp": "ADDR_C_SWSP", "c.sdsp": "ADDR_C_SDSP", "c.fsdsp": "ADDR_C_SDSP",
+}
+
+
+def cxx_classify(name, instr):
+    exts = [e.split("_", 1)[1] for e in instr["extension"]]
+    fields = instr["variable_fields"]
+    mask, match = int(instr["mask"], 16), int(instr["match"], 16)
+    compressed = match & 3 != 3
+    flags, addr, rd = [], "ADDR_NONE", "RD_NONE"
+    if compressed:
+        flags.append("COMPRESSED")
+        addr = cxx_rvc_addr.get(name, addr)
+        if addr != "ADDR_NONE":
+            flags.append("STORE" if re.match(r"c\.f?s", name) else "LOAD")
+        if name in ["c.jal", "c.jalr"]:
+            rd = "RD_RA"
+        elif name == "c.addi16sp" or any(f in fields for f in ["rd", "rd_n0", "rd_n2", "rd_rs1", "rd_rs1_n0"]):
+            rd = "RD"
+        elif "rd_p" in fields:
+            rd = "RD_C_RS2S"
+        elif "rd_rs1_p" in fields:
+            rd = "RD_C_RS1S"
+    else:
+        opcode = match & 0x7f
+        if opcode in [0x03, 0x07] or name.startswith("hlv"):
+            flags.append("LOAD")
+        if opcode in [0x23, 0x27] or name.startswith("hsv"):
+            flags.append("STORE")
+        if opcode in [0x03, 0x07]:
+            addr = "ADDR_I"
+        elif opcode in [0x23, 0x27]:
+            addr = "ADDR_S"
+        elif opcode == 0x2f or name.startswith("hlv") or name.startswith("hsv"):
+            addr = "ADDR_RS1"
+        if "rd" in fields:
+            rd = "RD"
+    if "a" in exts:
+        flags.append("AMO")
+    if "zicsr" in exts:
+        flags.append("CSR")
+    if "m" in exts:
+        flags.append("LONG_LATENCY")
+    if any(e in cxx_fp_extensions for e in exts):
+        flags.append("FP")
+        if rd != "RD_NONE" and not cxx_int_rd.match(name):
+            flags.append("FP_RD")
+    return mask, match, flags, addr, rd
+
+
+def cxx_slots(entries, lsb, width):
+    slots = [[] for _ in range(1 << width)]
+    for i, (mask, match) in entries:
+        fm, fv = (mask >> lsb) & ((1 << width) - 1), (match >> lsb) & ((1 << width) - 1)
+        for s in range(1 << width):
+            if s & fm == fv:
+                slots[s].append(i)
+    return slots
+
+
+def cxx_decoder(instrs):
+    """constexpr tables of C++ for cosim/emulator/src/insn_decode.h: the insns, and a two level dispatch on them. The
+    first level is the major opcode of 32 bit insns and the quadrant and funct3 of compressed ones, the second one the
+    field of the insn that splits each first level bucket best."""
+    insns = []
+    for xlens, d in instrs:
+        for name, instr in d.items():
+            if not any(e.split("_", 1)[1] in cxx_extensions for e in instr["extension"]):
+                continue
+            mask, match, flags, addr, rd = cxx_classify(name, instr)
+            insns.append((name, mask, match, flags, addr, xlens, rd))
+    insns.sort(key=lambda e: (e[2] & 3 != 3, e[0]))
+
+    buckets, slots, index, ranges = [], [], [], {}
+    for key in range(56):
+        if key < 32:
+            entries = [(i, (e[1], e[2])) for i, e in enumerate(insns) if e[2] & 3 == 3 and (e[2] >> 2) & 31 == key]
+            candidates = [(lsb, w) for w in range(1, 8) for lsb in range(7, 33 - w)]
+        else:
+            q, f3 = (key - 32) // 8, (key - 32) % 8
+            entries = [(i, (e[1], e[2])) for i, e in enumerate(insns) if e[2] & 3 == q and (e[2] >> 13) & 7 == f3]
+            candidates = [(lsb, w) for w in range(1, 8) for lsb in range(2, 14 - w)]
+        lsb, width = 0, 0
+        if len(entries) > 1:
+            def cost(c):
+                s = cxx_slots(entries, *c)
+                return max(len(x) for x in s), sum(len(x) for x in s), c[1]
+            lsb, width = min(candidates, key=cost)
+        buckets.append((len(slots), lsb, width))
+        for s in cxx_slots(entries, lsb, width):
+            # the most specific encoding first, e.g. c.ebreak before c.jalr before c.add
+            s = tuple(sorted(s, key=lambda i: (-bin(insns[i][1]).count("1"), insns[i][0])))
+            if s not in ranges:
+                ranges[s] = (len(index), len(s))
+                index.extend(s)
+            slots.append(ranges[s])
+
+    out = ("// Generated by scripts/riscvopcodes.py from riscv-opcodes, do not edit.\n"
+           "// Included by insn_decode.h, which declares the types.\n\n"
+           "#pragma once\n\n"
+           "inline constexpr riscv_insn_t riscv_insns[] = {\n")
+    for name, mask, match, flags, addr, xlens, rd in insns:
+        fl = " | ".join([f"riscv_insn_t::RV{x}" for x in sorted(xlens)] + [f"riscv_insn_t::{f}" for f in flags])
+        out += f'    {{"{name}", {mask:#010x}, {match:#010x}, {fl}, riscv_insn_t::{addr}, riscv_insn_t::{rd}}},\n'
+    out += "};\n\ninline constexpr riscv_decode_bucket_t riscv_decode_buckets[] = {\n"
+    for base, lsb, width in buckets:
+        out += f"    {{{base}, {lsb}, {width}}},\n"
+    out += "};\n\ninline constexpr riscv_decode_slot_t riscv_decode_slots[] = {\n"
+    for i in range(0, len(slots), 8):
+        out += "    " + " ".join(f"{{{start}, {count}}}," for start, count in slots[i:i + 8]) + "\n"
+    out += "};\n\ninline constexpr uint16_t riscv_decode_index[] = {\n"
+    for i in range(0, len(index), 16):
+        out += "    " + " ".join(f"{x}," for x in index[i:i + 16]) + "\n"
+    out += "};"
+    return out
+
+
 if __name__ == "__main__":
     tpe = sys.argv[1]
     if tpe in ["rv64*", "rv32*", "rv_*"]:
@@ -57,3 +187,6 @@ if __name__ == "__main__":
 '''
         csr_names_str += "}"
         print(csr_names_str)
+    if tpe in ["cxx"]:
+        print(cxx_decoder([([32, 64], create_inst_dict(["rv_*"], False)), ([32], create_inst_dict(["rv32*"], False)),
+                           ([64], create_inst_dict(["rv64*"], False))]))